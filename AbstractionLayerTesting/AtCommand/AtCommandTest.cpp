@@ -0,0 +1,288 @@
+//Modules
+#include "OperatingSystemModule.hpp"
+//Applications
+#include "Log.hpp"
+#include "AtResponseParser.hpp"
+#include "ByteScanner.hpp"
+#include "RingBuffer.hpp"
+//C++
+#include <cassert>
+#include <chrono>
+#include <vector>
+
+static const char TAG[] = "AtCommandTest";
+
+using Result = AtResponseSettings::Result;
+
+//A byte at a time so that every line and line ending is split across calls.
+static void parseByteByByte(AtResponseParser &parser, std::string_view data) {
+    for (char byte : data) {
+        parser.parse(std::string_view(&byte, 1));
+    }
+}
+
+static int responseTest() {
+    AtResponseParser parser;
+
+    parser.beginCommand("AT+CSQ");
+    parseByteByByte(parser, "\r\n+CSQ: 20,99\r\n\r\nOK\r\n");
+    assert(parser.responseComplete());
+
+    const AtResponseSettings::Response &response = parser.responseConst();
+    if (1 != response.lines.size() || "+CSQ: 20,99" != response.lines[0] || Result::Ok != response.result || !response.succeeded()) {
+        CBT_LOGE(TAG, "AT+CSQ response was not parsed");
+        return EXIT_FAILURE;
+    }
+
+    //Basic commands have no prefix so every line is part of the response.
+    parser.beginCommand("ATI");
+    assert(ErrorType::Success == parser.parse("\r\nQuectel\r\nEC21\r\nRevision: EC21AFAR06A01M4G\r\n\r\nOK\r\n"));
+    assert(parser.responseComplete() && 3 == parser.responseConst().lines.size());
+    assert("Revision: EC21AFAR06A01M4G" == parser.responseConst().lines[2]);
+
+    parser.beginCommand("AT+QIACT=1");
+    assert(ErrorType::Success == parser.parse("\r\n+CME ERROR: 30\r\n"));
+    assert(parser.responseComplete() && Result::CmeError == parser.responseConst().result && !parser.responseConst().succeeded());
+    assert("+CME ERROR: 30" == parser.responseConst().finalLine);
+
+    return EXIT_SUCCESS;
+}
+
+static int urcTest() {
+    AtResponseParser parser;
+    std::vector<std::string> recv;
+    std::vector<std::string> registration;
+
+    assert(ErrorType::Success == parser.addUrcHandler("+QIURC:", [&recv](std::string_view urc) { recv.emplace_back(urc); }));
+    assert(ErrorType::Success == parser.addUrcHandler("+CREG:", [&registration](std::string_view urc) { registration.emplace_back(urc); }));
+    assert(ErrorType::FileExists == parser.addUrcHandler("+CREG:", [](std::string_view urc) {}));
+
+    //Unsolicited with nothing pending.
+    parseByteByByte(parser, "\r\n+QIURC: \"recv\",0\r\n");
+    assert(1 == recv.size() && "+QIURC: \"recv\",0" == recv[0]);
+
+    //In the middle of a response, and +CREG: is the command's own answer even though there's a handler for it.
+    parser.beginCommand("AT+CREG?");
+    parseByteByByte(parser, "\r\n+CREG: 0,5\r\n\r\n+QIURC: \"recv\",1\r\n\r\nOK\r\n");
+    assert(parser.responseComplete());
+    assert(1 == parser.responseConst().lines.size() && "+CREG: 0,5" == parser.responseConst().lines[0]);
+    assert(2 == recv.size() && "+QIURC: \"recv\",1" == recv[1]);
+    assert(registration.empty());
+    parser.endCommand();
+
+    //The same line is a URC when it isn't the answer to anything.
+    assert(ErrorType::Success == parser.parse("\r\n+CREG: 1\r\n"));
+    assert(1 == registration.size() && "+CREG: 1" == registration[0]);
+
+    assert(ErrorType::Success == parser.removeUrcHandler("+CREG:"));
+    assert(ErrorType::NoData == parser.removeUrcHandler("+CREG:"));
+    assert(ErrorType::Success == parser.parse("\r\n+CREG: 2\r\n"));
+    assert(1 == registration.size() && 1 == parser.unhandledLines());
+
+    return EXIT_SUCCESS;
+}
+
+static int promptTest() {
+    AtResponseParser parser;
+    AtResponseSettings::Expectation expectation;
+    expectation.prompt = true;
+
+    //The prompt has no line ending and whatever comes after it belongs to the next command.
+    parser.beginCommand("AT+QISEND=0,5", expectation);
+    assert(ErrorType::Success == parser.parse("> \r\nSEND OK\r\n"));
+    assert(parser.responseComplete() && Result::Prompt == parser.responseConst().result);
+
+    parser.beginCommand("");
+    assert(!parser.responseComplete());
+    assert(ErrorType::Success == parser.process());
+    assert(parser.responseComplete() && Result::SendOk == parser.responseConst().result);
+    assert(0 == parser.unhandledLines());
+
+    return EXIT_SUCCESS;
+}
+
+static int payloadTest() {
+    AtResponseParser parser;
+    AtResponseSettings::Expectation expectation;
+    expectation.payload = true;
+    std::vector<std::string> recv;
+    parser.addUrcHandler("+QIURC:", [&recv](std::string_view urc) { recv.emplace_back(urc); });
+
+    //The payload looks like lines and result codes but is taken as it is.
+    const std::string payload("ab\r\nOK\r\n+QIURC: x");
+    parser.beginCommand("AT+QIRD=0,1500", expectation);
+    parseByteByByte(parser, std::string("\r\n+QIRD: ").append(std::to_string(payload.size())).append("\r\n").append(payload).append("\r\n\r\nOK\r\n"));
+    assert(parser.responseComplete() && Result::Ok == parser.responseConst().result);
+    if (payload != parser.payload()) {
+        CBT_LOGE(TAG, "Payload was not taken as it is");
+        return EXIT_FAILURE;
+    }
+    assert(recv.empty());
+    parser.endCommand();
+    assert(parser.payload().empty());
+
+    //Nothing to read.
+    parser.beginCommand("AT+QIRD=0,1500", expectation);
+    assert(ErrorType::Success == parser.parse("\r\n+QIRD: 0\r\n\r\nOK\r\n"));
+    assert(parser.responseComplete() && parser.payload().empty());
+
+    //The payload is left in the ring buffer and whatever follows the response is still there for the next command.
+    const std::string large(AtResponseParser::MaxPayloadLength, 'z');
+    parser.beginCommand("AT+QIRD=1,1500", expectation);
+    assert(ErrorType::Success == parser.parse(std::string("\r\n+QIRD: 1500\r\n").append(large, 0, 1000)));
+    assert(!parser.responseComplete() && std::string_view(large).substr(0, 1000) == parser.payload());
+    assert(ErrorType::Success == parser.parse(std::string(large, 1000).append("\r\n\r\nOK\r\n\r\n+QIURC: \"recv\",1\r\n")));
+    assert(parser.responseComplete() && large == parser.payload() && recv.empty());
+    parser.endCommand();
+    assert(ErrorType::Success == parser.process());
+    assert(1 == recv.size() && "+QIURC: \"recv\",1" == recv[0]);
+
+    return EXIT_SUCCESS;
+}
+
+static int longLineTest() {
+    AtResponseParser parser(32);
+
+    parser.beginCommand("ATI");
+    assert(ErrorType::LimitReached == parser.parse(std::string(100, 'x').append("\r\n")));
+    assert(ErrorType::Success == parser.parse("\r\nshort\r\nOK\r\n"));
+    assert(parser.responseComplete() && 1 == parser.responseConst().lines.size() && "short" == parser.responseConst().lines[0]);
+
+    return EXIT_SUCCESS;
+}
+
+static int throughputTest() {
+    AtResponseParser parser;
+    Count urcs = 0;
+    parser.addUrcHandler("+QIURC:", [&urcs](std::string_view urc) { urcs++; });
+
+    //Lines arrive in pieces that don't line up with the line endings. Each byte is looked at once so this stays linear.
+    std::string stream;
+    constexpr Count Lines = 20000;
+    for (Count i = 0; i < Lines; i++) {
+        stream.append("\r\n+QIURC: \"recv\",").append(std::to_string(i % 12)).append("\r\n");
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    constexpr Bytes Chunk = 7;
+    for (Bytes i = 0; i < stream.size(); i += Chunk) {
+        parser.parse(std::string_view(stream).substr(i, Chunk));
+    }
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    assert(Lines == urcs);
+    CBT_LOGI(TAG, "Parsed %u bytes in %f seconds", stream.size(), elapsed);
+
+    return EXIT_SUCCESS;
+}
+
+static int scannerTest() {
+    //Every length and every position of the delimiter so that the vector loops and the tails are all covered.
+    std::string data(201, 'a');
+    for (size_t offset = 0; offset < 40; offset++) {
+        for (size_t length = 0; offset + length < data.size(); length++) {
+            const std::string_view view = std::string_view(data).substr(offset, length);
+            if (std::string_view::npos != ByteScanner::find(view, '\n') || std::string_view::npos != ByteScanner::findEither(view, '\r', '\n')) {
+                CBT_LOGE(TAG, "Found a delimiter that isn't there at offset %u, length %u", offset, length);
+                return EXIT_FAILURE;
+            }
+
+            for (size_t position = 0; position < length; position++) {
+                //The line ending after it must not be found first.
+                data[offset + position] = '\n';
+                data[offset + position + 1] = '\r';
+                assert(position == ByteScanner::find(view, '\n'));
+                assert(position == ByteScanner::findEither(view, '\r', '\n'));
+                data[offset + position] = 'a';
+                data[offset + position + 1] = 'a';
+            }
+        }
+    }
+
+    //Bytes with the top bit set are compared as bytes and not as signed numbers.
+    assert(33 == ByteScanner::find(std::string(33, '\x7f') + "\xff", '\xff'));
+
+    //A ring buffer is searched where it is, across the wrap around the end of its storage.
+    RingBuffer ring(64, 64);
+    assert(ErrorType::Success == ring.write(std::string(48, 'x')));
+    ring.consume(40);
+    assert(ErrorType::Success == ring.write(std::string(30, 'y') + "\n" + std::string(10, 'z') + "\n"));
+    assert(38 == ring.find('\n') && 38 == ring.find('\n', 38) && 49 == ring.find('\n', 39));
+    assert(std::string_view::npos == ring.find('\n', 50) && std::string_view::npos == ring.find('q'));
+    assert(0 == ring.find('x') && 8 == ring.find('y', 3) && 39 == ring.find('z', 20));
+
+    //Every way that the readable bytes can wrap is put back in order when they're needed in one piece.
+    std::string expected;
+    for (Bytes i = 0; i < 64; i++) {
+        expected.push_back(static_cast<char>('A' + i % 58));
+    }
+    for (Bytes head = 1; head < 64; head++) {
+        for (Bytes size = 64 - head; size <= 64; size++) {
+            RingBuffer wrapped(64, 64);
+            //Consuming everything would rewind the head so the first byte is kept.
+            assert(ErrorType::Success == wrapped.write(std::string(head, '-') + expected[0]));
+            wrapped.consume(head);
+            assert(ErrorType::Success == wrapped.write(std::string_view(expected).substr(1, size - 1)));
+            if (std::string_view(expected).substr(0, size) != wrapped.contiguous()) {
+                CBT_LOGE(TAG, "Ring buffer bytes out of order with the head at %u and %u bytes", head, size);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static int longLineThroughputTest() {
+    AtResponseParser parser(8192);
+    Count urcs = 0;
+    parser.addUrcHandler("+QIURC:", [&urcs](std::string_view urc) { urcs++; });
+
+    //Long lines are where finding the line ending matters most.
+    std::string stream;
+    constexpr Count Lines = 2000;
+    const std::string padding(4000, 'p');
+    for (Count i = 0; i < Lines; i++) {
+        stream.append("+QIURC: \"").append(padding).append("\"\r\n");
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    constexpr Bytes Chunk = 1500;
+    for (Bytes i = 0; i < stream.size(); i += Chunk) {
+        parser.parse(std::string_view(stream).substr(i, Chunk));
+    }
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    assert(Lines == urcs);
+    CBT_LOGI(TAG, "Parsed %u bytes of long lines in %f seconds", stream.size(), elapsed);
+
+    return EXIT_SUCCESS;
+}
+
+static int runAllTests() {
+    std::vector<std::function<int(void)>> tests = {
+        responseTest,
+        urcTest,
+        promptTest,
+        payloadTest,
+        longLineTest,
+        throughputTest,
+        scannerTest,
+        longLineThroughputTest
+    };
+
+    for (auto test : tests) {
+        if (EXIT_SUCCESS != test()) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int main() {
+    OperatingSystem::Init();
+    Logger::Init();
+
+    return runAllTests();
+}
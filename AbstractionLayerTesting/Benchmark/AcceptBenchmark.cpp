@@ -0,0 +1,165 @@
+//Modules
+#include "OperatingSystemModule.hpp"
+#include "IpServerModule.hpp"
+//Applications
+#include "Log.hpp"
+//Posix
+#include <netinet/in.h>
+#include <unistd.h>
+//C++
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+static const char TAG[] = "AcceptBenchmark";
+static constexpr Port ServerPort = 44300;
+static constexpr Count ClientThreads = 4;
+static constexpr Count ConnectionsPerClient = 500;
+static constexpr Milliseconds RunTimeout = 5000;
+static constexpr Count MaxWorkers = 4;
+static constexpr Count LatencyEvents = 100;
+
+static std::atomic<Count> accepted(0);
+static std::array<std::atomic<Count>, MaxWorkers> acceptedByWorker;
+static std::atomic<Count> connectFailures(0);
+
+static void *startClientThread(void *arg) {
+    struct sockaddr_in address = {};
+    //Reset instead of closing gracefully. Otherwise thousands of ephemeral ports are left in TIME_WAIT, some of which are the
+    //fixed ports that the other tests listen on.
+    const struct linger reset = {.l_onoff = 1, .l_linger = 0};
+
+    address.sin_family = AF_INET;
+    address.sin_port = htons(ServerPort);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    for (Count i = 0; i < ConnectionsPerClient; i++) {
+        const Socket sock = socket(AF_INET, SOCK_STREAM, 0);
+        setsockopt(sock, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+        if (0 != connect(sock, reinterpret_cast<struct sockaddr *>(&address), sizeof(address))) {
+            connectFailures++;
+        }
+        close(sock);
+    }
+
+    return nullptr;
+}
+
+static int runBenchmark(const Count workers) {
+    IpServer server;
+    const Count connections = ClientThreads * ConnectionsPerClient;
+
+    accepted = 0;
+    connectFailures = 0;
+    for (auto &count : acceptedByWorker) {
+        count = 0;
+    }
+
+    auto onAccept = [](const Socket socket, const Id worker) {
+        close(socket);
+        accepted++;
+        acceptedByWorker[worker]++;
+    };
+
+    if (ErrorType::Success != server.listenToSharded(IpServerSettings::Protocol::Tcp, IpServerSettings::Version::IPv4, ServerPort, workers, onAccept)) {
+        CBT_LOGE(TAG, "Failed to listen with %u workers", workers);
+        return EXIT_FAILURE;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (Count i = 0; i < ClientThreads; i++) {
+        Id threadId;
+        const std::string name = std::string("acceptClient").append(std::to_string(i));
+        OperatingSystem::Instance().createThread(OperatingSystemConfig::Priority::Normal, name, nullptr, 16*1024, startClientThread, threadId);
+    }
+
+    for (Count i = 0; i < ClientThreads; i++) {
+        const std::string name = std::string("acceptClient").append(std::to_string(i));
+        OperatingSystem::Instance().joinThread(name);
+        OperatingSystem::Instance().deleteThread(name);
+    }
+
+    while (accepted + connectFailures < connections && std::chrono::steady_clock::now() - start < std::chrono::milliseconds(RunTimeout)) {
+        OperatingSystem::Instance().delay(1);
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    server.stopSharded();
+
+    //One JSON object per line so that runs can be collected and compared by a script.
+    std::string perWorker;
+    for (Count i = 0; i < workers; i++) {
+        perWorker.append(0 == i ? "" : ",").append(std::to_string(acceptedByWorker[i]));
+    }
+    printf("{\"benchmark\":\"accept\",\"workers\":%u,\"connections\":%u,\"accepted\":%u,\"acceptedByWorker\":[%s],\"seconds\":%.6f,\"acceptsPerSecond\":%.0f}\n",
+           workers, connections, accepted.load(), perWorker.c_str(), elapsed.count(), accepted / elapsed.count());
+
+    if (connections != accepted) {
+        CBT_LOGE(TAG, "Only accepted %u of %u connections", accepted.load(), connections);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static int runEventLatency() {
+    IpServer server;
+    std::atomic<bool> ran(false);
+    double totalSeconds = 0;
+
+    if (ErrorType::Success != server.listenToSharded(IpServerSettings::Protocol::Tcp, IpServerSettings::Version::IPv4, ServerPort, 1, [](const Socket socket, const Id worker) { close(socket); })) {
+        CBT_LOGE(TAG, "Failed to listen for the event latency");
+        return EXIT_FAILURE;
+    }
+
+    auto event = [&ran]() -> ErrorType {
+        ran = true;
+        return ErrorType::Success;
+    };
+
+    //Each event is added while the idle worker is waiting for connections so that the time includes waking it up.
+    for (Count i = 0; i < LatencyEvents; i++) {
+        OperatingSystem::Instance().delay(1);
+
+        ran = false;
+        std::unique_ptr<EventAbstraction> queued = std::make_unique<EventQueue::Event<IpServer>>(event);
+        const auto start = std::chrono::steady_clock::now();
+        if (ErrorType::Success != server.shardEventQueue(0)->addEvent(queued)) {
+            CBT_LOGE(TAG, "Failed to add an event to the worker");
+            server.stopSharded();
+            return EXIT_FAILURE;
+        }
+
+        while (!ran && std::chrono::steady_clock::now() - start < std::chrono::milliseconds(RunTimeout)) {
+            OperatingSystem::Instance().delay(0);
+        }
+        totalSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (!ran) {
+            CBT_LOGE(TAG, "The worker did not run its event");
+            server.stopSharded();
+            return EXIT_FAILURE;
+        }
+    }
+
+    server.stopSharded();
+
+    printf("{\"benchmark\":\"shardEventLatency\",\"events\":%u,\"meanMicroseconds\":%.1f}\n", LatencyEvents, totalSeconds * 1000000 / LatencyEvents);
+
+    return EXIT_SUCCESS;
+}
+
+int main() {
+    OperatingSystem::Init();
+    Logger::Init();
+
+    for (const Count workers : {Count(1), Count(2), MaxWorkers}) {
+        if (EXIT_SUCCESS != runBenchmark(workers)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return runEventLatency();
+}
@@ -0,0 +1,253 @@
+//Modules
+#include "OperatingSystemModule.hpp"
+#include "UartModule.hpp"
+//Applications
+#include "Log.hpp"
+#include "CleonFrameCodec.hpp"
+#include "CleonLoadGenerator.hpp"
+//Posix
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <termios.h>
+#include <unistd.h>
+//C++
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+static const char TAG[] = "CleonIngestBenchmark";
+static constexpr std::chrono::milliseconds StepDuration(200);
+static constexpr Hertz FirstRate = 1000;
+static constexpr Hertz LastRate = 256000;
+static constexpr Bytes ReceiveSize = 4096;
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @struct Scenario
+ * @brief A shape of load to find the sustained frame rate for.
+*/
+struct Scenario {
+    const char *name;
+    Count burstSize;
+    Percent crcErrors;
+    Percent truncations;
+};
+
+/**
+ * @struct Result
+ * @brief What happened at one frame rate.
+*/
+struct Result {
+    Count generated = 0;  ///< Frames the Cleon sent.
+    Count corrupted = 0;  ///< Frames that were deliberately corrupted and should be rejected.
+    Count ingested = 0;   ///< Frames that made it all the way through.
+    Count lost = 0;       ///< Frames that were not corrupted but didn't make it through.
+    Bytes overrun = 0;    ///< Bytes the Cleon couldn't send because the UART's buffers were full.
+    double seconds = 0;   ///< How long the Foundation took to ingest everything.
+    double cpu = 0;       ///< Processor time used by the whole process.
+};
+
+static double cpuSeconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+/// @brief Stands in for the protobuf message since nanopb isn't built for the tests. The message reference and each field's id and value.
+static ErrorType encodeFields(const Id messageRef, const std::vector<CleonLoadSettings::Field> &fields, std::string &payload) {
+    payload.assign(reinterpret_cast<const char *>(&messageRef), sizeof(messageRef));
+    for (const auto &field : fields) {
+        payload.append(reinterpret_cast<const char *>(&field), sizeof(field));
+    }
+
+    return ErrorType::Success;
+}
+
+/// @brief The other half of encodeFields.
+static ErrorType decodeFields(std::string_view payload, Id &messageRef, std::vector<CleonLoadSettings::Field> &fields) {
+    if (payload.size() < sizeof(messageRef) || 0 != (payload.size() - sizeof(messageRef)) % sizeof(CleonLoadSettings::Field)) {
+        return ErrorType::InvalidParameter;
+    }
+
+    memcpy(&messageRef, payload.data(), sizeof(messageRef));
+    fields.resize((payload.size() - sizeof(messageRef)) / sizeof(CleonLoadSettings::Field));
+    memcpy(fields.data(), payload.data() + sizeof(messageRef), fields.size() * sizeof(CleonLoadSettings::Field));
+
+    return ErrorType::Success;
+}
+
+/**
+ * @brief Play the Cleon. Sends the load on the controlling side of a pseudo-terminal without ever waiting on the Foundation.
+ * @details Bytes that don't fit in the pseudo-terminal are thrown away like they would be by a UART whose FIFO overran.
+*/
+static void runCleon(const int fd, CleonLoadGenerator &generator, Result &result) {
+    std::string pending;
+    const Clock::time_point start = Clock::now();
+
+    while (Clock::now() - start < StepDuration) {
+        std::this_thread::sleep_until(start + generator.nextFrameDue());
+
+        pending.clear();
+        generator.generate(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start), pending);
+
+        Bytes written = 0;
+        while (written < pending.size()) {
+            const ssize_t bytes = write(fd, pending.data() + written, pending.size() - written);
+            if (bytes <= 0) {
+                break;
+            }
+            written += bytes;
+        }
+
+        result.overrun += pending.size() - written;
+    }
+
+    //Enough to finish any frame that was cut short so the frames after it are let through.
+    std::string filler(CleonFrameSettings::HeaderSize + CleonFrameCodec::DefaultMaxPayloadSize + CleonFrameSettings::TrailerSize, 0);
+    Bytes written = 0;
+    while (written < filler.size()) {
+        const ssize_t bytes = write(fd, filler.data() + written, filler.size() - written);
+        if (bytes > 0) {
+            written += bytes;
+        }
+        else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+static int runStep(const Scenario &scenario, const Hertz rate, Result &result) {
+    //The Cleon's side of the link. Non-blocking so that a slow Foundation makes it lose bytes instead of slowing down.
+    const int cleon = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    assert(-1 != cleon && 0 == grantpt(cleon) && 0 == unlockpt(cleon));
+    struct termios settings;
+    assert(0 == tcgetattr(cleon, &settings));
+    cfmakeraw(&settings);
+    assert(0 == tcsetattr(cleon, TCSANOW, &settings));
+
+    Uart uart;
+    uart.device() = ptsname(cleon);
+    if (ErrorType::Success != uart.setDriverConfig(115200, 8, 'N', 1, UartConfig::FlowControl::Disable) ||
+        ErrorType::Success != uart.setFirmwareConfig(ReceiveSize, ReceiveSize, -1) ||
+        ErrorType::Success != uart.init()) {
+        CBT_LOGE(TAG, "Failed to open the UART");
+        close(cleon);
+        return EXIT_FAILURE;
+    }
+
+    CleonLoadGenerator generator(encodeFields);
+    CleonLoadSettings::Profile profile;
+    profile.frameRate = rate;
+    profile.burstSize = scenario.burstSize;
+    profile.crcErrors = scenario.crcErrors;
+    profile.truncations = scenario.truncations;
+    profile.values = {CleonLoadSettings::Distribution::Normal, 20.0f, 2.0f};
+    assert(ErrorType::Success == generator.setProfile(profile));
+
+    //The Foundation's ingest path: UART, frames, then the fields of each message.
+    Id messageRef = 0;
+    std::vector<CleonLoadSettings::Field> fields;
+    fields.reserve(profile.maxFields);
+    CleonFrameCodec codec([&](const CleonFrameSettings::Frame &frame) {
+        if (ErrorType::Success == decodeFields(frame.payload, messageRef, fields)) {
+            result.ingested++;
+        }
+    });
+
+    const double cpuStart = cpuSeconds();
+    const Clock::time_point start = Clock::now();
+    std::atomic<bool> cleonDone(false);
+    std::thread cleonThread([&]() {
+        runCleon(cleon, generator, result);
+        cleonDone = true;
+    });
+
+    std::string buffer;
+    while (true) {
+        buffer.resize(ReceiveSize);
+        const ErrorType error = uart.rxBlocking(buffer, 20);
+        if (ErrorType::Success == error) {
+            codec.decode(buffer);
+        }
+        else if (ErrorType::Timeout == error && cleonDone) {
+            break;
+        }
+        else if (ErrorType::Timeout != error) {
+            CBT_LOGE(TAG, "Failed to receive");
+            break;
+        }
+    }
+
+    cleonThread.join();
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    result.cpu = cpuSeconds() - cpuStart;
+
+    const CleonLoadSettings::Statistics &statistics = generator.statisticsConst();
+    result.generated = statistics.frames;
+    result.corrupted = statistics.crcErrors + statistics.truncations;
+    //Corrupted frames are supposed to be rejected. Anything else that's missing was lost.
+    result.lost = result.generated - result.corrupted - result.ingested;
+
+    uart.deinit();
+    close(cleon);
+    return EXIT_SUCCESS;
+}
+
+static int runScenario(const Scenario &scenario) {
+    Hertz sustained = 0;
+
+    for (Hertz rate = FirstRate; rate <= LastRate; rate *= 2) {
+        Result result;
+        if (EXIT_SUCCESS != runStep(scenario, rate, result)) {
+            return EXIT_FAILURE;
+        }
+
+        //One JSON object per line so that runs can be collected and compared by a script.
+        printf("{\"benchmark\":\"cleonIngest\",\"scenario\":\"%s\",\"burstSize\":%u,\"framesPerSecond\":%u,\"generated\":%u,\"corrupted\":%u,"
+               "\"ingested\":%u,\"lost\":%u,\"overrunBytes\":%u,\"cpuMicrosecondsPerFrame\":%.2f}\n",
+               scenario.name, scenario.burstSize, rate, result.generated, result.corrupted, result.ingested, result.lost, result.overrun,
+               0 == result.ingested ? 0.0 : result.cpu * 1e6 / result.ingested);
+        fflush(stdout);
+
+        if (0 != result.lost) {
+            break;
+        }
+        sustained = rate;
+    }
+
+    printf("{\"benchmark\":\"cleonIngestSustained\",\"scenario\":\"%s\",\"framesPerSecond\":%u}\n", scenario.name, sustained);
+    fflush(stdout);
+
+    //Well within what a Cleon can send at 1 Mbit/s, but a loaded machine can still drop frames, so it's reported rather than failed.
+    if (0 == sustained) {
+        CBT_LOGW(TAG, "Frames were lost at %u frames per second in scenario %s", FirstRate, scenario.name);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int main() {
+    OperatingSystem::Init();
+    Logger::Init();
+
+    const std::vector<Scenario> scenarios = {
+        {"steady", 1, 0.0f, 0.0f},
+        {"bursty", 32, 0.0f, 0.0f},
+        {"corrupted", 1, 1.0f, 1.0f}
+    };
+
+    for (const auto &scenario : scenarios) {
+        if (EXIT_SUCCESS != runScenario(scenario)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,541 @@
+//Modules
+#include "OperatingSystemModule.hpp"
+#include "WifiModule.hpp"
+#include "IpClientModule.hpp"
+#include "IpServerModule.hpp"
+//Applications
+#include "Log.hpp"
+//Posix
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+//C++
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+static const char TAG[] = "IpBenchmark";
+static constexpr Port BasePort = 44500;
+static constexpr Port ConnectPort = 44590;
+static constexpr Milliseconds Timeout = 2000;
+static constexpr Count PingPongIterations = 500;
+static constexpr Bytes BytesPerStream = 4*1024*1024;
+//Small messages are bounded by the cost of each call rather than bytes so they don't need as many bytes to settle.
+static constexpr Count MessagesPerStream = 16*1024;
+static constexpr Count Connections = 400;
+static constexpr Bytes ReceiveBufferSize = 64*1024;
+static constexpr std::array<Bytes, 3> MessageSizes = {64, 1024, 16*1024};
+static constexpr std::array<Count, 2> ConcurrencyLevels = {1, 4};
+
+using Clock = std::chrono::steady_clock;
+
+enum class Path : uint8_t {
+    Blocking = 0, ///< sendBlocking and receiveBlocking on the calling thread.
+    NonBlocking   ///< sendNonBlocking and receiveNonBlocking run by the network's event queue.
+};
+
+enum class Workload : uint8_t {
+    PingPong = 0, ///< The client sends a message and waits for the server to echo it back.
+    Stream        ///< The client sends as fast as it can and the server acknowledges the last byte.
+};
+
+/**
+ * @struct Pair
+ * @brief A client connected to a server over loopback along with the networks that run their events.
+*/
+struct Pair {
+    Wifi clientNetwork;
+    Wifi serverNetwork;
+    IpClient client;
+    IpServer server;
+    Id id = 0;
+    Path path = Path::Blocking;
+    Workload workload = Workload::PingPong;
+    Bytes messageSize = 0;
+    std::vector<uint64_t> latencies;
+    std::atomic<bool> clientPassed = false;
+    std::atomic<bool> serverPassed = false;
+};
+
+/**
+ * @struct Completions
+ * @brief Counts the callbacks of non-blocking calls. Shared with the callbacks since they can run after the caller gives up.
+*/
+struct Completions {
+    std::atomic<Count> pending = 0;
+    std::atomic<bool> failed = false;
+};
+
+static std::atomic<bool> networksRunning(false);
+
+static Bytes streamBytes(const Bytes messageSize) {
+    return std::min<Bytes>(BytesPerStream, messageSize * MessagesPerStream);
+}
+
+static const char *toString(const Path path) {
+    return Path::Blocking == path ? "blocking" : "nonBlocking";
+}
+
+static double cpuSeconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static uint64_t percentile(const std::vector<uint64_t> &sorted, const double fraction) {
+    return sorted.empty() ? 0 : sorted[static_cast<size_t>(fraction * (sorted.size() - 1))];
+}
+
+static void runNetwork(Wifi *network) {
+
+    //Yield instead of sleeping when there is nothing to do so that the sleep isn't what gets measured.
+    while (networksRunning) {
+        if (ErrorType::Success != network->mainLoop()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+static void waitFor(const std::atomic<bool> &done) {
+    while (!done) {
+        std::this_thread::yield();
+    }
+}
+
+//The event queue doesn't wait for its lock so these retry when another thread has it or the send queue is full.
+static ErrorType sendNonBlocking(IpClientAbstraction &ip, const std::shared_ptr<std::string> &data, std::function<void(const ErrorType error, const Bytes bytesWritten)> callback) {
+    ErrorType error;
+    while (ErrorType::LimitReached == (error = ip.sendNonBlocking(data, Timeout, callback)) || ErrorType::Timeout == error) {
+        std::this_thread::yield();
+    }
+    return error;
+}
+
+static ErrorType sendNonBlocking(IpServerAbstraction &ip, const std::shared_ptr<std::string> &data, std::function<void(const ErrorType error, const Bytes bytesWritten)> callback) {
+    ErrorType error;
+    while (ErrorType::LimitReached == (error = ip.sendNonBlocking(data, Timeout, callback)) || ErrorType::Timeout == error) {
+        std::this_thread::yield();
+    }
+    return error;
+}
+
+template <typename Ip>
+static ErrorType receiveNonBlocking(Ip &ip, std::shared_ptr<std::string> buffer, std::function<void(const ErrorType error, std::shared_ptr<std::string> buffer)> callback) {
+    ErrorType error;
+    while (ErrorType::LimitReached == (error = ip.receiveNonBlocking(buffer, Timeout, callback)) || ErrorType::Timeout == error) {
+        std::this_thread::yield();
+    }
+    return error;
+}
+
+/**
+ * @brief Send a message from the client and wait until it has been written.
+*/
+static ErrorType clientSend(Pair &pair, const std::shared_ptr<std::string> &message) {
+    //IpClient only exposes the blocking calls through the abstraction.
+    IpClientAbstraction &client = pair.client;
+
+    if (Path::Blocking == pair.path) {
+        return client.sendBlocking(*message, Timeout);
+    }
+
+    std::atomic<bool> sent = false;
+    ErrorType result = ErrorType::Failure;
+    ErrorType error = sendNonBlocking(client, message, [&sent, &result](const ErrorType error, const Bytes bytesWritten) {
+        result = error;
+        sent = true;
+    });
+
+    if (ErrorType::Success != error) {
+        return error;
+    }
+
+    waitFor(sent);
+    return result;
+}
+
+/**
+ * @brief Receive exactly the number of bytes given on the client.
+*/
+static ErrorType clientReceive(Pair &pair, const Bytes bytesToReceive) {
+    IpClientAbstraction &client = pair.client;
+    auto buffer = std::make_shared<std::string>();
+    Bytes received = 0;
+
+    while (received < bytesToReceive) {
+        buffer->resize(std::min<Bytes>(ReceiveBufferSize, bytesToReceive - received));
+
+        ErrorType result = ErrorType::Failure;
+        if (Path::Blocking == pair.path) {
+            result = client.receiveBlocking(*buffer, Timeout);
+        }
+        else {
+            std::atomic<bool> done = false;
+            const ErrorType error = receiveNonBlocking(client, buffer, [&done, &result](const ErrorType error, std::shared_ptr<std::string> buffer) {
+                result = error;
+                done = true;
+            });
+
+            if (ErrorType::Success != error) {
+                return error;
+            }
+            waitFor(done);
+        }
+
+        if (ErrorType::Success != result) {
+            return result;
+        }
+        else if (buffer->empty()) {
+            return ErrorType::Failure;
+        }
+
+        received += buffer->size();
+    }
+
+    return ErrorType::Success;
+}
+
+static void runServer(Pair &pair) {
+    const Bytes bytesToReceive = Workload::PingPong == pair.workload ? PingPongIterations * pair.messageSize : streamBytes(pair.messageSize);
+    const bool echo = Workload::PingPong == pair.workload;
+    const auto acknowledgement = std::make_shared<std::string>(1, '!');
+
+    if (Path::Blocking == pair.path) {
+        std::string buffer;
+        Bytes received = 0;
+
+        while (received < bytesToReceive) {
+            buffer.resize(ReceiveBufferSize);
+            if (ErrorType::Success != pair.server.receiveBlocking(buffer, Timeout) || buffer.empty()) {
+                return;
+            }
+            received += buffer.size();
+
+            if (echo && ErrorType::Success != pair.server.sendBlocking(buffer, Timeout)) {
+                return;
+            }
+        }
+
+        pair.serverPassed = echo || ErrorType::Success == pair.server.sendBlocking(*acknowledgement, Timeout);
+        return;
+    }
+
+    //Each receive is started by the callback of the one before it, so the server is driven entirely by its network.
+    std::atomic<bool> done = false;
+    Bytes received = 0;
+    auto sends = std::make_shared<Completions>();
+    std::function<void(const ErrorType error, std::shared_ptr<std::string> buffer)> onReceive;
+
+    auto onSent = [sends](const ErrorType error, const Bytes bytesWritten) {
+        if (ErrorType::Success != error) {
+            sends->failed = true;
+        }
+        sends->pending--;
+    };
+    auto send = [&pair, sends, onSent](const std::shared_ptr<std::string> &data) {
+        sends->pending++;
+        if (ErrorType::Success != sendNonBlocking(pair.server, data, onSent)) {
+            sends->pending--;
+            sends->failed = true;
+        }
+    };
+
+    onReceive = [&](const ErrorType error, std::shared_ptr<std::string> buffer) {
+        if (ErrorType::Success != error || buffer->empty()) {
+            sends->failed = true;
+            done = true;
+            return;
+        }
+        received += buffer->size();
+
+        if (echo) {
+            //The buffer is reused for the next receive so the echo needs its own copy.
+            send(std::make_shared<std::string>(*buffer));
+        }
+
+        if (received >= bytesToReceive) {
+            if (!echo) {
+                send(acknowledgement);
+            }
+            done = true;
+            return;
+        }
+
+        buffer->resize(ReceiveBufferSize);
+        if (ErrorType::Success != receiveNonBlocking(pair.server, buffer, onReceive)) {
+            sends->failed = true;
+            done = true;
+        }
+    };
+
+    if (ErrorType::Success != receiveNonBlocking(pair.server, std::make_shared<std::string>(ReceiveBufferSize, 0), onReceive)) {
+        return;
+    }
+
+    waitFor(done);
+    //The last echo is still being written when the last receive finishes.
+    while (0 != sends->pending && !sends->failed) {
+        std::this_thread::yield();
+    }
+    pair.serverPassed = !sends->failed;
+}
+
+static void runClient(Pair &pair) {
+    const auto message = std::make_shared<std::string>(pair.messageSize, 'a');
+
+    if (Workload::PingPong == pair.workload) {
+        pair.latencies.reserve(PingPongIterations);
+
+        for (Count i = 0; i < PingPongIterations; i++) {
+            const Clock::time_point start = Clock::now();
+            if (ErrorType::Success != clientSend(pair, message) || ErrorType::Success != clientReceive(pair, message->size())) {
+                return;
+            }
+            pair.latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+        }
+
+        pair.clientPassed = true;
+        return;
+    }
+
+    IpClientAbstraction &client = pair.client;
+    auto sends = std::make_shared<Completions>();
+
+    for (Bytes sent = 0; sent < streamBytes(pair.messageSize); sent += message->size()) {
+        if (Path::Blocking == pair.path) {
+            if (ErrorType::Success != client.sendBlocking(*message, Timeout)) {
+                return;
+            }
+        }
+        else {
+            //Keep the send queue full and let its backpressure pace us instead of waiting for each message.
+            const ErrorType error = sendNonBlocking(client, message, [sends](const ErrorType error, const Bytes written) {
+                if (ErrorType::Success != error) {
+                    sends->failed = true;
+                }
+            });
+
+            if (ErrorType::Success != error || sends->failed) {
+                return;
+            }
+        }
+    }
+
+    pair.clientPassed = ErrorType::Success == clientReceive(pair, 1) && !sends->failed;
+}
+
+static int runBenchmark(const Workload workload, const Path path, const Bytes messageSize, const Count concurrency) {
+    std::vector<std::unique_ptr<Pair>> pairs;
+    ErrorType error;
+
+    const TcpTuningSettings::Settings tuning = TcpTuning::profile(Workload::PingPong == workload ? TcpTuningSettings::Profile::LowLatency : TcpTuningSettings::Profile::Unknown);
+
+    for (Count i = 0; i < concurrency; i++) {
+        auto pair = std::make_unique<Pair>();
+        Socket sock = -1;
+
+        pair->id = i;
+        pair->path = path;
+        pair->workload = workload;
+        pair->messageSize = messageSize;
+        pair->client.setNetwork(pair->clientNetwork);
+        pair->server.setNetwork(pair->serverNetwork);
+        pair->client.setTuning(tuning);
+        pair->server.setTuning(tuning);
+
+        if (ErrorType::Success != (error = pair->server.listenTo(IpServerSettings::Protocol::Tcp, IpServerSettings::Version::IPv4, BasePort + i))) {
+            CBT_LOGE(TAG, "Failed to listen on port %u", BasePort + i);
+            return EXIT_FAILURE;
+        }
+        //The connection waits in the listen backlog until it is accepted.
+        if (ErrorType::Success != (error = pair->client.connectTo("127.0.0.1", BasePort + i, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::IPv4, sock, Timeout)) ||
+            ErrorType::Success != (error = pair->server.acceptConnection(sock))) {
+            CBT_LOGE(TAG, "Failed to connect pair %u", i);
+            return EXIT_FAILURE;
+        }
+
+        pairs.push_back(std::move(pair));
+    }
+
+    //The threads of the operating system module are real time and would starve each other while they spin waiting for events.
+    //Plain threads share the processor fairly so the numbers aren't skewed by how many cores the machine has.
+    std::vector<std::thread> networkThreads;
+    std::vector<std::thread> threads;
+
+    networksRunning = true;
+    if (Path::NonBlocking == path) {
+        for (auto &pair : pairs) {
+            networkThreads.emplace_back(runNetwork, &pair->clientNetwork);
+            networkThreads.emplace_back(runNetwork, &pair->serverNetwork);
+        }
+    }
+
+    const double cpuStart = cpuSeconds();
+    const Clock::time_point start = Clock::now();
+
+    for (auto &pair : pairs) {
+        threads.emplace_back(runServer, std::ref(*pair));
+        threads.emplace_back(runClient, std::ref(*pair));
+    }
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    const std::chrono::duration<double> elapsed = Clock::now() - start;
+    const double cpu = cpuSeconds() - cpuStart;
+
+    networksRunning = false;
+    for (auto &thread : networkThreads) {
+        thread.join();
+    }
+
+    for (auto &pair : pairs) {
+        if (!pair->clientPassed || !pair->serverPassed) {
+            CBT_LOGE(TAG, "Pair %u failed. path:%s messageSize:%u concurrency:%u", pair->id, toString(path), messageSize, concurrency);
+            return EXIT_FAILURE;
+        }
+    }
+
+    //One JSON object per line so that runs can be collected and compared by a script.
+    if (Workload::PingPong == workload) {
+        std::vector<uint64_t> latencies;
+        for (auto &pair : pairs) {
+            latencies.insert(latencies.end(), pair->latencies.begin(), pair->latencies.end());
+        }
+        std::sort(latencies.begin(), latencies.end());
+
+        //Every message crosses the loopback twice.
+        const double bytes = 2.0 * latencies.size() * messageSize;
+        printf("{\"benchmark\":\"pingPong\",\"path\":\"%s\",\"messageSize\":%u,\"concurrency\":%u,\"roundTrips\":%zu,"
+               "\"p50Microseconds\":%.1f,\"p90Microseconds\":%.1f,\"p99Microseconds\":%.1f,\"maxMicroseconds\":%.1f,"
+               "\"roundTripsPerSecond\":%.0f,\"cpuNanosecondsPerByte\":%.2f}\n",
+               toString(path), messageSize, concurrency, latencies.size(),
+               percentile(latencies, 0.50) / 1e3, percentile(latencies, 0.90) / 1e3, percentile(latencies, 0.99) / 1e3, percentile(latencies, 1.0) / 1e3,
+               latencies.size() / elapsed.count(), cpu * 1e9 / bytes);
+    }
+    else {
+        const double bytes = static_cast<double>(streamBytes(messageSize)) * concurrency;
+        printf("{\"benchmark\":\"stream\",\"path\":\"%s\",\"messageSize\":%u,\"concurrency\":%u,\"bytes\":%.0f,\"seconds\":%.6f,"
+               "\"megabytesPerSecond\":%.1f,\"cpuNanosecondsPerByte\":%.2f}\n",
+               toString(path), messageSize, concurrency, bytes, elapsed.count(),
+               bytes / elapsed.count() / (1024*1024), cpu * 1e9 / bytes);
+    }
+    fflush(stdout);
+
+    return EXIT_SUCCESS;
+}
+
+static std::atomic<Count> connectFailures(0);
+static Count connectionsPerThread = 0;
+static std::vector<uint64_t> connectLatencies[ConcurrencyLevels.back()];
+
+static void *runConnections(void *arg) {
+    const Id id = *reinterpret_cast<Id *>(arg);
+    //Reset instead of closing gracefully so that thousands of ports aren't left in TIME_WAIT.
+    const struct linger reset = {.l_onoff = 1, .l_linger = 0};
+    for (Count i = 0; i < connectionsPerThread; i++) {
+        IpClient client;
+        Socket sock = -1;
+
+        const Clock::time_point start = Clock::now();
+        if (ErrorType::Success != client.connectTo("127.0.0.1", ConnectPort, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::IPv4, sock, Timeout)) {
+            connectFailures++;
+            continue;
+        }
+        connectLatencies[id].push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+
+        setsockopt(sock, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+        client.disconnect();
+    }
+
+    return nullptr;
+}
+
+static int runConnectBenchmark(const Count concurrency) {
+    IpServer server;
+    std::array<Id, ConcurrencyLevels.back()> ids;
+
+    connectFailures = 0;
+    connectionsPerThread = Connections / concurrency;
+    for (auto &latencies : connectLatencies) {
+        latencies.clear();
+    }
+
+    auto onAccept = [](const Socket socket, const Id worker) {
+        close(socket);
+    };
+
+    if (ErrorType::Success != server.listenToSharded(IpServerSettings::Protocol::Tcp, IpServerSettings::Version::IPv4, ConnectPort, 1, onAccept)) {
+        CBT_LOGE(TAG, "Failed to listen on port %u", ConnectPort);
+        return EXIT_FAILURE;
+    }
+
+    const double cpuStart = cpuSeconds();
+    const Clock::time_point start = Clock::now();
+
+    for (Count i = 0; i < concurrency; i++) {
+        Id threadId;
+        ids[i] = i;
+        OperatingSystem::Instance().createThread(OperatingSystemConfig::Priority::Normal, std::string("connect").append(std::to_string(i)), &ids[i], 64*1024, runConnections, threadId);
+    }
+
+    for (Count i = 0; i < concurrency; i++) {
+        const std::string name = std::string("connect").append(std::to_string(i));
+        OperatingSystem::Instance().joinThread(name);
+        OperatingSystem::Instance().deleteThread(name);
+    }
+
+    const std::chrono::duration<double> elapsed = Clock::now() - start;
+    const double cpu = cpuSeconds() - cpuStart;
+    server.stopSharded();
+
+    std::vector<uint64_t> latencies;
+    for (auto &threadLatencies : connectLatencies) {
+        latencies.insert(latencies.end(), threadLatencies.begin(), threadLatencies.end());
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    printf("{\"benchmark\":\"connect\",\"path\":\"blocking\",\"concurrency\":%u,\"connections\":%zu,\"seconds\":%.6f,\"connectionsPerSecond\":%.0f,"
+           "\"p50Microseconds\":%.1f,\"p99Microseconds\":%.1f,\"cpuMicrosecondsPerConnection\":%.1f}\n",
+           concurrency, latencies.size(), elapsed.count(), latencies.size() / elapsed.count(),
+           percentile(latencies, 0.50) / 1e3, percentile(latencies, 0.99) / 1e3, latencies.empty() ? 0.0 : cpu * 1e6 / latencies.size());
+    fflush(stdout);
+
+    if (0 != connectFailures) {
+        CBT_LOGE(TAG, "%u connections failed", connectFailures.load());
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int main() {
+    OperatingSystem::Init();
+    Logger::Init();
+
+    for (const Workload workload : {Workload::PingPong, Workload::Stream}) {
+        for (const Path path : {Path::Blocking, Path::NonBlocking}) {
+            for (const Bytes messageSize : MessageSizes) {
+                for (const Count concurrency : ConcurrencyLevels) {
+                    if (EXIT_SUCCESS != runBenchmark(workload, path, messageSize, concurrency)) {
+                        return EXIT_FAILURE;
+                    }
+                }
+            }
+        }
+    }
+
+    for (const Count concurrency : ConcurrencyLevels) {
+        if (EXIT_SUCCESS != runConnectBenchmark(concurrency)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
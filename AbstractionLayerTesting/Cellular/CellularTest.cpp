@@ -0,0 +1,583 @@
+//Modules
+#include "OperatingSystemModule.hpp"
+#include "CellularModule.hpp"
+#include "IpCellularClientModule.hpp"
+#include "UartModule.hpp"
+//Applications
+#include "Log.hpp"
+//Posix
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+//C++
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+static const char TAG[] = "CellularTest";
+static constexpr Port EchoPort = 44700;
+
+/// @brief A TCP server on the loopback that sends back whatever it receives on each connection.
+class EchoServer {
+
+    public:
+    EchoServer() {
+        _listener = socket(AF_INET, SOCK_STREAM, 0);
+        const int reuse = 1;
+        setsockopt(_listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        struct sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(EchoPort);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        assert(0 == bind(_listener, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)));
+        assert(0 == listen(_listener, 16));
+
+        _thread = std::thread([this]() {
+            int connection;
+            while (0 <= (connection = accept(_listener, nullptr, nullptr))) {
+                _connections.push_back(connection);
+                _echoes.emplace_back([connection]() {
+                    char buffer[512];
+                    ssize_t received;
+
+                    while (0 < (received = recv(connection, buffer, sizeof(buffer), 0))) {
+                        send(connection, buffer, received, MSG_NOSIGNAL);
+                    }
+                });
+            }
+        });
+    }
+    ~EchoServer() {
+        shutdown(_listener, SHUT_RDWR);
+        _thread.join();
+        close(_listener);
+
+        for (const int connection : _connections) {
+            shutdown(connection, SHUT_RDWR);
+        }
+        for (std::thread &echo : _echoes) {
+            echo.join();
+        }
+        for (const int connection : _connections) {
+            close(connection);
+        }
+    }
+
+    private:
+    int _listener;
+    std::thread _thread;
+    std::vector<int> _connections;
+    std::vector<std::thread> _echoes;
+};
+
+/// @brief A simulated modem that is up, with a network thread running its main loop.
+class SimulatedModem {
+
+    public:
+    SimulatedModem() {
+        cellular.ic() = std::make_unique<Uart>();
+        cellular.accessPointName().assign("simulator");
+        cellular.radioAccessTechnology() = CellularConfig::RadioAccessTechnology::Lte;
+        cellular.accessMode() = CellularConfig::AccessMode::Buffer;
+    }
+    ~SimulatedModem() {
+        stop();
+    }
+
+    /// @brief Start the network thread.
+    void start() {
+        _network = std::thread([this]() {
+            while (!_done) {
+                cellular.mainLoop();
+                OperatingSystem::Instance().delay(1);
+            }
+        });
+    }
+    /// @brief Stop the network thread.
+    void stop() {
+        _done = true;
+        if (_network.joinable()) {
+            _network.join();
+        }
+    }
+    /// @brief The simulator on the other end of the UART.
+    Uart &modem() { return static_cast<Uart &>(*cellular.ic()); }
+
+    Cellular cellular;
+
+    private:
+    std::atomic<bool> _done = false;
+    std::thread _network;
+};
+
+static double secondsSince(const std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static ErrorType echo(IpClientAbstraction &client, const std::string &data, std::string &echoed) {
+    ErrorType error = client.sendBlocking(data, 1000);
+    if (ErrorType::Success != error) {
+        return error;
+    }
+
+    echoed.clear();
+    while (echoed.size() < data.size() && ErrorType::Success == error) {
+        std::string buffer(data.size() - echoed.size(), 0);
+        if (ErrorType::Success == (error = client.receiveBlocking(buffer, 1000))) {
+            echoed.append(buffer);
+        }
+    }
+
+    return error;
+}
+
+static int cellularTest() {
+    EchoServer server;
+    SimulatedModem simulated;
+    Cellular &cellular = simulated.cellular;
+    Uart &modem = simulated.modem();
+
+    //Skips init which waits for the modem to reset. Echo is left on and the responses have to be parsed around it.
+    assert(ErrorType::Success == cellular.networkUp());
+    assert(cellular.statusConst().isUp);
+
+    DecibelMilliWatts signalStrength = 0;
+    assert(ErrorType::Success == cellular.getSignalStrength(signalStrength));
+    if (-73 != signalStrength) {
+        CBT_LOGE(TAG, "Expected -73dBm for an rssi of 20 but got %d", signalStrength);
+        return EXIT_FAILURE;
+    }
+
+    //Only the network thread talks to the modem from here on.
+    simulated.start();
+
+    IpCellularClient client;
+    client.setNetwork(cellular);
+    Socket sock = -1;
+    assert(ErrorType::Success == client.connectTo("127.0.0.1", EchoPort, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::IPv4, sock, 5000));
+    assert(0 == sock);
+
+    std::string echoed;
+    assert(ErrorType::Success == echo(client, "hello", echoed));
+    assert("hello" == echoed);
+
+    //Without a callback the caller waits for the network thread to send it, and with one it doesn't.
+    std::string buffer(16, 0);
+    assert(ErrorType::Success == client.sendNonBlocking(std::make_shared<std::string>("queued"), 1000, nullptr));
+    assert(ErrorType::Success == static_cast<IpClientAbstraction &>(client).receiveBlocking(buffer, 1000) && "queued" == buffer);
+    std::atomic<ErrorType> sent = ErrorType::Failure;
+    assert(ErrorType::Success == client.sendNonBlocking(std::make_shared<std::string>("called"), 1000, [&sent](const ErrorType error, const Bytes) {
+        sent = error;
+    }));
+    buffer.resize(16);
+    assert(ErrorType::Success == static_cast<IpClientAbstraction &>(client).receiveBlocking(buffer, 1000) && "called" == buffer);
+    assert(ErrorType::Success == sent);
+
+    //Each way takes 50ms plus 100ms at 10000 bytes per second.
+    QuectelSimulatorSettings::Settings settings = modem.simulatorSettings();
+    settings.latency = 50;
+    settings.bandwidth = 10000;
+    assert(ErrorType::Success == modem.setSimulatorSettings(settings));
+    const std::string data(1000, 'x');
+    const auto start = std::chrono::steady_clock::now();
+    assert(ErrorType::Success == echo(client, data, echoed));
+    const double elapsed = secondsSince(start);
+    assert(data == echoed);
+
+    if (elapsed < 0.3 || elapsed > 1.0) {
+        CBT_LOGE(TAG, "Round trip of 1000 bytes took %f seconds", elapsed);
+        return EXIT_FAILURE;
+    }
+
+    //Larger than a segment. Waiting for each segment to be acknowledged before sending the next takes about a second.
+    settings.bandwidth = 100000;
+    assert(ErrorType::Success == modem.setSimulatorSettings(settings));
+    const std::string upload(20000, 'y');
+    const auto uploadStart = std::chrono::steady_clock::now();
+    assert(ErrorType::Success == echo(client, upload, echoed));
+    const double uploadElapsed = secondsSince(uploadStart);
+    assert(upload == echoed);
+
+    if (uploadElapsed > 0.7) {
+        CBT_LOGE(TAG, "Round trip of %u bytes took %f seconds", upload.size(), uploadElapsed);
+        return EXIT_FAILURE;
+    }
+
+    //Nothing to receive.
+    buffer.resize(16);
+    assert(ErrorType::Timeout == static_cast<IpClientAbstraction &>(client).receiveBlocking(buffer, 100));
+
+    assert(ErrorType::Success == client.disconnect());
+    return EXIT_SUCCESS;
+}
+
+static int multiplexTest() {
+    constexpr Count Clients = 4;
+    EchoServer server;
+    SimulatedModem simulated;
+    QuectelSimulatorSettings::Settings settings = simulated.modem().simulatorSettings();
+    settings.latency = 20;
+    assert(ErrorType::Success == simulated.modem().setSimulatorSettings(settings));
+    assert(ErrorType::Success == simulated.cellular.networkUp());
+    simulated.start();
+
+    std::array<IpCellularClient, Clients> clients;
+    for (Count i = 0; i < Clients; i++) {
+        Socket sock = -1;
+        clients[i].setNetwork(simulated.cellular);
+        assert(ErrorType::Success == clients[i].connectTo("127.0.0.1", EchoPort, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::IPv4, sock, 5000));
+        assert(static_cast<Socket>(i) == sock);
+    }
+
+    //Every connection at once, each from its own thread.
+    std::atomic<Count> echoed = 0;
+    std::vector<std::thread> streams;
+    for (Count i = 0; i < Clients; i++) {
+        streams.emplace_back([&clients, &echoed, i]() {
+            const std::string data(5000, static_cast<char>('a' + i));
+            std::string received;
+
+            for (int j = 0; j < 3; j++) {
+                if (ErrorType::Success == echo(clients[i], data, received) && data == received) {
+                    echoed++;
+                }
+            }
+        });
+    }
+    for (std::thread &stream : streams) {
+        stream.join();
+    }
+
+    if (Clients * 3 != echoed) {
+        CBT_LOGE(TAG, "Only %u of %u echoes came back intact", echoed.load(), Clients * 3);
+        return EXIT_FAILURE;
+    }
+
+    //A connection that isn't receiving what it's sent doesn't hold up the others.
+    const std::string unread(3 * SocketMultiplexer::MaxReceiveBuffer, 'z');
+    assert(ErrorType::Success == static_cast<IpClientAbstraction &>(clients[0]).sendBlocking(unread, 2000));
+    OperatingSystem::Instance().delay(100);
+
+    std::string received;
+    const auto start = std::chrono::steady_clock::now();
+    assert(ErrorType::Success == echo(clients[1], "ping", received));
+    const double elapsed = secondsSince(start);
+    assert("ping" == received);
+
+    if (elapsed > 0.5) {
+        CBT_LOGE(TAG, "A connection was held up by one that isn't receiving for %f seconds", elapsed);
+        return EXIT_FAILURE;
+    }
+
+    //It gets all of it once it does.
+    received.clear();
+    ErrorType error = ErrorType::Success;
+    while (received.size() < unread.size() && ErrorType::Success == error) {
+        std::string buffer(unread.size(), 0);
+        if (ErrorType::Success == (error = static_cast<IpClientAbstraction &>(clients[0]).receiveBlocking(buffer, 1000))) {
+            received.append(buffer);
+        }
+    }
+    assert(unread == received);
+
+    //Connection ids are given back on disconnect.
+    assert(ErrorType::Success == clients[2].disconnect());
+    IpCellularClient another;
+    another.setNetwork(simulated.cellular);
+    Socket sock = -1;
+    assert(ErrorType::Success == another.connectTo("127.0.0.1", EchoPort, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::IPv4, sock, 5000));
+    assert(2 == sock);
+
+    return EXIT_SUCCESS;
+}
+
+static int monitorTest() {
+    SimulatedModem simulated;
+    Cellular &cellular = simulated.cellular;
+    Uart &modem = simulated.modem();
+    cellular.monitorPeriod() = 50;
+
+    DecibelMilliWatts signalStrength = 0;
+    assert(ErrorType::NoData == cellular.getSignalStrength(signalStrength));
+
+    //Registers a while after the network is brought up. The modem reports it rather than being asked every second.
+    QuectelSimulatorSettings::Settings settings = modem.simulatorSettings();
+    settings.registrationStatus = static_cast<uint8_t>(RegistrationStatus::Searching);
+    assert(ErrorType::Success == modem.setSimulatorSettings(settings));
+    std::thread registering([&modem, settings]() mutable {
+        OperatingSystem::Instance().delay(200);
+        settings.registrationStatus = static_cast<uint8_t>(RegistrationStatus::Home);
+        assert(ErrorType::Success == modem.setSimulatorSettings(settings));
+    });
+    const auto start = std::chrono::steady_clock::now();
+    assert(ErrorType::Success == cellular.networkUp());
+    const double elapsed = secondsSince(start);
+    registering.join();
+
+    if (elapsed > 0.5) {
+        CBT_LOGE(TAG, "Took %f seconds to notice the modem registered", elapsed);
+        return EXIT_FAILURE;
+    }
+
+    RegistrationStatus registration = RegistrationStatus::Unknown;
+    std::string operatorName;
+    assert(ErrorType::Success == cellular.getRegistrationStatus(registration));
+    assert(RegistrationStatus::Home == registration);
+    assert(ErrorType::Success == cellular.getOperatorName(operatorName));
+    assert("Simulator" == operatorName);
+
+    simulated.start();
+
+    //Reads come from the cache so they are cheap enough to call as often as the application likes.
+    const auto readStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < 1000; i++) {
+        assert(ErrorType::Success == cellular.getSignalStrength(signalStrength));
+    }
+    const double readElapsed = secondsSince(readStart);
+    assert(-73 == signalStrength);
+
+    if (readElapsed > 0.1) {
+        CBT_LOGE(TAG, "1000 reads of the signal strength took %f seconds", readElapsed);
+        return EXIT_FAILURE;
+    }
+
+    //The monitor picks up changes in the background.
+    settings.signalQuality = 10;
+    settings.registrationStatus = static_cast<uint8_t>(RegistrationStatus::Roaming);
+    assert(ErrorType::Success == modem.setSimulatorSettings(settings));
+    for (int i = 0; i < 100 && -93 != signalStrength; i++) {
+        OperatingSystem::Instance().delay(10);
+        assert(ErrorType::Success == cellular.getSignalStrength(signalStrength));
+    }
+    assert(ErrorType::Success == cellular.getRegistrationStatus(registration));
+
+    if (-93 != signalStrength || RegistrationStatus::Roaming != registration) {
+        CBT_LOGE(TAG, "Cached status was not updated. %ddBm <stat:%u>", signalStrength, static_cast<uint8_t>(registration));
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static int transparentTest() {
+    EchoServer server;
+    SimulatedModem simulated;
+    Cellular &cellular = simulated.cellular;
+    Uart &modem = simulated.modem();
+    cellular.accessMode() = CellularConfig::AccessMode::Transparent;
+    cellular.escapeGuardTime() = 100;
+    cellular.monitorPeriod() = 1000;
+    QuectelSimulatorSettings::Settings settings = modem.simulatorSettings();
+    settings.escapeGuardTime = 100;
+    assert(ErrorType::Success == modem.setSimulatorSettings(settings));
+    assert(ErrorType::Success == cellular.networkUp());
+    simulated.start();
+
+    IpCellularClient client;
+    client.setNetwork(cellular);
+    Socket sock = -1;
+    assert(ErrorType::Success == client.connectTo("127.0.0.1", EchoPort, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::IPv4, sock, 5000));
+    assert(0 == sock);
+
+    std::string echoed;
+    assert(ErrorType::Success == echo(client, "hello", echoed));
+    assert("hello" == echoed);
+
+    //Nothing but the data goes over the UART so it streams at the bandwidth, about 0.5 seconds each way at the same time.
+    settings.bandwidth = 100000;
+    assert(ErrorType::Success == modem.setSimulatorSettings(settings));
+    const std::string bulk(50000, 't');
+    const auto start = std::chrono::steady_clock::now();
+    assert(ErrorType::Success == echo(client, bulk, echoed));
+    const double elapsed = secondsSince(start);
+    assert(bulk == echoed);
+
+    if (elapsed > 0.8) {
+        CBT_LOGE(TAG, "Round trip of %u bytes in transparent access mode took %f seconds", bulk.size(), elapsed);
+        return EXIT_FAILURE;
+    }
+
+    //The monitor switches to command mode to sample the status while the connection is idle.
+    DecibelMilliWatts signalStrength = 0;
+    settings.signalQuality = 10;
+    assert(ErrorType::Success == modem.setSimulatorSettings(settings));
+    for (int i = 0; i < 300 && -93 != signalStrength; i++) {
+        OperatingSystem::Instance().delay(10);
+        assert(ErrorType::Success == cellular.getSignalStrength(signalStrength));
+    }
+    assert(-93 == signalStrength);
+
+    //Opening another connection needs command mode. The first goes back to data mode afterwards without losing anything.
+    const std::string pending(2000, 'p');
+    assert(ErrorType::Success == static_cast<IpClientAbstraction &>(client).sendBlocking(pending, 1000));
+    IpCellularClient another;
+    another.setNetwork(cellular);
+    Socket anotherSock = -1;
+    assert(ErrorType::Success != another.connectTo("127.0.0.1", EchoPort, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::IPv4, anotherSock, 5000));
+
+    echoed.clear();
+    ErrorType error = ErrorType::Success;
+    while (echoed.size() < pending.size() && ErrorType::Success == error) {
+        std::string buffer(pending.size(), 0);
+        if (ErrorType::Success == (error = static_cast<IpClientAbstraction &>(client).receiveBlocking(buffer, 1000))) {
+            echoed.append(buffer);
+        }
+    }
+    assert(pending == echoed);
+    assert(ErrorType::Success == echo(client, "again", echoed));
+    assert("again" == echoed);
+
+    assert(ErrorType::Success == client.disconnect());
+
+    //The remote closing the connection ends data mode with NO CARRIER after the last of its data.
+    const int listener = socket(AF_INET, SOCK_STREAM, 0);
+    const int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(EchoPort + 1);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert(0 == bind(listener, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)));
+    assert(0 == listen(listener, 1));
+    std::thread goodbye([listener]() {
+        const int connection = accept(listener, nullptr, nullptr);
+        send(connection, "bye", 3, MSG_NOSIGNAL);
+        close(connection);
+    });
+
+    assert(ErrorType::Success == client.connectTo("127.0.0.1", EchoPort + 1, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::IPv4, sock, 5000));
+    goodbye.join();
+    close(listener);
+
+    std::string received;
+    error = ErrorType::Success;
+    while (ErrorType::Success == error) {
+        std::string buffer(16, 0);
+        if (ErrorType::Success == (error = static_cast<IpClientAbstraction &>(client).receiveBlocking(buffer, 1000))) {
+            received.append(buffer);
+        }
+    }
+
+    if ("bye" != received || ErrorType::EndOfFile != error) {
+        CBT_LOGE(TAG, "Expected bye and the end of the connection but got %s and %u", received.c_str(), static_cast<uint8_t>(error));
+        return EXIT_FAILURE;
+    }
+
+    assert(ErrorType::Success == client.disconnect());
+    return EXIT_SUCCESS;
+}
+
+static int lostResponseTest() {
+    SimulatedModem simulated;
+    Cellular &cellular = simulated.cellular;
+    Uart &modem = simulated.modem();
+    cellular.monitorPeriod() = 100;
+    assert(ErrorType::Success == cellular.networkUp());
+    simulated.start();
+
+    //A remote that sends without being asked.
+    const int listener = socket(AF_INET, SOCK_STREAM, 0);
+    const int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(EchoPort + 2);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert(0 == bind(listener, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)));
+    assert(0 == listen(listener, 1));
+    std::atomic<int> connection = -1;
+    std::thread accepting([listener, &connection]() { connection = accept(listener, nullptr, nullptr); });
+
+    IpCellularClient client;
+    client.setNetwork(cellular);
+    Socket sock = -1;
+    assert(ErrorType::Success == client.connectTo("127.0.0.1", EchoPort + 2, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::IPv4, sock, 5000));
+    accepting.join();
+
+    //+QIURC: "recv" is held up behind the responses to the next status sample, which are given up on and thrown away with it.
+    QuectelSimulatorSettings::Settings settings = modem.simulatorSettings();
+    settings.stalled = true;
+    assert(ErrorType::Success == modem.setSimulatorSettings(settings));
+    send(connection, "unasked", 7, MSG_NOSIGNAL);
+    OperatingSystem::Instance().delay(1500);
+    settings.stalled = false;
+    assert(ErrorType::Success == modem.setSimulatorSettings(settings));
+
+    std::string buffer(16, 0);
+    const ErrorType error = static_cast<IpClientAbstraction &>(client).receiveBlocking(buffer, 1000);
+    close(connection);
+    close(listener);
+
+    if (ErrorType::Success != error || "unasked" != buffer) {
+        CBT_LOGE(TAG, "Data that arrived while a response was lost was not read. Received %s and %u", buffer.c_str(), static_cast<uint8_t>(error));
+        return EXIT_FAILURE;
+    }
+
+    assert(ErrorType::Success == client.disconnect());
+    return EXIT_SUCCESS;
+}
+
+static int abortTest() {
+    Uart modem;
+
+    auto receiveAll = [&modem]() {
+        std::string received;
+        std::string buffer(64, 0);
+
+        while (ErrorType::Success == modem.rxBlocking(buffer, 50)) {
+            received.append(buffer);
+            buffer.resize(64);
+        }
+
+        return received;
+    };
+
+    //The next command sent without waiting for the answer aborts AT+COPS=0 and is thrown away.
+    assert(ErrorType::Success == modem.txBlocking("AT+COPS=0\rAT\r", 100));
+    std::string received = receiveAll();
+    if ("AT+COPS=0\r\r\nERROR\r\n" != received) {
+        CBT_LOGE(TAG, "AT+COPS=0 was not aborted by the command behind it. Received %s", received.c_str());
+        return EXIT_FAILURE;
+    }
+
+    //Sent on its own it runs to the end.
+    assert(ErrorType::Success == modem.txBlocking("AT+COPS=0\r", 100));
+    received = receiveAll();
+    if ("AT+COPS=0\r\r\nOK\r\n" != received) {
+        CBT_LOGE(TAG, "AT+COPS=0 did not succeed on its own. Received %s", received.c_str());
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static int runAllTests() {
+    std::vector<std::function<int(void)>> tests = {
+        cellularTest,
+        multiplexTest,
+        monitorTest,
+        transparentTest,
+        lostResponseTest,
+        abortTest
+    };
+
+    for (auto test : tests) {
+        if (EXIT_SUCCESS != test()) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int main() {
+    OperatingSystem::Init();
+    Logger::Init();
+
+    return runAllTests();
+}
@@ -0,0 +1,463 @@
+//Modules
+#include "OperatingSystemModule.hpp"
+#include "IpClientModule.hpp"
+//Applications
+#include "Log.hpp"
+#include "RingBuffer.hpp"
+#include "StreamFramer.hpp"
+#include "CleonFrameCodec.hpp"
+#include "CleonLoadGenerator.hpp"
+//Posix
+#include <netinet/in.h>
+#include <unistd.h>
+//C++
+#include <algorithm>
+#include <chrono>
+
+static const char TAG[] = "FramingTest";
+static constexpr Port ServerPort = 44200;
+
+static std::string lengthPrefixed(const std::string &payload) {
+    std::string frame;
+    frame.push_back(static_cast<char>((payload.size() >> 8) & 0xFF));
+    frame.push_back(static_cast<char>(payload.size() & 0xFF));
+    frame.append(payload);
+    return frame;
+}
+
+static int ringBufferWrapTest() {
+    RingBuffer ring(8, 8);
+    std::array<std::span<char>, 2> regions;
+
+    assert(ErrorType::Success == ring.write("abcdef"));
+    ring.consume(4);
+    //Free space is now the last 2 bytes and the first 4 bytes.
+    assert(2 == ring.freeRegions(regions));
+    assert(2 == regions[0].size());
+    assert(4 == regions[1].size());
+
+    assert(ErrorType::Success == ring.write("ghij"));
+    assert('e' == ring.at(0));
+    assert('j' == ring.at(5));
+    if (ring.contiguous() != "efghij") {
+        CBT_LOGE(TAG, "Wrapped data was not linearized correctly");
+        return EXIT_FAILURE;
+    }
+
+    assert(ErrorType::LimitReached == ring.write("klm"));
+
+    return EXIT_SUCCESS;
+}
+
+static int ringBufferGrowTest() {
+    RingBuffer ring(4, 64);
+
+    assert(ErrorType::Success == ring.write("abc"));
+    ring.consume(2);
+    assert(ErrorType::Success == ring.write("defghijklmnop"));
+    assert(16 == ring.capacity());
+    assert(ring.contiguous() == "cdefghijklmnop");
+
+    return EXIT_SUCCESS;
+}
+
+static int lengthPrefixTest() {
+    RingBuffer ring(16, 1024);
+    FramingSettings::Settings settings;
+    settings.mode = FramingSettings::Mode::LengthPrefix;
+    settings.prefixLength = 2;
+    StreamFramer framer(settings);
+    std::string_view frame;
+
+    //A whole frame and half of the next.
+    const std::string stream = lengthPrefixed("Hello") + lengthPrefixed("World!");
+    assert(ErrorType::Success == ring.write(stream.substr(0, 10)));
+
+    assert(ErrorType::Success == framer.nextFrame(ring, frame));
+    assert(frame == "Hello");
+    framer.release(ring);
+
+    assert(ErrorType::NoData == framer.nextFrame(ring, frame));
+    assert(ErrorType::Success == ring.write(stream.substr(10)));
+    assert(ErrorType::Success == framer.nextFrame(ring, frame));
+    if (frame != "World!") {
+        CBT_LOGE(TAG, "Frame split across writes was not reassembled");
+        return EXIT_FAILURE;
+    }
+    framer.release(ring);
+    assert(ring.empty());
+
+    settings.maxFrameSize = 4;
+    StreamFramer smallFramer(settings);
+    assert(ErrorType::Success == ring.write(lengthPrefixed("Hello")));
+    assert(ErrorType::LimitReached == smallFramer.nextFrame(ring, frame));
+
+    return EXIT_SUCCESS;
+}
+
+static int delimiterTest() {
+    RingBuffer ring;
+    FramingSettings::Settings settings;
+    settings.mode = FramingSettings::Mode::Delimiter;
+    settings.delimiter = "\r\n";
+    StreamFramer framer(settings);
+    std::string_view frame;
+
+    //The delimiter of the second message is split between writes.
+    assert(ErrorType::Success == ring.write("OK\r\n+CSQ: 20,99\r"));
+    assert(ErrorType::Success == framer.nextFrame(ring, frame));
+    assert(frame == "OK");
+    framer.release(ring);
+
+    assert(ErrorType::NoData == framer.nextFrame(ring, frame));
+    assert(ErrorType::Success == ring.write("\n"));
+    assert(ErrorType::Success == framer.nextFrame(ring, frame));
+    if (frame != "+CSQ: 20,99") {
+        CBT_LOGE(TAG, "Delimiter split across writes was not found");
+        return EXIT_FAILURE;
+    }
+    framer.release(ring);
+
+    return EXIT_SUCCESS;
+}
+
+static int receiveFrameTest() {
+    struct sockaddr_in address = {};
+    const int reuse = 1;
+    constexpr Milliseconds timeout = 1000;
+    constexpr int messages = 100;
+
+    address.sin_family = AF_INET;
+    address.sin_port = htons(ServerPort);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    const Socket listener = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    assert(0 == bind(listener, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)));
+    assert(0 == listen(listener, 1));
+
+    IpClient client;
+    Socket sock = -1;
+    assert(ErrorType::Success == client.connectTo("127.0.0.1", ServerPort, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::IPv4, sock, timeout));
+    const Socket serverSide = accept(listener, nullptr, nullptr);
+    assert(-1 != serverSide);
+
+    FramingSettings::Settings settings;
+    settings.mode = FramingSettings::Mode::LengthPrefix;
+    settings.prefixLength = 2;
+    client.setFraming(settings);
+
+    //Lots of small messages in one write so that they are framed from the same read.
+    std::string stream;
+    for (int i = 0; i < messages; i++) {
+        stream.append(lengthPrefixed(std::to_string(i)));
+    }
+    assert(stream.size() == static_cast<size_t>(send(serverSide, stream.data(), stream.size(), 0)));
+
+    for (int i = 0; i < messages; i++) {
+        std::string_view frame;
+        if (ErrorType::Success != client.receiveFrame(frame, timeout) || frame != std::to_string(i)) {
+            CBT_LOGE(TAG, "Message %d was not received", i);
+            return EXIT_FAILURE;
+        }
+        client.releaseFrame();
+    }
+
+    //The peer hanging up is reported instead of waiting for the timeout.
+    close(serverSide);
+    std::string_view frame;
+    assert(ErrorType::Failure == client.receiveFrame(frame, timeout));
+
+    close(listener);
+    return EXIT_SUCCESS;
+}
+
+/// @brief Stands in for the protobuf message. The message reference followed by the id and value of each field.
+static ErrorType encodeFields(const Id messageRef, const std::vector<CleonLoadSettings::Field> &fields, std::string &payload) {
+    payload.assign(reinterpret_cast<const char *>(&messageRef), sizeof(messageRef));
+    for (const auto &field : fields) {
+        payload.append(reinterpret_cast<const char *>(&field), sizeof(field));
+    }
+
+    return ErrorType::Success;
+}
+
+static Id messageRefOf(const CleonFrameSettings::Frame &frame) {
+    Id messageRef = 0;
+    std::copy_n(frame.payload.data(), sizeof(messageRef), reinterpret_cast<char *>(&messageRef));
+    return messageRef;
+}
+
+static int cleonFrameTest() {
+    assert(0xCBF43926 == CleonFrameCodec::crc32("123456789"));
+
+    std::string stream;
+    std::vector<std::string> payloads = {"", "a", std::string(300, '\xCF'), std::string(4096, 'x')};
+    for (size_t i = 0; i < payloads.size(); i++) {
+        assert(ErrorType::Success == CleonFrameCodec::encode(static_cast<uint8_t>(i + 1), payloads[i], stream));
+    }
+    assert(ErrorType::InvalidParameter == CleonFrameCodec::encode(0, std::string(0x10000, 'x'), stream));
+
+    const std::string header = stream.substr(0, 4);
+    assert('\xCF' == header[0] && 1 == header[1] && 0 == header[2] && 0 == header[3]);
+
+    //Split every way from one byte at a time to all at once.
+    for (Bytes chunkSize = 1; chunkSize <= stream.size(); chunkSize += (chunkSize < 64 ? 1 : 997)) {
+        std::vector<std::pair<uint8_t, std::string>> received;
+        CleonFrameCodec codec([&received](const CleonFrameSettings::Frame &frame) {
+            received.emplace_back(frame.qref, std::string(frame.payload));
+        });
+
+        for (Bytes i = 0; i < stream.size(); i += chunkSize) {
+            assert(ErrorType::Success == codec.decode(std::string_view(stream).substr(i, chunkSize)));
+        }
+
+        bool intact = received.size() == payloads.size();
+        for (size_t i = 0; intact && i < payloads.size(); i++) {
+            intact = received[i].first == i + 1 && received[i].second == payloads[i];
+        }
+
+        if (!intact || 0 != codec.statisticsConst().discarded) {
+            CBT_LOGE(TAG, "Frames were not decoded intact in chunks of %u bytes", static_cast<unsigned>(chunkSize));
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static int cleonResyncTest() {
+    std::vector<std::string> received;
+    CleonFrameCodec codec([&received](const CleonFrameSettings::Frame &frame) {
+        received.emplace_back(frame.payload);
+    }, 256);
+
+    std::string good;
+    assert(ErrorType::Success == CleonFrameCodec::encode(7, "good", good));
+
+    //Noise, including a start of frame byte, before a frame.
+    std::string stream = "noise\xCF" "noise" + good;
+    //A frame with a corrupted payload whose own payload holds a valid frame.
+    std::string corrupted;
+    assert(ErrorType::Success == CleonFrameCodec::encode(8, "xx" + good + "yy", corrupted));
+    corrupted[5] ^= 0x01;
+    stream += corrupted;
+    //A header saying the payload is larger than the decoder accepts.
+    stream += std::string("\xCF\x01\xFF\xFF", 4) + good;
+
+    assert(ErrorType::Success == codec.decode(stream));
+
+    const CleonFrameSettings::Statistics &statistics = codec.statisticsConst();
+    //The stray start of frame byte in the noise is followed by a length that is too large.
+    if (3 != received.size() || 3 != statistics.frames || 1 != statistics.crcErrors || 2 != statistics.oversized) {
+        CBT_LOGE(TAG, "Received %u frames with %u CRC errors and %u oversized", static_cast<unsigned>(received.size()),
+                 static_cast<unsigned>(statistics.crcErrors), static_cast<unsigned>(statistics.oversized));
+        return EXIT_FAILURE;
+    }
+
+    for (const auto &payload : received) {
+        assert("good" == payload);
+    }
+
+    //Bytes that can't be the start of a frame are never held on to.
+    assert(ErrorType::Success == codec.decode(std::string(10000, 'z')));
+    assert(codec.ring().empty());
+
+    codec.reset();
+    assert(0 == codec.statisticsConst().frames && 0 == codec.statisticsConst().discarded);
+
+    return EXIT_SUCCESS;
+}
+
+static int cleonThroughputTest() {
+    //Ten seconds of a 1 Mbit/s link, received in the small reads a UART gives back.
+    constexpr Bytes total = 10 * 1000000 / 8;
+    constexpr Bytes readSize = 64;
+
+    std::string stream;
+    Count sent = 0;
+    while (stream.size() < total) {
+        std::string payload(17 + (sent * 37) % 200, '\0');
+        for (Bytes i = 0; i < payload.size(); i++) {
+            payload[i] = static_cast<char>(sent + i);
+        }
+        assert(ErrorType::Success == CleonFrameCodec::encode(static_cast<uint8_t>(sent), payload, stream));
+        sent++;
+    }
+
+    Count received = 0;
+    CleonFrameCodec codec([&received](const CleonFrameSettings::Frame &frame) {
+        assert(static_cast<uint8_t>(received) == frame.qref);
+        received++;
+    });
+
+    const auto start = std::chrono::steady_clock::now();
+    for (Bytes i = 0; i < stream.size(); i += readSize) {
+        codec.decode(std::string_view(stream).substr(i, readSize));
+    }
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+    if (received != sent || 0 != codec.statisticsConst().discarded) {
+        CBT_LOGE(TAG, "Decoded %u of %u frames", static_cast<unsigned>(received), static_cast<unsigned>(sent));
+        return EXIT_FAILURE;
+    }
+
+    //Far faster than the link so that decoding never holds up the UART.
+    if (elapsed > 1000) {
+        CBT_LOGE(TAG, "Decoding ten seconds of frames took %lld ms", static_cast<long long>(elapsed));
+        return EXIT_FAILURE;
+    }
+
+    CBT_LOGI(TAG, "Decoded %u frames in %lld ms", static_cast<unsigned>(received), static_cast<long long>(elapsed));
+    return EXIT_SUCCESS;
+}
+
+static int cleonLoadScheduleTest() {
+    CleonLoadGenerator generator(encodeFields);
+    CleonLoadSettings::Profile profile;
+
+    profile.burstSize = 0;
+    assert(ErrorType::InvalidParameter == generator.setProfile(profile));
+    profile.burstSize = 1;
+    profile.minFields = 5;
+    profile.maxFields = 4;
+    assert(ErrorType::InvalidParameter == generator.setProfile(profile));
+    profile.maxFields = 5;
+    profile.crcErrors = 101.0f;
+    assert(ErrorType::InvalidParameter == generator.setProfile(profile));
+    profile.crcErrors = 0.0f;
+    profile.values = {CleonLoadSettings::Distribution::Normal, 10.0f, 0.0f};
+    assert(ErrorType::InvalidParameter == generator.setProfile(profile));
+
+    //Nothing unsolicited without a rate, but a frame can still be asked for.
+    profile.values = {CleonLoadSettings::Distribution::Constant, 42.0f, 0.0f};
+    assert(ErrorType::Success == generator.setProfile(profile));
+    std::string stream;
+    assert(ErrorType::Success == generator.generate(std::chrono::seconds(10), stream) && stream.empty());
+    assert(std::chrono::microseconds::max() == generator.nextFrameDue());
+    assert(ErrorType::Success == generator.frame(9, stream));
+
+    std::vector<CleonFrameSettings::Frame> frames;
+    std::vector<std::string> payloads;
+    CleonFrameCodec codec([&](const CleonFrameSettings::Frame &frame) {
+        payloads.emplace_back(frame.payload);
+        frames.push_back({frame.qref, payloads.back()});
+    });
+    codec.decode(stream);
+    assert(1 == frames.size() && 9 == frames[0].qref && sizeof(Id) + 5 * sizeof(CleonLoadSettings::Field) == frames[0].payload.size());
+
+    CleonLoadSettings::Field field;
+    std::copy_n(frames[0].payload.data() + sizeof(Id), sizeof(field), reinterpret_cast<char *>(&field));
+    assert(CleonLoadGenerator::FirstFieldId == field.id && 42.0f == field.value);
+
+    //Frames are due at 0, 1, ... 10ms.
+    profile.frameRate = 1000;
+    assert(ErrorType::Success == generator.setProfile(profile));
+    stream.clear();
+    assert(ErrorType::Success == generator.generate(std::chrono::milliseconds(10), stream));
+    assert(std::chrono::milliseconds(11) == generator.nextFrameDue());
+    assert(12 == generator.statisticsConst().frames);
+
+    //The same rate in bursts of 10 every 10ms.
+    profile.burstSize = 10;
+    assert(ErrorType::Success == generator.setProfile(profile));
+    stream.clear();
+    assert(ErrorType::Success == generator.generate(std::chrono::milliseconds(9), stream));
+    assert(std::chrono::milliseconds(10) == generator.nextFrameDue());
+    assert(ErrorType::Success == generator.generate(std::chrono::milliseconds(10), stream));
+
+    frames.clear();
+    payloads.clear();
+    payloads.reserve(32);
+    codec.decode(stream);
+    if (20 != frames.size()) {
+        CBT_LOGE(TAG, "Generated %u frames in two bursts of 10", static_cast<unsigned>(frames.size()));
+        return EXIT_FAILURE;
+    }
+
+    //Message references carry on from the frames before so that lost frames can be counted.
+    for (size_t i = 0; i < frames.size(); i++) {
+        assert(12 + i == messageRefOf(frames[i]) && 0 == frames[i].qref);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static int cleonLoadCorruptionTest() {
+    CleonLoadGenerator generator(encodeFields);
+    CleonLoadSettings::Profile profile;
+    profile.frameRate = 1000;
+    profile.minFields = 0;
+    profile.maxFields = 40;
+    profile.values = {CleonLoadSettings::Distribution::Normal, 50.0f, 5.0f};
+    profile.crcErrors = 10.0f;
+    profile.truncations = 10.0f;
+    profile.seed = 7;
+    assert(ErrorType::Success == generator.setProfile(profile));
+
+    std::string stream;
+    assert(ErrorType::Success == generator.generate(std::chrono::seconds(2), stream));
+    //Whatever the last frame says its length is, this is enough to finish it so the frames it's holding back are checked.
+    stream.append(CleonFrameSettings::HeaderSize + CleonFrameCodec::DefaultMaxPayloadSize + CleonFrameSettings::TrailerSize, 'z');
+
+    Count received = 0;
+    Count lost = 0;
+    Id expected = 0;
+    Count minFields = profile.maxFields;
+    Count maxFields = 0;
+    CleonFrameCodec codec([&](const CleonFrameSettings::Frame &frame) {
+        const Id messageRef = messageRefOf(frame);
+        lost += messageRef - expected;
+        expected = messageRef + 1;
+        received++;
+
+        const Count fields = (frame.payload.size() - sizeof(Id)) / sizeof(CleonLoadSettings::Field);
+        minFields = std::min(minFields, fields);
+        maxFields = std::max(maxFields, fields);
+    });
+
+    codec.decode(stream);
+
+    const CleonLoadSettings::Statistics &generated = generator.statisticsConst();
+    const bool corrupted = generated.crcErrors > 100 && generated.truncations > 100;
+    //Every frame that wasn't corrupted gets through, and no corrupted frame does.
+    if (!corrupted || generated.frames - generated.crcErrors - generated.truncations != received || generated.crcErrors + generated.truncations != lost) {
+        CBT_LOGE(TAG, "Received %u of %u frames with %u CRC errors and %u truncations", static_cast<unsigned>(received), static_cast<unsigned>(generated.frames),
+                 static_cast<unsigned>(generated.crcErrors), static_cast<unsigned>(generated.truncations));
+        return EXIT_FAILURE;
+    }
+
+    assert(0 == minFields && 40 == maxFields);
+
+    return EXIT_SUCCESS;
+}
+
+static int runAllTests() {
+    std::vector<std::function<int(void)>> tests = {
+        ringBufferWrapTest,
+        ringBufferGrowTest,
+        lengthPrefixTest,
+        delimiterTest,
+        receiveFrameTest,
+        cleonFrameTest,
+        cleonResyncTest,
+        cleonThroughputTest,
+        cleonLoadScheduleTest,
+        cleonLoadCorruptionTest
+    };
+
+    for (auto test : tests) {
+        if (EXIT_SUCCESS != test()) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int main() {
+    OperatingSystem::Init();
+    Logger::Init();
+
+    return runAllTests();
+}
@@ -0,0 +1,159 @@
+//Modules
+#include "HostResolverModule.hpp"
+#include "OperatingSystemModule.hpp"
+//Applications
+#include "Log.hpp"
+//C++
+#include <fstream>
+
+static const char TAG[] = "HostResolverTest";
+static const std::string ResolverFile("/tmp/hostResolverTestFile");
+
+static void writeResolverFile(const std::string &records) {
+    std::ofstream file(ResolverFile, std::ios::trunc);
+    file << records;
+}
+
+static int resolverFileTest() {
+    std::vector<ResolvedAddress> addresses;
+    std::string ipAddress;
+    constexpr Milliseconds timeout = 1000;
+
+    writeResolverFile("#hostname ttl address\ncloud.example.test 1 192.0.2.10\ncloud.example.test 60 2001:db8::10\nother.example.test 60 192.0.2.20\n");
+    assert(ErrorType::Success == HostResolver::Instance().setResolverFile(ResolverFile));
+
+    assert(ErrorType::Success == HostResolver::Instance().resolveBlocking("cloud.example.test", addresses, timeout));
+    assert(2 == addresses.size());
+    assert(AF_INET == addresses[0].family);
+    assert(AF_INET6 == addresses[1].family);
+    assert(ErrorType::Success == addresses[0].toString(ipAddress));
+    if (0 != ipAddress.compare("192.0.2.10")) {
+        CBT_LOGE(TAG, "Resolved to %s", ipAddress.c_str());
+        return EXIT_FAILURE;
+    }
+    assert(ErrorType::Success == addresses[1].toString(ipAddress));
+    assert(0 == ipAddress.compare("2001:db8::10"));
+
+    //Addresses don't need a record.
+    assert(ErrorType::Success == HostResolver::Instance().resolveBlocking("192.0.2.30", addresses, timeout));
+    assert(1 == addresses.size() && AF_INET == addresses[0].family);
+    assert(ErrorType::Success == HostResolver::Instance().resolveBlocking("2001:db8::30", addresses, timeout));
+    assert(1 == addresses.size() && AF_INET6 == addresses[0].family);
+    assert(ErrorType::Success == addresses[0].toString(ipAddress));
+    assert(0 == ipAddress.compare("2001:db8::30"));
+
+    return EXIT_SUCCESS;
+}
+
+static int cacheTest() {
+    std::vector<ResolvedAddress> addresses;
+    std::string ipAddress;
+    constexpr Milliseconds timeout = 1000;
+    const Count lookups = HostResolver::Instance().lookups();
+
+    //The record changes but the cached answer is used until the shortest time to live (1 second) expires.
+    writeResolverFile("cloud.example.test 1 192.0.2.11\nother.example.test 60 192.0.2.20\n");
+    for (int i = 0; i < 100; i++) {
+        assert(ErrorType::Success == HostResolver::Instance().resolveBlocking("cloud.example.test", addresses, timeout));
+    }
+    assert(lookups == HostResolver::Instance().lookups());
+    assert(ErrorType::Success == addresses[0].toString(ipAddress));
+    assert(0 == ipAddress.compare("192.0.2.10"));
+
+    OperatingSystem::Instance().delay(1100);
+
+    assert(ErrorType::Success == HostResolver::Instance().resolveBlocking("cloud.example.test", addresses, timeout));
+    assert(lookups + 1 == HostResolver::Instance().lookups());
+    assert(1 == addresses.size());
+    assert(ErrorType::Success == addresses[0].toString(ipAddress));
+    if (0 != ipAddress.compare("192.0.2.11")) {
+        CBT_LOGE(TAG, "Expired answer was not refreshed. Resolved to %s", ipAddress.c_str());
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static int negativeCacheTest() {
+    std::vector<ResolvedAddress> addresses;
+    constexpr Milliseconds timeout = 1000;
+    const Count lookups = HostResolver::Instance().lookups();
+
+    assert(ErrorType::NoData == HostResolver::Instance().resolveBlocking("missing.example.test", addresses, timeout));
+    assert(ErrorType::NoData == HostResolver::Instance().resolveBlocking("missing.example.test", addresses, timeout));
+    assert(addresses.empty());
+    assert(lookups + 1 == HostResolver::Instance().lookups());
+
+    return EXIT_SUCCESS;
+}
+
+static int nonBlockingTest() {
+    bool resolved = false;
+    ErrorType result = ErrorType::Failure;
+    std::string ipAddress;
+    constexpr Milliseconds timeout = 1000;
+
+    auto callback = [&resolved, &result, &ipAddress](const ErrorType error, std::shared_ptr<std::vector<ResolvedAddress>> addresses) {
+        result = error;
+        if (ErrorType::Success == error) {
+            addresses->front().toString(ipAddress);
+        }
+        resolved = true;
+    };
+
+    assert(ErrorType::Success == HostResolver::Instance().resolveNonBlocking("other.example.test", callback));
+    for (Milliseconds i = 0; i < timeout / 10 && !resolved; i++) {
+        OperatingSystem::Instance().delay(10);
+    }
+
+    if (!resolved || ErrorType::Success != result || 0 != ipAddress.compare("192.0.2.20")) {
+        CBT_LOGE(TAG, "Non-blocking lookup failed");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static int systemResolverTest() {
+    std::vector<ResolvedAddress> addresses;
+    constexpr Milliseconds timeout = 1000;
+
+    //Restores the system resolver.
+    assert(ErrorType::Success == HostResolver::Instance().setResolverFile(""));
+    assert(ErrorType::Success == HostResolver::Instance().resolveBlocking("127.0.0.1", addresses, timeout));
+    assert(1 == addresses.size());
+    assert(AF_INET == addresses[0].family);
+
+    return EXIT_SUCCESS;
+}
+
+static int runAllTests() {
+    std::vector<std::function<int(void)>> tests = {
+        resolverFileTest,
+        cacheTest,
+        negativeCacheTest,
+        nonBlockingTest,
+        systemResolverTest
+    };
+
+    for (auto test : tests) {
+        if (EXIT_SUCCESS != test()) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int main() {
+    OperatingSystem::Init();
+    Logger::Init();
+    //Non-blocking lookups are answered by the resolver's own thread.
+    HostResolver::Init();
+
+    const int result = runAllTests();
+
+    remove(ResolverFile.c_str());
+
+    return result;
+}
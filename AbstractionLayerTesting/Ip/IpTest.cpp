@@ -5,11 +5,20 @@
 #include "IpServerModule.hpp"
 //Applications
 #include "Log.hpp"
+//C++
+#include <array>
+#include <atomic>
+#include <chrono>
 
 static const char TAG[] = "IpTest";
 static const std::string globalDataToSend("Hello World!");
 
 static constexpr Port ServerPort = 44000;
+static constexpr Port UnusedPort = 44001;
+static constexpr Port DualStackPort = 44600;
+static constexpr Port DualStackShardedPort = 44601;
+//Threads must stop using the network before main returns and destroys it.
+static std::atomic<bool> testsRunning(true);
 
 struct ClientNetwork {
     IpClient *client;
@@ -23,7 +32,7 @@ struct ServerNetwork {
 
 static void *startNetworkThread(void *arg) {
     Wifi *wifi = reinterpret_cast<Wifi *>(arg);
-    while (true) {
+    while (testsRunning) {
         OperatingSystem::Instance().delay(1);
         wifi->mainLoop();
     }
@@ -39,8 +48,6 @@ static void *startServerThread(void *arg) {
         assert(false);
     }
 
-    while(true);
-
     return nullptr;
 }
 
@@ -59,8 +66,6 @@ static void *startClientThread(void *arg) {
         CBT_LOGI(TAG, "Connected to server");
     }
 
-    while(true);
-
     return nullptr;
 }
 
@@ -85,18 +90,17 @@ static int blockingSendTest() {
     Socket sock = -1;
     constexpr Milliseconds timeout = 1000;
 
-    while (true) {
-        error = wifiNetworkServer.server->acceptConnection(sock);
-        if (ErrorType::Success != error) {
-            continue;
-        }
-        else {
-            assert(-1 != sock);
-            CBT_LOGI(TAG, "Accepted connection");
-            break;
+    //The server thread may not be listening yet.
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+    while (ErrorType::Success != (error = wifiNetworkServer.server->acceptConnection(sock))) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            CBT_LOGE(TAG, "No connection was accepted");
+            return EXIT_FAILURE;
         }
         OperatingSystem::Instance().delay(1);
     }
+    assert(-1 != sock);
+    CBT_LOGI(TAG, "Accepted connection");
 
     error = wifiNetworkClient.client->sendNonBlocking(std::make_shared<std::string>(globalDataToSend), timeout);
     if (ErrorType::Success != error) {
@@ -106,10 +110,109 @@ static int blockingSendTest() {
     return EXIT_SUCCESS;
 }
 
+static int connectRefusedTest() {
+    IpClient client;
+    Socket sock = -1;
+    constexpr Milliseconds timeout = 1000;
+
+    client.setNetwork(*wifiNetworkClient.wifi);
+
+    //Every candidate address for localhost refuses the connection so this should fail without waiting for the timeout.
+    const auto start = std::chrono::steady_clock::now();
+    const ErrorType error = client.connectTo("localhost", UnusedPort, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::Unknown, sock, timeout);
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+    if (ErrorType::Success == error || -1 != sock) {
+        CBT_LOGE(TAG, "Connected to a port that nobody is listening on");
+        return EXIT_FAILURE;
+    }
+
+    if (elapsed.count() >= timeout) {
+        CBT_LOGE(TAG, "Refused connection took %lld ms", static_cast<long long>(elapsed.count()));
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static int dualStackTest() {
+    IpServer server;
+    IpClient client;
+    Socket clientSocket = -1;
+    Socket serverSocket = -1;
+
+    assert(ErrorType::Success == server.listenTo(IpServerSettings::Protocol::Tcp, IpServerSettings::Version::DualStack, DualStackPort));
+    assert(ErrorType::Success == client.connectTo("127.0.0.1", DualStackPort, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::IPv4, clientSocket, 1000));
+    assert(ErrorType::Success == server.acceptConnection(serverSocket));
+
+    //Not ::ffff:127.0.0.1
+    if (IpServerSettings::Version::IPv4 != server.peerConst().version || "127.0.0.1" != server.peerConst().address || 0 == server.peerConst().port) {
+        CBT_LOGE(TAG, "IPv4 client was reported as %s port %u", server.peerConst().address.c_str(), server.peerConst().port);
+        return EXIT_FAILURE;
+    }
+
+    client.disconnect();
+    server.closeConnection();
+
+    if (IpServerSettings::Version::DualStack != server.version()) {
+        //This host has no IPv6 so there's only one family to serve.
+        return EXIT_SUCCESS;
+    }
+
+    //One worker and one event loop accept both families.
+    std::array<PeerAddress, 2> peers;
+    std::atomic<int> accepted(0);
+    std::atomic<int> recorded(0);
+    auto onAccept = [&peers, &accepted, &recorded](const Socket socket, const Id worker) {
+        const int i = accepted++;
+        if (i < static_cast<int>(peers.size())) {
+            IpServer::peerAddress(socket, peers[i]);
+            recorded++;
+        }
+        close(socket);
+    };
+
+    assert(ErrorType::Success == server.listenToSharded(IpServerSettings::Protocol::Tcp, IpServerSettings::Version::DualStack, DualStackShardedPort, 1, onAccept));
+
+    IpClient ipv4Client;
+    IpClient ipv6Client;
+    assert(ErrorType::Success == ipv4Client.connectTo("127.0.0.1", DualStackShardedPort, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::IPv4, clientSocket, 1000));
+    const ErrorType ipv6Error = ipv6Client.connectTo("::1", DualStackShardedPort, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::IPv6, clientSocket, 1000);
+    const int expected = ErrorType::Success == ipv6Error ? 2 : 1;
+
+    for (int i = 0; i < 100 && recorded < expected; i++) {
+        OperatingSystem::Instance().delay(10);
+    }
+    server.stopSharded();
+
+    if (expected != recorded) {
+        CBT_LOGE(TAG, "Dual stack workers accepted %d of %d connections", recorded.load(), expected);
+        return EXIT_FAILURE;
+    }
+
+    bool sawIpv4 = false;
+    bool sawIpv6 = 1 == expected;
+    for (int i = 0; i < expected; i++) {
+        sawIpv4 = sawIpv4 || (IpServerSettings::Version::IPv4 == peers[i].version && "127.0.0.1" == peers[i].address);
+        sawIpv6 = sawIpv6 || (IpServerSettings::Version::IPv6 == peers[i].version && "::1" == peers[i].address);
+    }
+
+    if (!sawIpv4 || !sawIpv6) {
+        CBT_LOGE(TAG, "Dual stack peers were reported as %s and %s", peers[0].address.c_str(), peers[1].address.c_str());
+        return EXIT_FAILURE;
+    }
+
+    ipv4Client.disconnect();
+    ipv6Client.disconnect();
+    return EXIT_SUCCESS;
+}
+
 static int runAllTests() {
     std::vector<std::function<int(void)>> tests = {
         blockingSendTest,
-        blockingReceiveTest
+        blockingReceiveTest,
+        connectRefusedTest,
+        dualStackTest
     };
 
     for (auto test : tests) {
@@ -163,5 +266,10 @@ int main() {
 
     int result = runAllTests();
 
+    testsRunning = false;
+    OperatingSystem::Instance().joinThread("networkThread");
+    OperatingSystem::Instance().joinThread("serverThread");
+    OperatingSystem::Instance().joinThread("clientThread");
+
     return result;
 }
\ No newline at end of file
@@ -0,0 +1,175 @@
+//Modules
+#include "OperatingSystemModule.hpp"
+#include "WifiModule.hpp"
+#include "IpClientPoolModule.hpp"
+//Applications
+#include "Log.hpp"
+//Posix
+#include <netinet/in.h>
+#include <poll.h>
+#include <unistd.h>
+
+static const char TAG[] = "IpClientPoolTest";
+static constexpr Port ServerPort = 44100;
+static constexpr Milliseconds Timeout = 1000;
+
+static Socket listener = -1;
+
+static ErrorType startListening() {
+    struct sockaddr_in address = {};
+    const int reuse = 1;
+
+    address.sin_family = AF_INET;
+    address.sin_port = htons(ServerPort);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (0 != bind(listener, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) || 0 != listen(listener, 8)) {
+        return ErrorType::Failure;
+    }
+
+    return ErrorType::Success;
+}
+
+//Returns the accepted socket or -1 if no connection was made to the server.
+static Socket acceptPending() {
+    struct pollfd descriptor = {.fd = listener, .events = POLLIN, .revents = 0};
+
+    if (1 != poll(&descriptor, 1, 100)) {
+        return -1;
+    }
+
+    return accept(listener, nullptr, nullptr);
+}
+
+static int reuseTest(Wifi &wifi) {
+    IpClientPool pool(wifi);
+    std::unique_ptr<IpClient> client;
+
+    assert(ErrorType::Success == pool.lease("127.0.0.1", ServerPort, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::IPv4, client, Timeout));
+    const Socket serverSide = acceptPending();
+    assert(-1 != serverSide);
+    const Socket firstSocket = client->sockConst();
+    assert(1 == pool.leasedConnections());
+
+    assert(ErrorType::Success == pool.giveBack(client));
+    assert(nullptr == client);
+    assert(1 == pool.idleConnections());
+    assert(0 == pool.leasedConnections());
+
+    assert(ErrorType::Success == pool.lease("127.0.0.1", ServerPort, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::IPv4, client, Timeout));
+    if (firstSocket != client->sockConst() || -1 != acceptPending()) {
+        CBT_LOGE(TAG, "The idle connection was not reused");
+        return EXIT_FAILURE;
+    }
+
+    pool.giveBack(client);
+    close(serverSide);
+    return EXIT_SUCCESS;
+}
+
+static int maxPerHostTest(Wifi &wifi) {
+    constexpr Count maxPerHost = 2;
+    IpClientPool pool(wifi, maxPerHost);
+    std::unique_ptr<IpClient> first, second, third;
+
+    assert(ErrorType::Success == pool.lease("127.0.0.1", ServerPort, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::IPv4, first, Timeout));
+    assert(ErrorType::Success == pool.lease("127.0.0.1", ServerPort, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::IPv4, second, Timeout));
+    const Socket serverSide1 = acceptPending();
+    const Socket serverSide2 = acceptPending();
+
+    if (ErrorType::LimitReached != pool.lease("127.0.0.1", ServerPort, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::IPv4, third, 50)) {
+        CBT_LOGE(TAG, "Leased more than the maximum number of connections to a host");
+        return EXIT_FAILURE;
+    }
+
+    //Once a connection is given back, it can be leased again.
+    assert(ErrorType::Success == pool.giveBack(second));
+    assert(ErrorType::Success == pool.lease("127.0.0.1", ServerPort, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::IPv4, third, 50));
+
+    pool.giveBack(first);
+    pool.giveBack(third);
+    close(serverSide1);
+    close(serverSide2);
+    return EXIT_SUCCESS;
+}
+
+static int healthCheckTest(Wifi &wifi) {
+    IpClientPool pool(wifi);
+    std::unique_ptr<IpClient> client;
+
+    assert(ErrorType::Success == pool.lease("127.0.0.1", ServerPort, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::IPv4, client, Timeout));
+    const Socket serverSide = acceptPending();
+    assert(ErrorType::Success == pool.giveBack(client));
+
+    //The server hangs up on the idle connection so the next lease has to make a new connection.
+    close(serverSide);
+    OperatingSystem::Instance().delay(10);
+
+    assert(ErrorType::Success == pool.lease("127.0.0.1", ServerPort, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::IPv4, client, Timeout));
+    const Socket newServerSide = acceptPending();
+    if (-1 == newServerSide) {
+        CBT_LOGE(TAG, "A closed connection was leased");
+        return EXIT_FAILURE;
+    }
+
+    pool.giveBack(client);
+    close(newServerSide);
+    return EXIT_SUCCESS;
+}
+
+static int idleTimeoutTest(Wifi &wifi) {
+    constexpr Milliseconds idleTimeout = 50;
+    IpClientPool pool(wifi, IpClientPool::DefaultMaxPerHost, idleTimeout);
+    std::unique_ptr<IpClient> client;
+
+    assert(ErrorType::Success == pool.lease("127.0.0.1", ServerPort, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::IPv4, client, Timeout));
+    const Socket serverSide = acceptPending();
+    assert(ErrorType::Success == pool.giveBack(client));
+    assert(1 == pool.idleConnections());
+
+    OperatingSystem::Instance().delay(2*idleTimeout);
+    pool.mainLoop();
+
+    if (0 != pool.idleConnections()) {
+        CBT_LOGE(TAG, "Idle connection was not reaped");
+        return EXIT_FAILURE;
+    }
+
+    close(serverSide);
+    return EXIT_SUCCESS;
+}
+
+static int runAllTests(Wifi &wifi) {
+    std::vector<std::function<int(Wifi &)>> tests = {
+        reuseTest,
+        maxPerHostTest,
+        healthCheckTest,
+        idleTimeoutTest
+    };
+
+    for (auto test : tests) {
+        if (EXIT_SUCCESS != test(wifi)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int main() {
+    OperatingSystem::Init();
+    Logger::Init();
+    Wifi testWifi;
+
+    if (ErrorType::Success != startListening()) {
+        CBT_LOGE(TAG, "Failed to listen on port %d", ServerPort);
+        return EXIT_FAILURE;
+    }
+
+    const int result = runAllTests(testWifi);
+
+    close(listener);
+    return result;
+}
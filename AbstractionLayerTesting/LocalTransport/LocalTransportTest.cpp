@@ -0,0 +1,211 @@
+//Modules
+#include "OperatingSystemModule.hpp"
+#include "IpClientModule.hpp"
+#include "IpServerModule.hpp"
+#include "SharedMemoryClientModule.hpp"
+//Applications
+#include "Log.hpp"
+//Posix
+#include <sys/socket.h>
+//C++
+#include <atomic>
+#include <vector>
+
+static const char TAG[] = "LocalTransportTest";
+static const std::string StreamPath("/tmp/localTransportStream.sock");
+static const std::string SeqpacketPath("/tmp/localTransportSeqpacket.sock");
+static const std::string SharedMemoryPath("/tmp/localTransportSharedMemory.sock");
+
+//Small enough that the transfer wraps around the rings many times.
+static constexpr Bytes RingSize = 4096;
+static constexpr Bytes BytesToTransfer = 4*1024*1024;
+
+static std::atomic<bool> peerPassed(false);
+static std::atomic<bool> peerDone(false);
+
+static char pattern(const Bytes index) {
+    return static_cast<char>(index % 251);
+}
+
+static void *startSharedMemoryPeer(void *arg) {
+    SharedMemoryClient peer(RingSize);
+    std::string buffer;
+    Bytes received = 0;
+
+    if (ErrorType::Success != peer.acceptOn(SharedMemoryPath, 2000)) {
+        CBT_LOGE(TAG, "Shared memory peer was not connected to");
+        peerDone = true;
+        return nullptr;
+    }
+
+    while (received < BytesToTransfer) {
+        buffer.resize(1500);
+        if (ErrorType::Success != peer.receiveBlocking(buffer, 1000)) {
+            CBT_LOGE(TAG, "Shared memory peer stopped receiving after %u bytes", received);
+            peerDone = true;
+            return nullptr;
+        }
+
+        for (char byte : buffer) {
+            if (pattern(received++) != byte) {
+                CBT_LOGE(TAG, "Shared memory peer received corrupt data at byte %u", received - 1);
+                peerDone = true;
+                return nullptr;
+            }
+        }
+    }
+
+    std::string reply(BytesToTransfer, 0);
+    for (Bytes i = 0; i < reply.size(); i++) {
+        reply[i] = pattern(i);
+    }
+
+    if (ErrorType::Success != peer.sendBlocking(reply, 1000)) {
+        CBT_LOGE(TAG, "Shared memory peer could not reply");
+        peerDone = true;
+        return nullptr;
+    }
+
+    //The other side disconnects once it has the reply.
+    buffer.resize(1500);
+    peerPassed = ErrorType::Failure == peer.receiveBlocking(buffer, 1000);
+    peerDone = true;
+    return nullptr;
+}
+
+static int unixStreamTest() {
+    IpServer server;
+    IpClient client;
+    Socket clientSocket = -1;
+    Socket serverSocket = -1;
+    const std::string message("Hello from the same host");
+
+    assert(ErrorType::InvalidParameter == server.listenToLocal(IpServerSettings::Protocol::Tcp, StreamPath));
+    assert(ErrorType::Success == server.listenToLocal(IpServerSettings::Protocol::UnixStream, StreamPath));
+
+    //The connection waits in the backlog until it is accepted.
+    assert(ErrorType::Success == client.connectTo(StreamPath, 0, IpClientSettings::Protocol::UnixStream, IpClientSettings::Version::Unknown, clientSocket, 1000));
+    assert(ErrorType::Success == server.acceptConnection(serverSocket));
+
+    assert(message.size() == static_cast<size_t>(send(clientSocket, message.data(), message.size(), 0)));
+    std::string buffer(256, 0);
+    assert(ErrorType::Success == server.receiveBlocking(buffer, 1000));
+    if (buffer != message) {
+        CBT_LOGE(TAG, "Received %s instead of %s", buffer.c_str(), message.c_str());
+        return EXIT_FAILURE;
+    }
+
+    TcpTuningSettings::Statistics statistics;
+    assert(ErrorType::NotSupported == client.tcpStatistics(statistics));
+    assert(ErrorType::NotSupported == server.tcpStatistics(statistics));
+
+    client.disconnect();
+    return EXIT_SUCCESS;
+}
+
+static int seqpacketTest() {
+    IpServer server;
+    IpClient client;
+    Socket clientSocket = -1;
+    Socket serverSocket = -1;
+    const std::vector<std::string> messages = {"one", "a little longer", std::string(2000, 'x')};
+
+    assert(ErrorType::Success == server.listenToLocal(IpServerSettings::Protocol::UnixSeqpacket, SeqpacketPath));
+    assert(ErrorType::Success == client.connectTo(SeqpacketPath, 0, IpClientSettings::Protocol::UnixSeqpacket, IpClientSettings::Version::Unknown, clientSocket, 1000));
+    assert(ErrorType::Success == server.acceptConnection(serverSocket));
+
+    for (const std::string &message : messages) {
+        assert(message.size() == static_cast<size_t>(send(clientSocket, message.data(), message.size(), 0)));
+    }
+
+    //Each message comes out on its own even though there's room for all of them.
+    for (const std::string &message : messages) {
+        std::string buffer(4096, 0);
+        assert(ErrorType::Success == server.receiveBlocking(buffer, 1000));
+        if (buffer != message) {
+            CBT_LOGE(TAG, "Message boundaries were not kept. Received %u bytes instead of %u", buffer.size(), message.size());
+            return EXIT_FAILURE;
+        }
+    }
+
+    client.disconnect();
+    return EXIT_SUCCESS;
+}
+
+static int sharedMemoryTest() {
+    SharedMemoryClient client;
+    Socket sock = -1;
+    Id peerThread;
+    ErrorType error;
+
+    OperatingSystem::Instance().createThread(OperatingSystemConfig::Priority::Normal, "sharedMemoryPeer", nullptr, 64*1024, startSharedMemoryPeer, peerThread);
+
+    //The peer may not be accepting yet.
+    for (int i = 0; i < 100; i++) {
+        error = client.connectTo(SharedMemoryPath, 0, IpClientSettings::Protocol::Unknown, IpClientSettings::Version::Unknown, sock, 1000);
+        if (ErrorType::Success == error || ErrorType::NotSupported == error) {
+            break;
+        }
+        OperatingSystem::Instance().delay(10);
+    }
+
+    if (ErrorType::NotSupported == error) {
+        OperatingSystem::Instance().joinThread("sharedMemoryPeer");
+        return EXIT_SUCCESS;
+    }
+    assert(ErrorType::Success == error);
+
+    std::string buffer(1500, 0);
+    assert(ErrorType::Timeout == client.receiveBlocking(buffer, 10));
+
+    std::string data(BytesToTransfer, 0);
+    for (Bytes i = 0; i < data.size(); i++) {
+        data[i] = pattern(i);
+    }
+    assert(ErrorType::Success == client.sendBlocking(data, 1000));
+
+    Bytes received = 0;
+    while (received < BytesToTransfer) {
+        buffer.resize(3000);
+        assert(ErrorType::Success == client.receiveBlocking(buffer, 1000));
+        for (char byte : buffer) {
+            if (pattern(received++) != byte) {
+                CBT_LOGE(TAG, "Received corrupt data at byte %u", received - 1);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    client.disconnect();
+    OperatingSystem::Instance().joinThread("sharedMemoryPeer");
+
+    if (!peerDone || !peerPassed) {
+        CBT_LOGE(TAG, "Shared memory peer did not notice the disconnect");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static int runAllTests() {
+    std::vector<std::function<int(void)>> tests = {
+        unixStreamTest,
+        seqpacketTest,
+        sharedMemoryTest
+    };
+
+    for (auto test : tests) {
+        if (EXIT_SUCCESS != test()) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int main() {
+    OperatingSystem::Init();
+    Logger::Init();
+
+    return runAllTests();
+}
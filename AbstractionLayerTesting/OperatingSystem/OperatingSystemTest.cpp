@@ -1,4 +1,5 @@
 //C++
+#include <chrono>
 #include <vector>
 #include <functional>
 //Modules
@@ -76,6 +77,15 @@ static int semaphoreTest() {
     error = OperatingSystem::Instance().waitSemaphore(semaphoreName, 1000);
     assert(ErrorType::Success == error);
 
+    //Nothing else increments it so the wait has to give up once the timeout expires.
+    const auto start = std::chrono::steady_clock::now();
+    error = OperatingSystem::Instance().waitSemaphore(semaphoreName, 50);
+    const auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    if (ErrorType::Timeout != error || waited < 40 || waited > 500) {
+        CBT_LOGE(TAG, "Waited %lld ms for a 50 ms timeout", static_cast<long long>(waited));
+        return EXIT_FAILURE;
+    }
+
     return EXIT_SUCCESS;
 }
 
@@ -0,0 +1,282 @@
+//Modules
+#include "OperatingSystemModule.hpp"
+#include "SendQueueModule.hpp"
+//Applications
+#include "Log.hpp"
+//Posix
+#include <sys/socket.h>
+#include <unistd.h>
+#include <poll.h>
+//C++
+#include <chrono>
+#include <vector>
+
+static const char TAG[] = "SendQueueTest";
+//Small enough that the socket fills up long before the messages run out.
+static constexpr int SocketBufferSize = 4096;
+
+static void makeSocketPair(Socket &writer, Socket &reader) {
+    int sockets[2];
+    const int bufferSize = SocketBufferSize;
+
+    assert(0 == socketpair(AF_UNIX, SOCK_STREAM, 0, sockets));
+    assert(0 == setsockopt(sockets[0], SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize)));
+    assert(0 == setsockopt(sockets[1], SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize)));
+    writer = sockets[0];
+    reader = sockets[1];
+}
+
+static std::string readerReceived;
+
+static void *startReaderThread(void *arg) {
+    const Socket reader = *static_cast<Socket *>(arg);
+    char buffer[4096];
+    ssize_t bytesRead;
+
+    while ((bytesRead = recv(reader, buffer, sizeof(buffer), 0)) > 0) {
+        readerReceived.append(buffer, bytesRead);
+    }
+
+    return nullptr;
+}
+
+static Bytes drain(Socket reader, std::string &received) {
+    char buffer[1024];
+    Bytes total = 0;
+    ssize_t bytesRead;
+
+    while ((bytesRead = recv(reader, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+        received.append(buffer, bytesRead);
+        total += bytesRead;
+    }
+
+    return total;
+}
+
+static int backpressureTest() {
+    constexpr Bytes messageSize = 1000;
+    constexpr Milliseconds timeout = 5000;
+    Socket writer, reader;
+    makeSocketPair(writer, reader);
+
+    SendQueue queue(16*1024, 4*1024);
+    std::vector<bool> throttleChanges;
+    Count completed = 0;
+    std::string expected;
+
+    queue.setSocket(writer);
+    queue.setBackpressureCallback([&throttleChanges](const bool throttle) { throttleChanges.push_back(throttle); });
+
+    //Keep producing without anyone reading until the queue pushes back.
+    Count queued = 0;
+    while (ErrorType::Success == queue.enqueue(std::make_shared<std::string>(messageSize, static_cast<char>('a' + queued % 26)), timeout,
+                                               [&completed](const ErrorType error, const Bytes bytesWritten) {
+                                                   assert(ErrorType::Success == error);
+                                                   assert(messageSize == bytesWritten);
+                                                   completed++;
+                                               })) {
+        expected.append(messageSize, static_cast<char>('a' + queued % 26));
+        queued++;
+        queue.flush();
+        assert(queued < 1000);
+    }
+
+    if (1 != throttleChanges.size() || !throttleChanges.back() || !queue.throttled()) {
+        CBT_LOGE(TAG, "Producer was not throttled at the high watermark");
+        return EXIT_FAILURE;
+    }
+    assert(queue.queuedBytes() >= 16*1024);
+    assert(ErrorType::LimitReached == queue.enqueue(std::make_shared<std::string>("x"), timeout, nullptr));
+
+    //The peer catching up lets the producer go again.
+    std::string received;
+    while (queue.queuedBytes() > 0) {
+        drain(reader, received);
+        queue.flush();
+    }
+    drain(reader, received);
+
+    if (2 != throttleChanges.size() || throttleChanges.back() || queue.throttled()) {
+        CBT_LOGE(TAG, "Producer was not resumed at the low watermark");
+        return EXIT_FAILURE;
+    }
+
+    //Short writes were continued from where they left off.
+    if (queued != completed || received != expected) {
+        CBT_LOGE(TAG, "Received %zu of %zu bytes. %u of %u messages completed", received.size(), expected.size(), completed, queued);
+        return EXIT_FAILURE;
+    }
+
+    close(writer);
+    close(reader);
+    return EXIT_SUCCESS;
+}
+
+static int deadlineTest() {
+    Socket writer, reader;
+    makeSocketPair(writer, reader);
+
+    SendQueue queue(1024*1024, 0);
+    ErrorType firstError = ErrorType::Success, lastError = ErrorType::Success;
+    Bytes firstWritten = 0;
+    std::string received;
+
+    queue.setSocket(writer);
+
+    //Too big for the socket so the first message is left partly written and the second never starts.
+    assert(ErrorType::Success == queue.enqueue(std::make_shared<std::string>(256*1024, 'a'), 50, [&](const ErrorType error, const Bytes bytesWritten) {
+        firstError = error;
+        firstWritten = bytesWritten;
+    }));
+    assert(ErrorType::Success == queue.enqueue(std::make_shared<std::string>(16, 'b'), 50, [&](const ErrorType error, const Bytes bytesWritten) {
+        lastError = error;
+        assert(0 == bytesWritten);
+    }));
+    assert(ErrorType::LimitReached == queue.flush());
+
+    OperatingSystem::Instance().delay(100);
+
+    //The partly written message can't be dropped without corrupting the stream so the whole queue gives up.
+    if (ErrorType::Failure != queue.flush() || ErrorType::Failure != firstError || ErrorType::Failure != lastError) {
+        CBT_LOGE(TAG, "A partly written message that expired did not fail the queue");
+        return EXIT_FAILURE;
+    }
+    assert(firstWritten > 0 && firstWritten < 256*1024);
+    assert(ErrorType::PrerequisitesNotMet == queue.enqueue(std::make_shared<std::string>("c"), 50, nullptr));
+
+    //A message that expires before it is started is dropped and the connection is still usable.
+    queue.setSocket(writer);
+    drain(reader, received);
+    received.clear();
+
+    assert(ErrorType::Success == queue.enqueue(std::make_shared<std::string>(256*1024, 'd'), 5000, nullptr));
+    assert(ErrorType::Success == queue.enqueue(std::make_shared<std::string>("late"), 10, [&](const ErrorType error, const Bytes bytesWritten) {
+        lastError = error;
+    }));
+    assert(ErrorType::Success == queue.enqueue(std::make_shared<std::string>("on time"), 5000, nullptr));
+    queue.flush();
+    OperatingSystem::Instance().delay(50);
+
+    while (queue.queuedBytes() > 0) {
+        drain(reader, received);
+        queue.flush();
+    }
+    drain(reader, received);
+
+    if (ErrorType::Timeout != lastError || received != std::string(256*1024, 'd').append("on time")) {
+        CBT_LOGE(TAG, "An expired message that was not started was not dropped cleanly");
+        return EXIT_FAILURE;
+    }
+
+    close(writer);
+    close(reader);
+    return EXIT_SUCCESS;
+}
+
+static int sendBlockingTest() {
+    constexpr Bytes messageSize = 512*1024;
+    Socket writer, reader;
+    makeSocketPair(writer, reader);
+
+    SendQueue queue;
+    std::string received;
+    queue.setSocket(writer);
+
+    //Nobody is reading so only part of the message fits.
+    if (ErrorType::Failure != queue.sendBlocking(std::string(messageSize, 'a'), 50)) {
+        CBT_LOGE(TAG, "A partly sent blocking message did not fail when it timed out");
+        return EXIT_FAILURE;
+    }
+    drain(reader, received);
+    received.clear();
+
+    queue.setSocket(writer);
+
+    //Read on another thread so that the whole message goes out in pieces.
+    Id thread;
+    assert(ErrorType::Success == OperatingSystem::Instance().createThread(OperatingSystemConfig::Priority::Normal, "sendQueueReader", &reader, 16*1024, startReaderThread, thread));
+
+    assert(ErrorType::Success == queue.sendBlocking(std::string(messageSize, 'b'), 5000));
+    assert(ErrorType::Success == queue.sendBlocking("end", 5000));
+    shutdown(writer, SHUT_WR);
+
+    OperatingSystem::Instance().joinThread("sendQueueReader");
+    OperatingSystem::Instance().deleteThread("sendQueueReader");
+
+    if (readerReceived != std::string(messageSize, 'b').append("end")) {
+        CBT_LOGE(TAG, "Blocking send did not write the whole message");
+        return EXIT_FAILURE;
+    }
+
+    close(writer);
+    close(reader);
+    return EXIT_SUCCESS;
+}
+
+static int scheduledFlushTest() {
+    constexpr Bytes messageSize = 256*1024;
+    Socket writer, reader;
+    makeSocketPair(writer, reader);
+
+    EventQueue events;
+    auto queue = std::make_shared<SendQueue>(1024*1024, 0);
+    std::string received;
+    Count completed = 0;
+    queue->setSocket(writer);
+
+    assert(ErrorType::Success == queue->enqueue(std::make_shared<std::string>(messageSize, 'a'), 5000, [&](const ErrorType error, const Bytes bytesWritten) {
+        assert(ErrorType::Success == error && messageSize == bytesWritten);
+        completed++;
+    }));
+    assert(ErrorType::Success == SendQueue::scheduleFlush(queue, events));
+    assert(ErrorType::Success == events.runNextEvent());
+
+    //Nobody is reading so the socket is full. The flush waits for it to become writable instead of going straight back on the queue.
+    OperatingSystem::Instance().delay(50);
+    if (ErrorType::NoData != events.runNextEvent()) {
+        CBT_LOGE(TAG, "The flush of a full socket was retried before the socket was writable");
+        return EXIT_FAILURE;
+    }
+
+    //Each time the reader makes room the flush comes back.
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (0 == completed && std::chrono::steady_clock::now() < deadline) {
+        drain(reader, received);
+        events.runNextEvent();
+        OperatingSystem::Instance().delay(1);
+    }
+    drain(reader, received);
+
+    if (1 != completed || received != std::string(messageSize, 'a')) {
+        CBT_LOGE(TAG, "Received %zu of %zu bytes once the socket was writable", received.size(), messageSize);
+        return EXIT_FAILURE;
+    }
+
+    close(writer);
+    close(reader);
+    return EXIT_SUCCESS;
+}
+
+static int runAllTests() {
+    std::vector<std::function<int(void)>> tests = {
+        backpressureTest,
+        deadlineTest,
+        sendBlockingTest,
+        scheduledFlushTest
+    };
+
+    for (auto test : tests) {
+        if (EXIT_SUCCESS != test()) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int main() {
+    OperatingSystem::Init();
+    Logger::Init();
+
+    return runAllTests();
+}
@@ -0,0 +1,187 @@
+//Modules
+#include "OperatingSystemModule.hpp"
+#include "IpClientModule.hpp"
+#include "TcpTuningModule.hpp"
+//Applications
+#include "Log.hpp"
+//Posix
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+//C++
+#include <chrono>
+
+static const char TAG[] = "TcpTuningTest";
+static constexpr Port ServerPort = 44400;
+
+static int option(Socket sock, int level, int name) {
+    int value = -1;
+    socklen_t length = sizeof(value);
+    assert(0 == getsockopt(sock, level, name, &value, &length));
+    return value;
+}
+
+static Socket listenOnLoopback() {
+    struct sockaddr_in address = {};
+    const int reuse = 1;
+
+    address.sin_family = AF_INET;
+    address.sin_port = htons(ServerPort);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    const Socket listener = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    assert(0 == bind(listener, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)));
+    assert(0 == listen(listener, 1));
+
+    return listener;
+}
+
+static int profileTest() {
+    const TcpTuningSettings::Settings defaults = TcpTuning::profile(TcpTuningSettings::Profile::Unknown);
+    assert(!defaults.noDelay && !defaults.cork && !defaults.keepAlive);
+    assert(0 == defaults.sendBufferSize && 0 == defaults.receiveBufferSize && 0 == defaults.userTimeout);
+
+    const TcpTuningSettings::Settings lowLatency = TcpTuning::profile(TcpTuningSettings::Profile::LowLatency);
+    const TcpTuningSettings::Settings bulk = TcpTuning::profile(TcpTuningSettings::Profile::Bulk);
+    const TcpTuningSettings::Settings cellular = TcpTuning::profile(TcpTuningSettings::Profile::Cellular);
+
+    //Bulk relies on Nagle instead of corking, which would hold back the end of every message.
+    if (!lowLatency.noDelay || lowLatency.cork || bulk.cork || bulk.noDelay) {
+        CBT_LOGE(TAG, "Low latency should turn Nagle off and bulk should leave it on without corking");
+        return EXIT_FAILURE;
+    }
+
+    //Dead peers take longer to notice on a high latency link.
+    assert(cellular.userTimeout > lowLatency.userTimeout);
+    assert(cellular.keepAlive && cellular.noDelay);
+
+    return EXIT_SUCCESS;
+}
+
+static int connectTuningTest() {
+    constexpr Milliseconds timeout = 1000;
+    const Socket listener = listenOnLoopback();
+
+    IpClient client;
+    Socket sock = -1;
+    assert(ErrorType::Success == client.setTuning(TcpTuning::profile(TcpTuningSettings::Profile::Cellular)));
+    assert(ErrorType::Success == client.connectTo("127.0.0.1", ServerPort, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::IPv4, sock, timeout));
+    const Socket serverSide = accept(listener, nullptr, nullptr);
+    assert(-1 != serverSide);
+
+    if (1 != option(sock, IPPROTO_TCP, TCP_NODELAY) || 0 == option(sock, SOL_SOCKET, SO_KEEPALIVE)) {
+        CBT_LOGE(TAG, "Profile was not applied when connecting");
+        return EXIT_FAILURE;
+    }
+#ifdef TCP_KEEPIDLE
+    assert(60 == option(sock, IPPROTO_TCP, TCP_KEEPIDLE));
+#endif
+#ifdef TCP_USER_TIMEOUT
+    assert(120000 == option(sock, IPPROTO_TCP, TCP_USER_TIMEOUT));
+#endif
+
+    //Changing the tuning of an open connection takes effect right away.
+    TcpTuningSettings::Settings settings = TcpTuning::profile(TcpTuningSettings::Profile::Bulk);
+    settings.sendBufferSize = 64*1024;
+    assert(ErrorType::Success == client.setTuning(settings));
+    assert(0 == option(sock, IPPROTO_TCP, TCP_NODELAY));
+    //Linux doubles the size for bookkeeping.
+    assert(option(sock, SOL_SOCKET, SO_SNDBUF) >= static_cast<int>(settings.sendBufferSize));
+#ifdef TCP_CORK
+    assert(0 == option(sock, IPPROTO_TCP, TCP_CORK));
+#endif
+
+    //A message smaller than a segment goes out straight away instead of waiting on the 200ms cork timer.
+    const std::string message("partial segment");
+    const auto start = std::chrono::steady_clock::now();
+    assert(static_cast<ssize_t>(message.size()) == send(sock, message.data(), message.size(), 0));
+    std::string received(message.size(), 0);
+    assert(static_cast<ssize_t>(message.size()) == recv(serverSide, received.data(), received.size(), MSG_WAITALL));
+    const auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    if (waited >= 100) {
+        CBT_LOGE(TAG, "The end of a message was held back for %lld ms", static_cast<long long>(waited));
+        return EXIT_FAILURE;
+    }
+
+    close(serverSide);
+    close(listener);
+    return EXIT_SUCCESS;
+}
+
+static int statisticsTest() {
+    constexpr Milliseconds timeout = 1000;
+    constexpr Bytes bytesToSend = 32*1024;
+    const Socket listener = listenOnLoopback();
+
+    IpClient client;
+    Socket sock = -1;
+    TcpTuningSettings::Statistics statistics;
+
+    assert(ErrorType::PrerequisitesNotMet == client.tcpStatistics(statistics));
+
+    assert(ErrorType::Success == client.connectTo("127.0.0.1", ServerPort, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::IPv4, sock, timeout));
+    const Socket serverSide = accept(listener, nullptr, nullptr);
+    assert(-1 != serverSide);
+
+    const std::string data(bytesToSend, 'a');
+    assert(bytesToSend == send(sock, data.data(), data.size(), 0));
+
+    std::string received(bytesToSend, 0);
+    Bytes total = 0;
+    while (total < bytesToSend) {
+        const ssize_t bytesRead = recv(serverSide, received.data() + total, bytesToSend - total, 0);
+        assert(bytesRead > 0);
+        total += bytesRead;
+    }
+
+    //Give the acknowledgements a moment to come back.
+    OperatingSystem::Instance().delay(10);
+
+    const ErrorType error = client.tcpStatistics(statistics);
+    if (ErrorType::NotSupported == error) {
+        close(serverSide);
+        close(listener);
+        return EXIT_SUCCESS;
+    }
+    assert(ErrorType::Success == error);
+
+    if (0 == statistics.roundTripTime || 0 == statistics.congestionWindow || 0 == statistics.maxSegmentSize) {
+        CBT_LOGE(TAG, "Statistics were not filled in. rtt:%u cwnd:%u mss:%u", statistics.roundTripTime, statistics.congestionWindow, statistics.maxSegmentSize);
+        return EXIT_FAILURE;
+    }
+
+#ifdef __linux__
+    if (statistics.bytesAcked < bytesToSend) {
+        CBT_LOGE(TAG, "Only %llu of %u bytes were acknowledged", static_cast<unsigned long long>(statistics.bytesAcked), bytesToSend);
+        return EXIT_FAILURE;
+    }
+#endif
+
+    close(serverSide);
+    close(listener);
+    return EXIT_SUCCESS;
+}
+
+static int runAllTests() {
+    std::vector<std::function<int(void)>> tests = {
+        profileTest,
+        connectTuningTest,
+        statisticsTest
+    };
+
+    for (auto test : tests) {
+        if (EXIT_SUCCESS != test()) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int main() {
+    OperatingSystem::Init();
+    Logger::Init();
+
+    return runAllTests();
+}
@@ -0,0 +1,415 @@
+//Modules
+#include "OperatingSystemModule.hpp"
+#include "WifiModule.hpp"
+//Applications
+#include "Log.hpp"
+#include "TrafficShaper.hpp"
+#include "ShapedIpClient.hpp"
+//C++
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+static const char TAG[] = "TrafficShapingTest";
+
+using Priority = TrafficShaperSettings::Priority;
+
+/// @brief Records what is sent through it instead of sending it anywhere.
+class FakeClient : public IpClientAbstraction {
+
+    public:
+    ErrorType connectTo(std::string hostname, Port port, IpClientSettings::Protocol protocol, IpClientSettings::Version version, Socket &socket, Milliseconds timeout) override {
+        _hostname = hostname;
+        _port = port;
+        _protocol = protocol;
+        _version = version;
+        _socket = socket = 1;
+        _status.connected = true;
+        return ErrorType::Success;
+    }
+    ErrorType disconnect() override {
+        _status.connected = false;
+        return ErrorType::Success;
+    }
+    ErrorType sendBlocking(const std::string &data, const Milliseconds timeout) override {
+        pieces.push_back(data.size());
+        return ErrorType::Success;
+    }
+    ErrorType receiveBlocking(std::string &buffer, const Milliseconds timeout) override {
+        return ErrorType::Success;
+    }
+    ErrorType sendNonBlocking(const std::shared_ptr<std::string> data, const Milliseconds timeout, std::function<void(const ErrorType error, const Bytes bytesWritten)> callback = nullptr) override {
+        pieces.push_back(data->size());
+        if (nullptr != callback) {
+            callback(ErrorType::Success, data->size());
+        }
+        return ErrorType::Success;
+    }
+    ErrorType receiveNonBlocking(std::shared_ptr<std::string> buffer, const Milliseconds timeout, std::function<void(const ErrorType error, std::shared_ptr<std::string> buffer)> callback = nullptr) override {
+        if (nullptr != callback) {
+            callback(ErrorType::Success, buffer);
+        }
+        return ErrorType::Success;
+    }
+
+    std::vector<Bytes> pieces;
+};
+
+static double secondsSince(const std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int rateTest() {
+    TrafficShaperSettings::Settings settings;
+    settings.rate = 20000;
+    settings.burst = 2000;
+    TrafficShaper shaper(settings);
+    Milliseconds retryIn;
+
+    //A full bucket goes out at once.
+    auto start = std::chrono::steady_clock::now();
+    assert(ErrorType::Success == shaper.acquire(2000, Priority::Bulk, 0));
+    assert(ErrorType::NotAvailable == shaper.tryAcquire(1000, Priority::Bulk, retryIn));
+    assert(retryIn > 0 && retryIn <= 50);
+
+    //The rest is paced at the rate.
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 8; i++) {
+        assert(ErrorType::Success == shaper.acquire(1000, Priority::Bulk, 1000));
+    }
+
+    const double elapsed = secondsSince(start);
+    if (elapsed < 0.3 || elapsed > 0.8) {
+        CBT_LOGE(TAG, "8000 bytes at 20000 bytes per second took %f seconds", elapsed);
+        return EXIT_FAILURE;
+    }
+
+    assert(ErrorType::Timeout == shaper.acquire(2000, Priority::Bulk, 10));
+
+    return EXIT_SUCCESS;
+}
+
+static int oversizedTest() {
+    TrafficShaperSettings::Settings settings;
+    settings.rate = 20000;
+    settings.burst = 1000;
+    TrafficShaper shaper(settings);
+    Milliseconds retryIn;
+
+    //Larger than the burst still goes once the bucket is full, and the difference is paid off afterwards.
+    assert(ErrorType::Success == shaper.tryAcquire(5000, Priority::Bulk, retryIn));
+    assert(ErrorType::NotAvailable == shaper.tryAcquire(1, Priority::Bulk, retryIn));
+    if (retryIn < 150 || retryIn > 250) {
+        CBT_LOGE(TAG, "Expected to wait about 200ms to pay off 4000 bytes of debt but was told %u", retryIn);
+        return EXIT_FAILURE;
+    }
+
+    //Defaults to a second's worth.
+    settings.burst = 0;
+    TrafficShaper defaultBurst(settings);
+    assert(20000 == defaultBurst.settingsConst().burst);
+
+    return EXIT_SUCCESS;
+}
+
+static int priorityTest() {
+    TrafficShaperSettings::Settings settings;
+    settings.rate = 100000;
+    settings.burst = 1000;
+    TrafficShaper shaper(settings);
+    Milliseconds retryIn;
+
+    assert(ErrorType::Success == shaper.tryAcquire(1000, Priority::Bulk, retryIn));
+
+    //Bulk gets nothing while control is waiting, even once the bucket has filled again.
+    shaper.beginWaiting(Priority::Control);
+    OperatingSystem::Instance().delay(20);
+    assert(ErrorType::NotAvailable == shaper.tryAcquire(100, Priority::Bulk, retryIn));
+    assert(ErrorType::NotAvailable == shaper.tryAcquire(100, Priority::Interactive, retryIn));
+    assert(ErrorType::Timeout == shaper.acquire(100, Priority::Bulk, 30));
+    assert(ErrorType::Success == shaper.tryAcquire(100, Priority::Control, retryIn));
+    shaper.endWaiting(Priority::Control);
+
+    assert(ErrorType::Success == shaper.tryAcquire(100, Priority::Bulk, retryIn));
+
+    //An upload on another thread steps aside for control traffic that shows up part way through.
+    settings.rate = 20000;
+    TrafficShaper link(settings);
+    std::atomic<bool> uploadDone(false);
+    std::chrono::steady_clock::time_point uploadFinished;
+    std::thread upload([&link, &uploadDone, &uploadFinished]() {
+        for (int i = 0; i < 10; i++) {
+            assert(ErrorType::Success == link.acquire(1000, Priority::Bulk, 1000));
+        }
+        uploadFinished = std::chrono::steady_clock::now();
+        uploadDone = true;
+    });
+
+    OperatingSystem::Instance().delay(100);
+    assert(!uploadDone);
+    assert(ErrorType::Success == link.acquire(1000, Priority::Control, 1000));
+    const std::chrono::steady_clock::time_point controlSent = std::chrono::steady_clock::now();
+    upload.join();
+
+    if (!(controlSent < uploadFinished)) {
+        CBT_LOGE(TAG, "Control traffic waited for the upload to finish");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static int budgetTest() {
+    TrafficShaperSettings::Settings settings;
+    settings.budget = 1000;
+    TrafficShaper shaper(settings);
+    Milliseconds retryIn;
+
+    assert(ErrorType::Success == shaper.acquire(600, Priority::Bulk, 0));
+    assert(ErrorType::Success == shaper.recordReceived(300));
+    assert(ErrorType::LimitReached == shaper.acquire(200, Priority::Bulk, 1000));
+    assert(ErrorType::LimitReached == shaper.tryAcquire(200, Priority::Interactive, retryIn));
+    //Control can still say that the budget is spent.
+    assert(ErrorType::Success == shaper.acquire(200, Priority::Control, 0));
+
+    TrafficShaperSettings::Usage usage;
+    assert(ErrorType::Success == shaper.usage(usage));
+    assert(600 == usage.bytesSent[static_cast<size_t>(Priority::Bulk)]);
+    assert(200 == usage.bytesSent[static_cast<size_t>(Priority::Control)]);
+    assert(300 == usage.bytesReceived);
+    assert(1100 == usage.total());
+
+    //Picking up where a previous boot left off.
+    assert(ErrorType::Success == shaper.resetUsage(100));
+    assert(ErrorType::Success == shaper.usage(usage));
+    assert(100 == usage.total());
+    assert(ErrorType::Success == shaper.acquire(900, Priority::Bulk, 0));
+    assert(ErrorType::LimitReached == shaper.acquire(1, Priority::Bulk, 0));
+
+    return EXIT_SUCCESS;
+}
+
+static int intervalTest() {
+    TrafficShaperSettings::Settings settings;
+    settings.budget = 100;
+    settings.accountingInterval = 1;
+    TrafficShaper shaper(settings);
+    TrafficShaperSettings::Usage usage;
+
+    assert(ErrorType::Success == shaper.acquire(100, Priority::Bulk, 0));
+    assert(ErrorType::LimitReached == shaper.acquire(1, Priority::Bulk, 0));
+    assert(ErrorType::Success == shaper.usage(usage));
+    assert(0 == usage.intervalElapsed);
+
+    OperatingSystem::Instance().delay(1100);
+
+    assert(ErrorType::Success == shaper.acquire(1, Priority::Bulk, 0));
+    assert(ErrorType::Success == shaper.usage(usage));
+    assert(1 == usage.total());
+    assert(0 == usage.intervalElapsed);
+
+    return EXIT_SUCCESS;
+}
+
+static int shapedClientTest() {
+    TrafficShaperSettings::Settings settings;
+    settings.rate = 1000000;
+    settings.burst = 1000;
+    settings.budget = 10000;
+    TrafficShaper shaper(settings);
+    FakeClient fake;
+    ShapedIpClient client(fake, shaper, Priority::Interactive);
+    Wifi network;
+    Socket sock = -1;
+
+    client.setNetwork(network);
+    assert(ErrorType::Success == client.connectTo("localhost", 1234, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::IPv4, sock, 100));
+    assert(client.statusConst().connected);
+    assert(1234 == client.portConst());
+    assert(sock == client.sockConst());
+
+    //Streams go out a burst at a time.
+    assert(ErrorType::Success == client.sendBlocking(std::string(3500, 'a'), 1000));
+    const std::vector<Bytes> expected = {1000, 1000, 1000, 500};
+    if (expected != fake.pieces) {
+        CBT_LOGE(TAG, "Stream was sent in %u pieces instead of %u", fake.pieces.size(), expected.size());
+        return EXIT_FAILURE;
+    }
+
+    std::string buffer(500, 0);
+    assert(ErrorType::Success == client.receiveBlocking(buffer, 100));
+
+    //Non blocking sends wait for tokens on the network's queue.
+    std::atomic<bool> sent(false);
+    ErrorType sendError = ErrorType::Failure;
+    auto callback = [&sent, &sendError](const ErrorType error, const Bytes bytesWritten) {
+        sendError = error;
+        sent = true;
+    };
+
+    fake.pieces.clear();
+    assert(ErrorType::Success == client.sendNonBlocking(std::make_shared<std::string>(800, 'b'), 1000, callback));
+    for (int i = 0; i < 1000 && !sent; i++) {
+        client.mainLoop();
+        network.runNextEvent();
+        OperatingSystem::Instance().delay(1);
+    }
+    assert(sent && ErrorType::Success == sendError);
+    assert(1 == fake.pieces.size() && 800 == fake.pieces[0]);
+
+    auto received = std::make_shared<std::string>(1000, 0);
+    std::atomic<bool> receiveDone(false);
+    assert(ErrorType::Success == client.receiveNonBlocking(received, 100, [&receiveDone](const ErrorType error, std::shared_ptr<std::string> buffer) { receiveDone = true; }));
+    assert(receiveDone);
+
+    TrafficShaperSettings::Usage usage;
+    assert(ErrorType::Success == shaper.usage(usage));
+    assert(4300 == usage.bytesSent[static_cast<size_t>(Priority::Interactive)]);
+    assert(1500 == usage.bytesReceived);
+
+    //Over the budget.
+    sent = false;
+    assert(ErrorType::Success == client.sendNonBlocking(std::make_shared<std::string>(5000, 'c'), 1000, callback));
+    for (int i = 0; i < 1000 && !sent; i++) {
+        client.mainLoop();
+        network.runNextEvent();
+    }
+    assert(sent && ErrorType::LimitReached == sendError);
+    assert(ErrorType::LimitReached == client.sendBlocking(std::string(5000, 'c'), 1000));
+
+    return EXIT_SUCCESS;
+}
+
+static int deferredSendTest() {
+    TrafficShaperSettings::Settings settings;
+    settings.rate = 1000;
+    settings.burst = 100;
+    TrafficShaper shaper(settings);
+    FakeClient fake;
+    ShapedIpClient client(fake, shaper, Priority::Bulk);
+    Wifi network;
+    Socket sock = -1;
+
+    client.setNetwork(network);
+    assert(ErrorType::Success == client.connectTo("localhost", 1234, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::IPv4, sock, 100));
+    assert(ErrorType::Success == shaper.acquire(100, Priority::Bulk, 0));
+
+    std::atomic<bool> sent(false);
+    ErrorType sendError = ErrorType::Failure;
+    auto callback = [&sent, &sendError](const ErrorType error, const Bytes bytesWritten) {
+        sendError = error;
+        sent = true;
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    assert(ErrorType::Success == client.sendNonBlocking(std::make_shared<std::string>(100, 'a'), 1000, callback));
+    assert(ErrorType::Success == network.runNextEvent());
+    assert(!sent);
+
+    //Waiting for tokens leaves the network's queue idle instead of running the send over and over.
+    assert(ErrorType::NoData == network.runNextEvent());
+    assert(ErrorType::NoData == client.mainLoop());
+
+    int eventsRun = 0;
+    while (!sent && secondsSince(start) < 1) {
+        client.mainLoop();
+        if (ErrorType::NoData != network.runNextEvent()) {
+            eventsRun++;
+        }
+        OperatingSystem::Instance().delay(1);
+    }
+
+    assert(sent && ErrorType::Success == sendError);
+    assert(1 == fake.pieces.size() && 100 == fake.pieces[0]);
+
+    const double elapsed = secondsSince(start);
+    if (elapsed < 0.05 || eventsRun > 5) {
+        CBT_LOGE(TAG, "Deferred send went out after %f seconds and %d events", elapsed, eventsRun);
+        return EXIT_FAILURE;
+    }
+
+    //A send that can't get tokens before its deadline times out.
+    sent = false;
+    assert(ErrorType::Success == client.sendNonBlocking(std::make_shared<std::string>(100, 'b'), 10, callback));
+    while (!sent && secondsSince(start) < 2) {
+        client.mainLoop();
+        network.runNextEvent();
+        OperatingSystem::Instance().delay(1);
+    }
+    assert(sent && ErrorType::Timeout == sendError);
+
+    return EXIT_SUCCESS;
+}
+
+static int destroyedClientTest() {
+    TrafficShaperSettings::Settings settings;
+    settings.rate = 1000;
+    settings.burst = 100;
+    TrafficShaper shaper(settings);
+    FakeClient fake;
+    Wifi network;
+    Socket sock = -1;
+    Milliseconds retryIn;
+
+    std::atomic<int> sent(0);
+    ErrorType sendError = ErrorType::Success;
+    auto callback = [&sent, &sendError](const ErrorType error, const Bytes bytesWritten) {
+        sendError = error;
+        sent++;
+    };
+
+    {
+        ShapedIpClient client(fake, shaper, Priority::Control);
+        client.setNetwork(network);
+        assert(ErrorType::Success == client.connectTo("localhost", 1234, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::IPv4, sock, 100));
+        assert(ErrorType::Success == shaper.acquire(100, Priority::Control, 0));
+
+        //One send waiting for its retry time and one still on the network's queue.
+        assert(ErrorType::Success == client.sendNonBlocking(std::make_shared<std::string>(100, 'a'), 1000, callback));
+        assert(ErrorType::Success == network.runNextEvent());
+        assert(ErrorType::Success == client.sendNonBlocking(std::make_shared<std::string>(100, 'b'), 1000, callback));
+        assert(0 == sent);
+    }
+
+    assert(2 == sent && ErrorType::Failure == sendError);
+    assert(fake.pieces.empty());
+
+    //The event left on the queue has nothing to do now that the client is gone.
+    network.runNextEvent();
+    assert(2 == sent && fake.pieces.empty());
+
+    //Lower priorities aren't held off by sends that will never happen.
+    OperatingSystem::Instance().delay(150);
+    assert(ErrorType::Success == shaper.tryAcquire(100, Priority::Bulk, retryIn));
+
+    return EXIT_SUCCESS;
+}
+
+static int runAllTests() {
+    std::vector<std::function<int(void)>> tests = {
+        rateTest,
+        oversizedTest,
+        priorityTest,
+        budgetTest,
+        intervalTest,
+        shapedClientTest,
+        deferredSendTest,
+        destroyedClientTest
+    };
+
+    for (auto test : tests) {
+        if (EXIT_SUCCESS != test()) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int main() {
+    OperatingSystem::Init();
+    Logger::Init();
+
+    return runAllTests();
+}
@@ -0,0 +1,474 @@
+//Modules
+#include "OperatingSystemModule.hpp"
+#include "UartModule.hpp"
+//Applications
+#include "Log.hpp"
+#include "WriteCoalescer.hpp"
+//Posix
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+//C++
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+static const char TAG[] = "UartTest";
+
+/// @brief The controlling side of a pseudo-terminal. The UART is opened on the other side as if it were a serial device.
+class PseudoTerminal {
+    public:
+    PseudoTerminal() {
+        _fd = posix_openpt(O_RDWR | O_NOCTTY);
+        assert(-1 != _fd);
+        assert(0 == grantpt(_fd));
+        assert(0 == unlockpt(_fd));
+        _device = ptsname(_fd);
+
+        //Nothing the UART sends is echoed or translated on its way back.
+        struct termios settings;
+        assert(0 == tcgetattr(_fd, &settings));
+        cfmakeraw(&settings);
+        assert(0 == tcsetattr(_fd, TCSANOW, &settings));
+    }
+    ~PseudoTerminal() { hangUp(); }
+
+    /// @brief Close the controlling side, like unplugging the serial device.
+    void hangUp() {
+        if (-1 != _fd) {
+            close(_fd);
+            _fd = -1;
+        }
+    }
+
+    const std::string &device() const { return _device; }
+
+    void write(const std::string &data) {
+        Bytes written = 0;
+        while (written < data.size()) {
+            const ssize_t result = ::write(_fd, data.data() + written, data.size() - written);
+            assert(result > 0);
+            written += result;
+        }
+    }
+
+    std::string read(const Bytes size, const Milliseconds timeout) {
+        std::string data;
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+
+        while (data.size() < size && std::chrono::steady_clock::now() < deadline) {
+            struct pollfd descriptor = {_fd, POLLIN, 0};
+            if (poll(&descriptor, 1, 10) <= 0) {
+                continue;
+            }
+
+            char bytes[4096];
+            const ssize_t result = ::read(_fd, bytes, std::min<size_t>(sizeof(bytes), size - data.size()));
+            if (result > 0) {
+                data.append(bytes, result);
+            }
+        }
+
+        return data;
+    }
+
+    private:
+    int _fd = -1;
+    std::string _device;
+};
+
+static void open(Uart &uart, PseudoTerminal &terminal, const int8_t terminatingByte = -1) {
+    uart.device() = terminal.device();
+    assert(ErrorType::Success == uart.setDriverConfig(115200, 8, 'N', 1, UartConfig::FlowControl::Disable));
+    assert(ErrorType::Success == uart.setFirmwareConfig(4096, 4096, terminatingByte));
+    assert(ErrorType::Success == uart.init());
+}
+
+static int roundTripTest() {
+    PseudoTerminal terminal;
+    Uart uart;
+    open(uart, terminal);
+
+    terminal.write("hello");
+    std::string buffer(64, '\0');
+    assert(ErrorType::Success == uart.rxBlocking(buffer, 1000));
+    if ("hello" != buffer) {
+        CBT_LOGE(TAG, "Received %s instead of hello", buffer.c_str());
+        return EXIT_FAILURE;
+    }
+
+    //The rest stays in the ring buffer for the next receive when the buffer is too small.
+    terminal.write("0123456789");
+    buffer.resize(4);
+    assert(ErrorType::Success == uart.rxBlocking(buffer, 1000) && "0123" == buffer);
+    buffer.resize(64);
+    assert(ErrorType::Success == uart.rxBlocking(buffer, 1000) && "456789" == buffer);
+
+    //Straight into memory that the caller owns. What was read ahead goes first.
+    std::array<char, 64> memory;
+    Bytes received = 0;
+    terminal.write("0123456789");
+    buffer.resize(4);
+    assert(ErrorType::Success == uart.rxBlocking(buffer, 1000) && "0123" == buffer);
+    assert(ErrorType::Success == uart.rxBlockingInto(memory, received, 1000) && "456789" == std::string_view(memory.data(), received));
+    terminal.write("direct");
+    assert(ErrorType::Success == uart.rxBlockingInto(memory, received, 1000));
+    if ("direct" != std::string_view(memory.data(), received)) {
+        CBT_LOGE(TAG, "Received %.*s instead of direct", static_cast<int>(received), memory.data());
+        return EXIT_FAILURE;
+    }
+    assert(ErrorType::Timeout == uart.rxBlockingInto(memory, received, 50) && 0 == received);
+
+    assert(ErrorType::Success == uart.txBlocking("world", 1000));
+    if ("world" != terminal.read(5, 1000)) {
+        CBT_LOGE(TAG, "The terminal did not receive what was transmitted");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static int terminatingByteTest() {
+    PseudoTerminal terminal;
+    Uart uart;
+    open(uart, terminal, '\n');
+
+    terminal.write("line one\nline two\npart");
+    std::string buffer(64, '\0');
+    assert(ErrorType::Success == uart.rxBlocking(buffer, 1000) && "line one\n" == buffer);
+    buffer.resize(64);
+    assert(ErrorType::Success == uart.rxBlocking(buffer, 1000) && "line two\n" == buffer);
+
+    //Nothing is lost when the terminating byte doesn't arrive in time.
+    buffer.resize(64);
+    assert(ErrorType::Timeout == uart.rxBlocking(buffer, 50) && buffer.empty());
+    terminal.write("ial\n");
+    buffer.resize(64);
+    assert(ErrorType::Success == uart.rxBlocking(buffer, 1000));
+    if ("partial\n" != buffer) {
+        CBT_LOGE(TAG, "Received %s instead of partial", buffer.c_str());
+        return EXIT_FAILURE;
+    }
+
+    terminal.write("too long\n");
+    buffer.resize(3);
+    assert(ErrorType::LimitReached == uart.rxBlocking(buffer, 1000) && "too" == buffer);
+    buffer.resize(64);
+    assert(ErrorType::Success == uart.rxBlocking(buffer, 1000) && " long\n" == buffer);
+
+    return EXIT_SUCCESS;
+}
+
+static int timeoutAndFlushTest() {
+    PseudoTerminal terminal;
+    Uart uart;
+    open(uart, terminal);
+
+    std::string buffer(64, '\0');
+    const auto start = std::chrono::steady_clock::now();
+    assert(ErrorType::Timeout == uart.rxBlocking(buffer, 100));
+    const auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    if (waited < 90 || waited > 500) {
+        CBT_LOGE(TAG, "Waited %lld ms for a 100 ms timeout", static_cast<long long>(waited));
+        return EXIT_FAILURE;
+    }
+
+    terminal.write("stale");
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    assert(ErrorType::Success == uart.flushRxBuffer());
+    buffer.resize(64);
+    assert(ErrorType::Timeout == uart.rxBlocking(buffer, 50));
+
+    return EXIT_SUCCESS;
+}
+
+static int hangUpTest() {
+    PseudoTerminal terminal;
+    Uart uart;
+    open(uart, terminal);
+
+    terminal.write("last");
+    std::string buffer(64, '\0');
+    assert(ErrorType::Success == uart.rxBlocking(buffer, 1000) && "last" == buffer);
+
+    //A hang up is reported as soon as it happens instead of looking like there is nothing to receive until the timeout.
+    terminal.hangUp();
+    const auto start = std::chrono::steady_clock::now();
+    buffer.resize(64);
+    const ErrorType error = uart.rxBlocking(buffer, 1000);
+    std::array<char, 64> memory;
+    Bytes received = 0;
+    const ErrorType intoError = uart.rxBlockingInto(memory, received, 1000);
+    const auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+    if (ErrorType::EndOfFile != error || !buffer.empty() || ErrorType::EndOfFile != intoError || 0 != received || waited > 500) {
+        CBT_LOGE(TAG, "The hang up was not reported. Waited %lld ms", static_cast<long long>(waited));
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static int configTest() {
+    PseudoTerminal terminal;
+    Uart uart;
+
+    assert(ErrorType::InvalidParameter == uart.setDriverConfig(12345, 8, 'N', 1, UartConfig::FlowControl::Disable));
+    assert(ErrorType::InvalidParameter == uart.setDriverConfig(115200, 9, 'N', 1, UartConfig::FlowControl::Disable));
+    assert(ErrorType::InvalidParameter == uart.setDriverConfig(115200, 8, 'M', 1, UartConfig::FlowControl::Disable));
+    assert(ErrorType::InvalidParameter == uart.setDriverConfig(115200, 8, 'N', 3, UartConfig::FlowControl::Disable));
+    assert(ErrorType::InvalidParameter == uart.setDriverConfig(115200, 8, 'N', 1, UartConfig::FlowControl::Rts));
+    assert(115200 == uart.baudRate() && 8 == uart.dataBits());
+
+    uart.device() = "/dev/doesNotExist";
+    assert(ErrorType::FileNotFound == uart.init());
+    uart.device() = "/dev/null";
+    assert(ErrorType::InvalidParameter == uart.init());
+
+    open(uart, terminal);
+    assert(ErrorType::PrerequisitesNotMet == uart.init());
+
+    //Applied to the open device straight away.
+    assert(ErrorType::Success == uart.setDriverConfig(9600, 7, 'O', 2, UartConfig::FlowControl::Disable));
+    const int fd = ::open(terminal.device().c_str(), O_RDWR | O_NOCTTY);
+    assert(-1 != fd);
+    struct termios settings;
+    assert(0 == tcgetattr(fd, &settings));
+    close(fd);
+
+    //A pseudo-terminal always reports 8 data bits and no parity since there is no line for them to apply to, so only the rest is checked.
+    const bool applied = B9600 == cfgetospeed(&settings) && 0 != (settings.c_cflag & CSTOPB) && 0 == (settings.c_cflag & CRTSCTS) &&
+                         0 == (settings.c_lflag & (ICANON | ECHO | ISIG));
+    if (!applied) {
+        CBT_LOGE(TAG, "The driver configuration was not applied to the device");
+        return EXIT_FAILURE;
+    }
+
+    assert(ErrorType::Success == uart.deinit());
+    assert(ErrorType::PrerequisitesNotMet == uart.txBlocking("x", 100));
+
+    return EXIT_SUCCESS;
+}
+
+static int nonBlockingTest() {
+    PseudoTerminal terminal;
+    Uart uart;
+    open(uart, terminal);
+
+    ErrorType txError = ErrorType::Failure;
+    Bytes bytesWritten = 0;
+    assert(ErrorType::Success == uart.txNonBlocking(std::make_shared<std::string>("queued"), [&](const ErrorType error, const Bytes written) {
+        txError = error;
+        bytesWritten = written;
+    }));
+
+    ErrorType rxError = ErrorType::Failure;
+    std::shared_ptr<std::string> received;
+    assert(ErrorType::Success == uart.rxNonBlocking(std::make_shared<std::string>(64, '\0'), [&](const ErrorType error, std::shared_ptr<std::string> buffer) {
+        rxError = error;
+        received = buffer;
+    }));
+
+    //Nothing happens until the queue is run.
+    assert(ErrorType::Failure == txError && nullptr == received.get());
+
+    assert(ErrorType::Success == uart.runNextEvent());
+    assert(ErrorType::Success == txError && 6 == bytesWritten);
+    assert("queued" == terminal.read(6, 1000));
+
+    terminal.write("reply");
+    assert(ErrorType::Success == uart.runNextEvent());
+    if (ErrorType::Success != rxError || nullptr == received.get() || "reply" != *received) {
+        CBT_LOGE(TAG, "The non-blocking receive did not complete");
+        return EXIT_FAILURE;
+    }
+
+    assert(ErrorType::NoData == uart.runNextEvent());
+
+    return EXIT_SUCCESS;
+}
+
+static int coalescingTest() {
+    PseudoTerminal terminal;
+    Uart uart;
+    open(uart, terminal);
+
+    std::vector<Bytes> bytesWritten;
+    auto callback = [&](const ErrorType error, const Bytes written) {
+        assert(ErrorType::Success == error);
+        bytesWritten.push_back(written);
+    };
+
+    //Small writes waiting in the queue take up one event between them.
+    const Count eventsAvailable = uart.eventsAvailable();
+    assert(ErrorType::Success == uart.txNonBlocking(std::make_shared<std::string>("AT"), callback));
+    assert(ErrorType::Success == uart.txNonBlocking(std::make_shared<std::string>("+CSQ"), callback));
+    assert(ErrorType::Success == uart.txNonBlocking(std::make_shared<std::string>("\r"), callback));
+    assert(eventsAvailable - 1 == uart.eventsAvailable());
+
+    assert(ErrorType::Success == uart.runNextEvent());
+    if (std::vector<Bytes>({2, 4, 1}) != bytesWritten || "AT+CSQ\r" != terminal.read(7, 1000)) {
+        CBT_LOGE(TAG, "The writes were not coalesced");
+        return EXIT_FAILURE;
+    }
+    assert(ErrorType::NoData == uart.runNextEvent());
+
+    //A receive in between keeps the writes after it from going out before it.
+    bytesWritten.clear();
+    assert(ErrorType::Success == uart.txNonBlocking(std::make_shared<std::string>("first"), callback));
+    assert(ErrorType::Success == uart.rxNonBlocking(std::make_shared<std::string>(64, '\0')));
+    assert(ErrorType::Success == uart.txNonBlocking(std::make_shared<std::string>("second"), callback));
+    assert(eventsAvailable - 3 == uart.eventsAvailable());
+
+    assert(ErrorType::Success == uart.runNextEvent());
+    assert("first" == terminal.read(5, 1000));
+    terminal.write("reply");
+    assert(ErrorType::Success == uart.runNextEvent());
+    assert(ErrorType::Success == uart.runNextEvent());
+    assert("second" == terminal.read(6, 1000));
+    assert(std::vector<Bytes>({5, 6}) == bytesWritten);
+
+    //Writes aren't combined past the transmit buffer size.
+    bytesWritten.clear();
+    assert(ErrorType::Success == uart.txNonBlocking(std::make_shared<std::string>(4000, 'a'), callback));
+    assert(ErrorType::Success == uart.txNonBlocking(std::make_shared<std::string>(200, 'b'), callback));
+    assert(eventsAvailable - 2 == uart.eventsAvailable());
+
+    assert(ErrorType::Success == uart.runNextEvent());
+    assert(std::string(4000, 'a') == terminal.read(4000, 1000));
+    assert(ErrorType::Success == uart.runNextEvent());
+    assert(std::string(200, 'b') == terminal.read(200, 1000));
+    assert(std::vector<Bytes>({4000, 200}) == bytesWritten);
+
+    return EXIT_SUCCESS;
+}
+
+static int unlimitedCoalescingTest() {
+    PseudoTerminal terminal;
+    Uart uart;
+    uart.device() = terminal.device();
+    assert(ErrorType::Success == uart.setDriverConfig(115200, 8, 'N', 1, UartConfig::FlowControl::Disable));
+    //No transmit buffer size, which is what a UART that was never given one has.
+    assert(ErrorType::Success == uart.setFirmwareConfig(4096, 0, -1));
+    assert(ErrorType::Success == uart.init());
+
+    std::vector<Bytes> bytesWritten;
+    auto callback = [&](const ErrorType error, const Bytes written) {
+        assert(ErrorType::Success == error);
+        bytesWritten.push_back(written);
+    };
+
+    //Writes are still combined, however large they are.
+    const Count eventsAvailable = uart.eventsAvailable();
+    assert(ErrorType::Success == uart.txNonBlocking(std::make_shared<std::string>("AT"), callback));
+    assert(ErrorType::Success == uart.txNonBlocking(std::make_shared<std::string>(5000, 'a'), callback));
+    assert(ErrorType::Success == uart.txNonBlocking(std::make_shared<std::string>("\r"), callback));
+    if (eventsAvailable - 1 != uart.eventsAvailable()) {
+        CBT_LOGE(TAG, "The writes were not coalesced without a transmit buffer size");
+        return EXIT_FAILURE;
+    }
+
+    assert(ErrorType::Success == uart.runNextEvent());
+    assert(std::string("AT").append(5000, 'a').append("\r") == terminal.read(5003, 1000));
+    assert(std::vector<Bytes>({2, 5000, 1}) == bytesWritten);
+
+    return EXIT_SUCCESS;
+}
+
+static int destroyedCoalescerTest() {
+    EventQueue queue;
+    Count transfers = 0;
+    std::vector<ErrorType> errors;
+    auto callback = [&errors](const ErrorType error, const Bytes written) {
+        errors.push_back(error);
+    };
+
+    {
+        WriteCoalescer coalescer(queue, [&transfers](const std::string &data) -> ErrorType {
+            transfers++;
+            return ErrorType::Success;
+        });
+
+        assert(ErrorType::Success == coalescer.write(std::make_shared<std::string>("AT"), callback, 0));
+        assert(ErrorType::Success == coalescer.write(std::make_shared<std::string>("\r"), callback, 0));
+    }
+
+    //The transfer outlived the coalescer that queued it so it fails its writes instead of sending them.
+    assert(ErrorType::Success == queue.runNextEvent());
+    if (0 != transfers || std::vector<ErrorType>({ErrorType::Failure, ErrorType::Failure}) != errors) {
+        CBT_LOGE(TAG, "A transfer queued by a destroyed coalescer was sent");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static int throughputTest() {
+    PseudoTerminal terminal;
+    Uart uart;
+    open(uart, terminal);
+
+    constexpr Bytes total = 256*1024;
+    std::string sent(total, '\0');
+    for (Bytes i = 0; i < total; i++) {
+        sent[i] = static_cast<char>(i * 31 + (i >> 8));
+    }
+
+    //More than the pseudo-terminal holds so the writer is pushed back on while the UART drains it.
+    std::thread writer([&terminal, &sent]() { terminal.write(sent); });
+
+    std::string received;
+    std::string buffer;
+    const auto start = std::chrono::steady_clock::now();
+    while (received.size() < total) {
+        buffer.resize(4096);
+        if (ErrorType::Success != uart.rxBlocking(buffer, 1000)) {
+            break;
+        }
+        received.append(buffer);
+    }
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    writer.join();
+
+    if (received != sent) {
+        CBT_LOGE(TAG, "Received %u of %u bytes intact", static_cast<unsigned>(received.size()), static_cast<unsigned>(total));
+        return EXIT_FAILURE;
+    }
+
+    CBT_LOGI(TAG, "Received %u bytes in %lld us", static_cast<unsigned>(total), static_cast<long long>(elapsed));
+    return EXIT_SUCCESS;
+}
+
+static int runAllTests() {
+    std::vector<std::function<int(void)>> tests = {
+        roundTripTest,
+        terminatingByteTest,
+        timeoutAndFlushTest,
+        hangUpTest,
+        configTest,
+        nonBlockingTest,
+        coalescingTest,
+        unlimitedCoalescingTest,
+        destroyedCoalescerTest,
+        throughputTest
+    };
+
+    for (auto test : tests) {
+        if (EXIT_SUCCESS != test()) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int main() {
+    OperatingSystem::Init();
+    Logger::Init();
+
+    return runAllTests();
+}
@@ -47,7 +47,9 @@ namespace IpClientSettings {
     enum class Protocol : uint8_t {
         Unknown = 0, ///< Unknown
         Tcp,         ///< Transmission Control Protocol
-        Udp          ///< User Datagram Protocol
+        Udp,         ///< User Datagram Protocol
+        UnixStream,  ///< Unix domain stream socket for processes on the same host. The hostname is the path of the socket.
+        UnixSeqpacket ///< Unix domain sequenced packet socket. Like UnixStream, but the boundaries between messages are kept.
     };
 }
 
@@ -32,7 +32,8 @@ namespace IpServerSettings {
     enum class Version : uint8_t {
         Unknown = 0, ///< Unknown
         IPv4,        ///< Internet Protocol Version 4
-        IPv6         ///< Internet Protocol Version 6
+        IPv6,        ///< Internet Protocol Version 6
+        DualStack    ///< One IPv6 socket that also accepts IPv4 connections.
     };
 
     /**
@@ -42,7 +43,9 @@ namespace IpServerSettings {
     enum class Protocol : uint8_t {
         Unknown = 0, ///< Unknown
         Tcp,         ///< Transmission Control Protocol
-        Udp          ///< User Datagram Protocol
+        Udp,         ///< User Datagram Protocol
+        UnixStream,  ///< Unix domain stream socket for processes on the same host. The hostname is the path of the socket.
+        UnixSeqpacket ///< Unix domain sequenced packet socket. Like UnixStream, but the boundaries between messages are kept.
     };
 }
 
@@ -9,6 +9,10 @@
 
 //Foundation
 #include "CommunicationProtocol.hpp"
+//C++
+#include <algorithm>
+#include <span>
+#include <string>
 
 namespace IcCommunicationProtocolTypes {
     /**
@@ -56,6 +60,21 @@ class IcCommunicationProtocol : public CommunicationProtocol {
      * @sa Fnd::CommunicationProtocol::receive
     */
     virtual ErrorType rxBlocking(std::string &buffer, const Milliseconds timeout) = 0;
+    /**
+     * @brief receive data into memory that the caller owns, such as the free space of a ring buffer
+     * @details Receives into a temporary buffer and copies it unless overridden by an IC that can receive into the memory directly.
+     * @param[out] buffer Where to put the data. Receives no more than its size.
+     * @param[out] bytesReceived The number of bytes put in the buffer. 0 unless ErrorType::Success is returned.
+     * @sa rxBlocking
+    */
+    virtual ErrorType rxBlockingInto(std::span<char> buffer, Bytes &bytesReceived, const Milliseconds timeout) {
+        std::string received(buffer.size(), 0);
+        const ErrorType error = rxBlocking(received, timeout);
+
+        bytesReceived = ErrorType::Success == error ? std::min<Bytes>(received.size(), buffer.size()) : 0;
+        std::copy_n(received.data(), bytesReceived, buffer.data());
+        return error;
+    }
     /**
      * @brief receive data
      * @sa Fnd::CommunicationProtocol::receiveNonBlocking
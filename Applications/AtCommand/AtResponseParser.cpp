@@ -0,0 +1,296 @@
+//AbstractionLayer
+#include "AtResponseParser.hpp"
+//Applications
+#include "ByteScanner.hpp"
+//C++
+#include <algorithm>
+#include <cassert>
+#include <charconv>
+
+AtResponseParser::AtResponseParser(const Bytes maxLineLength) : _ring(maxLineLength), _maxLineLength(maxLineLength) {}
+
+ErrorType AtResponseParser::addUrcHandler(const std::string &prefix, std::function<void(std::string_view urc)> handler) {
+    if (prefix.empty() || nullptr == handler) {
+        return ErrorType::InvalidParameter;
+    }
+
+    for (const UrcHandler &urcHandler : _urcHandlers) {
+        if (urcHandler.prefix == prefix) {
+            return ErrorType::FileExists;
+        }
+    }
+
+    _urcHandlers.push_back({prefix, handler});
+    return ErrorType::Success;
+}
+
+ErrorType AtResponseParser::removeUrcHandler(const std::string &prefix) {
+    auto urcHandler = std::find_if(_urcHandlers.begin(), _urcHandlers.end(), [&prefix](const UrcHandler &urcHandler) {
+        return urcHandler.prefix == prefix;
+    });
+
+    if (_urcHandlers.end() == urcHandler) {
+        return ErrorType::NoData;
+    }
+
+    _urcHandlers.erase(urcHandler);
+    return ErrorType::Success;
+}
+
+ErrorType AtResponseParser::beginCommand(std::string_view command, const AtResponseSettings::Expectation &expectation) {
+    releasePayload();
+    _pending = true;
+    _expectation = expectation;
+    _response = AtResponseSettings::Response();
+    _responsePrefix.clear();
+
+    //Extended commands answer with lines that start with their name: AT+CREG? is answered with +CREG: <n>,<stat>
+    if (command.size() > 3 && ('A' == command[0] || 'a' == command[0]) && ('T' == command[1] || 't' == command[1]) && '+' == command[2]) {
+        const size_t end = command.find_first_of("=?", 2);
+        _responsePrefix.assign(command.substr(2, std::string_view::npos == end ? std::string_view::npos : end - 2));
+        _responsePrefix.push_back(':');
+    }
+
+    return ErrorType::Success;
+}
+
+void AtResponseParser::endCommand() {
+    releasePayload();
+    _pending = false;
+    _responsePrefix.clear();
+}
+
+ErrorType AtResponseParser::parse(std::string_view data) {
+    const ErrorType error = _ring.write(data);
+    if (ErrorType::Success != error) {
+        return error;
+    }
+
+    return process();
+}
+
+ErrorType AtResponseParser::process() {
+    ErrorType error = ErrorType::Success;
+    //Only valid until the ring buffer is consumed from at the end.
+    const std::string_view data = _ring.contiguous();
+    //Everything before lineStart is finished with. Everything from lineStart to position has been looked at.
+    Bytes lineStart = _held;
+    Bytes position = _held + _scanned;
+
+    //Stop at the end of a response so that whatever follows it is left for the next command.
+    while (position < data.size() && !responseComplete()) {
+        const char byte = data[position];
+
+        switch (_state) {
+            case State::LineStart:
+                if ('\r' == byte || '\n' == byte) {
+                    lineStart = ++position;
+                }
+                else if ('>' == byte && _pending && _expectation.prompt) {
+                    //The prompt has no line ending. The modem is waiting for the data.
+                    _response.result = AtResponseSettings::Result::Prompt;
+                    _response.finalLine.assign(">");
+                    lineStart = ++position;
+                    _state = State::AfterPrompt;
+                }
+                else {
+                    position++;
+                    _state = State::InLine;
+                }
+                break;
+
+            case State::AfterPrompt:
+                if (' ' == byte) {
+                    lineStart = ++position;
+                }
+                _state = State::LineStart;
+                break;
+
+            case State::InLine: {
+                //Jump straight to the line ending instead of looking at the line a byte at a time.
+                const Bytes limit = std::min<Bytes>(data.size(), lineStart + _maxLineLength + 1);
+                const size_t found = ByteScanner::findEither(data.substr(position, limit - position), '\r', '\n');
+
+                if (std::string_view::npos != found) {
+                    position += found;
+                    const char ending = data[position];
+                    const ErrorType dispatchError = dispatch(data.substr(lineStart, position - lineStart));
+                    if (ErrorType::Success != dispatchError) {
+                        error = dispatchError;
+                    }
+
+                    lineStart = ++position;
+
+                    if (0 == _payloadRemaining) {
+                        _state = State::LineStart;
+                    }
+                    else {
+                        //The payload starts after the whole line ending.
+                        _state = '\r' == ending ? State::PayloadStart : State::Payload;
+                    }
+                }
+                else if (limit - lineStart > _maxLineLength) {
+                    lineStart = position = limit;
+                    _state = State::Discard;
+                    error = ErrorType::LimitReached;
+                }
+                else {
+                    position = limit;
+                }
+                break;
+            }
+
+            case State::Discard: {
+                const size_t found = ByteScanner::findEither(data.substr(position), '\r', '\n');
+                if (std::string_view::npos != found) {
+                    position += found + 1;
+                    _state = State::LineStart;
+                }
+                else {
+                    position = data.size();
+                }
+                lineStart = position;
+                break;
+            }
+
+            case State::PayloadStart:
+                if ('\n' == byte) {
+                    lineStart = ++position;
+                }
+                _state = State::Payload;
+                break;
+
+            case State::Payload: {
+                const Bytes bytes = std::min<Bytes>(_payloadRemaining, data.size() - position);
+                //Left where it is in the ring buffer.
+                if (0 == _payloadLength) {
+                    _payloadOffset = position;
+                }
+                _payloadLength += bytes;
+                _payloadRemaining -= bytes;
+                position += bytes;
+                lineStart = position;
+
+                if (0 == _payloadRemaining) {
+                    _state = State::LineStart;
+                }
+                break;
+            }
+        }
+    }
+
+    //Nothing from the start of the payload on is removed until the command has ended.
+    const Bytes finished = 0 == _payloadLength ? lineStart : std::min(lineStart, _payloadOffset);
+    _ring.consume(finished);
+    _payloadOffset -= 0 == _payloadLength ? 0 : finished;
+    _held = lineStart - finished;
+    _scanned = position - lineStart;
+
+    return error;
+}
+
+std::string_view AtResponseParser::payload() {
+    if (0 == _payloadLength) {
+        return std::string_view();
+    }
+
+    return _ring.contiguous().substr(_payloadOffset, _payloadLength);
+}
+
+void AtResponseParser::releasePayload() {
+    _ring.consume(_held);
+    _held = 0;
+    _payloadOffset = 0;
+    _payloadLength = 0;
+}
+
+void AtResponseParser::reset() {
+    _ring.clear();
+    _scanned = 0;
+    _state = State::LineStart;
+    _payloadRemaining = 0;
+    _payloadOffset = 0;
+    _payloadLength = 0;
+    _held = 0;
+    _response = AtResponseSettings::Response();
+    endCommand();
+}
+
+ErrorType AtResponseParser::dispatch(std::string_view line) {
+    if (line.empty()) {
+        return ErrorType::Success;
+    }
+
+    if (_pending && AtResponseSettings::Result::Pending == _response.result) {
+        const AtResponseSettings::Result result = toResult(line);
+        if (AtResponseSettings::Result::Pending != result) {
+            _response.result = result;
+            _response.finalLine.assign(line);
+            return ErrorType::Success;
+        }
+
+        const bool ownLine = !_responsePrefix.empty() && line.starts_with(_responsePrefix);
+        const bool urc = std::any_of(_urcHandlers.begin(), _urcHandlers.end(), [&line](const UrcHandler &urcHandler) {
+            return line.starts_with(urcHandler.prefix);
+        });
+
+        if (ownLine || !urc) {
+            _response.lines.emplace_back(line);
+
+            if (ownLine && _expectation.payload) {
+                //+QIRD: <read_actual_length>[,...]
+                std::string_view length = line.substr(_responsePrefix.size());
+                length.remove_prefix(std::min(length.find_first_not_of(' '), length.size()));
+
+                Bytes bytes = 0;
+                std::from_chars(length.data(), length.data() + length.size(), bytes);
+                if (bytes > MaxPayloadLength) {
+                    return ErrorType::LimitReached;
+                }
+
+                _payloadRemaining = bytes;
+            }
+
+            return ErrorType::Success;
+        }
+    }
+
+    for (const UrcHandler &urcHandler : _urcHandlers) {
+        if (line.starts_with(urcHandler.prefix)) {
+            urcHandler.handler(line);
+            return ErrorType::Success;
+        }
+    }
+
+    _unhandledLines++;
+    return ErrorType::Success;
+}
+
+AtResponseSettings::Result AtResponseParser::toResult(std::string_view line) {
+    if ("OK" == line) {
+        return AtResponseSettings::Result::Ok;
+    }
+    else if ("ERROR" == line) {
+        return AtResponseSettings::Result::Error;
+    }
+    else if (line.starts_with("+CME ERROR:")) {
+        return AtResponseSettings::Result::CmeError;
+    }
+    else if (line.starts_with("+CMS ERROR:")) {
+        return AtResponseSettings::Result::CmsError;
+    }
+    else if ("SEND OK" == line) {
+        return AtResponseSettings::Result::SendOk;
+    }
+    else if ("SEND FAIL" == line) {
+        return AtResponseSettings::Result::SendFail;
+    }
+    else if ("NO CARRIER" == line) {
+        return AtResponseSettings::Result::NoCarrier;
+    }
+    else if ("CONNECT" == line || line.starts_with("CONNECT ")) {
+        return AtResponseSettings::Result::Connect;
+    }
+
+    return AtResponseSettings::Result::Pending;
+}
@@ -0,0 +1,241 @@
+/**************************************************************************//**
+* @author Ben Haubrich
+* @file   AtResponseParser.hpp
+* @details \b Synopsis: \n Splits the bytes received from a modem into AT command
+*          responses and unsolicited result codes.
+* @ingroup Applications
+*******************************************************************************/
+#ifndef __AT_RESPONSE_PARSER_HPP__
+#define __AT_RESPONSE_PARSER_HPP__
+
+//AbstractionLayer
+#include "Error.hpp"
+#include "Types.hpp"
+//Applications
+#include "RingBuffer.hpp"
+//C++
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @namespace AtResponseSettings
+ * @brief Settings and results for parsing AT command responses.
+*/
+namespace AtResponseSettings {
+
+    /**
+     * @enum Result
+     * @brief The final result code that ends a response.
+    */
+    enum class Result : uint8_t {
+        Pending = 0, ///< The response has not ended yet.
+        Ok,          ///< OK
+        Error,       ///< ERROR
+        CmeError,    ///< +CME ERROR: <err>
+        CmsError,    ///< +CMS ERROR: <err>
+        SendOk,      ///< SEND OK
+        SendFail,    ///< SEND FAIL
+        NoCarrier,   ///< NO CARRIER
+        Connect,     ///< CONNECT. The modem has switched to data mode.
+        Prompt       ///< The "> " prompt asking for the data of a send command.
+    };
+
+    /**
+     * @struct Expectation
+     * @brief What a command is answered with, other than information lines and a final result code.
+    */
+    struct Expectation {
+        bool prompt = false;  ///< The command is answered with a "> " prompt (e.g. AT+QISEND) which ends the response.
+        bool payload = false; ///< The information line is followed by as many raw bytes as the first number on the line (e.g. AT+QIRD). @sa AtResponseParser::payload
+    };
+
+    /**
+     * @struct Response
+     * @brief The response to a command.
+    */
+    struct Response {
+        std::vector<std::string> lines; ///< The information lines without their line endings.
+        std::string finalLine;          ///< The line holding the final result code, including any error code.
+        Result result = Result::Pending; ///< The final result code.
+
+        /// @brief True if the response ended successfully.
+        bool succeeded() const { return Result::Ok == result || Result::SendOk == result || Result::Prompt == result || Result::Connect == result; }
+    };
+}
+
+/**
+ * @class AtResponseParser
+ * @brief An incremental parser for the lines that a modem sends back.
+ * @details Bytes are added to a ring buffer as they are received and each byte is looked at once, with line endings found by the
+ *          ByteScanner. Complete lines are either information lines or the final result code of the pending command, or unsolicited
+ *          result codes (URCs) which are passed to the handler registered for their prefix. A URC can arrive in the middle of a
+ *          response without being mistaken for part of it.
+ *
+ *          Lines that begin with the command's own prefix (e.g. +CREG: for AT+CREG?) always belong to the response, even if a handler
+ *          is registered for the same prefix to receive it when it's unsolicited.
+ *
+ *          Not thread safe. Bytes should be parsed by whoever is reading the modem.
+ * @code
+ * parser.addUrcHandler("+QIURC:", [](std::string_view urc) { ... });
+ * parser.beginCommand("AT+CSQ");
+ * uart.txBlocking("AT+CSQ\r", timeout);
+ * while (!parser.responseComplete()) {
+ *     uart.rxBlocking(bytes, timeout);
+ *     parser.parse(bytes);
+ * }
+ * //parser.responseConst().lines[0] is "+CSQ: 20,99"
+ * parser.endCommand();
+ * @endcode
+*/
+class AtResponseParser {
+
+    public:
+    /// @brief The default size of the longest line.
+    static constexpr Bytes DefaultMaxLineLength = 1024;
+    /// @brief The largest payload accepted after an information line. Pg. 20 Quectel LTE TCP/IP Application Note.
+    static constexpr Bytes MaxPayloadLength = 1500;
+
+    /**
+     * @brief Constructor.
+     * @param[in] maxLineLength The longest line allowed. Longer lines are thrown away.
+    */
+    AtResponseParser(const Bytes maxLineLength = DefaultMaxLineLength);
+    ~AtResponseParser() = default;
+
+    /**
+     * @brief Call a handler for each unsolicited result code that begins with the prefix.
+     * @param[in] prefix The start of the line, such as "+QIURC:".
+     * @param[in] handler Called from parse with the whole line. The view is only valid during the call.
+     * @returns ErrorType::Success if the handler was added.
+     * @returns ErrorType::InvalidParameter if the prefix is empty or the handler is nullptr.
+     * @returns ErrorType::FileExists if there is already a handler for the prefix.
+    */
+    ErrorType addUrcHandler(const std::string &prefix, std::function<void(std::string_view urc)> handler);
+    /**
+     * @brief Stop calling the handler for a prefix.
+     * @param[in] prefix The prefix given to addUrcHandler.
+     * @returns ErrorType::Success if the handler was removed.
+     * @returns ErrorType::NoData if there is no handler for the prefix.
+    */
+    ErrorType removeUrcHandler(const std::string &prefix);
+
+    /**
+     * @brief Start collecting the response to a command.
+     * @param[in] command The command that was sent, such as "AT+CREG?". Used to tell its information lines apart from URCs.
+     * @param[in] expectation How the response ends.
+     * @post Any response still being collected is thrown away.
+     * @returns ErrorType::Success
+    */
+    ErrorType beginCommand(std::string_view command, const AtResponseSettings::Expectation &expectation = AtResponseSettings::Expectation());
+    /// @brief Stop collecting the response to the pending command. Lines that arrive for it later are treated as unsolicited.
+    void endCommand();
+    /// @brief True if a response is being collected or has been collected and not ended.
+    bool commandPending() const { return _pending; }
+    /// @brief True once the final result code of the pending command has been received.
+    bool responseComplete() const { return _pending && AtResponseSettings::Result::Pending != _response.result; }
+    /// @brief Get the response to the pending command as a constant reference
+    const AtResponseSettings::Response &responseConst() const { return _response; }
+    /// @brief Get how the pending command's response ends as a constant reference
+    const AtResponseSettings::Expectation &expectationConst() const { return _expectation; }
+    /**
+     * @brief Get the payload of the pending command's response without copying it out of the ring buffer.
+     * @details The payload is held in the ring buffer from when it starts to arrive until endCommand, beginCommand or reset.
+     * @returns The payload received so far. Empty if the command doesn't expect a payload.
+     * @post The view is invalidated by any call that modifies the parser.
+    */
+    std::string_view payload();
+
+    /**
+     * @brief Parse bytes received from the modem.
+     * @details Parsing stops at the end of the pending command's response so that anything received after it is kept for the next
+     *          command. Call process after beginCommand to parse those bytes.
+     * @param[in] data The bytes.
+     * @returns ErrorType::Success if the bytes were parsed.
+     * @returns ErrorType::LimitReached if a line was longer than the maximum. The line is thrown away and parsing continues after it.
+     * @returns ErrorType::NoMemory if there was no room for the bytes.
+    */
+    ErrorType parse(std::string_view data);
+    /**
+     * @brief Parse bytes written straight into the ring buffer.
+     * @returns The same as parse.
+     * @sa ring
+    */
+    ErrorType process();
+    /// @brief Get the ring buffer that holds bytes which are not part of a complete line yet. Commit received bytes to it and call process.
+    RingBuffer &ring() { return _ring; }
+    /// @brief Throw away everything received and any pending command.
+    void reset();
+
+    /// @brief The number of complete lines that were neither part of a response nor handled as a URC.
+    Count unhandledLines() const { return _unhandledLines; }
+
+    private:
+    /**
+     * @enum State
+     * @brief What the next byte is expected to be.
+    */
+    enum class State : uint8_t {
+        LineStart = 0, ///< The first byte of a line, or a line ending left over from the last line.
+        InLine,        ///< The rest of a line.
+        AfterPrompt,   ///< The space after a "> " prompt.
+        Discard,       ///< The rest of a line that was too long.
+        PayloadStart,  ///< The line feed after the carriage return that ended the line before a payload.
+        Payload        ///< Raw bytes that follow an information line.
+    };
+
+    /**
+     * @struct UrcHandler
+     * @brief A handler for the URCs that begin with a prefix.
+    */
+    struct UrcHandler {
+        std::string prefix;                                   ///< The start of the line.
+        std::function<void(std::string_view urc)> handler;    ///< Called with each matching line.
+    };
+
+    /// @brief Bytes received that are not part of a complete line yet.
+    RingBuffer _ring;
+    /// @brief The longest line allowed.
+    Bytes _maxLineLength;
+    /// @brief The number of bytes at the front of the ring buffer that have already been looked at.
+    Bytes _scanned = 0;
+    /// @brief What the next byte is expected to be.
+    State _state = State::LineStart;
+    /// @brief Payload only. The number of payload bytes still to come.
+    Bytes _payloadRemaining = 0;
+    /// @brief Payload only. Where the payload starts in the ring buffer.
+    Bytes _payloadOffset = 0;
+    /// @brief Payload only. The number of payload bytes received so far.
+    Bytes _payloadLength = 0;
+    /// @brief The number of bytes at the front of the ring buffer that have been parsed but are kept because they hold the payload.
+    Bytes _held = 0;
+    /// @brief The registered URC handlers.
+    std::vector<UrcHandler> _urcHandlers;
+    /// @brief True while a command's response is being collected.
+    bool _pending = false;
+    /// @brief The prefix of the pending command's information lines, such as "+CREG:". Empty for basic commands like ATI.
+    std::string _responsePrefix;
+    /// @brief How the pending command's response ends.
+    AtResponseSettings::Expectation _expectation;
+    /// @brief The response to the pending command.
+    AtResponseSettings::Response _response;
+    /// @brief Lines that were neither part of a response nor handled as a URC.
+    Count _unhandledLines = 0;
+
+    /**
+     * @brief Handle a complete line.
+     * @returns ErrorType::Success if the line was handled.
+     * @returns ErrorType::LimitReached if the line announces a payload that is too large. The payload is parsed as lines instead.
+    */
+    ErrorType dispatch(std::string_view line);
+    /**
+     * @brief Get the final result code of a line.
+     * @returns AtResponseSettings::Result::Pending if the line is not a final result code.
+    */
+    static AtResponseSettings::Result toResult(std::string_view line);
+    /// @brief Remove the payload and anything parsed after it from the ring buffer.
+    void releasePayload();
+};
+
+#endif // __AT_RESPONSE_PARSER_HPP__
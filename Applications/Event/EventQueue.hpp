@@ -54,8 +54,9 @@ class EventQueue {
      * @returns ErrorType::Success
      * @returns ErrorType::LimitReached if the maximum number of events has been reached.
      * @returns ErrorType::Timeout if the semaphore could not be obtained in time
+     * @note Virtual so that queues whose thread sleeps while waiting for something else can wake it.
     */
-    ErrorType addEvent(std::unique_ptr<EventAbstraction> &event);
+    virtual ErrorType addEvent(std::unique_ptr<EventAbstraction> &event);
 
     /**
      * @class Event
@@ -0,0 +1,158 @@
+#include "WriteCoalescer.hpp"
+#include "OperatingSystemModule.hpp"
+//C++
+#include <cassert>
+
+std::atomic<int> WriteCoalescer::semaphoreCount(0);
+
+WriteCoalescer::Owner::~Owner() {
+    OperatingSystem::Instance().deleteSemaphore(semaphore);
+}
+
+WriteCoalescer::WriteCoalescer(EventQueue &queue, Transfer transfer) : _queue(queue), _transfer(transfer) {
+    const int instance = ++semaphoreCount;
+    _binarySemaphore = std::string("writeCoalescerBinarySemaphore").append(std::to_string(instance));
+    ErrorType error = OperatingSystem::Instance().createSemaphore(1, 1, _binarySemaphore);
+    assert(ErrorType::Success == error);
+
+    _owner = std::make_shared<Owner>();
+    _owner->coalescer = this;
+    _owner->queued = 0;
+    _owner->semaphore = std::string("writeCoalescerOwnerSemaphore").append(std::to_string(instance));
+    error = OperatingSystem::Instance().createSemaphore(1, 1, _owner->semaphore);
+    assert(ErrorType::Success == error);
+}
+
+WriteCoalescer::~WriteCoalescer() {
+    //Nothing more can be added to the queued transfer once this is gone.
+    if (ErrorType::Success == OperatingSystem::Instance().waitSemaphore(_binarySemaphore, SemaphoreTimeout)) {
+        _open.reset();
+        OperatingSystem::Instance().incrementSemaphore(_binarySemaphore);
+    }
+
+    //Give the queue a chance to send what was written. It might be this thread that runs the queue, so don't wait forever.
+    for (Milliseconds waited = 0; 0 != _owner->queued && waited < DestroyTimeout; waited++) {
+        OperatingSystem::Instance().delay(1);
+    }
+
+    //Wait for a transfer that is being sent and leave the rest nothing to send with.
+    const ErrorType error = OperatingSystem::Instance().waitSemaphore(_owner->semaphore, DestroyTimeout);
+    _owner->coalescer = nullptr;
+    if (ErrorType::Success == error) {
+        OperatingSystem::Instance().incrementSemaphore(_owner->semaphore);
+    }
+
+    OperatingSystem::Instance().deleteSemaphore(_binarySemaphore);
+}
+
+ErrorType WriteCoalescer::write(const std::shared_ptr<std::string> data, Callback callback, const Bytes maxTransferSize) {
+    if (nullptr == data.get()) {
+        return ErrorType::InvalidParameter;
+    }
+
+    ErrorType error = OperatingSystem::Instance().waitSemaphore(_binarySemaphore, SemaphoreTimeout);
+    if (ErrorType::Success != error) {
+        return ErrorType::Timeout;
+    }
+
+    const bool unlimited = 0 == maxTransferSize;
+
+    //The queued transfer hasn't been taken by the event that sends it yet, so anything added now goes out with it.
+    if (nullptr != _open.get() && !_open->taken && (unlimited || _open->data.size() + data->size() <= maxTransferSize)) {
+        _open->data.append(*data);
+        _open->writes.emplace_back(data->size(), callback);
+        _coalesced++;
+    }
+    else {
+        auto batch = std::make_shared<Batch>();
+        batch->data = *data;
+        batch->writes.emplace_back(data->size(), callback);
+
+        //Bind the owner instead of this so that a transfer that runs after this is destroyed doesn't use it.
+        std::unique_ptr<EventAbstraction> event = std::make_unique<EventQueue::Event<WriteCoalescer, std::shared_ptr<Batch>>>(std::bind(&WriteCoalescer::sendIfOwned, _owner, std::placeholders::_1), batch);
+        _owner->queued++;
+        if (ErrorType::Success == (error = _queue.addEvent(event))) {
+            //Too large to add anything to.
+            _open = unlimited || batch->data.size() < maxTransferSize ? batch : nullptr;
+        }
+        else {
+            _owner->queued--;
+        }
+    }
+
+    OperatingSystem::Instance().incrementSemaphore(_binarySemaphore);
+
+    return error;
+}
+
+ErrorType WriteCoalescer::interrupt() {
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(_binarySemaphore, SemaphoreTimeout)) {
+        return ErrorType::Timeout;
+    }
+
+    _open.reset();
+
+    OperatingSystem::Instance().incrementSemaphore(_binarySemaphore);
+
+    return ErrorType::Success;
+}
+
+ErrorType WriteCoalescer::sendIfOwned(std::shared_ptr<Owner> owner, std::shared_ptr<Batch> batch) {
+    ErrorType error = OperatingSystem::Instance().waitSemaphore(owner->semaphore, DestroyTimeout);
+
+    if (ErrorType::Success == error) {
+        if (nullptr != owner->coalescer) {
+            error = owner->coalescer->send(batch);
+        }
+        else {
+            //The coalescer that would send it is gone and so is nearly everything it would have been sent with.
+            error = ErrorType::Failure;
+            finish(*batch, error);
+        }
+
+        OperatingSystem::Instance().incrementSemaphore(owner->semaphore);
+    }
+    else {
+        error = ErrorType::Timeout;
+        batch->taken = true;
+        finish(*batch, error);
+    }
+
+    owner->queued--;
+    return error;
+}
+
+ErrorType WriteCoalescer::send(std::shared_ptr<Batch> batch) {
+    //Writes check this before adding to the transfer, so only a write that was already being added when this was set can still get in.
+    batch->taken = true;
+
+    //Close it off so that the next write starts a new transfer. The writes that were already being added finish before this gets
+    //the semaphore.
+    ErrorType error;
+    Count attempts = 0;
+    while (ErrorType::Success != (error = OperatingSystem::Instance().waitSemaphore(_binarySemaphore, SemaphoreTimeout)) && ++attempts < SendAttempts);
+
+    if (ErrorType::Success != error) {
+        //Nothing has been added since it was taken, since adding a write doesn't hold the semaphore for anywhere near this long.
+        finish(*batch, ErrorType::Timeout);
+        return ErrorType::Timeout;
+    }
+
+    if (_open == batch) {
+        _open.reset();
+    }
+    OperatingSystem::Instance().incrementSemaphore(_binarySemaphore);
+
+    error = _transfer(batch->data);
+    finish(*batch, error);
+
+    return error;
+}
+
+void WriteCoalescer::finish(const Batch &batch, const ErrorType error) {
+    for (const auto &write : batch.writes) {
+        if (nullptr != write.second) {
+            write.second(error, ErrorType::Success == error ? write.first : 0);
+        }
+    }
+}
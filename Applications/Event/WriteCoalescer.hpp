@@ -0,0 +1,145 @@
+/**************************************************************************//**
+* @author Ben Haubrich
+* @file   WriteCoalescer.hpp
+* @details \b Synopsis: \n Queues non-blocking writes on an event queue and
+*          combines consecutive small ones into a single transfer.
+* @ingroup Applications
+*******************************************************************************/
+#ifndef __WRITE_COALESCER_HPP__
+#define __WRITE_COALESCER_HPP__
+
+//AbstractionLayer
+#include "EventQueue.hpp"
+//C++
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @class WriteCoalescer
+ * @brief Combines consecutive writes that are waiting in an event queue so that they go out in one transfer.
+ * @details A write is added to the transfer that was queued by the write before it if that transfer hasn't started yet and there's room
+ *          for it. Otherwise a new transfer is queued. Each write's callback is called once its transfer is done, with the number of its
+ *          own bytes that were written.
+ *
+ *          Writes are never reordered with anything else that is queued. Call interrupt whenever something other than a write is queued
+ *          so that writes made after it aren't added to a transfer that runs before it.
+ * @code
+ * //Three events would have been queued. Only one is.
+ * coalescer.write(std::make_shared<std::string>("AT"), callback, 64);
+ * coalescer.write(std::make_shared<std::string>("+CSQ"), callback, 64);
+ * coalescer.write(std::make_shared<std::string>("\r"), callback, 64);
+ *
+ * //Something other than a write is about to be queued.
+ * if (ErrorType::Success == coalescer.interrupt()) {
+ *     queue.addEvent(event);
+ * }
+ * @endcode
+*/
+class WriteCoalescer {
+
+    public:
+    /**
+     * @brief Sends a transfer.
+     * @param[in] data The bytes of every write in the transfer.
+     * @returns ErrorType::Success if every byte was sent.
+    */
+    using Transfer = std::function<ErrorType(const std::string &data)>;
+    /**
+     * @brief Called when a write's transfer is done.
+     * @param[in] error The error of the transfer.
+     * @param[in] bytesWritten The number of the write's own bytes that were sent. 0 if the transfer failed.
+    */
+    using Callback = std::function<void(const ErrorType error, const Bytes bytesWritten)>;
+
+    /**
+     * @brief Constructor.
+     * @param[in] queue The queue that the transfers are run by.
+     * @param[in] transfer Sends a transfer when it is run.
+    */
+    WriteCoalescer(EventQueue &queue, Transfer transfer);
+    /**
+     * @brief Destructor.
+     * @details Waits up to DestroyTimeout for the transfers that are queued to be run. Transfers that are still queued after that fail
+     *          their writes with ErrorType::Failure when the queue gets to them instead of being sent.
+    */
+    ~WriteCoalescer();
+
+    /**
+     * @brief Queue a write.
+     * @param[in] data The bytes to write.
+     * @param[in] callback Called when the write is done. May be nullptr.
+     * @param[in] maxTransferSize The most bytes that writes are combined into. Writes larger than this are sent in a transfer of their own.
+     *                            0 is no limit, like a transmit buffer size that was never configured.
+     * @returns ErrorType::Success if the write was queued.
+     * @returns ErrorType::InvalidParameter if data is nullptr.
+     * @returns ErrorType::Timeout if the write couldn't be queued in time.
+     * @returns The error of EventQueue::addEvent if a transfer couldn't be queued.
+    */
+    ErrorType write(const std::shared_ptr<std::string> data, Callback callback, const Bytes maxTransferSize);
+    /**
+     * @brief Stop adding writes to the transfer that is queued because something else has been queued after it.
+     * @returns ErrorType::Success if writes made from now on go in a new transfer.
+     * @returns ErrorType::Timeout if the queued transfer couldn't be closed off in time. Whatever was going to be queued after it shouldn't be.
+    */
+    ErrorType interrupt();
+
+    /// @brief The number of writes that were added to a transfer that was already queued.
+    Count coalesced() const { return _coalesced; }
+
+    private:
+    /**
+     * @struct Batch
+     * @brief The writes in one transfer.
+    */
+    struct Batch {
+        std::string data;                                 ///< The bytes of every write.
+        std::vector<std::pair<Bytes, Callback>> writes;   ///< The size and callback of each write.
+        std::atomic<bool> taken = false;                  ///< Set once the transfer has started so that nothing more is added to it.
+    };
+
+    /**
+     * @struct Owner
+     * @brief Lets the transfers on the queue find out whether the coalescer that queued them still exists.
+    */
+    struct Owner {
+        WriteCoalescer *coalescer;   ///< nullptr once the coalescer has been destroyed.
+        std::string semaphore;       ///< Held while a transfer uses the coalescer so that it isn't destroyed in the meantime.
+        std::atomic<Count> queued;   ///< The number of transfers on the queue.
+
+        ~Owner();
+    };
+
+    /// @brief The timeout for semaphore operations.
+    static constexpr Milliseconds SemaphoreTimeout = 100;
+    /// @brief The number of times a transfer tries to close itself off before it gives up and fails its writes.
+    static constexpr Count SendAttempts = 10;
+    /// @brief The longest the destructor waits for the transfers that are queued.
+    static constexpr Milliseconds DestroyTimeout = 100;
+    /// @brief The number of semaphores that have been created.
+    static std::atomic<int> semaphoreCount;
+
+    /// @brief The queue that the transfers are run by.
+    EventQueue &_queue;
+    /// @brief Sends a transfer.
+    Transfer _transfer;
+    /// @brief The transfer that has been queued and can still be added to. nullptr if there isn't one.
+    std::shared_ptr<Batch> _open;
+    /// @brief The number of writes that were added to a transfer that was already queued.
+    Count _coalesced = 0;
+    /// @brief The binary semaphore that protects _open.
+    std::string _binarySemaphore;
+    /// @brief Shared with the transfers on the queue, which can outlive this.
+    std::shared_ptr<Owner> _owner;
+
+    /// @brief Run by the queue. Sends the transfer if the coalescer that queued it still exists and fails its writes otherwise.
+    static ErrorType sendIfOwned(std::shared_ptr<Owner> owner, std::shared_ptr<Batch> batch);
+    /// @brief Send a transfer and tell each of its writes how it went.
+    ErrorType send(std::shared_ptr<Batch> batch);
+    /// @brief Tell each of the writes in a transfer how it went.
+    static void finish(const Batch &batch, const ErrorType error);
+};
+
+#endif //__WRITE_COALESCER_HPP__
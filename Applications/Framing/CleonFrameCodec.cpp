@@ -0,0 +1,145 @@
+#include "CleonFrameCodec.hpp"
+//C++
+#include <algorithm>
+#include <array>
+#include <cassert>
+
+namespace {
+
+    /// @brief The CRC32 of every byte value, so that the CRC is updated a byte at a time instead of a bit at a time.
+    constexpr std::array<uint32_t, 256> CrcTable = []() {
+        std::array<uint32_t, 256> table = {};
+
+        for (uint32_t i = 0; i < table.size(); i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc >> 1) ^ (0 != (crc & 1) ? 0xEDB88320 : 0);
+            }
+            table[i] = crc;
+        }
+
+        return table;
+    }();
+
+    /// @brief Read the 16 bit little endian length from a header.
+    inline Bytes payloadLength(const RingBuffer &ring) {
+        return static_cast<uint8_t>(ring.at(2)) | (static_cast<uint8_t>(ring.at(3)) << 8);
+    }
+}
+
+CleonFrameCodec::CleonFrameCodec(std::function<void(const CleonFrameSettings::Frame &frame)> handler, const Bytes maxPayloadSize) :
+    _handler(handler),
+    _maxPayloadSize(std::min(maxPayloadSize, CleonFrameSettings::MaxPayloadSize)),
+    //Allocated once. The ring buffer never holds more than one frame that is incomplete.
+    _ring(CleonFrameSettings::HeaderSize + _maxPayloadSize + CleonFrameSettings::TrailerSize,
+          CleonFrameSettings::HeaderSize + _maxPayloadSize + CleonFrameSettings::TrailerSize) {}
+
+ErrorType CleonFrameCodec::decode(std::string_view data) {
+    //Whatever is left after processing is less than one frame, so there is always room for more.
+    while (!data.empty()) {
+        const Bytes chunk = std::min<Bytes>(data.size(), _ring.available());
+        assert(chunk > 0);
+
+        _ring.write(data.substr(0, chunk));
+        data.remove_prefix(chunk);
+        process();
+    }
+
+    return ErrorType::Success;
+}
+
+ErrorType CleonFrameCodec::process() {
+    using namespace CleonFrameSettings;
+
+    while (!_ring.empty()) {
+        if (StartOfFrame != static_cast<uint8_t>(_ring.at(0))) {
+            const size_t start = _ring.find(static_cast<char>(StartOfFrame), 1);
+            discard(std::string_view::npos == start ? _ring.size() : start);
+            continue;
+        }
+
+        if (_ring.size() < HeaderSize) {
+            break;
+        }
+
+        const Bytes length = payloadLength(_ring);
+        if (length > _maxPayloadSize) {
+            //Either corrupted or from something that doesn't belong on this link. Look for a frame in what follows.
+            _statistics.oversized++;
+            discard(1);
+            continue;
+        }
+
+        const Bytes frameSize = HeaderSize + length + TrailerSize;
+        if (_ring.size() < frameSize) {
+            break;
+        }
+
+        const std::string_view frame = _ring.contiguous().substr(0, frameSize);
+        const std::string_view checked = frame.substr(0, HeaderSize + length);
+        const std::string_view trailer = frame.substr(HeaderSize + length);
+        const uint32_t received = static_cast<uint8_t>(trailer[0]) |
+                                  (static_cast<uint8_t>(trailer[1]) << 8) |
+                                  (static_cast<uint8_t>(trailer[2]) << 16) |
+                                  (static_cast<uint32_t>(static_cast<uint8_t>(trailer[3])) << 24);
+
+        if (crc32(checked) != received) {
+            //The start of frame byte may have been part of the last frame's payload, so the real one could be anywhere after it.
+            _statistics.crcErrors++;
+            discard(1);
+            continue;
+        }
+
+        _statistics.frames++;
+        if (nullptr != _handler) {
+            _handler(Frame{static_cast<uint8_t>(frame[1]), frame.substr(HeaderSize, length)});
+        }
+        _ring.consume(frameSize);
+    }
+
+    return ErrorType::Success;
+}
+
+void CleonFrameCodec::reset() {
+    _ring.clear();
+    _statistics = CleonFrameSettings::Statistics();
+}
+
+ErrorType CleonFrameCodec::encode(const uint8_t qref, std::string_view payload, std::string &frame) {
+    using namespace CleonFrameSettings;
+
+    if (payload.size() > MaxPayloadSize) {
+        return ErrorType::InvalidParameter;
+    }
+
+    const Bytes start = frame.size();
+    frame.reserve(start + HeaderSize + payload.size() + TrailerSize);
+
+    frame.push_back(static_cast<char>(StartOfFrame));
+    frame.push_back(static_cast<char>(qref));
+    frame.push_back(static_cast<char>(payload.size() & 0xFF));
+    frame.push_back(static_cast<char>((payload.size() >> 8) & 0xFF));
+    frame.append(payload);
+
+    const uint32_t crc = crc32(std::string_view(frame).substr(start));
+    for (int i = 0; i < 4; i++) {
+        frame.push_back(static_cast<char>((crc >> (8 * i)) & 0xFF));
+    }
+
+    return ErrorType::Success;
+}
+
+uint32_t CleonFrameCodec::crc32(std::string_view data) {
+    uint32_t crc = 0xFFFFFFFF;
+
+    for (const char byte : data) {
+        crc = (crc >> 8) ^ CrcTable[(crc ^ static_cast<uint8_t>(byte)) & 0xFF];
+    }
+
+    return crc ^ 0xFFFFFFFF;
+}
+
+void CleonFrameCodec::discard(const Bytes bytes) {
+    _statistics.discarded += bytes;
+    _ring.consume(bytes);
+}
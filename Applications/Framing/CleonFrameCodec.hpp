@@ -0,0 +1,153 @@
+/**************************************************************************//**
+* @author Ben Haubrich
+* @file   CleonFrameCodec.hpp
+* @details \b Synopsis: \n Encodes and decodes the frames that carry messages
+*          between a Cleon and the Foundation over the UART.
+* @ingroup Applications
+*******************************************************************************/
+#ifndef __CLEON_FRAME_CODEC_HPP__
+#define __CLEON_FRAME_CODEC_HPP__
+
+//AbstractionLayer
+#include "Error.hpp"
+#include "Types.hpp"
+//Applications
+#include "RingBuffer.hpp"
+//C++
+#include <functional>
+#include <string>
+#include <string_view>
+
+/**
+ * @namespace CleonFrameSettings
+ * @brief The layout of a Cleon frame and the results of decoding them.
+ * @details | 0xCF | qref | length (16 bit little endian) | payload (nanopb) | CRC32 (little endian) |
+ *
+ *          The CRC32 is the standard one (reflected polynomial 0xEDB88320, initial value and final XOR of 0xFFFFFFFF) over the header and
+ *          the payload.
+*/
+namespace CleonFrameSettings {
+
+    /// @brief The first byte of every frame.
+    constexpr uint8_t StartOfFrame = 0xCF;
+    /// @brief The start of frame, qref and length.
+    constexpr Bytes HeaderSize = 4;
+    /// @brief The CRC32.
+    constexpr Bytes TrailerSize = 4;
+    /// @brief The largest payload that the length can describe.
+    constexpr Bytes MaxPayloadSize = 0xFFFF;
+
+    /**
+     * @struct Frame
+     * @brief A frame that has been received and validated.
+    */
+    struct Frame {
+        uint8_t qref = 0;         ///< The query reference that the frame answers.
+        std::string_view payload; ///< The nanopb encoded message. Only valid during the call to the frame handler.
+    };
+
+    /**
+     * @struct Statistics
+     * @brief What the decoder has seen since it was created or reset.
+    */
+    struct Statistics {
+        Count frames = 0;         ///< Frames that were validated and handed out.
+        Count crcErrors = 0;      ///< Frames that were complete but had the wrong CRC32.
+        Count oversized = 0;      ///< Headers with a length larger than the decoder accepts.
+        Bytes discarded = 0;      ///< Bytes thrown away while looking for the start of a valid frame.
+    };
+}
+
+/**
+ * @class CleonFrameCodec
+ * @brief An incremental decoder for a stream of Cleon frames, and the encoder for them.
+ * @details Bytes can be given to the decoder in chunks of any size, split anywhere. They are copied once into a ring buffer that is
+ *          allocated when the decoder is created and big enough for the largest frame, and each validated frame is handed to the
+ *          frame handler as a view of the ring buffer.
+ *
+ *          Corruption is recovered from by throwing away one byte at a time from the start of the frame that failed and looking for
+ *          the next start of frame byte from there, so that a valid frame inside the bytes that failed is still found. Bytes that don't
+ *          begin with a start of frame byte are skipped in bulk with the ByteScanner. A corrupted length can't make the decoder wait
+ *          for more than the largest frame it accepts.
+ *
+ *          Not thread safe. Bytes should be decoded by whoever is reading the UART.
+ * @code
+ * CleonFrameCodec codec([](const CleonFrameSettings::Frame &frame) {
+ *     //Deserialize frame.payload...
+ * });
+ *
+ * uart.rxBlocking(bytes, timeout);
+ * codec.decode(bytes);
+ * @endcode
+*/
+class CleonFrameCodec {
+
+    public:
+    /// @brief The default largest payload accepted by the decoder.
+    static constexpr Bytes DefaultMaxPayloadSize = 4096;
+
+    /**
+     * @brief Constructor.
+     * @param[in] handler Called from decode and process with each frame that is validated.
+     * @param[in] maxPayloadSize The largest payload accepted. Frames that say they are larger are treated as corruption. At most
+     *            CleonFrameSettings::MaxPayloadSize.
+    */
+    CleonFrameCodec(std::function<void(const CleonFrameSettings::Frame &frame)> handler, const Bytes maxPayloadSize = DefaultMaxPayloadSize);
+    ~CleonFrameCodec() = default;
+
+    /**
+     * @brief Decode bytes received from the stream.
+     * @param[in] data The bytes. Any number of them, including partial frames and several frames at once.
+     * @returns ErrorType::Success
+    */
+    ErrorType decode(std::string_view data);
+    /**
+     * @brief Decode bytes that were written straight into the ring buffer.
+     * @returns ErrorType::Success
+     * @sa ring
+    */
+    ErrorType process();
+    /// @brief Get the ring buffer that holds bytes which are not part of a complete frame yet. Commit received bytes to it and call process.
+    RingBuffer &ring() { return _ring; }
+    /// @brief Throw away everything received and the statistics.
+    void reset();
+
+    /// @brief Get the statistics as a constant reference
+    const CleonFrameSettings::Statistics &statisticsConst() const { return _statistics; }
+    /// @brief Get the largest payload accepted by the decoder.
+    Bytes maxPayloadSize() const { return _maxPayloadSize; }
+
+    /**
+     * @brief Append a frame to a buffer.
+     * @param[in] qref The query reference.
+     * @param[in] payload The nanopb encoded message.
+     * @param[out] frame The buffer to append the frame to. Appended so that several frames can be sent at once.
+     * @returns ErrorType::Success if the frame was appended.
+     * @returns ErrorType::InvalidParameter if the payload is larger than CleonFrameSettings::MaxPayloadSize.
+    */
+    static ErrorType encode(const uint8_t qref, std::string_view payload, std::string &frame);
+    /**
+     * @brief Calculate the CRC32 of data.
+     * @param[in] data The data.
+     * @returns The CRC32.
+    */
+    static uint32_t crc32(std::string_view data);
+
+    private:
+    /// @brief Called with each frame that is validated.
+    std::function<void(const CleonFrameSettings::Frame &frame)> _handler;
+    /// @brief The largest payload accepted.
+    Bytes _maxPayloadSize;
+    /// @brief Bytes that are not part of a complete frame yet.
+    RingBuffer _ring;
+    /// @brief What the decoder has seen.
+    CleonFrameSettings::Statistics _statistics;
+
+    /**
+     * @brief Throw away bytes from the front of the ring buffer while looking for the start of a frame.
+     * @param[in] bytes The number of bytes to throw away.
+    */
+    void discard(const Bytes bytes);
+};
+
+#endif //__CLEON_FRAME_CODEC_HPP__
@@ -0,0 +1,108 @@
+#include "CleonLoadGenerator.hpp"
+//Applications
+#include "CleonFrameCodec.hpp"
+
+CleonLoadGenerator::CleonLoadGenerator(Encoder encoder) : _encoder(encoder) {
+    setProfile(_profile);
+}
+
+ErrorType CleonLoadGenerator::setProfile(const CleonLoadSettings::Profile &profile) {
+    const bool isPercentage = profile.crcErrors >= 0.0f && profile.crcErrors <= 100.0f && profile.truncations >= 0.0f && profile.truncations <= 100.0f;
+    const CleonLoadSettings::Values &values = profile.values;
+    const bool isDistribution = (CleonLoadSettings::Distribution::Uniform != values.distribution || values.first <= values.second) &&
+                                (CleonLoadSettings::Distribution::Normal != values.distribution || values.second > 0.0f);
+
+    if (0 == profile.burstSize || profile.minFields > profile.maxFields || !isPercentage || !isDistribution) {
+        return ErrorType::InvalidParameter;
+    }
+
+    _profile = profile;
+    _bursts = 0;
+    _random.seed(profile.seed);
+    _fields.reserve(profile.maxFields);
+
+    return ErrorType::Success;
+}
+
+ErrorType CleonLoadGenerator::frame(const uint8_t qref, std::string &stream) {
+    using namespace CleonFrameSettings;
+
+    if (nullptr == _encoder) {
+        return ErrorType::PrerequisitesNotMet;
+    }
+
+    const Count fieldCount = std::uniform_int_distribution<Count>(_profile.minFields, _profile.maxFields)(_random);
+    _fields.clear();
+    for (Count i = 0; i < fieldCount; i++) {
+        _fields.push_back({FirstFieldId + i * FieldIdStep, value()});
+    }
+
+    ErrorType error = _encoder(_messageRef, _fields, _payload);
+    if (ErrorType::Success != error) {
+        return error;
+    }
+
+    const Bytes start = stream.size();
+    if (ErrorType::Success != (error = CleonFrameCodec::encode(qref, _payload, stream))) {
+        return error;
+    }
+
+    _messageRef++;
+    _statistics.frames++;
+
+    const Bytes frameSize = stream.size() - start;
+    if (chance(_profile.crcErrors)) {
+        //Anywhere but the start of frame byte so that the frame still has to be checked to find the error.
+        const Bytes byte = std::uniform_int_distribution<Bytes>(1, frameSize - 1)(_random);
+        stream[start + byte] ^= static_cast<char>(1 << std::uniform_int_distribution<int>(0, 7)(_random));
+        _statistics.crcErrors++;
+    }
+    else if (chance(_profile.truncations)) {
+        //At least the start of frame byte is sent and at least the last byte of the CRC is not.
+        stream.resize(start + std::uniform_int_distribution<Bytes>(1, frameSize - 1)(_random));
+        _statistics.truncations++;
+    }
+
+    _statistics.bytes += stream.size() - start;
+    return ErrorType::Success;
+}
+
+ErrorType CleonLoadGenerator::generate(const std::chrono::microseconds elapsed, std::string &stream) {
+    while (nextFrameDue() <= elapsed) {
+        for (Count i = 0; i < _profile.burstSize; i++) {
+            //Unsolicited frames aren't answering a query.
+            const ErrorType error = frame(0, stream);
+            if (ErrorType::Success != error) {
+                return error;
+            }
+        }
+
+        _bursts++;
+    }
+
+    return ErrorType::Success;
+}
+
+std::chrono::microseconds CleonLoadGenerator::nextFrameDue() const {
+    if (0 == _profile.frameRate) {
+        return std::chrono::microseconds::max();
+    }
+
+    return std::chrono::microseconds(_bursts * _profile.burstSize * 1000000 / _profile.frameRate);
+}
+
+float CleonLoadGenerator::value() {
+    switch (_profile.values.distribution) {
+        case CleonLoadSettings::Distribution::Uniform:
+            return std::uniform_real_distribution<float>(_profile.values.first, _profile.values.second)(_random);
+        case CleonLoadSettings::Distribution::Normal:
+            return std::normal_distribution<float>(_profile.values.first, _profile.values.second)(_random);
+        case CleonLoadSettings::Distribution::Constant:
+        default:
+            return _profile.values.first;
+    }
+}
+
+bool CleonLoadGenerator::chance(const Percent percent) {
+    return percent > 0.0f && std::uniform_real_distribution<Percent>(0.0f, 100.0f)(_random) < percent;
+}
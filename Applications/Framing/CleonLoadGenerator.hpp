@@ -0,0 +1,193 @@
+/**************************************************************************//**
+* @author Ben Haubrich
+* @file   CleonLoadGenerator.hpp
+* @details \b Synopsis: \n Generates a stream of Cleon frames at a configurable
+*          rate and shape for simulators and benchmarks.
+* @ingroup Applications
+*******************************************************************************/
+#ifndef __CLEON_LOAD_GENERATOR_HPP__
+#define __CLEON_LOAD_GENERATOR_HPP__
+
+//AbstractionLayer
+#include "Error.hpp"
+#include "Types.hpp"
+//C++
+#include <chrono>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * @namespace CleonLoadSettings
+ * @brief The shape of the load and what was generated.
+*/
+namespace CleonLoadSettings {
+
+    /**
+     * @enum Distribution
+     * @brief How the values of the fields are chosen.
+    */
+    enum class Distribution : uint8_t {
+        Constant = 0, ///< Always Values::first.
+        Uniform,      ///< Anywhere from Values::first up to Values::second.
+        Normal        ///< A mean of Values::first with a standard deviation of Values::second.
+    };
+
+    /**
+     * @struct Values
+     * @brief The distribution of the values of the fields.
+    */
+    struct Values {
+        Distribution distribution = Distribution::Uniform; ///< How the values are chosen.
+        float first = 0.0f;                                ///< @sa Distribution
+        float second = 100.0f;                             ///< @sa Distribution
+    };
+
+    /**
+     * @struct Profile
+     * @brief The load to generate.
+    */
+    struct Profile {
+        Hertz frameRate = 0;         ///< Unsolicited frames per second averaged over time. 0 to only send frames when asked.
+        Count burstSize = 1;         ///< The number of frames sent back to back each time. Larger bursts are further apart so the rate is the same.
+        Count minFields = 25;        ///< The fewest fields in a frame.
+        Count maxFields = 25;        ///< The most fields in a frame. The number of fields is uniform from minFields to maxFields.
+        Values values;               ///< The distribution of the values of the fields.
+        Percent crcErrors = 0.0f;    ///< The percentage of frames with a bit flipped after the start of frame byte.
+        Percent truncations = 0.0f;  ///< The percentage of frames that are cut short before their CRC.
+        uint32_t seed = 1;           ///< The seed of the random numbers so that a load can be repeated.
+    };
+
+    /**
+     * @struct Field
+     * @brief A field of a data reply.
+    */
+    struct Field {
+        Id id = 0;          ///< The field id.
+        float value = 0.0f; ///< The value.
+    };
+
+    /**
+     * @struct Statistics
+     * @brief What has been generated.
+    */
+    struct Statistics {
+        Count frames = 0;      ///< Frames generated, including the ones that were corrupted.
+        Count crcErrors = 0;   ///< Frames with a bit flipped.
+        Count truncations = 0; ///< Frames that were cut short.
+        Bytes bytes = 0;       ///< Bytes generated.
+    };
+}
+
+/**
+ * @class CleonLoadGenerator
+ * @brief Generates Cleon data replies on a schedule.
+ * @details Each frame carries a message reference that goes up by one with every frame so that whoever receives them can tell how
+ *          many were lost. The payload is serialized by the encoder given to the constructor so that a simulator can use the real
+ *          protobuf messages while a benchmark uses whatever it can build.
+ *
+ *          The schedule is kept against the time given to generate, so frames that fall due while nobody is asking for them are
+ *          all generated at once the next time they are asked for, just like a Cleon that keeps sending while nobody is reading.
+ * @code
+ * CleonLoadGenerator generator([](Id messageRef, const std::vector<CleonLoadSettings::Field> &fields, std::string &payload) {
+ *     //Serialize the fields into payload...
+ *     return ErrorType::Success;
+ * });
+ *
+ * CleonLoadSettings::Profile profile;
+ * profile.frameRate = 1000;
+ * generator.setProfile(profile);
+ *
+ * std::string stream;
+ * generator.generate(std::chrono::milliseconds(10), stream);
+ * //stream holds the frames due at 0, 1, ... 10ms.
+ * @endcode
+*/
+class CleonLoadGenerator {
+
+    public:
+    /**
+     * @brief Serializes the payload of a data reply.
+     * @param[in] messageRef The message reference of the frame.
+     * @param[in] fields The fields of the frame.
+     * @param[out] payload The serialized payload. Assigned, not appended.
+     * @returns ErrorType::Success if the payload was serialized.
+    */
+    using Encoder = std::function<ErrorType(const Id messageRef, const std::vector<CleonLoadSettings::Field> &fields, std::string &payload)>;
+
+    /// @brief The field ids start at this and go up by FieldIdStep, the same as the data reply the simulator sends when asked.
+    static constexpr Id FirstFieldId = 30;
+    /// @brief The difference between one field id and the next.
+    static constexpr Id FieldIdStep = 10;
+
+    /**
+     * @brief Constructor.
+     * @param[in] encoder Serializes the payload of each frame.
+    */
+    CleonLoadGenerator(Encoder encoder);
+    ~CleonLoadGenerator() = default;
+
+    /**
+     * @brief Set the load to generate.
+     * @param[in] profile The load.
+     * @post The schedule starts over from no time elapsed.
+     * @returns ErrorType::Success if the profile was set.
+     * @returns ErrorType::InvalidParameter if the burst size is 0, minFields is larger than maxFields, a percentage is outside 0 to 100, or
+     *          the values can't be drawn from the distribution (a uniform range that ends before it starts or a standard deviation that isn't positive).
+    */
+    ErrorType setProfile(const CleonLoadSettings::Profile &profile);
+    /// @brief Get the profile as a constant reference
+    const CleonLoadSettings::Profile &profileConst() const { return _profile; }
+    /// @brief Get the statistics as a constant reference
+    const CleonLoadSettings::Statistics &statisticsConst() const { return _statistics; }
+
+    /**
+     * @brief Append a frame straight away, such as the reply to a request.
+     * @param[in] qref The query reference of the frame.
+     * @param[out] stream The frame is appended to this.
+     * @returns ErrorType::Success if the frame was appended.
+     * @returns ErrorType::PrerequisitesNotMet if there is no encoder.
+     * @returns ErrorType::InvalidParameter if the payload is too large for a frame.
+     * @returns The error of the encoder if it failed.
+    */
+    ErrorType frame(const uint8_t qref, std::string &stream);
+    /**
+     * @brief Append every unsolicited frame that is due.
+     * @param[in] elapsed The time since the profile was set.
+     * @param[out] stream The frames are appended to this.
+     * @returns ErrorType::Success if all the frames that were due were appended.
+     * @returns The error of the encoder if it failed. The frames before it are still appended.
+    */
+    ErrorType generate(const std::chrono::microseconds elapsed, std::string &stream);
+    /**
+     * @brief Get when the next unsolicited frames are due.
+     * @returns The time since the profile was set, or std::chrono::microseconds::max() if the frame rate is 0.
+    */
+    std::chrono::microseconds nextFrameDue() const;
+
+    private:
+    /// @brief Serializes the payload of each frame.
+    Encoder _encoder;
+    /// @brief The load to generate.
+    CleonLoadSettings::Profile _profile;
+    /// @brief What has been generated.
+    CleonLoadSettings::Statistics _statistics;
+    /// @brief The message reference of the next frame.
+    Id _messageRef = 0;
+    /// @brief The number of bursts generated since the profile was set.
+    uint64_t _bursts = 0;
+    /// @brief Random numbers for the fields and the corruption.
+    std::mt19937 _random;
+    /// @brief Reused for each frame so that a steady load doesn't allocate.
+    std::vector<CleonLoadSettings::Field> _fields;
+    /// @brief Reused for each frame so that a steady load doesn't allocate.
+    std::string _payload;
+
+    /// @brief Get a value from the profile's distribution.
+    float value();
+    /// @brief True with the chance given as a percentage.
+    bool chance(const Percent percent);
+};
+
+#endif //__CLEON_LOAD_GENERATOR_HPP__
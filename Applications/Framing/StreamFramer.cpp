@@ -0,0 +1,92 @@
+#include "StreamFramer.hpp"
+//C++
+#include <cassert>
+
+StreamFramer::StreamFramer(const FramingSettings::Settings &settings) : _settings(settings) {}
+
+ErrorType StreamFramer::nextFrame(RingBuffer &ring, std::string_view &frame) {
+    //Release wasn't called so the same frame is still at the front.
+    assert(0 == _frameLength);
+
+    switch (_settings.mode) {
+        case FramingSettings::Mode::LengthPrefix:
+            return nextLengthPrefixedFrame(ring, frame);
+        case FramingSettings::Mode::Delimiter:
+            return nextDelimitedFrame(ring, frame);
+        default:
+            return ErrorType::PrerequisitesNotMet;
+    }
+}
+
+void StreamFramer::release(RingBuffer &ring) {
+    assert(_frameLength <= ring.size());
+
+    ring.consume(_frameLength);
+    _frameLength = 0;
+    _scanned = 0;
+}
+
+ErrorType StreamFramer::nextLengthPrefixedFrame(RingBuffer &ring, std::string_view &frame) {
+    const Bytes prefixLength = _settings.prefixLength;
+
+    if (1 != prefixLength && 2 != prefixLength && 4 != prefixLength) {
+        return ErrorType::PrerequisitesNotMet;
+    }
+
+    if (ring.size() < prefixLength) {
+        return ErrorType::NoData;
+    }
+
+    //The prefix may wrap around the end of the ring so read it a byte at a time instead of asking for a contiguous view.
+    Bytes payloadLength = 0;
+    for (Bytes i = 0; i < prefixLength; i++) {
+        const Bytes byte = static_cast<uint8_t>(ring.at(_settings.bigEndian ? i : prefixLength - 1 - i));
+        payloadLength = (payloadLength << 8) | byte;
+    }
+
+    if (payloadLength > _settings.maxFrameSize) {
+        return ErrorType::LimitReached;
+    }
+
+    if (ring.size() < prefixLength + payloadLength) {
+        return ErrorType::NoData;
+    }
+
+    frame = ring.contiguous().substr(prefixLength, payloadLength);
+    _frameLength = prefixLength + payloadLength;
+
+    return ErrorType::Success;
+}
+
+ErrorType StreamFramer::nextDelimitedFrame(RingBuffer &ring, std::string_view &frame) {
+    const std::string &delimiter = _settings.delimiter;
+
+    if (delimiter.empty()) {
+        return ErrorType::PrerequisitesNotMet;
+    }
+
+    const std::string_view data = ring.contiguous();
+
+    //Back up by the delimiter length in case the last read ended part way through a delimiter.
+    const Bytes searchFrom = _scanned >= delimiter.size() ? _scanned - (delimiter.size() - 1) : 0;
+    const size_t end = data.find(delimiter, searchFrom);
+
+    if (std::string_view::npos == end) {
+        _scanned = data.size();
+
+        if (data.size() > _settings.maxFrameSize + delimiter.size()) {
+            return ErrorType::LimitReached;
+        }
+
+        return ErrorType::NoData;
+    }
+
+    if (end > _settings.maxFrameSize) {
+        return ErrorType::LimitReached;
+    }
+
+    frame = data.substr(0, end);
+    _frameLength = end + delimiter.size();
+
+    return ErrorType::Success;
+}
@@ -0,0 +1,109 @@
+/**************************************************************************//**
+* @author Ben Haubrich
+* @file   StreamFramer.hpp
+* @details \b Synopsis: \n Splits a byte stream into messages.
+* @ingroup Applications
+*******************************************************************************/
+#ifndef __STREAM_FRAMER_HPP__
+#define __STREAM_FRAMER_HPP__
+
+//AbstractionLayer
+#include "Error.hpp"
+#include "Types.hpp"
+//Applications
+#include "RingBuffer.hpp"
+//C++
+#include <string>
+#include <string_view>
+
+/**
+ * @namespace FramingSettings
+ * @brief Settings for splitting a byte stream into messages.
+*/
+namespace FramingSettings {
+
+    /**
+     * @enum Mode
+     * @brief How the messages are separated in the stream.
+    */
+    enum class Mode : uint8_t {
+        Unknown = 0,  ///< Unknown
+        LengthPrefix, ///< Each message is preceded by its length as an unsigned integer.
+        Delimiter     ///< Each message is followed by a delimiter.
+    };
+
+    /**
+     * @struct Settings
+     * @brief How to split the stream.
+    */
+    struct Settings {
+        Mode mode = Mode::Unknown;           ///< How the messages are separated.
+        Bytes prefixLength = 4;              ///< LengthPrefix only. The size of the length (1, 2 or 4 bytes).
+        bool bigEndian = true;               ///< LengthPrefix only. True if the length is in network byte order.
+        std::string delimiter = "\r\n";      ///< Delimiter only. The bytes that end each message.
+        Bytes maxFrameSize = 64*1024;        ///< The largest message allowed. Anything bigger is a protocol error.
+    };
+}
+
+/**
+ * @class StreamFramer
+ * @brief Finds complete messages in a ring buffer and hands them out as views of the ring buffer.
+ * @details A frame is only removed from the ring buffer when it is released so the view is valid until then as long as nothing else
+ *          modifies the ring buffer. Any number of complete messages that arrived in the same read can be taken one after the
+ *          other without reading from the stream again.
+ * @code
+ * std::string_view frame;
+ * while (ErrorType::Success == framer.nextFrame(ring, frame)) {
+ *     //Use the frame...
+ *     framer.release(ring);
+ * }
+ * @endcode
+*/
+class StreamFramer {
+
+    public:
+    /**
+     * @brief Constructor.
+     * @param[in] settings How to split the stream.
+    */
+    StreamFramer(const FramingSettings::Settings &settings = FramingSettings::Settings());
+    ~StreamFramer() = default;
+
+    /**
+     * @brief Get the next complete message.
+     * @param[in] ring The bytes received from the stream.
+     * @param[out] frame The message without its length prefix or delimiter.
+     * @returns ErrorType::Success if a complete message was found.
+     * @returns ErrorType::NoData if the next message has not been fully received yet.
+     * @returns ErrorType::LimitReached if the message is bigger than the maximum frame size. The stream can not be resynchronized.
+     * @returns ErrorType::PrerequisitesNotMet if the settings are not valid.
+     * @post If a message is found then it must be released before the next message is returned.
+    */
+    ErrorType nextFrame(RingBuffer &ring, std::string_view &frame);
+    /**
+     * @brief Remove the last message returned by nextFrame from the ring buffer.
+     * @param[in] ring The ring buffer that the message was returned from.
+     * @post The view returned by nextFrame is no longer valid.
+    */
+    void release(RingBuffer &ring);
+    /// @brief Forget about any partially scanned or unreleased message. Call this if the ring buffer is cleared.
+    void reset() { _scanned = 0; _frameLength = 0; }
+
+    /// @brief Get the settings as a constant reference
+    const FramingSettings::Settings &settingsConst() const { return _settings; }
+
+    private:
+    /// @brief How to split the stream.
+    FramingSettings::Settings _settings;
+    /// @brief Delimiter only. The number of bytes already searched for a delimiter so they aren't searched again.
+    Bytes _scanned = 0;
+    /// @brief The number of bytes the last message returned uses in the ring buffer, including the prefix or delimiter.
+    Bytes _frameLength = 0;
+
+    /// @sa nextFrame
+    ErrorType nextLengthPrefixedFrame(RingBuffer &ring, std::string_view &frame);
+    /// @sa nextFrame
+    ErrorType nextDelimitedFrame(RingBuffer &ring, std::string_view &frame);
+};
+
+#endif //__STREAM_FRAMER_HPP__
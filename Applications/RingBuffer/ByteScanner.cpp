@@ -0,0 +1,124 @@
+#include "ByteScanner.hpp"
+//C++
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+#if defined(__AVX2__)
+    constexpr size_t VectorSize = 32;
+
+    /// @brief Get a bit for each byte of the 32 at data that equals the byte.
+    inline uint32_t matches(const char *data, const __m256i byte) {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+        return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, byte)));
+    }
+
+    /// @brief Get a bit for each byte of the 32 at data that equals either byte.
+    inline uint32_t matches(const char *data, const __m256i first, const __m256i second) {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+        return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, first), _mm256_cmpeq_epi8(bytes, second))));
+    }
+
+    inline __m256i splat(const char byte) { return _mm256_set1_epi8(byte); }
+    inline size_t firstMatch(const uint32_t mask) { return __builtin_ctz(mask); }
+
+#elif defined(__SSE2__)
+    constexpr size_t VectorSize = 16;
+
+    /// @brief Get a bit for each byte of the 16 at data that equals the byte.
+    inline uint32_t matches(const char *data, const __m128i byte) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, byte)));
+    }
+
+    /// @brief Get a bit for each byte of the 16 at data that equals either byte.
+    inline uint32_t matches(const char *data, const __m128i first, const __m128i second) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(bytes, first), _mm_cmpeq_epi8(bytes, second))));
+    }
+
+    inline __m128i splat(const char byte) { return _mm_set1_epi8(byte); }
+    inline size_t firstMatch(const uint32_t mask) { return __builtin_ctz(mask); }
+
+#elif defined(__ARM_NEON)
+    constexpr size_t VectorSize = 16;
+
+    /// @brief Squeeze the comparison of 16 bytes into 4 bits per byte since NEON has no movemask.
+    inline uint64_t toMask(const uint8x16_t equal) {
+        const uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(equal), 4);
+        return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+    }
+
+    /// @brief Get 4 bits for each byte of the 16 at data that equals the byte.
+    inline uint64_t matches(const char *data, const uint8x16_t byte) {
+        const uint8x16_t bytes = vld1q_u8(reinterpret_cast<const uint8_t *>(data));
+        return toMask(vceqq_u8(bytes, byte));
+    }
+
+    /// @brief Get 4 bits for each byte of the 16 at data that equals either byte.
+    inline uint64_t matches(const char *data, const uint8x16_t first, const uint8x16_t second) {
+        const uint8x16_t bytes = vld1q_u8(reinterpret_cast<const uint8_t *>(data));
+        return toMask(vorrq_u8(vceqq_u8(bytes, first), vceqq_u8(bytes, second)));
+    }
+
+    inline uint8x16_t splat(const char byte) { return vdupq_n_u8(static_cast<uint8_t>(byte)); }
+    inline size_t firstMatch(const uint64_t mask) { return __builtin_ctzll(mask) / 4; }
+
+#else
+    //No vector instructions. Every byte is looked at by the tail loops.
+    constexpr size_t VectorSize = 0;
+#endif
+}
+
+size_t ByteScanner::find(std::string_view data, const char byte) {
+    size_t i = 0;
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(__ARM_NEON)
+    const auto needle = splat(byte);
+
+    for (; i + VectorSize <= data.size(); i += VectorSize) {
+        const auto mask = matches(data.data() + i, needle);
+        if (0 != mask) {
+            return i + firstMatch(mask);
+        }
+    }
+#endif
+
+    for (; i < data.size(); i++) {
+        if (byte == data[i]) {
+            return i;
+        }
+    }
+
+    return std::string_view::npos;
+}
+
+size_t ByteScanner::findEither(std::string_view data, const char first, const char second) {
+    size_t i = 0;
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(__ARM_NEON)
+    const auto firstNeedle = splat(first);
+    const auto secondNeedle = splat(second);
+
+    for (; i + VectorSize <= data.size(); i += VectorSize) {
+        const auto mask = matches(data.data() + i, firstNeedle, secondNeedle);
+        if (0 != mask) {
+            return i + firstMatch(mask);
+        }
+    }
+#endif
+
+    for (; i < data.size(); i++) {
+        if (first == data[i] || second == data[i]) {
+            return i;
+        }
+    }
+
+    return std::string_view::npos;
+}
@@ -0,0 +1,45 @@
+/**************************************************************************//**
+* @author Ben Haubrich
+* @file   ByteScanner.hpp
+* @details \b Synopsis: \n Finds delimiters in received bytes using the
+*          vector instructions of the target where there are any.
+* @ingroup Applications
+*******************************************************************************/
+#ifndef __BYTE_SCANNER_HPP__
+#define __BYTE_SCANNER_HPP__
+
+//C++
+#include <string_view>
+
+/**
+ * @namespace ByteScanner
+ * @brief Searches for delimiters such as a terminating byte or a line ending.
+ * @details The instruction set is chosen when the library is compiled: AVX2 if the compiler targets it (e.g. -mavx2), otherwise SSE2
+ *          on x86-64, NEON on ARM, or one byte at a time on anything else. Every version gives the same results.
+ * @code
+ * const size_t end = ByteScanner::findEither(data, '\r', '\n');
+ * if (std::string_view::npos != end) {
+ *     std::string_view line = data.substr(0, end);
+ * }
+ * @endcode
+*/
+namespace ByteScanner {
+
+    /**
+     * @brief Find the first occurrence of a byte.
+     * @param[in] data The bytes to search.
+     * @param[in] byte The byte to find.
+     * @returns The index of the byte, or std::string_view::npos if it isn't in the data.
+    */
+    size_t find(std::string_view data, const char byte);
+    /**
+     * @brief Find the first occurrence of either of two bytes, such as the carriage return or line feed that ends a line.
+     * @param[in] data The bytes to search.
+     * @param[in] first One byte to find.
+     * @param[in] second The other byte to find.
+     * @returns The index of whichever byte comes first, or std::string_view::npos if neither is in the data.
+    */
+    size_t findEither(std::string_view data, const char first, const char second);
+}
+
+#endif //__BYTE_SCANNER_HPP__
@@ -0,0 +1,144 @@
+#include "RingBuffer.hpp"
+#include "ByteScanner.hpp"
+//C++
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+RingBuffer::RingBuffer(Bytes capacity, Bytes maxCapacity) : _buffer(capacity), _maxCapacity(std::max(capacity, maxCapacity)) {
+    assert(capacity > 0);
+}
+
+ErrorType RingBuffer::reserve(Bytes freeSpace) {
+    if (available() >= freeSpace) {
+        return ErrorType::Success;
+    }
+
+    const Bytes needed = _size + freeSpace;
+    if (needed > _maxCapacity) {
+        return ErrorType::LimitReached;
+    }
+
+    Bytes newCapacity = _buffer.size();
+    while (newCapacity < needed) {
+        newCapacity = std::min<Bytes>(newCapacity * 2, _maxCapacity);
+    }
+
+    //Lay the readable bytes out from the start of the new buffer so that the free space is one region.
+    linearize();
+    _buffer.resize(newCapacity);
+
+    return ErrorType::Success;
+}
+
+Count RingBuffer::freeRegions(std::array<std::span<char>, 2> &regions) {
+    const Bytes capacity = _buffer.size();
+    const Bytes tail = (_head + _size) % capacity;
+    const Bytes freeSpace = available();
+
+    regions[0] = std::span<char>();
+    regions[1] = std::span<char>();
+
+    if (0 == freeSpace) {
+        return 0;
+    }
+
+    if (tail >= _head) {
+        //Free space runs from the tail to the end of the buffer and then wraps around to the head.
+        regions[0] = std::span<char>(_buffer.data() + tail, capacity - tail);
+        if (_head > 0) {
+            regions[1] = std::span<char>(_buffer.data(), _head);
+            return 2;
+        }
+        return 1;
+    }
+
+    regions[0] = std::span<char>(_buffer.data() + tail, _head - tail);
+    return 1;
+}
+
+void RingBuffer::commit(Bytes bytes) {
+    assert(bytes <= available());
+    _size += bytes;
+}
+
+ErrorType RingBuffer::write(std::string_view data) {
+    std::array<std::span<char>, 2> regions;
+
+    ErrorType error = reserve(data.size());
+    if (ErrorType::Success != error) {
+        return error;
+    }
+
+    freeRegions(regions);
+    const Bytes first = std::min<Bytes>(data.size(), regions[0].size());
+    memcpy(regions[0].data(), data.data(), first);
+    if (first < data.size()) {
+        memcpy(regions[1].data(), data.data() + first, data.size() - first);
+    }
+
+    commit(data.size());
+    return ErrorType::Success;
+}
+
+std::string_view RingBuffer::contiguous() {
+    if (_head + _size > _buffer.size()) {
+        linearize();
+    }
+
+    return std::string_view(_buffer.data() + _head, _size);
+}
+
+size_t RingBuffer::find(const char byte, const Bytes from) const {
+    if (from >= _size) {
+        return std::string_view::npos;
+    }
+
+    //The readable bytes are searched where they are, as two regions if they wrap around the end of the buffer.
+    const Bytes firstLength = std::min<Bytes>(_size, _buffer.size() - _head);
+    if (from < firstLength) {
+        const size_t found = ByteScanner::find(std::string_view(_buffer.data() + _head + from, firstLength - from), byte);
+        if (std::string_view::npos != found) {
+            return from + found;
+        }
+    }
+
+    const Bytes secondFrom = from > firstLength ? from - firstLength : 0;
+    const size_t found = ByteScanner::find(std::string_view(_buffer.data() + secondFrom, _size - firstLength - secondFrom), byte);
+    return std::string_view::npos == found ? found : firstLength + secondFrom + found;
+}
+
+void RingBuffer::consume(Bytes bytes) {
+    assert(bytes <= _size);
+
+    _size -= bytes;
+    //Rewinding when empty keeps the free space in one region for as long as possible.
+    _head = 0 == _size ? 0 : (_head + bytes) % _buffer.size();
+}
+
+void RingBuffer::linearize() {
+    if (0 == _head) {
+        return;
+    }
+
+    //The readable bytes from the head to the end of the storage, and the ones that wrapped around to the start.
+    const Bytes first = std::min<Bytes>(_size, _buffer.size() - _head);
+    const Bytes second = _size - first;
+    char *data = _buffer.data();
+
+    //Moved as whole blocks through the free space when there is room, instead of being rotated a byte at a time.
+    if (first <= available()) {
+        memmove(data + first, data, second);
+        memmove(data, data + _head, first);
+    }
+    else if (second <= available()) {
+        memmove(data + second, data + _head, first);
+        memcpy(data + _size, data, second);
+        memmove(data, data + second, _size);
+    }
+    else {
+        std::rotate(_buffer.begin(), _buffer.begin() + _head, _buffer.end());
+    }
+
+    _head = 0;
+}
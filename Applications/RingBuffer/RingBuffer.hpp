@@ -0,0 +1,137 @@
+/**************************************************************************//**
+* @author Ben Haubrich
+* @file   RingBuffer.hpp
+* @details \b Synopsis: \n Growable byte ring buffer that is filled in place
+*          and read without copying.
+* @ingroup Applications
+*******************************************************************************/
+#ifndef __RING_BUFFER_HPP__
+#define __RING_BUFFER_HPP__
+
+//AbstractionLayer
+#include "Error.hpp"
+#include "Types.hpp"
+//C++
+#include <array>
+#include <span>
+#include <string_view>
+#include <vector>
+
+/**
+ * @class RingBuffer
+ * @brief A byte ring buffer that grows on demand up to a maximum capacity.
+ * @details Writers ask for the free space as (at most) two contiguous regions so that a single scatter read such as readv can fill
+ *          both halves of a wrapped buffer in one call, and then commit the number of bytes that were written. Readers get views
+ *          of the readable bytes. The readable bytes are only moved if they wrap around the end of the buffer and a reader asks
+ *          for them as one contiguous view, or if the buffer grows.
+ * @code
+ * RingBuffer ring;
+ * std::array<std::span<char>, 2> regions;
+ *
+ * ring.reserve(1024);
+ * ring.freeRegions(regions);
+ * //Write into regions[0] first, then regions[1].
+ * ring.commit(bytesWritten);
+ *
+ * std::string_view data = ring.contiguous();
+ * //Use the data...
+ * ring.consume(data.size());
+ * @endcode
+*/
+class RingBuffer {
+
+    public:
+    /// @brief The default initial capacity.
+    static constexpr Bytes DefaultCapacity = 4096;
+    /// @brief The default maximum capacity.
+    static constexpr Bytes DefaultMaxCapacity = 1024*1024;
+
+    /**
+     * @brief Constructor.
+     * @param[in] capacity The initial capacity.
+     * @param[in] maxCapacity The capacity that the ring buffer will not grow past.
+    */
+    RingBuffer(Bytes capacity = DefaultCapacity, Bytes maxCapacity = DefaultMaxCapacity);
+    ~RingBuffer() = default;
+
+    /// @brief The number of readable bytes.
+    Bytes size() const { return _size; }
+    /// @brief True if there are no readable bytes.
+    bool empty() const { return 0 == _size; }
+    /// @brief The number of bytes that can be held without growing.
+    Bytes capacity() const { return _buffer.size(); }
+    /// @brief The number of bytes that can be written without growing.
+    Bytes available() const { return _buffer.size() - _size; }
+
+    /**
+     * @brief Make sure that there is at least this much free space, growing the buffer if needed.
+     * @param[in] freeSpace The free space needed.
+     * @returns ErrorType::Success if there is enough free space.
+     * @returns ErrorType::LimitReached if growing the buffer would exceed the maximum capacity.
+    */
+    ErrorType reserve(Bytes freeSpace);
+    /**
+     * @brief Get the free space as contiguous regions.
+     * @param[out] regions The free space. The second region is empty unless the free space wraps around the end of the buffer.
+     * @returns The number of regions that are not empty.
+     * @post The regions are invalidated by any call that modifies the ring buffer.
+    */
+    Count freeRegions(std::array<std::span<char>, 2> &regions);
+    /**
+     * @brief Mark bytes written to the free regions as readable.
+     * @param[in] bytes The number of bytes written.
+     * @pre bytes is not greater than available()
+    */
+    void commit(Bytes bytes);
+    /**
+     * @brief Copy data into the ring buffer, growing it if needed.
+     * @param[in] data The data to copy.
+     * @returns ErrorType::Success if the data was copied.
+     * @returns ErrorType::LimitReached if there was not enough space.
+    */
+    ErrorType write(std::string_view data);
+
+    /**
+     * @brief Get a readable byte.
+     * @param[in] index The index from the first readable byte.
+     * @pre index is less than size()
+    */
+    char at(Bytes index) const { return _buffer[(_head + index) % _buffer.size()]; }
+    /**
+     * @brief Find a byte in the readable bytes without moving them.
+     * @param[in] byte The byte to find.
+     * @param[in] from The index from the first readable byte to start searching at.
+     * @returns The index of the byte from the first readable byte, or std::string_view::npos if it isn't there.
+     * @sa ByteScanner::find
+    */
+    size_t find(const char byte, const Bytes from = 0) const;
+    /**
+     * @brief Get all of the readable bytes as one view.
+     * @details Moves the readable bytes to the start of the buffer if they wrap around the end.
+     * @post The view is invalidated by any call that modifies the ring buffer.
+    */
+    std::string_view contiguous();
+    /**
+     * @brief Remove bytes from the front of the readable bytes.
+     * @param[in] bytes The number of bytes to remove.
+     * @pre bytes is not greater than size()
+    */
+    void consume(Bytes bytes);
+    /// @brief Remove all readable bytes.
+    void clear() { _head = 0; _size = 0; }
+
+    private:
+    /// @brief The storage.
+    std::vector<char> _buffer;
+    /// @brief The capacity that the ring buffer will not grow past.
+    Bytes _maxCapacity;
+    /// @brief The index of the first readable byte.
+    Bytes _head = 0;
+    /// @brief The number of readable bytes.
+    Bytes _size = 0;
+
+    /// @brief Move the readable bytes to the start of the buffer.
+    void linearize();
+};
+
+#endif //__RING_BUFFER_HPP__
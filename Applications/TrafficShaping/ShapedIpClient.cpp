@@ -0,0 +1,375 @@
+//AbstractionLayer
+#include "ShapedIpClient.hpp"
+#include "NetworkAbstraction.hpp"
+#include "OperatingSystemModule.hpp"
+//C++
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+
+namespace {
+    Milliseconds millisecondsUntil(const std::chrono::steady_clock::time_point deadline) {
+        const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        return remaining > 0 ? static_cast<Milliseconds>(remaining) : 0;
+    }
+}
+
+std::atomic<int> ShapedIpClient::semaphoreCount(0);
+
+ShapedIpClient::Owner::~Owner() {
+    OperatingSystem::Instance().deleteSemaphore(semaphore);
+}
+
+ShapedIpClient::ShapedIpClient(IpClientAbstraction &client, TrafficShaper &shaper, const TrafficShaperSettings::Priority priority) :
+    IpClientAbstraction(), _client(client), _shaper(shaper), _priority(priority) {
+    const int instance = ++semaphoreCount;
+    _deferredSemaphore = std::string("shapedIpClientSemaphore").append(std::to_string(instance));
+    ErrorType error = OperatingSystem::Instance().createSemaphore(1, 1, _deferredSemaphore);
+    assert(ErrorType::Success == error);
+
+    _owner = std::make_shared<Owner>();
+    _owner->client = this;
+    _owner->semaphore = std::string("shapedIpClientOwnerSemaphore").append(std::to_string(instance));
+    error = OperatingSystem::Instance().createSemaphore(1, 1, _owner->semaphore);
+    assert(ErrorType::Success == error);
+
+    syncWithClient();
+}
+
+ShapedIpClient::~ShapedIpClient() {
+    //Events still on the network's queue hold the owner so wait for the one that may be running and then leave them nothing to do.
+    const ErrorType error = OperatingSystem::Instance().waitSemaphore(_owner->semaphore, SemaphoreTimeout);
+    _owner->client = nullptr;
+    if (ErrorType::Success == error) {
+        OperatingSystem::Instance().incrementSemaphore(_owner->semaphore);
+    }
+
+    //Nothing is left to pace the sends that are still waiting so finish them here.
+    std::vector<std::shared_ptr<PendingSend>> unsent;
+    if (ErrorType::Success == OperatingSystem::Instance().waitSemaphore(_deferredSemaphore, SemaphoreTimeout)) {
+        unsent = std::move(_deferred);
+        unsent.insert(unsent.end(), _scheduled.begin(), _scheduled.end());
+        _deferred.clear();
+        _scheduled.clear();
+        OperatingSystem::Instance().incrementSemaphore(_deferredSemaphore);
+    }
+
+    for (auto &pending : unsent) {
+        _shaper.endWaiting(pending->priority);
+        pending->sent(ErrorType::Failure, 0);
+    }
+
+    OperatingSystem::Instance().deleteSemaphore(_deferredSemaphore);
+}
+
+ErrorType ShapedIpClient::connectTo(std::string hostname, Port port, IpClientSettings::Protocol protocol, IpClientSettings::Version version, Socket &socket, Milliseconds timeout) {
+    const ErrorType error = _client.connectTo(hostname, port, protocol, version, socket, timeout);
+    syncWithClient();
+    return error;
+}
+
+ErrorType ShapedIpClient::disconnect() {
+    const ErrorType error = _client.disconnect();
+    syncWithClient();
+    return error;
+}
+
+ErrorType ShapedIpClient::sendBlocking(const std::string &data, const Milliseconds timeout) {
+    const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout);
+    const TrafficShaperSettings::Priority priority = _priority;
+    const Bytes burst = _shaper.settingsConst().burst;
+    ErrorType error = ErrorType::Success;
+
+    //Send a stream in pieces so that a higher priority can get in between them.
+    const Bytes pieceSize = isStream() && 0 != burst ? burst : std::max<Bytes>(1, data.size());
+
+    for (Bytes offset = 0; offset < data.size() && ErrorType::Success == error; offset += pieceSize) {
+        const Bytes bytes = std::min<Bytes>(pieceSize, data.size() - offset);
+
+        if (ErrorType::Success != (error = _shaper.acquire(bytes, priority, millisecondsUntil(deadline)))) {
+            break;
+        }
+
+        if (bytes == data.size()) {
+            error = _client.sendBlocking(data, millisecondsUntil(deadline));
+        }
+        else {
+            error = _client.sendBlocking(data.substr(offset, bytes), millisecondsUntil(deadline));
+        }
+    }
+
+    syncWithClient();
+    return error;
+}
+
+ErrorType ShapedIpClient::receiveBlocking(std::string &buffer, const Milliseconds timeout) {
+    const ErrorType error = _client.receiveBlocking(buffer, timeout);
+
+    //The data was received whether or not the shaper could count it.
+    if (ErrorType::Success == error) {
+        _shaper.recordReceived(buffer.size());
+    }
+
+    syncWithClient();
+    return error;
+}
+
+ErrorType ShapedIpClient::sendNonBlocking(const std::shared_ptr<std::string> data, const Milliseconds timeout, std::function<void(const ErrorType error, const Bytes bytesWritten)> callback) {
+    struct Result {
+        std::atomic<bool> sent = false;
+        ErrorType error = ErrorType::Failure;
+    };
+
+    if (nullptr == data.get()) {
+        return ErrorType::InvalidParameter;
+    }
+
+    //Shared with the events since the send can outlive this call if the caller stops waiting.
+    auto result = std::make_shared<Result>();
+
+    auto pending = std::make_shared<PendingSend>();
+    pending->data = data;
+    pending->deadline = Clock::now() + std::chrono::milliseconds(timeout);
+    pending->priority = _priority;
+    //Doesn't use this since the client may call it after this has been destroyed.
+    pending->sent = [callback, result](const ErrorType error, const Bytes bytesWritten) {
+        if (nullptr != callback) {
+            callback(error, bytesWritten);
+        }
+
+        result->error = error;
+        result->sent = true;
+    };
+
+    //Lower priorities hold off from now on, not just once the event gets its turn.
+    _shaper.beginWaiting(pending->priority);
+
+    ErrorType error = schedule(pending);
+    if (ErrorType::Success != error) {
+        _shaper.endWaiting(pending->priority);
+        return error;
+    }
+
+    //Block for the timeout specified if no callback is provided
+    if (nullptr == callback) {
+        Milliseconds i;
+        for (i = 0; i < timeout / 10 && !result->sent; i++) {
+            OperatingSystem::Instance().delay(10);
+        }
+
+        syncWithClient();
+
+        if (!result->sent) {
+            return ErrorType::Timeout;
+        }
+
+        return result->error;
+    }
+
+    return ErrorType::Success;
+}
+
+ErrorType ShapedIpClient::receiveNonBlocking(std::shared_ptr<std::string> buffer, const Milliseconds timeout, std::function<void(const ErrorType error, std::shared_ptr<std::string> buffer)> callback) {
+    struct Result {
+        std::atomic<bool> received = false;
+        ErrorType error = ErrorType::Failure;
+    };
+
+    //Shared with the client since it can receive after this returns.
+    auto result = std::make_shared<Result>();
+
+    //Always give the client a callback so that bytes that arrive after the caller stops waiting are still counted.
+    auto rx = [this, callback, result](const ErrorType error, std::shared_ptr<std::string> buffer) {
+        if (ErrorType::Success == error && nullptr != buffer.get()) {
+            _shaper.recordReceived(buffer->size());
+        }
+
+        syncWithClient();
+
+        if (nullptr != callback) {
+            callback(error, buffer);
+        }
+
+        result->error = error;
+        result->received = true;
+    };
+
+    ErrorType error = _client.receiveNonBlocking(buffer, timeout, rx);
+    if (ErrorType::Success != error) {
+        return error;
+    }
+
+    //Block for the timeout specified if no callback is provided
+    if (nullptr == callback) {
+        Milliseconds i;
+        for (i = 0; i < timeout / 10 && !result->received; i++) {
+            OperatingSystem::Instance().delay(10);
+        }
+
+        if (!result->received) {
+            return ErrorType::Timeout;
+        }
+
+        return result->error;
+    }
+
+    return ErrorType::Success;
+}
+
+ErrorType ShapedIpClient::mainLoop() {
+    std::vector<std::shared_ptr<PendingSend>> due;
+    const Clock::time_point now = Clock::now();
+
+    ErrorType error = OperatingSystem::Instance().waitSemaphore(_deferredSemaphore, SemaphoreTimeout);
+    if (ErrorType::Success != error) {
+        return error;
+    }
+
+    auto waiting = std::partition(_deferred.begin(), _deferred.end(), [now](const std::shared_ptr<PendingSend> &pending) {
+        return now < pending->notBefore;
+    });
+    due.assign(waiting, _deferred.end());
+    _deferred.erase(waiting, _deferred.end());
+
+    OperatingSystem::Instance().incrementSemaphore(_deferredSemaphore);
+
+    if (due.empty()) {
+        return ErrorType::NoData;
+    }
+
+    for (auto &pending : due) {
+        if (ErrorType::Success == (error = schedule(pending))) {
+            continue;
+        }
+
+        //The network's queue is full so wait for the next time around.
+        if (Clock::now() < pending->deadline && ErrorType::Success == defer(pending)) {
+            continue;
+        }
+
+        _shaper.endWaiting(pending->priority);
+        pending->sent(error, 0);
+    }
+
+    return ErrorType::Success;
+}
+
+void ShapedIpClient::syncWithClient() {
+    _socket = _client.sockConst();
+    _protocol = _client.protocolConst();
+    _version = _client.versionConst();
+    _hostname = _client.hostnameConst();
+    _port = _client.portConst();
+    _status = _client.statusConst();
+}
+
+ErrorType ShapedIpClient::schedule(std::shared_ptr<PendingSend> pending) {
+    //Bind the owner instead of this so that an event that runs after this is destroyed doesn't use it.
+    std::unique_ptr<EventAbstraction> event = std::make_unique<EventQueue::Event<ShapedIpClient>>(std::bind(&ShapedIpClient::paceIfOwned, _owner, pending));
+
+    ErrorType error = OperatingSystem::Instance().waitSemaphore(_deferredSemaphore, SemaphoreTimeout);
+    if (ErrorType::Success != error) {
+        return error;
+    }
+
+    //Tracked before it's added since the network can run it straight away.
+    _scheduled.push_back(pending);
+
+    OperatingSystem::Instance().incrementSemaphore(_deferredSemaphore);
+
+    //The event queue doesn't wait for its lock so try again if another thread has it.
+    Count attempts = 0;
+    while (ErrorType::Timeout == (error = network().addEvent(event)) && ++attempts < ScheduleAttempts) {
+        OperatingSystem::Instance().delay(0);
+    }
+
+    if (ErrorType::Success != error) {
+        unschedule(pending);
+    }
+
+    return error;
+}
+
+ErrorType ShapedIpClient::paceIfOwned(std::shared_ptr<Owner> owner, std::shared_ptr<PendingSend> pending) {
+    ErrorType error = OperatingSystem::Instance().waitSemaphore(owner->semaphore, SemaphoreTimeout);
+    if (ErrorType::Success != error) {
+        return error;
+    }
+
+    //The client finished the send with an error when it was destroyed.
+    if (nullptr == owner->client) {
+        OperatingSystem::Instance().incrementSemaphore(owner->semaphore);
+        return ErrorType::PrerequisitesNotMet;
+    }
+
+    error = owner->client->pace(pending);
+
+    OperatingSystem::Instance().incrementSemaphore(owner->semaphore);
+    return error;
+}
+
+ErrorType ShapedIpClient::pace(std::shared_ptr<PendingSend> pending) {
+    //Only try again later if it can be tracked so that it's not lost if this is destroyed in the meantime.
+    if (ErrorType::Success != unschedule(pending)) {
+        return ErrorType::Timeout;
+    }
+
+    Milliseconds retryIn = 0;
+    ErrorType error = _shaper.tryAcquire(pending->data->size(), pending->priority, retryIn);
+
+    if (ErrorType::NotAvailable == error) {
+        if (Clock::now() >= pending->deadline) {
+            error = ErrorType::Timeout;
+        }
+        else {
+            //Don't come back until the shaper expects to have the tokens so that the network's queue can go idle in the meantime.
+            pending->notBefore = std::min(Clock::now() + std::chrono::milliseconds(retryIn), pending->deadline);
+            if (ErrorType::Success == (error = defer(pending))) {
+                return ErrorType::Success;
+            }
+        }
+    }
+
+    _shaper.endWaiting(pending->priority);
+
+    if (ErrorType::Success == error) {
+        //Always with a callback so that the client doesn't block the network's thread.
+        error = _client.sendNonBlocking(pending->data, std::max<Milliseconds>(1, millisecondsUntil(pending->deadline)), pending->sent);
+        syncWithClient();
+
+        if (ErrorType::Success == error) {
+            return ErrorType::Success;
+        }
+    }
+
+    pending->sent(error, 0);
+    return error;
+}
+
+ErrorType ShapedIpClient::defer(std::shared_ptr<PendingSend> pending) {
+    ErrorType error = OperatingSystem::Instance().waitSemaphore(_deferredSemaphore, SemaphoreTimeout);
+    if (ErrorType::Success != error) {
+        return error;
+    }
+
+    _deferred.push_back(pending);
+
+    OperatingSystem::Instance().incrementSemaphore(_deferredSemaphore);
+    return ErrorType::Success;
+}
+
+ErrorType ShapedIpClient::unschedule(const std::shared_ptr<PendingSend> &pending) {
+    ErrorType error = OperatingSystem::Instance().waitSemaphore(_deferredSemaphore, SemaphoreTimeout);
+    if (ErrorType::Success != error) {
+        return error;
+    }
+
+    _scheduled.erase(std::remove(_scheduled.begin(), _scheduled.end(), pending), _scheduled.end());
+
+    OperatingSystem::Instance().incrementSemaphore(_deferredSemaphore);
+    return ErrorType::Success;
+}
+
+bool ShapedIpClient::isStream() const {
+    return IpClientSettings::Protocol::Tcp == _client.protocolConst() || IpClientSettings::Protocol::UnixStream == _client.protocolConst();
+}
@@ -0,0 +1,144 @@
+/**************************************************************************//**
+* @author Ben Haubrich
+* @file   ShapedIpClient.hpp
+* @details \b Synopsis: \n An IP client whose traffic is paced and counted by a
+*          traffic shaper.
+* @ingroup Applications
+*******************************************************************************/
+#ifndef __SHAPED_IP_CLIENT_HPP__
+#define __SHAPED_IP_CLIENT_HPP__
+
+//AbstractionLayer
+#include "IpClientAbstraction.hpp"
+//Applications
+#include "TrafficShaper.hpp"
+//C++
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+/**
+ * @class ShapedIpClient
+ * @brief Wraps any IP client so that what it sends waits for the shaper and what it receives is counted against the budget.
+ * @details sendBlocking sends stream protocols in pieces no larger than the shaper's burst so that a large upload can be overtaken by
+ *          a higher priority between pieces. Datagrams are sent whole since splitting them would change the message.
+ *
+ *          The non blocking functions wait for tokens on the network set with setNetwork instead of blocking the network's thread.
+ *          A send that has to wait is set aside until the shaper expects to have tokens for it, and mainLoop puts it back on the
+ *          network's queue once that time comes, so call mainLoop from the same loop that runs the network. sendNonBlocking takes the
+ *          tokens for all of its data at once and hands it to the client in one piece, so that the callback is called once for it.
+ *          Split large uploads into several sends to let a higher priority in between them.
+ *
+ *          Sends that are still waiting for tokens when the client is destroyed are finished with ErrorType::Failure.
+ * @code
+ * IpClient cellular;
+ * TrafficShaper shaper(settings);
+ * ShapedIpClient uploads(cellular, shaper, TrafficShaperSettings::Priority::Bulk);
+ * uploads.setNetwork(network);
+ * uploads.connectTo("example.com", 443, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::IPv4, sock, 5000);
+ * uploads.sendNonBlocking(data, 5000, callback);
+ * while (true) {
+ *     uploads.mainLoop();
+ *     network.mainLoop();
+ * }
+ * @endcode
+*/
+class ShapedIpClient : public IpClientAbstraction {
+
+    public:
+    /**
+     * @brief Constructor.
+     * @param[in] client The client to send and receive with. Must outlive this.
+     * @param[in] shaper The shaper shared by every client on the link. Must outlive this.
+     * @param[in] priority The priority of everything sent by this client.
+    */
+    ShapedIpClient(IpClientAbstraction &client, TrafficShaper &shaper, const TrafficShaperSettings::Priority priority = TrafficShaperSettings::Priority::Bulk);
+    ~ShapedIpClient();
+
+    ErrorType connectTo(std::string hostname, Port port, IpClientSettings::Protocol protocol, IpClientSettings::Version version, Socket &socket, Milliseconds timeout) override;
+    ErrorType disconnect() override;
+    /// @returns ErrorType::LimitReached if sending would go over the shaper's budget.
+    ErrorType sendBlocking(const std::string &data, const Milliseconds timeout) override;
+    ErrorType receiveBlocking(std::string &buffer, const Milliseconds timeout) override;
+    /// @returns ErrorType::LimitReached if sending would go over the shaper's budget.
+    ErrorType sendNonBlocking(const std::shared_ptr<std::string> data, const Milliseconds timeout, std::function<void(const ErrorType error, const Bytes bytesWritten)> callback = nullptr) override;
+    ErrorType receiveNonBlocking(std::shared_ptr<std::string> buffer, const Milliseconds timeout, std::function<void(const ErrorType error, std::shared_ptr<std::string> buffer)> callback = nullptr) override;
+
+    /**
+     * @brief Put the non blocking sends that were waiting for tokens back on the network's queue once their retry time has come.
+     * @returns ErrorType::Success if any sends were put back on the queue.
+     * @returns ErrorType::NoData if no sends are due.
+    */
+    ErrorType mainLoop();
+
+    /// @brief Get the priority as a constant reference
+    const TrafficShaperSettings::Priority &priorityConst() const { return _priority; }
+    /// @brief Set the priority of everything sent from now on.
+    ErrorType setPriority(const TrafficShaperSettings::Priority priority) { _priority = priority; return ErrorType::Success; }
+
+    private:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @struct PendingSend
+     * @brief A non blocking send that is waiting for tokens.
+    */
+    struct PendingSend {
+        std::shared_ptr<std::string> data;                                     ///< The data to send.
+        Clock::time_point deadline;                                            ///< When to give up waiting.
+        Clock::time_point notBefore;                                           ///< When the shaper expects to have tokens for it.
+        TrafficShaperSettings::Priority priority;                              ///< The priority when the send was made.
+        std::function<void(const ErrorType error, const Bytes bytesWritten)> sent; ///< Called once the send is done or given up on.
+    };
+
+    /**
+     * @struct Owner
+     * @brief Lets the events queued on the network find out whether the client that queued them still exists.
+    */
+    struct Owner {
+        ShapedIpClient *client; ///< nullptr once the client has been destroyed.
+        std::string semaphore;  ///< Held while an event uses the client so that it isn't destroyed in the meantime.
+
+        ~Owner();
+    };
+
+    /// @brief The number of times to try adding an event to the network before giving up.
+    static constexpr Count ScheduleAttempts = 8;
+    /// @brief The timeout for semaphore operations.
+    static constexpr Milliseconds SemaphoreTimeout = 1000;
+    /// @brief Used to give each client's semaphore a unique name.
+    static std::atomic<int> semaphoreCount;
+
+    /// @brief The client to send and receive with.
+    IpClientAbstraction &_client;
+    /// @brief The shaper that paces this client.
+    TrafficShaper &_shaper;
+    /// @brief The priority of everything sent by this client.
+    TrafficShaperSettings::Priority _priority;
+    /// @brief The sends waiting for their retry time.
+    std::vector<std::shared_ptr<PendingSend>> _deferred;
+    /// @brief The sends waiting for their event on the network's queue to run.
+    std::vector<std::shared_ptr<PendingSend>> _scheduled;
+    /// @brief Guards the deferred and scheduled sends since mainLoop and the network's events can run on different threads.
+    std::string _deferredSemaphore;
+    /// @brief Shared with the events on the network's queue, which can outlive this.
+    std::shared_ptr<Owner> _owner;
+
+    /// @brief Copy the client's connection details so that they can be read from this one.
+    void syncWithClient();
+    /// @brief Try to get tokens for the send on the network's queue.
+    ErrorType schedule(std::shared_ptr<PendingSend> pending);
+    /// @brief Run by the network's queue. Paces the send if the client that queued it still exists.
+    static ErrorType paceIfOwned(std::shared_ptr<Owner> owner, std::shared_ptr<PendingSend> pending);
+    /// @brief Send if there are tokens, otherwise set the send aside until the shaper expects to have them.
+    ErrorType pace(std::shared_ptr<PendingSend> pending);
+    /// @brief Set the send aside until mainLoop finds that its retry time has come.
+    ErrorType defer(std::shared_ptr<PendingSend> pending);
+    /// @brief Stop tracking a send whose event has been taken off the network's queue.
+    ErrorType unschedule(const std::shared_ptr<PendingSend> &pending);
+    /// @brief True if the protocol is a byte stream that can be split up without changing the message.
+    bool isStream() const;
+};
+
+#endif // __SHAPED_IP_CLIENT_HPP__
@@ -0,0 +1,172 @@
+//AbstractionLayer
+#include "TrafficShaper.hpp"
+#include "OperatingSystemModule.hpp"
+//C++
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+std::atomic<int> TrafficShaper::semaphoreCount(0);
+
+TrafficShaper::TrafficShaper(const TrafficShaperSettings::Settings &settings) : _settings(settings) {
+    if (0 == _settings.burst) {
+        _settings.burst = _settings.rate;
+    }
+
+    _tokens = _settings.burst;
+    _lastRefill = Clock::now();
+    _intervalStart = _lastRefill;
+
+    const int instance = ++semaphoreCount;
+    _semaphore = std::string("trafficShaperSemaphore").append(std::to_string(instance));
+    ErrorType error = OperatingSystem::Instance().createSemaphore(1, 1, _semaphore);
+    assert(ErrorType::Success == error);
+}
+
+TrafficShaper::~TrafficShaper() {
+    OperatingSystem::Instance().deleteSemaphore(_semaphore);
+}
+
+ErrorType TrafficShaper::acquire(const Bytes bytes, const TrafficShaperSettings::Priority priority, const Milliseconds timeout) {
+    const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout);
+    Milliseconds retryIn = 0;
+    ErrorType error;
+
+    beginWaiting(priority);
+
+    while (ErrorType::NotAvailable == (error = tryAcquire(bytes, priority, retryIn))) {
+        const Clock::time_point now = Clock::now();
+        if (now >= deadline) {
+            error = ErrorType::Timeout;
+            break;
+        }
+
+        const Milliseconds remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - now).count();
+        OperatingSystem::Instance().delay(std::min({retryIn, remaining, MaxWaitPeriod}));
+    }
+
+    endWaiting(priority);
+
+    return error;
+}
+
+ErrorType TrafficShaper::tryAcquire(const Bytes bytes, const TrafficShaperSettings::Priority priority, Milliseconds &retryIn) {
+    ErrorType error = ErrorType::NotAvailable;
+    retryIn = 0;
+
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(_semaphore, SemaphoreTimeout)) {
+        return ErrorType::Timeout;
+    }
+
+    refill(Clock::now());
+
+    //Control traffic has to get through even when the budget is spent. Otherwise there's no way to tell anyone it's spent.
+    if (0 != _settings.budget && TrafficShaperSettings::Priority::Control != priority && _usage.total() + bytes > _settings.budget) {
+        error = ErrorType::LimitReached;
+    }
+    else if (0 == _settings.rate) {
+        error = ErrorType::Success;
+    }
+    else if (higherPriorityWaiting(priority)) {
+        retryIn = MaxWaitPeriod;
+    }
+    else {
+        //Anything bigger than the burst waits for a full bucket and then pays off the rest as debt.
+        const double needed = std::min<double>(bytes, _settings.burst);
+        if (_tokens >= needed) {
+            _tokens -= bytes;
+            error = ErrorType::Success;
+        }
+        else {
+            retryIn = std::max<Milliseconds>(1, static_cast<Milliseconds>(std::ceil((needed - _tokens) * 1000 / _settings.rate)));
+        }
+    }
+
+    if (ErrorType::Success == error) {
+        _usage.bytesSent[static_cast<size_t>(priority)] += bytes;
+    }
+
+    OperatingSystem::Instance().incrementSemaphore(_semaphore);
+
+    return error;
+}
+
+void TrafficShaper::beginWaiting(const TrafficShaperSettings::Priority priority) {
+    assert(priority < TrafficShaperSettings::Priority::Count);
+
+    _waiting[static_cast<size_t>(priority)]++;
+}
+
+void TrafficShaper::endWaiting(const TrafficShaperSettings::Priority priority) {
+    assert(priority < TrafficShaperSettings::Priority::Count);
+
+    assert(_waiting[static_cast<size_t>(priority)] > 0);
+    _waiting[static_cast<size_t>(priority)]--;
+}
+
+ErrorType TrafficShaper::recordReceived(const Bytes bytes) {
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(_semaphore, SemaphoreTimeout)) {
+        return ErrorType::Timeout;
+    }
+
+    refill(Clock::now());
+    _usage.bytesReceived += bytes;
+    OperatingSystem::Instance().incrementSemaphore(_semaphore);
+
+    return ErrorType::Success;
+}
+
+ErrorType TrafficShaper::usage(TrafficShaperSettings::Usage &usage) {
+    const Clock::time_point now = Clock::now();
+
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(_semaphore, SemaphoreTimeout)) {
+        return ErrorType::Timeout;
+    }
+
+    refill(now);
+    usage = _usage;
+    usage.intervalElapsed = std::chrono::duration_cast<std::chrono::seconds>(now - _intervalStart).count();
+    OperatingSystem::Instance().incrementSemaphore(_semaphore);
+
+    return ErrorType::Success;
+}
+
+ErrorType TrafficShaper::resetUsage(const uint64_t used) {
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(_semaphore, SemaphoreTimeout)) {
+        return ErrorType::Timeout;
+    }
+
+    _usage = TrafficShaperSettings::Usage();
+    _usage.bytesReceived = used;
+    _intervalStart = Clock::now();
+    OperatingSystem::Instance().incrementSemaphore(_semaphore);
+
+    return ErrorType::Success;
+}
+
+void TrafficShaper::refill(const Clock::time_point now) {
+    const std::chrono::duration<double> sinceRefill = now - _lastRefill;
+    _tokens = std::min<double>(_settings.burst, _tokens + sinceRefill.count() * _settings.rate);
+    _lastRefill = now;
+
+    if (0 != _settings.accountingInterval) {
+        const std::chrono::seconds interval(_settings.accountingInterval);
+        const auto intervalsElapsed = (now - _intervalStart) / interval;
+
+        if (intervalsElapsed > 0) {
+            //Stay lined up with the billing cycle instead of drifting by however late this was called.
+            _intervalStart += intervalsElapsed * interval;
+            _usage = TrafficShaperSettings::Usage();
+        }
+    }
+}
+
+bool TrafficShaper::higherPriorityWaiting(const TrafficShaperSettings::Priority priority) const {
+    for (size_t i = 0; i < static_cast<size_t>(priority); i++) {
+        if (0 != _waiting[i]) {
+            return true;
+        }
+    }
+
+    return false;
+}
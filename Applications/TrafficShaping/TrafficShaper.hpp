@@ -0,0 +1,193 @@
+/**************************************************************************//**
+* @author Ben Haubrich
+* @file   TrafficShaper.hpp
+* @details \b Synopsis: \n Token bucket rate limiting with priority classes and
+*          data budgets for metered links.
+* @ingroup Applications
+*******************************************************************************/
+#ifndef __TRAFFIC_SHAPER_HPP__
+#define __TRAFFIC_SHAPER_HPP__
+
+//AbstractionLayer
+#include "Error.hpp"
+#include "Types.hpp"
+//C++
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/**
+ * @namespace TrafficShaperSettings
+ * @brief Settings for the traffic shaper.
+*/
+namespace TrafficShaperSettings {
+
+    /**
+     * @enum Priority
+     * @brief The class of a sender. Senders of a lower class wait while a sender of a higher class is waiting.
+    */
+    enum class Priority : uint8_t {
+        Control = 0, ///< Commands, acknowledgements and keep alives. Exempt from the data budget.
+        Interactive, ///< Telemetry that someone is waiting on.
+        Bulk,        ///< Uploads that can happen whenever there's room.
+        Count        ///< The number of priorities.
+    };
+
+    /// @brief The number of priorities.
+    constexpr size_t Priorities = static_cast<size_t>(Priority::Count);
+
+    /**
+     * @struct Settings
+     * @brief Limits applied to everything sent through the shaper. Limits that are 0 are not applied.
+    */
+    struct Settings {
+        Bytes rate = 0;                     ///< The sustained rate in bytes per second.
+        Bytes burst = 0;                    ///< The most bytes that can be sent at once after being idle. Defaults to one second at the rate.
+        uint64_t budget = 0;                ///< The bytes sent and received that are allowed in each accounting interval.
+        Seconds accountingInterval = 0;     ///< How often the byte counts start over. 0 counts forever, or until resetUsage is called.
+    };
+
+    /**
+     * @struct Usage
+     * @brief The bytes counted in the current accounting interval.
+    */
+    struct Usage {
+        std::array<uint64_t, Priorities> bytesSent = {}; ///< The bytes sent by each priority.
+        uint64_t bytesReceived = 0;                      ///< The bytes received.
+        Seconds intervalElapsed = 0;                     ///< The time since the interval started.
+
+        /// @brief The bytes sent and received, which is what the carrier bills.
+        uint64_t total() const {
+            uint64_t sum = bytesReceived;
+            for (const uint64_t sent : bytesSent) {
+                sum += sent;
+            }
+            return sum;
+        }
+    };
+}
+
+/**
+ * @class TrafficShaper
+ * @brief Paces senders that share a link with a token bucket and counts the bytes that cross it.
+ * @details Tokens are added at the rate up to the burst and each byte sent takes one token. A send larger than the burst waits for
+ *          a full bucket and then goes into debt so that messages of any size can be sent while the average rate holds.
+ *
+ *          Senders announce that they are waiting with beginWaiting. While a sender of a higher priority is waiting, senders of
+ *          lower priorities are not given tokens, so a bulk upload steps aside as soon as control traffic shows up.
+ *
+ *          Every byte sent and received is counted against the budget of the current accounting interval. Once the budget is used
+ *          up only Control traffic is allowed until the interval starts over.
+ *
+ *          Thread safe. One shaper is normally shared by every connection on the link.
+ * @code
+ * TrafficShaperSettings::Settings settings;
+ * settings.rate = 2000;
+ * settings.budget = 500*1024*1024;
+ * settings.accountingInterval = 30*24*60*60;
+ * TrafficShaper shaper(settings);
+ *
+ * if (ErrorType::Success == shaper.acquire(data.size(), TrafficShaperSettings::Priority::Bulk, 1000)) {
+ *     ip.sendBlocking(data, 1000);
+ * }
+ * @endcode
+*/
+class TrafficShaper {
+
+    public:
+    /**
+     * @brief Constructor.
+     * @param[in] settings The limits to apply.
+    */
+    TrafficShaper(const TrafficShaperSettings::Settings &settings);
+    ~TrafficShaper();
+
+    /**
+     * @brief Wait for enough tokens to send.
+     * @param[in] bytes The number of bytes about to be sent.
+     * @param[in] priority The priority of the sender.
+     * @param[in] timeout The time to wait for tokens.
+     * @post The bytes are counted as sent if ErrorType::Success is returned.
+     * @returns ErrorType::Success if the bytes can be sent.
+     * @returns ErrorType::Timeout if there were not enough tokens in time or the shaper couldn't be locked.
+     * @returns ErrorType::LimitReached if sending would go over the budget.
+    */
+    ErrorType acquire(const Bytes bytes, const TrafficShaperSettings::Priority priority, const Milliseconds timeout);
+    /**
+     * @brief Take tokens if there are enough right now.
+     * @details Does not wait. Senders that can't wait, like events on a network's queue, call this until it succeeds and call
+     *          beginWaiting and endWaiting around the attempts themselves so that lower priorities hold off in the meantime.
+     * @param[in] bytes The number of bytes about to be sent.
+     * @param[in] priority The priority of the sender.
+     * @param[out] retryIn The time until there should be enough tokens if ErrorType::NotAvailable is returned.
+     * @post The bytes are counted as sent if ErrorType::Success is returned.
+     * @returns ErrorType::Success if the bytes can be sent.
+     * @returns ErrorType::NotAvailable if there are not enough tokens or a sender of a higher priority is waiting.
+     * @returns ErrorType::LimitReached if sending would go over the budget.
+     * @returns ErrorType::Timeout if the shaper couldn't be locked.
+    */
+    ErrorType tryAcquire(const Bytes bytes, const TrafficShaperSettings::Priority priority, Milliseconds &retryIn);
+    /// @brief Announce that a sender of this priority is waiting for tokens.
+    void beginWaiting(const TrafficShaperSettings::Priority priority);
+    /// @brief Announce that a sender of this priority has stopped waiting for tokens.
+    void endWaiting(const TrafficShaperSettings::Priority priority);
+
+    /**
+     * @brief Count received bytes against the budget.
+     * @param[in] bytes The number of bytes received.
+     * @returns ErrorType::Success if the bytes were counted.
+     * @returns ErrorType::Timeout if the shaper couldn't be locked.
+    */
+    ErrorType recordReceived(const Bytes bytes);
+    /**
+     * @brief Get the bytes counted in the current accounting interval.
+     * @param[out] usage The usage.
+     * @returns ErrorType::Success if the usage was read.
+     * @returns ErrorType::Timeout if the shaper couldn't be locked.
+    */
+    ErrorType usage(TrafficShaperSettings::Usage &usage);
+    /**
+     * @brief Start a new accounting interval now, for example on the first day of the billing cycle.
+     * @param[in] used Bytes already used in this interval, such as a count saved before a reboot. Counted as received.
+     * @returns ErrorType::Success if the interval was started.
+     * @returns ErrorType::Timeout if the shaper couldn't be locked.
+    */
+    ErrorType resetUsage(const uint64_t used = 0);
+
+    /// @brief Get the settings.
+    const TrafficShaperSettings::Settings &settingsConst() const { return _settings; }
+
+    private:
+    using Clock = std::chrono::steady_clock;
+
+    /// @brief The timeout for semaphore operations.
+    static constexpr Milliseconds SemaphoreTimeout = 1000;
+    /// @brief The longest a waiting sender sleeps before checking again. Short enough to notice a higher priority leaving.
+    static constexpr Milliseconds MaxWaitPeriod = 10;
+
+    /// @brief The limits to apply.
+    TrafficShaperSettings::Settings _settings;
+    /// @brief The tokens in the bucket. Negative while a large send is being paid off.
+    double _tokens;
+    /// @brief When tokens were last added.
+    Clock::time_point _lastRefill;
+    /// @brief When the current accounting interval started.
+    Clock::time_point _intervalStart;
+    /// @brief The bytes counted in the current accounting interval.
+    TrafficShaperSettings::Usage _usage;
+    /// @brief The number of senders waiting at each priority. Atomic so that a sender is never lost when the shaper is busy.
+    std::array<std::atomic<Count>, TrafficShaperSettings::Priorities> _waiting = {};
+    /// @brief Protects everything above except the senders waiting.
+    std::string _semaphore;
+    /// @brief Used to give each shaper's semaphore a unique name.
+    static std::atomic<int> semaphoreCount;
+
+    /// @brief Add the tokens earned since the last refill and start a new accounting interval if it's time.
+    void refill(const Clock::time_point now);
+    /// @brief True if a sender of a higher priority is waiting.
+    bool higherPriorityWaiting(const TrafficShaperSettings::Priority priority) const;
+};
+
+#endif // __TRAFFIC_SHAPER_HPP__
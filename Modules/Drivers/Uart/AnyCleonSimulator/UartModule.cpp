@@ -3,6 +3,25 @@
 //Modules
 #include "SerializationModule.hpp"
 #include "CyclicRedundancyCheckModule.hpp"
+//Applications
+#include "CleonFrameCodec.hpp"
+//C++
+#include <algorithm>
+#include <thread>
+
+Uart::Uart() : UartAbstraction(),
+    _generator(std::bind(&Uart::serializeDataReply, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3)),
+    _coalescer(*this, [this](const std::string &data) { return txBlocking(data, TransferTimeout); }) {
+    _dataReply.resize(sizeof(CF));
+
+    //The same reply as always when asked, with nothing unsolicited.
+    CleonLoadSettings::Profile profile;
+    profile.minFields = 21;
+    profile.maxFields = 21;
+    profile.values.distribution = CleonLoadSettings::Distribution::Constant;
+    profile.values.first = 0.0f;
+    setLoadProfile(profile);
+}
 
 ErrorType Uart::init() {
     return ErrorType::Success;
@@ -13,46 +32,103 @@ ErrorType Uart::deinit() {
 }
 
 ErrorType Uart::txBlocking(const std::string &data, const Milliseconds timeout) {
-    const uint8_t apiCall = data.at(0);
-    uint8_t qref = data.at(1);
+    //Replies queue up behind anything that hasn't been received yet.
+    receiveUnsolicited();
 
-    _uartBufferBytesRead = 0;
+    //Coalesced writes carry several requests: api call, qref, 16 bit little endian length, payload, CRC32.
+    Bytes offset = 0;
+    do {
+        const std::string_view request = std::string_view(data).substr(offset);
+        if (request.size() < 2) {
+            return ErrorType::InvalidParameter;
+        }
 
-    switch (apiCall) {
-        case 0xFC:
-            if (ErrorType::Success != cleonToFoundationDataReply(qref)) {
-                return ErrorType::Failure;
-            }
-            break;
-        case 0xF0:
-            if (ErrorType::Success != cleonToFoundationAcknowledge(qref)) {
-                return ErrorType::Failure;
-            }
+        const uint8_t apiCall = request.at(0);
+        uint8_t qref = request.at(1);
+
+        switch (apiCall) {
+            case 0xFC:
+                if (ErrorType::Success != cleonToFoundationDataReply(qref)) {
+                    return ErrorType::Failure;
+                }
+                break;
+            case 0xF0:
+                if (ErrorType::Success != cleonToFoundationAcknowledge(qref)) {
+                    return ErrorType::Failure;
+                }
+                break;
+            default:
+                return ErrorType::NotSupported;
+        }
+
+        //A request too short to have a length is the only one.
+        if (request.size() < CleonFrameSettings::HeaderSize) {
             break;
-        default:
-            return ErrorType::NotSupported;
-    }
+        }
+
+        const Bytes length = static_cast<uint8_t>(request[2]) | (static_cast<uint8_t>(request[3]) << 8);
+        offset += CleonFrameSettings::HeaderSize + length + CleonFrameSettings::TrailerSize;
+    } while (offset < data.size());
 
     return ErrorType::Success;
 }
 
 ErrorType Uart::txNonBlocking(const std::shared_ptr<std::string> data, std::function<void(const ErrorType error, const Bytes bytesWritten)> callback) {
-    return ErrorType::NotImplemented;
+    return _coalescer.write(data, callback, transmitBufferSize());
 }
 
 ErrorType Uart::rxBlocking(std::string &buffer, const Milliseconds timeout) {
-    buffer.assign(_uartBuffer.substr(_uartBufferBytesRead, buffer.size()));
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+
+    receiveUnsolicited();
+    //Wait for the next unsolicited frames if there's nothing to receive and they'll arrive in time.
+    while (_uartBufferBytesRead == _uartBuffer.size()) {
+        const std::chrono::microseconds due = _generator.nextFrameDue();
+        if (std::chrono::microseconds::max() == due || _loadStart + due > deadline) {
+            break;
+        }
+
+        std::this_thread::sleep_until(_loadStart + due);
+        receiveUnsolicited();
+    }
+
+    buffer.assign(_uartBuffer, _uartBufferBytesRead, buffer.size());
     _uartBufferBytesRead += buffer.size();
 
     return ErrorType::Success;
 }
 
 ErrorType Uart::rxNonBlocking(std::shared_ptr<std::string> buffer, std::function<void(const ErrorType error, std::shared_ptr<std::string> buffer)> callback) {
-    return ErrorType::NotImplemented;
+    if (nullptr == buffer.get()) {
+        return ErrorType::InvalidParameter;
+    }
+
+    auto rx = [this, callback](std::shared_ptr<std::string> buffer) -> ErrorType {
+        const ErrorType error = rxBlocking(*buffer, TransferTimeout);
+
+        if (nullptr != callback) {
+            callback(error, buffer);
+        }
+
+        return error;
+    };
+
+    //Requests made after this must not be answered before it.
+    const ErrorType error = _coalescer.interrupt();
+    if (ErrorType::Success != error) {
+        return error;
+    }
+
+    std::unique_ptr<EventAbstraction> event = std::make_unique<EventQueue::Event<Uart>>(std::bind(rx, buffer));
+    return addEvent(event);
 }
 
 ErrorType Uart::flushRxBuffer() {
-    return ErrorType::NotAvailable;
+    receiveUnsolicited();
+    _uartBuffer.clear();
+    _uartBufferBytesRead = 0;
+
+    return ErrorType::Success;
 }
 
 ErrorType Uart::setHardwareConfig(int32_t txPinNumber, int32_t rxPinNumber, int32_t rtsPinNumber, int32_t ctsPinNumber, UartConfig::PeripheralNumber peripheralNumber) {
@@ -71,32 +147,53 @@ ErrorType Uart::setFirmwareConfig(Bytes receiveBufferSize, Bytes transmitBufferS
     return ErrorType::Success;
 }
 
+ErrorType Uart::setLoadProfile(const CleonLoadSettings::Profile &profile) {
+    if (profile.maxFields > MaxFields - FixedFields) {
+        return ErrorType::InvalidParameter;
+    }
+
+    const ErrorType error = _generator.setProfile(profile);
+    if (ErrorType::Success == error) {
+        _loadStart = std::chrono::steady_clock::now();
+    }
+
+    return error;
+}
+
 ErrorType Uart::cleonToFoundationDataReply(uint8_t qref) {
+    return _generator.frame(qref, _uartBuffer);
+}
+
+ErrorType Uart::cleonToFoundationAcknowledge(uint8_t qref) {
+    std::string acknowledge;
+    acknowledge.push_back(0x41);
+    acknowledge.push_back(qref);
+    acknowledge.push_back(0x1);
+    acknowledge.push_back(0x0);
+    acknowledge.push_back(0xF0);
+
+    uint32_t crcValue;
+    Crc::crc32LittleEndian(0xFFFFFFFF, acknowledge, crcValue);
+    for (Bytes i = 0; i < sizeof(crcValue); i++) {
+        acknowledge.push_back((uint8_t)((crcValue & (0xFF << 8*i)) >> 8*i));
+    }
+
+    _uartBuffer.append(acknowledge);
+    return ErrorType::Success;
+}
+
+ErrorType Uart::serializeDataReply(const Id messageRef, const std::vector<CleonLoadSettings::Field> &fields, std::string &payload) {
     Serializer serializer;
     Bytes maxSize;
     serializer.maxSerializedSize(maxSize, SerializationType::CleonToFoundationDataReply);
-    std::string serializedDataReply(maxSize, 0);
+    payload.resize(maxSize);
 
-    _uartBuffer = std::string(_uartBuffer.capacity(), 0);
-    CF *cleonDataReply = reinterpret_cast<CF*>(_uartBuffer.data());
+    std::fill(_dataReply.begin(), _dataReply.end(), 0);
+    CF *cleonDataReply = reinterpret_cast<CF*>(_dataReply.data());
 
     cleonDataReply->has_data1 = true;
     cleonDataReply->data1.fields_count = 0;
 
-    constexpr int messageRef = 280;
-    cleonDataReply->data1.fields[2].has_field_id = true;
-    cleonDataReply->data1.fields[2].field_id = messageRef;
-    cleonDataReply->data1.fields[2].has_uint_value = true;
-    cleonDataReply->data1.fields[2].uint_value = _messageRef++;
-    cleonDataReply->data1.fields_count++;
-
-    constexpr int timeSinceCreation = 300;
-    cleonDataReply->data1.fields[3].has_field_id = true;
-    cleonDataReply->data1.fields[3].field_id = timeSinceCreation;
-    cleonDataReply->data1.fields[3].has_uint_value = true;
-    cleonDataReply->data1.fields[3].uint_value = Seconds(1);
-    cleonDataReply->data1.fields_count++;
-
     constexpr int bitfieldStatuses1 = 0;
     cleonDataReply->data1.fields[0].has_field_id = true;
     cleonDataReply->data1.fields[0].field_id = bitfieldStatuses1;
@@ -108,52 +205,56 @@ ErrorType Uart::cleonToFoundationDataReply(uint8_t qref) {
     cleonDataReply->data1.fields[1].field_id = bitfieldStatuses2;
     cleonDataReply->data1.fields[1].has_uint_value = true;
     cleonDataReply->data1.fields_count++;
-    
-    {
-    int fieldId = 30;
-    for (int i = 4; i < 25; i++) {
-        cleonDataReply->data1.fields[i].has_field_id = true;
-        cleonDataReply->data1.fields[i].field_id = fieldId;
-        cleonDataReply->data1.fields[i].has_float_value = true;
-        fieldId += 10;
-        cleonDataReply->data1.fields_count++;
-    }
-    }
 
-    if (ErrorType::Success != serializer.serialize(_uartBuffer, serializedDataReply, SerializationType::CleonToFoundationDataReply)) {
-        return ErrorType::Failure;
-    }
+    constexpr int messageRefId = 280;
+    cleonDataReply->data1.fields[2].has_field_id = true;
+    cleonDataReply->data1.fields[2].field_id = messageRefId;
+    cleonDataReply->data1.fields[2].has_uint_value = true;
+    cleonDataReply->data1.fields[2].uint_value = messageRef;
+    cleonDataReply->data1.fields_count++;
 
-    std::string header(4,0);
-    header.at(0) = 0xCF;
-    header.at(1) = qref;
-    header.at(2) = serializedDataReply.size() & 0x00FF;
-    header.at(3) = (serializedDataReply.size() & 0xFF00) >> 8;
-    _uartBuffer.assign(header);
+    constexpr int timeSinceCreation = 300;
+    cleonDataReply->data1.fields[3].has_field_id = true;
+    cleonDataReply->data1.fields[3].field_id = timeSinceCreation;
+    cleonDataReply->data1.fields[3].has_uint_value = true;
+    cleonDataReply->data1.fields[3].uint_value = Seconds(1);
+    cleonDataReply->data1.fields_count++;
 
-    _uartBuffer.append(serializedDataReply);
+    for (Count i = 0; i < fields.size() && FixedFields + i < MaxFields; i++) {
+        auto &field = cleonDataReply->data1.fields[FixedFields + i];
+        field.has_field_id = true;
+        field.field_id = fields[i].id;
+        field.has_float_value = true;
+        field.float_value = fields[i].value;
+        cleonDataReply->data1.fields_count++;
+    }
 
-    uint32_t crcValue;
-    Crc::crc32LittleEndian(0xFFFFFFFF, _uartBuffer, crcValue);
-    for (Bytes i = 0; i < sizeof(crcValue); i++) {
-        _uartBuffer.push_back((uint8_t)((crcValue & (0xFF << 8*i)) >> 8*i));
+    if (ErrorType::Success != serializer.serialize(_dataReply, payload, SerializationType::CleonToFoundationDataReply)) {
+        return ErrorType::Failure;
     }
 
     return ErrorType::Success;
 }
 
-ErrorType Uart::cleonToFoundationAcknowledge(uint8_t qref) {
-    _uartBuffer.push_back(0x41);
-    _uartBuffer.push_back(qref);
-    _uartBuffer.push_back(0x1);
-    _uartBuffer.push_back(0x0);
-    _uartBuffer.push_back(0xF0);
+void Uart::receiveUnsolicited() {
+    //Drop what has been received once it's at least half the buffer so the buffer doesn't grow with the total.
+    if (_uartBufferBytesRead > 0 && _uartBufferBytesRead >= _uartBuffer.size() / 2) {
+        _uartBuffer.erase(0, _uartBufferBytesRead);
+        _uartBufferBytesRead = 0;
+    }
 
-    uint32_t crcValue;
-    Crc::crc32LittleEndian(0xFFFFFFFF, _uartBuffer, crcValue);
-    for (Bytes i = 0; i < sizeof(crcValue); i++) {
-        _uartBuffer.push_back((uint8_t)((crcValue & (0xFF << 8*i)) >> 8*i));
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _loadStart);
+    if (_generator.nextFrameDue() > elapsed) {
+        return;
     }
 
-    return ErrorType::Success;
-}
\ No newline at end of file
+    _unsolicited.clear();
+    _generator.generate(elapsed, _unsolicited);
+
+    const Bytes unread = _uartBuffer.size() - _uartBufferBytesRead;
+    const Bytes room = 0 == _receiveBufferSize ? _unsolicited.size() : _receiveBufferSize - std::min(unread, _receiveBufferSize);
+    const Bytes received = std::min<Bytes>(room, _unsolicited.size());
+
+    _uartBuffer.append(_unsolicited, 0, received);
+    _overrunBytes += _unsolicited.size() - received;
+}
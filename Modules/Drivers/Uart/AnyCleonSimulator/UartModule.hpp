@@ -3,22 +3,42 @@
 
 //AbstractionLayer
 #include "UartAbstraction.hpp"
+//Applications
+#include "CleonLoadGenerator.hpp"
+#include "WriteCoalescer.hpp"
 //Protobuf
 #include "api_fc.pb.h"
 #include "api_cf.pb.h"
 #include "apiF0tx.pb.h"
+//C++
+#include <chrono>
 
 class Uart : public UartAbstraction {
     public:
-    Uart() : UartAbstraction() {
-        _uartBuffer.reserve(sizeof(CF));
-    }
+    Uart();
     ~Uart() = default;
     ErrorType init() override;
     ErrorType deinit() override;
+    /**
+     * @brief Answer the requests in the data. There can be more than one when writes are coalesced.
+     * @returns ErrorType::Success if every request was answered.
+     * @returns ErrorType::NotSupported if a request is not a data request (0xFC) or sync request (0xF0). Requests before it are answered.
+     * @returns ErrorType::InvalidParameter if a request is too short to hold an api call and qref.
+    */
     ErrorType txBlocking(const std::string &data, const Milliseconds timeout) override;
     ErrorType rxBlocking(std::string &buffer, const Milliseconds timeout) override;
+    /**
+     * @brief Send requests from the event queue. Run it with runNextEvent.
+     * @details Requests made before the last one is run are sent with it, up to the transmit buffer size if one is set.
+     * @sa WriteCoalescer
+    */
     ErrorType txNonBlocking(const std::shared_ptr<std::string> data, std::function<void(const ErrorType error, const Bytes bytesWritten)> callback = nullptr) override;
+    /**
+     * @brief Receive from the event queue. Run it with runNextEvent.
+     * @returns ErrorType::Success if the receive was queued.
+     * @returns ErrorType::Timeout if the writes queued before it couldn't be kept from being added to in time.
+     * @returns The error of EventQueue::addEvent otherwise.
+    */
     ErrorType rxNonBlocking(std::shared_ptr<std::string> buffer, std::function<void(const ErrorType error, std::shared_ptr<std::string> buffer)> callback = nullptr) override;
     ErrorType flushRxBuffer() override;
 
@@ -26,13 +46,51 @@ class Uart : public UartAbstraction {
     ErrorType setDriverConfig(uint32_t baudRate, uint8_t dataBits, char parity, uint8_t stopBits, UartConfig::FlowControl flowControl) override;
     ErrorType setFirmwareConfig(Bytes receiveBufferSize, Bytes transmitBufferSize, int8_t terminatingByte) override;
 
+    /// @brief The fields that every data reply has before the ones chosen by the load profile.
+    static constexpr Count FixedFields = 4;
+    /// @brief The most fields that a data reply can hold.
+    static constexpr Count MaxFields = sizeof(CF::data1.fields) / sizeof(CF::data1.fields[0]);
+
+    /**
+     * @brief Send data replies without being asked, in addition to the ones sent in reply to requests.
+     * @details The default profile sends nothing unsolicited and replies with 21 float fields of 0 after the fixed ones.
+     *          Unsolicited frames that arrive while nobody is receiving are kept up to the receive buffer size set by setFirmwareConfig,
+     *          after which they are lost like they would be on a real UART that overruns.
+     * @param[in] profile The load to generate.
+     * @returns ErrorType::Success if the profile was set.
+     * @returns ErrorType::InvalidParameter if the profile is not valid or a frame would have more than MaxFields - FixedFields fields.
+     * @sa CleonLoadGenerator::setProfile
+    */
+    ErrorType setLoadProfile(const CleonLoadSettings::Profile &profile);
+    /// @brief Get what the simulator has sent as a constant reference
+    const CleonLoadSettings::Statistics &loadStatisticsConst() const { return _generator.statisticsConst(); }
+    /// @brief The number of bytes lost because they arrived while the receive buffer was full.
+    Bytes overrunBytes() const { return _overrunBytes; }
+
     private:
+    /// @brief The timeout given to the blocking calls made from the event queue.
+    static constexpr Milliseconds TransferTimeout = 1000;
+
     std::string _uartBuffer;
     Bytes _uartBufferBytesRead = 0;
-    Id _messageRef = 0;
+    /// @brief Generates the data replies and the unsolicited frames.
+    CleonLoadGenerator _generator;
+    /// @brief When the load profile was set.
+    std::chrono::steady_clock::time_point _loadStart;
+    /// @brief Bytes lost because the receive buffer was full.
+    Bytes _overrunBytes = 0;
+    /// @brief Reused to build each data reply before it is serialized.
+    std::string _dataReply;
+    /// @brief Reused for the unsolicited frames before they are added to the receive buffer.
+    std::string _unsolicited;
+    /// @brief Combines the requests that are waiting in the event queue.
+    WriteCoalescer _coalescer;
 
     ErrorType cleonToFoundationDataReply(uint8_t qref);
     ErrorType cleonToFoundationAcknowledge(uint8_t qref);
+    ErrorType serializeDataReply(const Id messageRef, const std::vector<CleonLoadSettings::Field> &fields, std::string &payload);
+    /// @brief Add the unsolicited frames that have arrived since the last time to the receive buffer.
+    void receiveUnsolicited();
 };
 
-#endif // __CBT_UART_HPP__
\ No newline at end of file
+#endif // __CBT_UART_HPP__
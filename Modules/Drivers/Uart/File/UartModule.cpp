@@ -67,56 +67,103 @@ ErrorType Uart::txBlocking(const std::string &data, const Milliseconds timeout)
 }
 
 ErrorType Uart::txNonBlocking(const std::shared_ptr<std::string> data, std::function<void(const ErrorType error, const Bytes bytesWritten)> callback) {
-    return ErrorType::NotImplemented;
+    return _coalescer.write(data, callback, transmitBufferSize());
 }
 
 ErrorType Uart::rxBlocking(std::string &buffer, const Milliseconds timeout) {
-    ErrorType error;
-    constexpr Bytes toReadAtOnce = 16;
-    Bytes readInThisFrame = 0;
-    std::string readBuffer(toReadAtOnce, '\0');
-
-    if (terminatingByte() >= 0) {
-        buffer.resize(0);
-    }
-    else {
-        ErrorType error = rxBuffer->readBlocking(_totalRead, buffer);
-        _totalRead += buffer.size();
-        return error;
+    if (nullptr == rxBuffer.get()) {
+        return ErrorType::PrerequisitesNotMet;
     }
 
-    bool bufferHasRoom = readInThisFrame < buffer.capacity();
+    const Bytes size = buffer.size();
+    const bool terminated = terminatingByte() >= 0;
+    ErrorType error = ErrorType::Success;
 
-    while (bufferHasRoom) {
-        error = rxBuffer->readBlocking(_totalRead, readBuffer);
-        if (ErrorType::EndOfFile == error) {
+    //Read in bulk and search what has been read, picking up where the last search stopped.
+    while (true) {
+        if (terminated) {
+            const size_t found = _received.find(static_cast<char>(terminatingByte()), _scanned);
+
+            if (std::string_view::npos != found && found < size) {
+                take(buffer, found + 1);
+                return ErrorType::Success;
+            }
+            else if (_received.size() >= size) {
+                take(buffer, size);
+                return ErrorType::LimitReached;
+            }
+
+            _scanned = _received.size();
+        }
+        else if (_received.size() >= size) {
+            take(buffer, size);
             return ErrorType::Success;
         }
 
-        _totalRead += readBuffer.size();
-        readInThisFrame += readBuffer.size();
+        if (ErrorType::EndOfFile == error) {
+            break;
+        }
 
-        buffer.append(readBuffer);
+        error = fill();
+        if (ErrorType::Success != error && ErrorType::EndOfFile != error) {
+            return error;
+        }
+    }
 
-        if (terminatingByte() >= 0) {
-            const size_t indexOfTerminatingByte = buffer.find(static_cast<char>(terminatingByte()), readInThisFrame - readBuffer.capacity());
-            const bool terminatingByteFound = std::string::npos != indexOfTerminatingByte;
+    const bool nothingLeft = _received.empty();
+    take(buffer, _received.size());
 
-            if (terminatingByteFound) {
-                buffer.resize(indexOfTerminatingByte + 1);
-                _totalRead = indexOfTerminatingByte + 1;
-                return ErrorType::Success;
-            }
+    return terminated && !nothingLeft ? ErrorType::Success : ErrorType::EndOfFile;
+}
+
+ErrorType Uart::rxNonBlocking(std::shared_ptr<std::string> buffer, std::function<void(const ErrorType error, std::shared_ptr<std::string> buffer)> callback) {
+    if (nullptr == buffer.get()) {
+        return ErrorType::InvalidParameter;
+    }
+
+    auto rx = [this, callback](std::shared_ptr<std::string> buffer) -> ErrorType {
+        const ErrorType error = rxBlocking(*buffer, TransferTimeout);
+
+        if (nullptr != callback) {
+            callback(error, buffer);
         }
 
-        bufferHasRoom = readInThisFrame < buffer.capacity();
+        return error;
+    };
+
+    //Writes made after this one must not be written before it.
+    const ErrorType error = _coalescer.interrupt();
+    if (ErrorType::Success != error) {
+        return error;
     }
 
-    return error;
+    std::unique_ptr<EventAbstraction> event = std::make_unique<EventQueue::Event<Uart>>(std::bind(rx, buffer));
+    return addEvent(event);
 }
 
-ErrorType Uart::rxNonBlocking(std::shared_ptr<std::string> buffer, std::function<void(const ErrorType error, std::shared_ptr<std::string> buffer)> callback) {
-    return ErrorType::NotImplemented;
+ErrorType Uart::fill() {
+    _chunk.resize(ReadChunkSize);
+
+    ErrorType error = rxBuffer->readBlocking(_totalRead, _chunk);
+    if (ErrorType::Success != error && ErrorType::EndOfFile != error) {
+        return error;
+    }
+
+    _totalRead += _chunk.size();
+
+    error = _received.write(_chunk);
+    if (ErrorType::Success != error) {
+        return error;
+    }
+
+    //A short read is the end of the file, for now. More may have been written to it by the next receive.
+    return _chunk.size() < ReadChunkSize ? ErrorType::EndOfFile : ErrorType::Success;
+}
+
+void Uart::take(std::string &buffer, const Bytes bytes) {
+    buffer.assign(_received.contiguous().substr(0, bytes));
+    _received.consume(bytes);
+    _scanned = 0;
 }
 
 ErrorType Uart::flushRxBuffer() {
@@ -6,18 +6,45 @@
 //Modules
 #include "StorageModule.hpp"
 #include "FileModule.hpp"
+//Applications
+#include "RingBuffer.hpp"
+#include "WriteCoalescer.hpp"
 
 class Uart : public UartAbstraction {
 
     public:
-    Uart() : UartAbstraction() {}
+    Uart() : UartAbstraction(), _coalescer(*this, [this](const std::string &data) { return txBlocking(data, TransferTimeout); }) {}
     ~Uart() = default;
 
     ErrorType init() override;
     ErrorType deinit() override;
     ErrorType txBlocking(const std::string &data, const Milliseconds timeout) override;
+    /**
+     * @brief Receive from the receive file.
+     * @details Without a terminating byte the buffer is filled. With one, bytes are received up to and including it and the rest are
+     *          kept for the next receive.
+     * @returns ErrorType::Success if the bytes were received. Also if the end of the file was reached before the terminating byte, in
+     *          which case whatever was left is received.
+     * @returns ErrorType::EndOfFile if the end of the file was reached before the buffer was filled, or there was nothing left.
+     * @returns ErrorType::LimitReached if the buffer was filled before the terminating byte was found.
+     * @sa UartAbstraction::rxBlocking
+    */
     ErrorType rxBlocking(std::string &buffer, const Milliseconds timeout) override;
+    /**
+     * @brief Transmit from the event queue. Run it with runNextEvent.
+     * @details Writes made before the last one is run are written with it, up to the transmit buffer size if one is set, and end with the
+     *          same newline.
+     * @sa UartAbstraction::txNonBlocking
+     * @sa WriteCoalescer
+    */
     ErrorType txNonBlocking(const std::shared_ptr<std::string> data, std::function<void(const ErrorType error, const Bytes bytesWritten)> callback = nullptr) override;
+    /**
+     * @brief Receive from the event queue. Run it with runNextEvent.
+     * @returns ErrorType::Success if the receive was queued.
+     * @returns ErrorType::Timeout if the writes queued before it couldn't be kept from being added to in time.
+     * @returns The error of EventQueue::addEvent otherwise.
+     * @sa UartAbstraction::rxNonBlocking
+    */
     ErrorType rxNonBlocking(std::shared_ptr<std::string> buffer, std::function<void(const ErrorType error, std::shared_ptr<std::string> buffer)> callback = nullptr) override;
     ErrorType flushRxBuffer() override;
 
@@ -26,11 +53,33 @@ class Uart : public UartAbstraction {
     ErrorType setFirmwareConfig(Bytes receiveBufferSize, Bytes transmitBufferSize, int8_t terminatingByte) override;
 
     private:
+    /// @brief The most read from the receive file at once.
+    static constexpr Bytes ReadChunkSize = 4096;
+    /// @brief The timeout given to the blocking calls made from the event queue.
+    static constexpr Milliseconds TransferTimeout = 1000;
+
     std::unique_ptr<File> txBuffer;
     std::unique_ptr<File> rxBuffer;
 
     //The total number of bytes read so far from the file.
     Bytes _totalRead = 0;
+    //Bytes read from the file that haven't been received yet.
+    RingBuffer _received;
+    //The number of bytes at the front of _received that have been searched for the terminating byte.
+    Bytes _scanned = 0;
+    //Reused for every read from the file so that reading doesn't allocate.
+    std::string _chunk;
+    //Combines the writes that are waiting in the event queue.
+    WriteCoalescer _coalescer;
+
+    /**
+     * @brief Read the next chunk of the receive file into the ring buffer.
+     * @returns ErrorType::Success if a whole chunk was read.
+     * @returns ErrorType::EndOfFile if the end of the file was reached.
+    */
+    ErrorType fill();
+    /// @brief Move bytes from the front of the ring buffer to the receive buffer.
+    void take(std::string &buffer, const Bytes bytes);
 };
 
 #endif // __UART_MODULE_HPP__
\ No newline at end of file
@@ -0,0 +1,510 @@
+//Modules
+#include "UartModule.hpp"
+//Posix
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <unistd.h>
+//C++
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+Uart::~Uart() {
+    deinit();
+}
+
+ErrorType Uart::init() {
+    if (-1 != _fd) {
+        return ErrorType::PrerequisitesNotMet;
+    }
+
+    if (_device.empty()) {
+        if (UartConfig::PeripheralNumber::Unknown == peripheralNumber()) {
+            return ErrorType::InvalidParameter;
+        }
+
+        _device = "/dev/ttyS" + std::to_string(static_cast<uint8_t>(peripheralNumber()));
+    }
+
+    //No controlling terminal so that the device can't send signals to the process.
+    _fd = open(_device.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (-1 == _fd) {
+        return toPlatformError(errno);
+    }
+
+    ErrorType error = applyDriverConfig();
+    if (ErrorType::Success != error) {
+        deinit();
+        return error;
+    }
+
+    _epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (-1 == _epoll) {
+        error = toPlatformError(errno);
+        deinit();
+        return error;
+    }
+
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = _fd;
+    if (-1 == epoll_ctl(_epoll, EPOLL_CTL_ADD, _fd, &event)) {
+        error = toPlatformError(errno);
+        deinit();
+        return error;
+    }
+
+    _received.clear();
+    _scanned = 0;
+
+    return ErrorType::Success;
+}
+
+ErrorType Uart::deinit() {
+    if (-1 != _epoll) {
+        close(_epoll);
+        _epoll = -1;
+    }
+
+    if (-1 != _fd) {
+        close(_fd);
+        _fd = -1;
+    }
+
+    return ErrorType::Success;
+}
+
+ErrorType Uart::txBlocking(const std::string &data, const Milliseconds timeout) {
+    if (-1 == _fd) {
+        return ErrorType::PrerequisitesNotMet;
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+    Bytes written = 0;
+
+    while (written < data.size()) {
+        const ssize_t result = write(_fd, data.data() + written, data.size() - written);
+
+        if (result > 0) {
+            written += result;
+            continue;
+        }
+        else if (-1 == result && EINTR == errno) {
+            continue;
+        }
+        else if (-1 == result && EAGAIN != errno) {
+            return toPlatformError(errno);
+        }
+
+        //The kernel's transmit buffer is full. Wait for the device to drain some of it.
+        const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0) {
+            return ErrorType::Timeout;
+        }
+
+        ErrorType error = wait(EPOLLOUT, remaining);
+        if (ErrorType::Success != error) {
+            return error;
+        }
+    }
+
+    return ErrorType::Success;
+}
+
+ErrorType Uart::txNonBlocking(const std::shared_ptr<std::string> data, std::function<void(const ErrorType error, const Bytes bytesWritten)> callback) {
+    return _coalescer.write(data, callback, transmitBufferSize());
+}
+
+ErrorType Uart::rxBlocking(std::string &buffer, const Milliseconds timeout) {
+    if (-1 == _fd) {
+        return ErrorType::PrerequisitesNotMet;
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+    const Bytes size = buffer.size();
+    const bool terminated = terminatingByte() >= 0;
+
+    //Whatever the kernel already has is taken now so that it is only waited on when there really is nothing.
+    fill();
+
+    while (true) {
+        if (!_received.empty()) {
+            const std::string_view received = _received.contiguous();
+
+            if (!terminated) {
+                const Bytes bytes = std::min<Bytes>(size, received.size());
+                buffer.assign(received.data(), bytes);
+                _received.consume(bytes);
+                _scanned = 0;
+                return ErrorType::Success;
+            }
+
+            const Bytes searchable = std::min<Bytes>(size, received.size());
+            const void *found = nullptr;
+            if (_scanned < searchable) {
+                found = memchr(received.data() + _scanned, static_cast<char>(terminatingByte()), searchable - _scanned);
+            }
+
+            if (nullptr != found) {
+                const Bytes bytes = static_cast<const char *>(found) - received.data() + 1;
+                buffer.assign(received.data(), bytes);
+                _received.consume(bytes);
+                _scanned = 0;
+                return ErrorType::Success;
+            }
+            else if (searchable == size) {
+                //No room left in the buffer for the terminating byte.
+                buffer.assign(received.data(), size);
+                _received.consume(size);
+                _scanned = 0;
+                return ErrorType::LimitReached;
+            }
+
+            _scanned = searchable;
+        }
+
+        const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0) {
+            buffer.resize(0);
+            return ErrorType::Timeout;
+        }
+
+        ErrorType error = wait(EPOLLIN, remaining);
+        if (ErrorType::Success != error) {
+            buffer.resize(0);
+            return error;
+        }
+
+        error = fill();
+        if (ErrorType::Success != error && ErrorType::NoData != error) {
+            buffer.resize(0);
+            return error;
+        }
+    }
+}
+
+ErrorType Uart::rxBlockingInto(std::span<char> buffer, Bytes &bytesReceived, const Milliseconds timeout) {
+    bytesReceived = 0;
+
+    if (terminatingByte() >= 0) {
+        return UartAbstraction::rxBlockingInto(buffer, bytesReceived, timeout);
+    }
+    else if (-1 == _fd) {
+        return ErrorType::PrerequisitesNotMet;
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+
+    while (true) {
+        //Whatever was read ahead goes first.
+        if (!_received.empty()) {
+            const std::string_view received = _received.contiguous();
+            bytesReceived = std::min<Bytes>(buffer.size(), received.size());
+            std::copy_n(received.data(), bytesReceived, buffer.data());
+            _received.consume(bytesReceived);
+            return ErrorType::Success;
+        }
+
+        const ssize_t bytesRead = read(_fd, buffer.data(), buffer.size());
+        if (bytesRead > 0) {
+            bytesReceived = bytesRead;
+            return ErrorType::Success;
+        }
+        else if (-1 == bytesRead && EINTR == errno) {
+            continue;
+        }
+        else if ((-1 == bytesRead && EIO == errno) || (0 == bytesRead && hungUp())) {
+            return ErrorType::EndOfFile;
+        }
+
+        const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0) {
+            return ErrorType::Timeout;
+        }
+
+        const ErrorType error = wait(EPOLLIN, remaining);
+        if (ErrorType::Success != error) {
+            return error;
+        }
+    }
+}
+
+ErrorType Uart::rxNonBlocking(std::shared_ptr<std::string> buffer, std::function<void(const ErrorType error, std::shared_ptr<std::string> buffer)> callback) {
+    if (nullptr == buffer.get()) {
+        return ErrorType::InvalidParameter;
+    }
+
+    auto rx = [this, callback](std::shared_ptr<std::string> buffer) -> ErrorType {
+        const ErrorType error = rxBlocking(*buffer, TransferTimeout);
+
+        if (nullptr != callback) {
+            callback(error, buffer);
+        }
+
+        return error;
+    };
+
+    //Writes made after this one must not be sent before it.
+    const ErrorType error = _coalescer.interrupt();
+    if (ErrorType::Success != error) {
+        return error;
+    }
+
+    std::unique_ptr<EventAbstraction> event = std::make_unique<EventQueue::Event<Uart>>(std::bind(rx, buffer));
+    return addEvent(event);
+}
+
+ErrorType Uart::flushRxBuffer() {
+    if (-1 == _fd) {
+        return ErrorType::PrerequisitesNotMet;
+    }
+
+    if (-1 == tcflush(_fd, TCIFLUSH)) {
+        return toPlatformError(errno);
+    }
+
+    _received.clear();
+    _scanned = 0;
+
+    return ErrorType::Success;
+}
+
+ErrorType Uart::setHardwareConfig(int32_t txNumber, int32_t rxNumber, int32_t rtsNumber, int32_t ctsNumber, UartConfig::PeripheralNumber peripheralNumber) {
+    _txNumber = txNumber;
+    _rxNumber = rxNumber;
+    _rtsNumber = rtsNumber;
+    _ctsNumber = ctsNumber;
+    _peripheralNumber = peripheralNumber;
+
+    return ErrorType::Success;
+}
+
+ErrorType Uart::setDriverConfig(uint32_t baudRate, uint8_t dataBits, char parity, uint8_t stopBits, UartConfig::FlowControl flowControl) {
+    const bool validBaudRate = B0 != toSpeed(baudRate);
+    const bool validDataBits = dataBits >= 5 && dataBits <= 8;
+    const bool validParity = 'N' == parity || 'E' == parity || 'O' == parity;
+    const bool validStopBits = 1 == stopBits || 2 == stopBits;
+    const bool validFlowControl = UartConfig::FlowControl::Disable == flowControl || UartConfig::FlowControl::CtsRts == flowControl;
+
+    if (!validBaudRate || !validDataBits || !validParity || !validStopBits || !validFlowControl) {
+        return ErrorType::InvalidParameter;
+    }
+
+    _baudRate = baudRate;
+    _dataBits = dataBits;
+    _parity = parity;
+    _stopBits = stopBits;
+    _flowControl = flowControl;
+
+    if (-1 != _fd) {
+        return applyDriverConfig();
+    }
+
+    return ErrorType::Success;
+}
+
+ErrorType Uart::setFirmwareConfig(Bytes receiveBufferSize, Bytes transmitBufferSize, int8_t terminatingByte) {
+    _receiveBufferSize = receiveBufferSize;
+    _transmitBufferSize = transmitBufferSize;
+    _terminatingByte = terminatingByte;
+
+    return ErrorType::Success;
+}
+
+ErrorType Uart::applyDriverConfig() {
+    struct termios settings;
+
+    if (-1 == tcgetattr(_fd, &settings)) {
+        return ENOTTY == errno ? ErrorType::InvalidParameter : toPlatformError(errno);
+    }
+
+    //Raw mode. No line editing, echo, signals or translation of any bytes.
+    cfmakeraw(&settings);
+    settings.c_cflag |= CLOCAL | CREAD;
+
+    settings.c_cflag &= ~CSIZE;
+    switch (dataBits()) {
+        case 5:
+            settings.c_cflag |= CS5;
+            break;
+        case 6:
+            settings.c_cflag |= CS6;
+            break;
+        case 7:
+            settings.c_cflag |= CS7;
+            break;
+        default:
+            settings.c_cflag |= CS8;
+            break;
+    }
+
+    settings.c_cflag &= ~(PARENB | PARODD);
+    if ('E' == parity()) {
+        settings.c_cflag |= PARENB;
+    }
+    else if ('O' == parity()) {
+        settings.c_cflag |= PARENB | PARODD;
+    }
+
+    if (2 == stopBits()) {
+        settings.c_cflag |= CSTOPB;
+    }
+    else {
+        settings.c_cflag &= ~CSTOPB;
+    }
+
+    if (UartConfig::FlowControl::CtsRts == flowControl()) {
+        settings.c_cflag |= CRTSCTS;
+    }
+    else {
+        settings.c_cflag &= ~CRTSCTS;
+    }
+
+    //The descriptor is non-blocking so these only matter to anyone else who opens the device.
+    settings.c_cc[VMIN] = 0;
+    settings.c_cc[VTIME] = 0;
+
+    const speed_t speed = toSpeed(baudRate());
+    if (-1 == cfsetispeed(&settings, speed) || -1 == cfsetospeed(&settings, speed)) {
+        return ErrorType::InvalidParameter;
+    }
+
+    if (-1 == tcsetattr(_fd, TCSANOW, &settings)) {
+        return toPlatformError(errno);
+    }
+
+    return ErrorType::Success;
+}
+
+ErrorType Uart::wait(const uint32_t events, const Milliseconds timeout) {
+    struct epoll_event event = {};
+    event.events = events;
+    event.data.fd = _fd;
+
+    if (-1 == epoll_ctl(_epoll, EPOLL_CTL_MOD, _fd, &event)) {
+        return toPlatformError(errno);
+    }
+
+    struct epoll_event ready;
+    int result;
+    do {
+        result = epoll_wait(_epoll, &ready, 1, static_cast<int>(timeout));
+    } while (-1 == result && EINTR == errno);
+
+    if (-1 == result) {
+        return toPlatformError(errno);
+    }
+    else if (0 == result) {
+        return ErrorType::Timeout;
+    }
+
+    if (0 != (ready.events & (EPOLLERR | EPOLLHUP)) && 0 == (ready.events & events)) {
+        //Hung up with nothing left to read, such as the other side of a pseudo-terminal closing.
+        return ErrorType::EndOfFile;
+    }
+
+    return ErrorType::Success;
+}
+
+ErrorType Uart::fill() {
+    const Bytes limit = receiveBufferSize() > 0 ? receiveBufferSize() : DefaultReceiveBufferSize;
+    std::array<std::span<char>, 2> regions;
+    std::array<struct iovec, 2> iov;
+    bool filled = false;
+    bool hangUp = false;
+
+    while (_received.size() < limit) {
+        ErrorType error = _received.reserve(limit - _received.size());
+        if (ErrorType::Success != error && 0 == _received.available()) {
+            return ErrorType::NoMemory;
+        }
+
+        //Don't read more than the limit so that the rest waits in the kernel and pushes back on the sender.
+        Bytes room = limit - _received.size();
+        const Count regionCount = _received.freeRegions(regions);
+        Count used = 0;
+        for (Count i = 0; i < regionCount && room > 0; i++) {
+            iov[i].iov_base = regions[i].data();
+            iov[i].iov_len = std::min<Bytes>(regions[i].size(), room);
+            room -= iov[i].iov_len;
+            used++;
+        }
+
+        const ssize_t bytesRead = readv(_fd, iov.data(), used);
+        if (bytesRead > 0) {
+            _received.commit(bytesRead);
+            filled = true;
+        }
+        else if (-1 == bytesRead && EINTR == errno) {
+            continue;
+        }
+        else {
+            //EAGAIN, or 0 from a tty with no minimum to read, once the kernel has nothing left.
+            hangUp = (-1 == bytesRead && EIO == errno) || (0 == bytesRead && hungUp());
+            break;
+        }
+    }
+
+    //What was read before the hang up is received first.
+    if (!filled && hangUp) {
+        return ErrorType::EndOfFile;
+    }
+    else if (!filled) {
+        return _received.size() < limit ? ErrorType::NoData : ErrorType::NoMemory;
+    }
+
+    return ErrorType::Success;
+}
+
+bool Uart::hungUp() {
+    struct pollfd descriptor = {_fd, POLLIN, 0};
+
+    //A read of 0 is also what a tty with no minimum to read gives when there's nothing yet.
+    return poll(&descriptor, 1, 0) > 0 && 0 != (descriptor.revents & (POLLHUP | POLLERR));
+}
+
+speed_t Uart::toSpeed(const uint32_t baudRate) {
+    switch (baudRate) {
+        case 1200:
+            return B1200;
+        case 2400:
+            return B2400;
+        case 4800:
+            return B4800;
+        case 9600:
+            return B9600;
+        case 19200:
+            return B19200;
+        case 38400:
+            return B38400;
+        case 57600:
+            return B57600;
+        case 115200:
+            return B115200;
+        case 230400:
+            return B230400;
+        case 460800:
+            return B460800;
+        case 500000:
+            return B500000;
+        case 576000:
+            return B576000;
+        case 921600:
+            return B921600;
+        case 1000000:
+            return B1000000;
+        case 1500000:
+            return B1500000;
+        case 2000000:
+            return B2000000;
+        case 3000000:
+            return B3000000;
+        case 4000000:
+            return B4000000;
+        default:
+            return B0;
+    }
+}
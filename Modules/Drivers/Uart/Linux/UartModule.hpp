@@ -0,0 +1,167 @@
+/***************************************************************************//**
+* @author   Ben Haubrich
+* @file     UartModule.hpp
+* @details  \b Synopsis: \n A UART on a Linux serial device (e.g. /dev/ttyUSB0) using termios.
+* @ingroup  Modules
+*******************************************************************************/
+#ifndef __UART_MODULE_HPP__
+#define __UART_MODULE_HPP__
+
+//AbstractionLayer
+#include "UartAbstraction.hpp"
+//Applications
+#include "RingBuffer.hpp"
+#include "WriteCoalescer.hpp"
+//Posix
+#include <termios.h>
+//C++
+#include <span>
+#include <string>
+
+/**
+ * @class Uart
+ * @brief A UART on a tty device that is read and written through its file descriptor.
+ * @details The device is opened non-blocking and waited on with epoll, so a blocking call sleeps in the kernel until the device is
+ *          ready or the timeout is reached instead of polling it. Bytes are read from the kernel straight into a ring buffer with as few
+ *          system calls as possible and the receive buffers are filled from there.
+ *
+ *          Anything that behaves like a tty can be used, including the subordinate side of a pseudo-terminal.
+ * @code
+ * Uart uart;
+ * uart.device() = "/dev/ttyUSB0";
+ * uart.setDriverConfig(115200, 8, 'N', 1, UartConfig::FlowControl::Disable);
+ * uart.setFirmwareConfig(4096, 4096, -1);
+ * uart.init();
+ * @endcode
+*/
+class Uart : public UartAbstraction {
+
+    public:
+    Uart() : UartAbstraction(), _coalescer(*this, [this](const std::string &data) { return txBlocking(data, TransferTimeout); }) {}
+    ~Uart();
+
+    /**
+     * @brief Open the device and apply the driver configuration.
+     * @returns ErrorType::Success if the device was opened.
+     * @returns ErrorType::FileNotFound if the device doesn't exist.
+     * @returns ErrorType::InvalidParameter if the device is not a tty or the driver configuration is not supported.
+     * @returns ErrorType::PrerequisitesNotMet if the device is already open.
+    */
+    ErrorType init() override;
+    ErrorType deinit() override;
+    /**
+     * @brief Write all of the data to the device.
+     * @returns ErrorType::Success if all of the data was written.
+     * @returns ErrorType::Timeout if the device would not take all of the data in time.
+     * @returns ErrorType::PrerequisitesNotMet if the UART has not been initialized.
+    */
+    ErrorType txBlocking(const std::string &data, const Milliseconds timeout) override;
+    /**
+     * @brief Receive from the device.
+     * @details Returns as soon as there is anything to receive, up to the size of the buffer. If a terminating byte is set, waits for
+     *          it instead and receives up to and including it. Bytes after it are kept for the next receive.
+     * @returns ErrorType::Success if anything was received.
+     * @returns ErrorType::Timeout if nothing was received in time, or the terminating byte didn't arrive in time. Nothing is lost.
+     * @returns ErrorType::LimitReached if the buffer was filled before the terminating byte was found.
+     * @returns ErrorType::EndOfFile if the device hung up and everything it sent before then has been received.
+     * @returns ErrorType::PrerequisitesNotMet if the UART has not been initialized.
+     * @sa UartAbstraction::rxBlocking
+    */
+    ErrorType rxBlocking(std::string &buffer, const Milliseconds timeout) override;
+    /**
+     * @brief Receive from the device straight into the buffer.
+     * @details Like rxBlocking, but reads from the device into the buffer when nothing was read ahead. With a terminating byte set, the
+     *          bytes after it have to be kept, so they go through the receive ring buffer and are copied like rxBlocking.
+     * @returns The same as rxBlocking.
+     * @sa IcCommunicationProtocol::rxBlockingInto
+    */
+    ErrorType rxBlockingInto(std::span<char> buffer, Bytes &bytesReceived, const Milliseconds timeout) override;
+    /**
+     * @brief Transmit from the event queue. Run it with runNextEvent.
+     * @details Writes made before the last one is run are sent with it, up to the transmit buffer size if one is set, and each callback
+     *          is given the number of its own bytes that were written.
+     * @sa UartAbstraction::txNonBlocking
+     * @sa WriteCoalescer
+    */
+    ErrorType txNonBlocking(const std::shared_ptr<std::string> data, std::function<void(const ErrorType error, const Bytes bytesWritten)> callback = nullptr) override;
+    /**
+     * @brief Receive from the event queue. Run it with runNextEvent.
+     * @returns ErrorType::Success if the receive was queued.
+     * @returns ErrorType::Timeout if the writes queued before it couldn't be kept from being added to in time.
+     * @returns The error of EventQueue::addEvent otherwise.
+     * @sa UartAbstraction::rxNonBlocking
+    */
+    ErrorType rxNonBlocking(std::shared_ptr<std::string> buffer, std::function<void(const ErrorType error, std::shared_ptr<std::string> buffer)> callback = nullptr) override;
+    ErrorType flushRxBuffer() override;
+
+    /**
+     * @brief Set the peripheral number. The pins are recorded but a tty device doesn't use them.
+     * @returns ErrorType::Success
+    */
+    ErrorType setHardwareConfig(PinNumber txNumber, PinNumber rxNumber, PinNumber rtsNumber, PinNumber ctsNumber, UartConfig::PeripheralNumber peripheralNumber) override;
+    /**
+     * @brief Set the line settings. Applied straight away if the device is open.
+     * @details Flow control can only be enabled in both directions (CRTSCTS) on Linux.
+     * @returns ErrorType::Success if the settings were set.
+     * @returns ErrorType::InvalidParameter if the settings are not supported. Nothing is changed.
+    */
+    ErrorType setDriverConfig(uint32_t baudRate, uint8_t dataBits, char parity, uint8_t stopBits, UartConfig::FlowControl flowControl) override;
+    ErrorType setFirmwareConfig(Bytes receiveBufferSize, Bytes transmitBufferSize, int8_t terminatingByte) override;
+
+    /// @brief Get the path of the device as a mutable reference. /dev/ttyS<peripheral number> if it is empty when initialized.
+    std::string &device() { return _device; }
+    /// @brief Get the path of the device as a constant reference
+    const std::string &deviceConst() const { return _device; }
+
+    private:
+    /// @brief The size of the receive ring buffer when no receive buffer size is configured.
+    static constexpr Bytes DefaultReceiveBufferSize = 4096;
+    /// @brief The longest that a transfer queued by a non-blocking call waits for the device.
+    static constexpr Milliseconds TransferTimeout = 1000;
+
+    /// @brief The path of the device.
+    std::string _device;
+    /// @brief The device. -1 if it's not open.
+    int _fd = -1;
+    /// @brief The epoll instance that waits on the device. -1 if it's not open.
+    int _epoll = -1;
+    /// @brief Bytes read from the device that haven't been received yet.
+    RingBuffer _received;
+    /// @brief The number of bytes at the front of _received that have been searched for the terminating byte.
+    Bytes _scanned = 0;
+    /// @brief Combines the writes that are waiting in the event queue.
+    WriteCoalescer _coalescer;
+
+    /**
+     * @brief Apply the driver configuration to the device.
+     * @returns ErrorType::Success if the configuration was applied.
+     * @returns ErrorType::InvalidParameter if the configuration isn't supported or the device isn't a tty.
+    */
+    ErrorType applyDriverConfig();
+    /**
+     * @brief Wait for the device to be ready.
+     * @param[in] events EPOLLIN or EPOLLOUT.
+     * @param[in] timeout The longest to wait.
+     * @returns ErrorType::Success if the device is ready.
+     * @returns ErrorType::Timeout if it wasn't ready in time.
+     * @returns ErrorType::EndOfFile if the device hung up and there is nothing left to read.
+    */
+    ErrorType wait(const uint32_t events, const Milliseconds timeout);
+    /**
+     * @brief Read everything the kernel has for the device into the ring buffer without waiting.
+     * @returns ErrorType::Success if anything was read.
+     * @returns ErrorType::NoData if there was nothing to read.
+     * @returns ErrorType::NoMemory if the ring buffer is full.
+     * @returns ErrorType::EndOfFile if the device hung up and there was nothing to read.
+    */
+    ErrorType fill();
+    /**
+     * @brief Check whether the device has hung up, such as the other side of a pseudo-terminal closing or a USB adapter being unplugged.
+     * @returns True if the device has hung up.
+    */
+    bool hungUp();
+    /// @brief Get the termios speed of a baud rate. B0 if it isn't one of the standard rates.
+    static speed_t toSpeed(const uint32_t baudRate);
+};
+
+#endif // __UART_MODULE_HPP__
@@ -0,0 +1,724 @@
+//Modules
+#include "UartModule.hpp"
+#include "OperatingSystemModule.hpp"
+//Posix
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+//C++
+#include <algorithm>
+#include <cassert>
+#include <charconv>
+#include <vector>
+
+namespace {
+    /// @brief Split the parameters of a command at the commas and remove any quotes around them.
+    std::vector<std::string_view> toParameters(std::string_view parameters) {
+        std::vector<std::string_view> split;
+
+        while (!parameters.empty()) {
+            const size_t comma = parameters.find(',');
+            std::string_view parameter = parameters.substr(0, comma);
+
+            if (parameter.size() >= 2 && '"' == parameter.front() && '"' == parameter.back()) {
+                parameter = parameter.substr(1, parameter.size() - 2);
+            }
+
+            split.push_back(parameter);
+
+            if (std::string_view::npos == comma) {
+                break;
+            }
+
+            parameters.remove_prefix(comma + 1);
+        }
+
+        return split;
+    }
+
+    /// @brief Get the number that a parameter holds. -1 if it does not hold one.
+    long toNumber(std::string_view parameter) {
+        long number = -1;
+        const auto [end, error] = std::from_chars(parameter.data(), parameter.data() + parameter.size(), number);
+
+        if (std::errc() != error || parameter.data() + parameter.size() != end) {
+            return -1;
+        }
+
+        return number;
+    }
+}
+
+std::atomic<int> Uart::semaphoreCount(0);
+
+Uart::Uart() : UartAbstraction() {
+    const int instance = ++semaphoreCount;
+    _settingsSemaphore = std::string("quectelSimulatorSemaphore").append(std::to_string(instance));
+    ErrorType error = OperatingSystem::Instance().createSemaphore(1, 1, _settingsSemaphore);
+    assert(ErrorType::Success == error);
+}
+
+Uart::~Uart() {
+    deinit();
+    OperatingSystem::Instance().deleteSemaphore(_settingsSemaphore);
+}
+
+ErrorType Uart::init() {
+    return ErrorType::Success;
+}
+
+ErrorType Uart::deinit() {
+    for (size_t i = 0; i < _connections.size(); i++) {
+        close(i);
+    }
+
+    return ErrorType::Success;
+}
+
+ErrorType Uart::txBlocking(const std::string &data, const Milliseconds) {
+    service(0);
+
+    const Clock::time_point now = Clock::now();
+    const Clock::time_point lastFromHost = _lastFromHost;
+    _lastFromHost = now;
+
+    if (_dataMode) {
+        //Quectel LTE Standard TCP/IP Application Note. +++ switches to command mode if there is silence for the guard time on
+        //either side of it. Otherwise it is data like anything else.
+        if (_escaping) {
+            _escaping = false;
+            forward("+++");
+        }
+
+        if ("+++" == data && now - lastFromHost >= std::chrono::milliseconds(_settings.escapeGuardTime)) {
+            _escaping = true;
+            _escapeAt = now + std::chrono::milliseconds(_settings.escapeGuardTime);
+        }
+        else {
+            forward(data);
+        }
+
+        return ErrorType::Success;
+    }
+
+    for (const char byte : data) {
+        //V.250 5.6.1. The running command is aborted and what aborted it is thrown away.
+        if (_executing) {
+            _executing = false;
+            respond("", "ERROR");
+            break;
+        }
+
+        if (0 < _sendRemaining) {
+            _sendData.push_back(byte);
+
+            if (0 == --_sendRemaining) {
+                Connection &connection = _connections[_sendConnection];
+
+                if (-1 == connection.fd || connection.endOfStream || connection.totalSent - connection.totalAcked + _sendData.size() > _settings.sendBufferSize) {
+                    respond("", "SEND FAIL");
+                }
+                else {
+                    connection.totalSent += _sendData.size();
+                    transmit(connection.uplink, _uplinkFree, std::move(_sendData));
+                    respond("", "SEND OK");
+                }
+
+                _sendData.clear();
+                _sendConnection = -1;
+            }
+        }
+        else if ('\r' == byte) {
+            if (_echo) {
+                _toHost.append(_command).push_back(byte);
+            }
+
+            handleCommand(_command);
+            _command.clear();
+        }
+        else if ('\n' != byte) {
+            _command.push_back(byte);
+        }
+    }
+
+    return ErrorType::Success;
+}
+
+ErrorType Uart::txNonBlocking(const std::shared_ptr<std::string>, std::function<void(const ErrorType error, const Bytes bytesWritten)>) {
+    return ErrorType::NotImplemented;
+}
+
+ErrorType Uart::rxBlocking(std::string &buffer, const Milliseconds timeout) {
+    if (ErrorType::Success != waitForHost(timeout)) {
+        buffer.resize(0);
+        return ErrorType::Timeout;
+    }
+
+    const Bytes bytes = std::min<Bytes>(buffer.size(), _toHost.size());
+    buffer.assign(_toHost, 0, bytes);
+    _toHost.erase(0, bytes);
+
+    return ErrorType::Success;
+}
+
+ErrorType Uart::rxBlockingInto(std::span<char> buffer, Bytes &bytesReceived, const Milliseconds timeout) {
+    bytesReceived = 0;
+
+    if (ErrorType::Success != waitForHost(timeout)) {
+        return ErrorType::Timeout;
+    }
+
+    bytesReceived = _toHost.copy(buffer.data(), buffer.size());
+    _toHost.erase(0, bytesReceived);
+
+    return ErrorType::Success;
+}
+
+ErrorType Uart::rxNonBlocking(std::shared_ptr<std::string>, std::function<void(const ErrorType error, std::shared_ptr<std::string> buffer)>) {
+    return ErrorType::NotImplemented;
+}
+
+ErrorType Uart::flushRxBuffer() {
+    service(0);
+    _toHost.clear();
+
+    return ErrorType::Success;
+}
+
+ErrorType Uart::setHardwareConfig(int32_t txNumber, int32_t rxNumber, int32_t rtsNumber, int32_t ctsNumber, UartConfig::PeripheralNumber peripheralNumber) {
+    _txNumber = txNumber;
+    _rxNumber = rxNumber;
+    _rtsNumber = rtsNumber;
+    _ctsNumber = ctsNumber;
+    _peripheralNumber = peripheralNumber;
+
+    return ErrorType::Success;
+}
+
+ErrorType Uart::setDriverConfig(uint32_t baudRate, uint8_t dataBits, char parity, uint8_t stopBits, UartConfig::FlowControl flowControl) {
+    _baudRate = baudRate;
+    _dataBits = dataBits;
+    _parity = parity;
+    _stopBits = stopBits;
+    _flowControl = flowControl;
+
+    return ErrorType::Success;
+}
+
+ErrorType Uart::setFirmwareConfig(Bytes receiveBufferSize, Bytes transmitBufferSize, int8_t terminatingByte) {
+    _receiveBufferSize = receiveBufferSize;
+    _transmitBufferSize = transmitBufferSize;
+    _terminatingByte = terminatingByte;
+
+    return ErrorType::Success;
+}
+
+ErrorType Uart::setSimulatorSettings(const QuectelSimulatorSettings::Settings &settings) {
+    ErrorType error = OperatingSystem::Instance().waitSemaphore(_settingsSemaphore, SemaphoreTimeout);
+    if (ErrorType::Success != error) {
+        return error;
+    }
+
+    _requestedSettings = settings;
+
+    OperatingSystem::Instance().incrementSemaphore(_settingsSemaphore);
+    return ErrorType::Success;
+}
+
+QuectelSimulatorSettings::Settings Uart::simulatorSettings() {
+    QuectelSimulatorSettings::Settings settings;
+
+    ErrorType error = OperatingSystem::Instance().waitSemaphore(_settingsSemaphore, SemaphoreTimeout);
+    assert(ErrorType::Success == error);
+    settings = _requestedSettings;
+    OperatingSystem::Instance().incrementSemaphore(_settingsSemaphore);
+
+    return settings;
+}
+
+void Uart::handleCommand(std::string_view command) {
+    if (command.empty()) {
+        return;
+    }
+    else if ("AT" == command) {
+        respond("");
+    }
+    else if ("ATI" == command) {
+        respond("Quectel\r\nEC21\r\nRevision: EC21EFAR06A01M4G");
+    }
+    else if (command.starts_with("ATE")) {
+        _echo = command.ends_with('1');
+        respond("");
+    }
+    else if ("ATS3?" == command) {
+        respond("013");
+    }
+    else if ("ATS4?" == command) {
+        respond("010");
+    }
+    else if ("AT+QSIMSTAT?" == command) {
+        respond(_settings.simInserted ? "+QSIMSTAT: 0,1" : "+QSIMSTAT: 0,0");
+    }
+    else if ("AT+COPS?" == command) {
+        respond("+COPS: 0,0,\"Simulator\",7");
+    }
+    else if ("AT+CREG?" == command) {
+        respond(std::string("+CREG: ").append(std::to_string(_registrationReporting)).append(",").append(std::to_string(_settings.registrationStatus)));
+    }
+    else if (command.starts_with("AT+CREG=")) {
+        //Pg. 76 EC21A AT Command Manual. Only <n> of 0 and 1 are simulated, 2 is reported like 1.
+        _registrationReporting = command.ends_with('0') ? 0 : 1;
+        _reportedRegistration = _settings.registrationStatus;
+        respond("");
+    }
+    else if ("AT+CSQ" == command) {
+        respond(std::string("+CSQ: ").append(std::to_string(_settings.signalQuality)).append(",99"));
+    }
+    else if (command.starts_with("AT+COPS=") || command.starts_with("AT+CGATT=")) {
+        execute();
+    }
+    else if (command.starts_with("AT+CGDCONT=") || command.starts_with("AT+QICSGP=")) {
+        respond("");
+    }
+    else if ("AT+QIACT?" == command) {
+        respond(_contextActive ? "+QIACT: 1,1,1,\"10.0.0.2\"" : "");
+    }
+    else if (command.starts_with("AT+QIACT=")) {
+        _contextActive = true;
+        respond("");
+    }
+    else if (command.starts_with("AT+QIDEACT=")) {
+        deinit();
+        _contextActive = false;
+        respond("");
+    }
+    else if (command.starts_with("AT+QIOPEN=")) {
+        open(command.substr(sizeof("AT+QIOPEN=") - 1));
+    }
+    else if (command.starts_with("AT+QICLOSE=")) {
+        const std::vector<std::string_view> parameters = toParameters(command.substr(sizeof("AT+QICLOSE=") - 1));
+        const long connection = parameters.empty() ? -1 : toNumber(parameters[0]);
+
+        if (connection < 0 || connection >= static_cast<long>(_connections.size())) {
+            respond("", "ERROR");
+        }
+        else {
+            close(connection);
+            respond("");
+        }
+    }
+    else if (command.starts_with("AT+QISEND=")) {
+        send(command.substr(sizeof("AT+QISEND=") - 1));
+    }
+    else if (command.starts_with("AT+QIRD=")) {
+        read(command.substr(sizeof("AT+QIRD=") - 1));
+    }
+    else if ("ATO" == command) {
+        resume();
+    }
+    else if ("AT+QIGETERROR" == command) {
+        respond("+QIGETERROR: 0,operation successful");
+    }
+    else {
+        respond("", "ERROR");
+    }
+}
+
+void Uart::respond(std::string_view lines, std::string_view result) {
+    if (!lines.empty()) {
+        _toHost.append("\r\n").append(lines).append("\r\n");
+    }
+
+    _toHost.append("\r\n").append(result).append("\r\n");
+}
+
+void Uart::urc(std::string_view line) {
+    _toHost.append("\r\n").append(line).append("\r\n");
+}
+
+//AT+QIOPEN=<contextID>,<connectID>,<service_type>,<IP_address>/<domain_name>,<remote_port>[,<local_port>[,<access_mode>]]
+void Uart::open(std::string_view parameters) {
+    constexpr int operationSuccessful = 0;
+    constexpr int socketIdentityUsed = 563;
+    constexpr int socketConnectFailed = 566;
+
+    const std::vector<std::string_view> split = toParameters(parameters);
+    if (split.size() < 5) {
+        respond("", "ERROR");
+        return;
+    }
+
+    const long connectionId = toNumber(split[1]);
+    const long accessMode = split.size() > 6 ? toNumber(split[6]) : 0;
+    constexpr long bufferAccessMode = 0;
+    constexpr long transparentAccessMode = 2;
+    //Only TCP in buffer and transparent access mode is simulated. Only one connection can be in transparent access mode.
+    if (connectionId < 0 || connectionId >= static_cast<long>(_connections.size()) || "TCP" != split[2] ||
+        (bufferAccessMode != accessMode && transparentAccessMode != accessMode) || (transparentAccessMode == accessMode && -1 != _dataConnection)) {
+        respond("", "ERROR");
+        return;
+    }
+
+    if (-1 != _connections[connectionId].fd) {
+        respond("", std::string("+CME ERROR: ").append(std::to_string(socketIdentityUsed)));
+        return;
+    }
+
+    //The result of opening the connection is reported after OK, except in transparent access mode where it's CONNECT or ERROR.
+    if (bufferAccessMode == accessMode) {
+        respond("");
+    }
+    std::string result = std::string("+QIOPEN: ").append(std::to_string(connectionId)).append(",");
+
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *addresses = nullptr;
+    const std::string host(split[3]);
+    const std::string port(split[4]);
+
+    int fd = -1;
+    if (_contextActive && 0 == getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses)) {
+        for (struct addrinfo *address = addresses; nullptr != address && -1 == fd; address = address->ai_next) {
+            fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+
+            if (-1 != fd && 0 != connect(fd, address->ai_addr, address->ai_addrlen)) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+
+        freeaddrinfo(addresses);
+    }
+
+    if (-1 == fd) {
+        if (transparentAccessMode == accessMode) {
+            respond("", "ERROR");
+        }
+        else {
+            urc(result.append(std::to_string(socketConnectFailed)));
+        }
+        return;
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    _connections[connectionId] = Connection();
+    _connections[connectionId].fd = fd;
+
+    if (transparentAccessMode == accessMode) {
+        _dataConnection = connectionId;
+        _dataMode = true;
+        respond("", "CONNECT");
+        return;
+    }
+
+    urc(result.append(std::to_string(operationSuccessful)));
+}
+
+void Uart::close(int connection) {
+    if (-1 != _connections[connection].fd) {
+        ::close(_connections[connection].fd);
+    }
+
+    _connections[connection] = Connection();
+
+    if (_dataConnection == connection) {
+        _dataConnection = -1;
+        _dataMode = false;
+        _escaping = false;
+    }
+
+    if (_sendConnection == connection) {
+        _sendConnection = -1;
+        _sendRemaining = 0;
+        _sendData.clear();
+    }
+}
+
+//AT+QISEND=<connectID>,<send_length>
+void Uart::send(std::string_view parameters) {
+    const std::vector<std::string_view> split = toParameters(parameters);
+    const long connectionId = split.size() > 0 ? toNumber(split[0]) : -1;
+    const long length = split.size() > 1 ? toNumber(split[1]) : -1;
+
+    if (connectionId < 0 || connectionId >= static_cast<long>(_connections.size()) || length < 0 || length > static_cast<long>(MaxSendLength)) {
+        respond("", "ERROR");
+        return;
+    }
+
+    Connection &connection = _connections[connectionId];
+
+    //Pg. 19 Quectel LTE Standard TCP/IP Application Note. A length of 0 asks how much has been sent.
+    if (0 == length) {
+        respond(std::string("+QISEND: ").append(std::to_string(connection.totalSent))
+                                         .append(",").append(std::to_string(connection.totalAcked))
+                                         .append(",").append(std::to_string(connection.totalSent - connection.totalAcked)));
+        return;
+    }
+
+    if (-1 == connection.fd || connection.endOfStream) {
+        respond("", "ERROR");
+        return;
+    }
+
+    _toHost.append("> ");
+    _sendConnection = connectionId;
+    _sendRemaining = length;
+    _sendData.clear();
+    _sendData.reserve(length);
+}
+
+//AT+QIRD=<connectID>,<read_length>
+void Uart::read(std::string_view parameters) {
+    const std::vector<std::string_view> split = toParameters(parameters);
+    const long connectionId = split.size() > 0 ? toNumber(split[0]) : -1;
+    const long length = split.size() > 1 ? toNumber(split[1]) : -1;
+
+    if (connectionId < 0 || connectionId >= static_cast<long>(_connections.size()) || length < 0) {
+        respond("", "ERROR");
+        return;
+    }
+
+    Connection &connection = _connections[connectionId];
+
+    if (-1 == connection.fd) {
+        respond("", "ERROR");
+        return;
+    }
+
+    //Pg. 21 Quectel LTE Standard TCP/IP Application Note. A length of 0 asks how much has been received.
+    if (0 == length) {
+        respond(std::string("+QIRD: ").append(std::to_string(connection.totalReceived))
+                                      .append(",").append(std::to_string(connection.totalRead))
+                                      .append(",").append(std::to_string(connection.received.size())));
+        return;
+    }
+
+    const Bytes bytes = std::min<Bytes>({static_cast<Bytes>(length), MaxReadLength, static_cast<Bytes>(connection.received.size())});
+
+    _toHost.append("\r\n+QIRD: ").append(std::to_string(bytes)).append("\r\n");
+    if (bytes > 0) {
+        _toHost.append(connection.received, 0, bytes).append("\r\n");
+        connection.received.erase(0, bytes);
+        connection.totalRead += bytes;
+    }
+    _toHost.append("\r\nOK\r\n");
+}
+
+void Uart::forward(std::string data) {
+    Connection &connection = _connections[_dataConnection];
+
+    if (-1 == connection.fd || connection.endOfStream) {
+        return;
+    }
+
+    connection.totalSent += data.size();
+    transmit(connection.uplink, _uplinkFree, std::move(data));
+}
+
+void Uart::resume() {
+    if (-1 == _dataConnection) {
+        respond("", "ERROR");
+        return;
+    }
+
+    Connection &connection = _connections[_dataConnection];
+
+    //Everything the endpoint sent while in command mode has been given to the host and it closed the connection.
+    if (connection.peerClosed) {
+        respond("", "NO CARRIER");
+        return;
+    }
+
+    respond("", "CONNECT");
+    _dataMode = true;
+
+    //What was received while in command mode goes first.
+    _toHost.append(connection.received);
+    connection.totalRead += connection.received.size();
+    connection.received.clear();
+}
+
+ErrorType Uart::waitForHost(const Milliseconds timeout) {
+    const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout);
+
+    service(0);
+
+    while (_toHost.empty() || _settings.stalled) {
+        const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - Clock::now()).count();
+        if (remaining <= 0) {
+            return ErrorType::Timeout;
+        }
+
+        service(remaining);
+    }
+
+    return ErrorType::Success;
+}
+
+void Uart::execute() {
+    if (0 == _settings.attachTime) {
+        respond("");
+        return;
+    }
+
+    _executing = true;
+    _executedAt = Clock::now() + std::chrono::milliseconds(_settings.attachTime);
+}
+
+void Uart::service(const Milliseconds wait) {
+    std::vector<struct pollfd> readable;
+    std::vector<size_t> polled;
+    Clock::time_point now = Clock::now();
+    Clock::time_point nextArrival = now + std::chrono::milliseconds(wait);
+
+    //The settings may be changed by another thread while the simulated modem waits.
+    refreshSettings();
+
+    if (0 != _registrationReporting) {
+        nextArrival = std::min(nextArrival, now + std::chrono::milliseconds(SettingsPollPeriod));
+
+        if (_reportedRegistration != _settings.registrationStatus) {
+            _reportedRegistration = _settings.registrationStatus;
+            urc(std::string("+CREG: ").append(std::to_string(_reportedRegistration)));
+        }
+    }
+
+    if (_executing) {
+        if (now >= _executedAt) {
+            _executing = false;
+            respond("");
+        }
+        else {
+            nextArrival = std::min(nextArrival, _executedAt);
+        }
+    }
+
+    if (_escaping) {
+        if (now >= _escapeAt) {
+            _escaping = false;
+            _dataMode = false;
+            respond("");
+        }
+        else {
+            nextArrival = std::min(nextArrival, _escapeAt);
+        }
+    }
+
+    for (size_t i = 0; i < _connections.size(); i++) {
+        Connection &connection = _connections[i];
+        if (-1 == connection.fd) {
+            continue;
+        }
+
+        while (!connection.uplink.empty() && connection.uplink.front().arrives <= now) {
+            std::string &data = connection.uplink.front().data;
+            const ssize_t sent = ::send(connection.fd, data.data(), data.size(), MSG_NOSIGNAL);
+
+            if (sent < 0) {
+                //The endpoint can't take any more right now, or it's gone and that will show up as the end of the stream.
+                break;
+            }
+
+            connection.totalAcked += sent;
+            data.erase(0, sent);
+            if (data.empty()) {
+                connection.uplink.pop_front();
+            }
+        }
+
+        while (!connection.downlink.empty() && connection.downlink.front().arrives <= now) {
+            //Pg. 36 Quectel LTE Standard TCP/IP Application Note. Reported once until everything received has been read.
+            const bool reportReceived = connection.received.empty();
+
+            connection.totalReceived += connection.downlink.front().data.size();
+
+            if (_dataMode && _dataConnection == static_cast<int>(i)) {
+                connection.totalRead += connection.downlink.front().data.size();
+                _toHost.append(connection.downlink.front().data);
+                connection.downlink.pop_front();
+                continue;
+            }
+
+            connection.received.append(connection.downlink.front().data);
+            connection.downlink.pop_front();
+
+            //The connection in transparent access mode gives it to the host when it returns to data mode.
+            if (reportReceived && _dataConnection != static_cast<int>(i)) {
+                urc(std::string("+QIURC: \"recv\",").append(std::to_string(i)));
+            }
+        }
+
+        if (connection.endOfStream && connection.downlink.empty() && !connection.peerClosed) {
+            if (_dataConnection != static_cast<int>(i)) {
+                connection.peerClosed = true;
+                urc(std::string("+QIURC: \"closed\",").append(std::to_string(i)));
+            }
+            else if (_dataMode) {
+                //The modem leaves data mode. Quectel LTE Standard TCP/IP Application Note.
+                connection.peerClosed = true;
+                _dataMode = false;
+                _escaping = false;
+                respond("", "NO CARRIER");
+            }
+            else if (connection.received.empty()) {
+                connection.peerClosed = true;
+            }
+        }
+
+        if (!connection.uplink.empty()) {
+            nextArrival = std::min(nextArrival, connection.uplink.front().arrives);
+        }
+        if (!connection.downlink.empty()) {
+            nextArrival = std::min(nextArrival, connection.downlink.front().arrives);
+        }
+
+        if (!connection.endOfStream) {
+            readable.push_back({connection.fd, POLLIN, 0});
+            polled.push_back(i);
+        }
+    }
+
+    const int timeout = std::max<int>(0, std::chrono::ceil<std::chrono::milliseconds>(nextArrival - now).count());
+    if (0 >= poll(readable.data(), readable.size(), timeout)) {
+        return;
+    }
+
+    for (size_t i = 0; i < readable.size(); i++) {
+        if (0 == readable[i].revents) {
+            continue;
+        }
+
+        Connection &connection = _connections[polled[i]];
+        std::string data(MaxReadLength, 0);
+        const ssize_t received = recv(connection.fd, data.data(), data.size(), 0);
+
+        if (received > 0) {
+            data.resize(received);
+            transmit(connection.downlink, _downlinkFree, std::move(data));
+        }
+        else if (0 == received || (EAGAIN != errno && EWOULDBLOCK != errno)) {
+            connection.endOfStream = true;
+        }
+    }
+}
+
+void Uart::refreshSettings() {
+    //Keep running with the settings it has if another thread is holding on to them. They're picked up next time.
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(_settingsSemaphore, 0)) {
+        return;
+    }
+
+    _settings = _requestedSettings;
+    OperatingSystem::Instance().incrementSemaphore(_settingsSemaphore);
+}
+
+void Uart::transmit(std::deque<InFlight> &queue, Clock::time_point &linkFree, std::string data) {
+    const Clock::time_point start = std::max(Clock::now(), linkFree);
+    const auto sending = 0 == _settings.bandwidth ? std::chrono::microseconds(0) : std::chrono::microseconds(data.size() * 1000000 / _settings.bandwidth);
+
+    linkFree = start + sending;
+    queue.push_back({linkFree + std::chrono::milliseconds(_settings.latency), std::move(data)});
+}
@@ -0,0 +1,227 @@
+/***************************************************************************//**
+* @author   Ben Haubrich
+* @file     UartModule.hpp
+* @details  \b Synopsis: \n A simulated Quectel EC21 modem on the other end of the UART.
+* @ingroup  Modules
+*******************************************************************************/
+#ifndef __CBT_UART_HPP__
+#define __CBT_UART_HPP__
+
+//AbstractionLayer
+#include "UartAbstraction.hpp"
+//C++
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <span>
+#include <string>
+#include <string_view>
+
+/**
+ * @namespace QuectelSimulatorSettings
+ * @brief Settings for the simulated modem.
+*/
+namespace QuectelSimulatorSettings {
+
+    /**
+     * @struct Settings
+     * @brief How the simulated modem and its network behave.
+    */
+    struct Settings {
+        Milliseconds latency = 0;             ///< One way delay added to socket data in each direction.
+        Bytes bandwidth = 0;                  ///< Bytes per second that socket data moves at in each direction. 0 is unlimited.
+        Bytes sendBufferSize = 8192;          ///< Bytes sent with AT+QISEND that can be unacknowledged before SEND FAIL.
+        bool simInserted = true;              ///< Reported by AT+QSIMSTAT?
+        uint8_t registrationStatus = 5;       ///< <stat> reported by AT+CREG? and by +CREG: once enabled. 1 is registered to the home network, 5 is roaming.
+        uint8_t signalQuality = 20;           ///< <rssi> reported by AT+CSQ. 0 to 31, or 99 if unknown.
+        Milliseconds escapeGuardTime = 1000;  ///< The silence needed before and after +++ for it to leave data mode.
+        Milliseconds attachTime = 10;         ///< How long AT+COPS=<mode> and AT+CGATT=<state> run for. Anything received from the host in that time aborts them.
+        bool stalled = false;                 ///< Nothing reaches the host while true, as if it were held up on the way. A flush of the host's receive buffer throws it away.
+    };
+}
+
+/**
+ * @class Uart
+ * @brief A stand in for the UART to a Quectel EC21 that answers the AT commands used by the Cellular and IpCellularClient modules.
+ * @details Connections opened with AT+QIOPEN are made to real TCP endpoints (e.g. a local server) in buffer access mode, with the
+ *          latency and bandwidth of the settings applied to the data going each way. Nothing runs in the background. The simulated modem
+ *          does its work while it is being transmitted to or received from.
+ *
+ *          Supported: AT, ATI, ATE, ATS3?, ATS4?, AT+QSIMSTAT?, AT+COPS, AT+CREG, AT+CSQ, AT+CGDCONT, AT+CGATT, AT+QICSGP, AT+QIACT,
+ *          AT+QIDEACT, AT+QIOPEN, AT+QICLOSE, AT+QISEND, AT+QIRD, AT+QIGETERROR and ATO. Sends the +QIURC: "recv" and "closed" URCs, and
+ *          the +CREG: URC when the registration status changes after AT+CREG=1.
+ *
+ *          AT+COPS=<mode> and AT+CGATT=<state> run for the attach time before answering OK. Anything received from the host while they
+ *          run aborts them with ERROR and is thrown away (V.250 5.6.1), so a host that sends its next command without waiting finds out.
+ *
+ *          One connection can be opened in transparent access mode. While it is in data mode everything the host sends is data for the
+ *          endpoint and everything the endpoint sends goes straight to the host, until +++ switches to command mode or the endpoint
+ *          closes the connection (NO CARRIER).
+*/
+class Uart : public UartAbstraction {
+    public:
+    Uart();
+    ~Uart();
+    ErrorType init() override;
+    ErrorType deinit() override;
+    ErrorType txBlocking(const std::string &data, const Milliseconds timeout) override;
+    /**
+     * @brief Receive what the simulated modem has sent.
+     * @details Unlike a hardware UART this returns as soon as there is anything to receive, up to the size of the buffer.
+     * @sa UartAbstraction::rxBlocking
+    */
+    ErrorType rxBlocking(std::string &buffer, const Milliseconds timeout) override;
+    /// @brief Receive what the simulated modem has sent straight into the buffer. Returns as soon as there is anything, like rxBlocking.
+    ErrorType rxBlockingInto(std::span<char> buffer, Bytes &bytesReceived, const Milliseconds timeout) override;
+    ErrorType txNonBlocking(const std::shared_ptr<std::string> data, std::function<void(const ErrorType error, const Bytes bytesWritten)> callback = nullptr) override;
+    ErrorType rxNonBlocking(std::shared_ptr<std::string> buffer, std::function<void(const ErrorType error, std::shared_ptr<std::string> buffer)> callback = nullptr) override;
+    ErrorType flushRxBuffer() override;
+
+    ErrorType setHardwareConfig(PinNumber txNumber, PinNumber rxNumber, PinNumber rtsNumber, PinNumber ctsNumber, UartConfig::PeripheralNumber peripheralNumber) override;
+    ErrorType setDriverConfig(uint32_t baudRate, uint8_t dataBits, char parity, uint8_t stopBits, UartConfig::FlowControl flowControl) override;
+    ErrorType setFirmwareConfig(Bytes receiveBufferSize, Bytes transmitBufferSize, int8_t terminatingByte) override;
+
+    /**
+     * @brief Change how the simulated modem behaves.
+     * @details Can be called from any thread. The simulated modem picks up the change the next time it is transmitted to or received
+     *          from, or while it is waiting in rxBlocking.
+     * @returns ErrorType::Success
+     * @returns ErrorType::Timeout if the settings could not be locked in time.
+    */
+    ErrorType setSimulatorSettings(const QuectelSimulatorSettings::Settings &settings);
+    /// @brief Get a copy of the settings of the simulated modem.
+    QuectelSimulatorSettings::Settings simulatorSettings();
+
+    private:
+    using Clock = std::chrono::steady_clock;
+
+    /// @brief The number of connection ids. Pg. 11 Quectel LTE Standard TCP/IP Application Note.
+    static constexpr Count MaxConnections = 12;
+    /// @brief The most that can be sent at once with AT+QISEND. Pg. 19 Quectel LTE Standard TCP/IP Application Note.
+    static constexpr Bytes MaxSendLength = 1460;
+    /// @brief The most that can be read at once with AT+QIRD. Pg. 20 Quectel LTE Standard TCP/IP Application Note.
+    static constexpr Bytes MaxReadLength = 1500;
+    /// @brief The longest the simulated modem waits before looking for changes to the settings that it reports unsolicited.
+    static constexpr Milliseconds SettingsPollPeriod = 10;
+    /// @brief The timeout for semaphore operations.
+    static constexpr Milliseconds SemaphoreTimeout = 1000;
+    /// @brief Used to give each simulated modem's semaphore a unique name.
+    static std::atomic<int> semaphoreCount;
+
+    /**
+     * @struct InFlight
+     * @brief Socket data on its way across the simulated network.
+    */
+    struct InFlight {
+        Clock::time_point arrives; ///< When the data reaches the other side.
+        std::string data;          ///< The data.
+    };
+
+    /**
+     * @struct Connection
+     * @brief A connection opened with AT+QIOPEN.
+    */
+    struct Connection {
+        int fd = -1;                   ///< The TCP socket to the endpoint. -1 if the connection is not open.
+        std::deque<InFlight> uplink;   ///< Sent by the host and not yet delivered to the endpoint.
+        std::deque<InFlight> downlink; ///< Sent by the endpoint and not yet delivered to the modem.
+        std::string received;          ///< Delivered to the modem and not yet read with AT+QIRD.
+        Bytes totalSent = 0;           ///< Accepted from the host with AT+QISEND.
+        Bytes totalAcked = 0;          ///< Delivered to the endpoint.
+        Bytes totalReceived = 0;       ///< Delivered to the modem.
+        Bytes totalRead = 0;           ///< Read by the host with AT+QIRD.
+        bool endOfStream = false;      ///< The endpoint closed the connection and there is nothing more to come from it.
+        bool peerClosed = false;       ///< Everything the endpoint sent before closing has been delivered and "closed" was reported.
+    };
+
+    /// @brief The settings that the simulated modem is running with. Only used by the thread that runs the simulated modem.
+    QuectelSimulatorSettings::Settings _settings;
+    /// @brief The settings most recently set with setSimulatorSettings.
+    QuectelSimulatorSettings::Settings _requestedSettings;
+    /// @brief Guards the requested settings since they are set from other threads.
+    std::string _settingsSemaphore;
+    /// @brief Bytes received from the host that are not a complete command yet.
+    std::string _command;
+    /// @brief Bytes for the host to receive.
+    std::string _toHost;
+    /// @brief True if commands are echoed back.
+    bool _echo = true;
+    /// @brief <n> of AT+CREG=<n>. The registration status is reported when it changes if this is not 0.
+    uint8_t _registrationReporting = 0;
+    /// @brief The registration status that the host was last told about.
+    uint8_t _reportedRegistration = 0;
+    /// @brief True while a command that can be aborted is running.
+    bool _executing = false;
+    /// @brief When the running command finishes.
+    Clock::time_point _executedAt;
+    /// @brief True if the PDP context has been activated.
+    bool _contextActive = false;
+    /// @brief The connection in transparent access mode. -1 if there isn't one.
+    int _dataConnection = -1;
+    /// @brief True while the connection in transparent access mode is in data mode.
+    bool _dataMode = false;
+    /// @brief Data mode only. True from receiving +++ until the guard time after it has passed.
+    bool _escaping = false;
+    /// @brief Data mode only. When the guard time after +++ ends.
+    Clock::time_point _escapeAt;
+    /// @brief When the last bytes were received from the host.
+    Clock::time_point _lastFromHost;
+    /// @brief AT+QISEND only. The connection that data from the host is going to.
+    int _sendConnection = -1;
+    /// @brief AT+QISEND only. The number of bytes the host still has to send.
+    Bytes _sendRemaining = 0;
+    /// @brief AT+QISEND only. The data received from the host so far.
+    std::string _sendData;
+    /// @brief When the last data sent each way finishes going out at the bandwidth.
+    Clock::time_point _uplinkFree, _downlinkFree;
+    /// @brief The connections.
+    std::array<Connection, MaxConnections> _connections;
+
+    /**
+     * @brief Run a complete command.
+     * @param[in] command The command without the command line termination character.
+    */
+    void handleCommand(std::string_view command);
+    /// @brief Respond with information lines and a final result code.
+    void respond(std::string_view lines, std::string_view result = "OK");
+    /// @brief Send an unsolicited result code.
+    void urc(std::string_view line);
+    /// @brief AT+QIOPEN
+    void open(std::string_view parameters);
+    /// @brief AT+QICLOSE
+    void close(int connection);
+    /// @brief AT+QISEND
+    void send(std::string_view parameters);
+    /// @brief AT+QIRD
+    void read(std::string_view parameters);
+    /// @brief Send data from the host to the endpoint of the connection in data mode.
+    void forward(std::string data);
+    /// @brief ATO. Return to data mode.
+    void resume();
+    /**
+     * @brief Run the simulated modem until it has something for the host.
+     * @returns ErrorType::Success if there is something for the host.
+     * @returns ErrorType::Timeout if there is nothing after the timeout.
+    */
+    ErrorType waitForHost(const Milliseconds timeout);
+    /// @brief Run a command that takes the attach time and is aborted by anything received from the host in the meantime.
+    void execute();
+
+    /// @brief Start running with the settings most recently set with setSimulatorSettings.
+    void refreshSettings();
+    /**
+     * @brief Move socket data across the simulated network.
+     * @param[in] wait The longest to wait for data from an endpoint.
+    */
+    void service(const Milliseconds wait);
+    /**
+     * @brief Put data on its way across the simulated network.
+     * @param[in] queue The direction the data is going.
+     * @param[in] linkFree When the last data sent the same way finishes going out.
+     * @param[in] data The data.
+    */
+    void transmit(std::deque<InFlight> &queue, Clock::time_point &linkFree, std::string data);
+};
+
+#endif // __CBT_UART_HPP__
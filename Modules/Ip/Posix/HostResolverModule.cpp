@@ -0,0 +1,376 @@
+//Modules
+#include "HostResolverModule.hpp"
+#include "OperatingSystemModule.hpp"
+//Posix
+#include <netdb.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+//C++
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <limits>
+
+std::atomic<int> HostResolver::semaphoreCount(0);
+
+void ResolvedAddress::setPort(Port port) {
+    if (AF_INET == family) {
+        reinterpret_cast<struct sockaddr_in *>(&address)->sin_port = htons(port);
+    }
+    else if (AF_INET6 == family) {
+        reinterpret_cast<struct sockaddr_in6 *>(&address)->sin6_port = htons(port);
+    }
+}
+
+ErrorType ResolvedAddress::toString(std::string &ipAddress) const {
+    char presentation[INET6_ADDRSTRLEN] = {0};
+    const void *source = nullptr;
+
+    if (AF_INET == family) {
+        source = &reinterpret_cast<const struct sockaddr_in *>(&address)->sin_addr;
+    }
+    else if (AF_INET6 == family) {
+        source = &reinterpret_cast<const struct sockaddr_in6 *>(&address)->sin6_addr;
+    }
+    else {
+        return ErrorType::InvalidParameter;
+    }
+
+    if (nullptr == inet_ntop(family, source, presentation, sizeof(presentation))) {
+        return toPlatformError(errno);
+    }
+
+    ipAddress.assign(presentation);
+    return ErrorType::Success;
+}
+
+HostResolver::HostResolver() : EventQueue(), _running(true) {
+    const int instance = ++semaphoreCount;
+    _cacheSemaphore = std::string("hostResolverSemaphore").append(std::to_string(instance));
+    ErrorType error = OperatingSystem::Instance().createSemaphore(1, 1, _cacheSemaphore);
+    assert(ErrorType::Success == error);
+    _queuedSemaphore = std::string("hostResolverQueuedSemaphore").append(std::to_string(instance));
+    error = OperatingSystem::Instance().createSemaphore(eventsAvailable(), 0, _queuedSemaphore);
+    assert(ErrorType::Success == error);
+
+    Id threadId;
+    _threadName = std::string("hostResolver").append(std::to_string(instance));
+    error = OperatingSystem::Instance().createThread(OperatingSystemConfig::Priority::Normal, _threadName, this, ResolverStackSize, runResolver, threadId);
+    assert(ErrorType::Success == error);
+}
+
+HostResolver::~HostResolver() {
+    _running = false;
+    //Wake the thread in case it's waiting for a lookup to be queued.
+    OperatingSystem::Instance().incrementSemaphore(_queuedSemaphore);
+    OperatingSystem::Instance().joinThread(_threadName);
+    OperatingSystem::Instance().deleteThread(_threadName);
+
+    OperatingSystem::Instance().deleteSemaphore(_queuedSemaphore);
+    OperatingSystem::Instance().deleteSemaphore(_cacheSemaphore);
+}
+
+void HostResolver::Init() {
+    //Global::Init is not thread safe and every client calls this from whichever thread it was created on.
+    static std::once_flag created;
+    std::call_once(created, []() { Global<HostResolver>::Init(); });
+}
+
+ErrorType HostResolver::mainLoop() {
+    return runNextEvent();
+}
+
+ErrorType HostResolver::resolveBlocking(const std::string &hostname, std::vector<ResolvedAddress> &addresses, const Milliseconds timeout) {
+    constexpr Milliseconds pendingDelay = 1;
+    const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout);
+    ErrorType error;
+
+    auto remaining = [&deadline]() -> Milliseconds {
+        const Clock::time_point now = Clock::now();
+        return now >= deadline ? 0 : std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+    };
+
+    while (true) {
+        error = OperatingSystem::Instance().waitSemaphore(_cacheSemaphore, remaining());
+        if (ErrorType::Success != error) {
+            return ErrorType::Timeout;
+        }
+
+        //A pending entry that has expired is a lookup whose answer was never stored so it's looked up again.
+        auto entry = _cache.find(hostname);
+        if (entry == _cache.end() || Clock::now() >= entry->second.expires) {
+            //Claim the lookup so that anyone else looking for the same hostname waits for our answer.
+            CacheEntry &claimed = _cache[hostname];
+            claimed.pending = true;
+            claimed.expires = Clock::now() + std::chrono::milliseconds(LookupTimeout);
+            _lookups++;
+            OperatingSystem::Instance().incrementSemaphore(_cacheSemaphore);
+            break;
+        }
+        else if (!entry->second.pending) {
+            addresses = entry->second.addresses;
+            error = entry->second.error;
+            OperatingSystem::Instance().incrementSemaphore(_cacheSemaphore);
+            return error;
+        }
+
+        OperatingSystem::Instance().incrementSemaphore(_cacheSemaphore);
+
+        if (Clock::now() >= deadline) {
+            return ErrorType::Timeout;
+        }
+        OperatingSystem::Instance().delay(pendingDelay);
+    }
+
+    //The lookup is done without holding the semaphore so that cached answers for other hostnames are still served.
+    Seconds timeToLive = 0;
+    std::vector<ResolvedAddress> resolved;
+    error = lookup(hostname, resolved, timeToLive);
+    if (ErrorType::Success != error) {
+        resolved.clear();
+        timeToLive = _negativeTimeToLive;
+    }
+
+    //Try hard to store the answer even if the caller's time is up since anyone else waiting on this hostname waits until the
+    //lookup times out otherwise.
+    Count attempts = 0;
+    ErrorType storeError;
+    while (ErrorType::Success != (storeError = OperatingSystem::Instance().waitSemaphore(_cacheSemaphore, SemaphoreTimeout)) && ++attempts < StoreAttempts);
+
+    if (ErrorType::Success == storeError) {
+        CacheEntry &entry = _cache[hostname];
+        entry.addresses = resolved;
+        entry.error = error;
+        entry.expires = Clock::now() + std::chrono::seconds(timeToLive);
+        entry.pending = false;
+        OperatingSystem::Instance().incrementSemaphore(_cacheSemaphore);
+    }
+
+    //The caller still gets the answer even if it couldn't be stored.
+    addresses = std::move(resolved);
+    return error;
+}
+
+ErrorType HostResolver::resolveNonBlocking(const std::string &hostname, std::function<void(const ErrorType error, std::shared_ptr<std::vector<ResolvedAddress>> addresses)> callback) {
+    if (nullptr == callback) {
+        return ErrorType::InvalidParameter;
+    }
+
+    auto addresses = std::make_shared<std::vector<ResolvedAddress>>();
+
+    //Answer from the cache right away if we can. There's no need to make the caller wait for the event queue.
+    if (ErrorType::Success == OperatingSystem::Instance().waitSemaphore(_cacheSemaphore, 0)) {
+        auto entry = _cache.find(hostname);
+        const bool cached = entry != _cache.end() && !entry->second.pending && Clock::now() < entry->second.expires;
+        ErrorType cachedError = ErrorType::Failure;
+        if (cached) {
+            *addresses = entry->second.addresses;
+            cachedError = entry->second.error;
+        }
+        OperatingSystem::Instance().incrementSemaphore(_cacheSemaphore);
+
+        if (cached) {
+            callback(cachedError, addresses);
+            return ErrorType::Success;
+        }
+    }
+
+    auto resolve = [this, callback](const std::string hostname, std::shared_ptr<std::vector<ResolvedAddress>> addresses) -> ErrorType {
+        const ErrorType error = resolveBlocking(hostname, *addresses, NonBlockingTimeout);
+        callback(error, addresses);
+        return error;
+    };
+
+    std::unique_ptr<EventAbstraction> event = std::make_unique<EventQueue::Event<HostResolver>>(std::bind(resolve, hostname, addresses));
+    const ErrorType error = addEvent(event);
+    if (ErrorType::Success == error) {
+        OperatingSystem::Instance().incrementSemaphore(_queuedSemaphore);
+    }
+
+    return error;
+}
+
+ErrorType HostResolver::setResolverFile(const std::string &path) {
+    if (!path.empty()) {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            return ErrorType::FileNotFound;
+        }
+    }
+
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(_cacheSemaphore, SemaphoreTimeout)) {
+        return ErrorType::Timeout;
+    }
+
+    _resolverFile = path;
+    OperatingSystem::Instance().incrementSemaphore(_cacheSemaphore);
+
+    flush();
+
+    return ErrorType::Success;
+}
+
+void HostResolver::flush() {
+    ErrorType error = OperatingSystem::Instance().waitSemaphore(_cacheSemaphore, NonBlockingTimeout);
+    assert(ErrorType::Success == error);
+
+    //Entries with a lookup in progress are kept so that whoever is waiting on them still gets an answer.
+    std::erase_if(_cache, [](const auto &entry) { return !entry.second.pending; });
+
+    OperatingSystem::Instance().incrementSemaphore(_cacheSemaphore);
+}
+
+ErrorType HostResolver::lookup(const std::string &hostname, std::vector<ResolvedAddress> &addresses, Seconds &timeToLive) {
+    //An address doesn't need resolving, and the resolver file wouldn't have a record for it.
+    ResolvedAddress literal;
+    if (parseAddress(hostname, literal)) {
+        addresses.assign(1, literal);
+        timeToLive = _defaultTimeToLive;
+        return ErrorType::Success;
+    }
+
+    //Copied since it can be changed from another thread while the file is being read.
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(_cacheSemaphore, SemaphoreTimeout)) {
+        return ErrorType::Timeout;
+    }
+    const std::string resolverFile = _resolverFile;
+    OperatingSystem::Instance().incrementSemaphore(_cacheSemaphore);
+
+    if (resolverFile.empty()) {
+        return lookupSystem(hostname, addresses, timeToLive);
+    }
+
+    return lookupResolverFile(resolverFile, hostname, addresses, timeToLive);
+}
+
+ErrorType HostResolver::lookupSystem(const std::string &hostname, std::vector<ResolvedAddress> &addresses, Seconds &timeToLive) {
+    struct addrinfo hints;
+    struct addrinfo *servinfo = nullptr;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    //The addresses don't depend on the socket type. This just stops getaddrinfo from returning every address once per type.
+    hints.ai_socktype = SOCK_STREAM;
+
+    const int result = getaddrinfo(hostname.c_str(), nullptr, &hints, &servinfo);
+    if (0 != result) {
+        return toResolverError(result);
+    }
+
+    addresses.clear();
+    for (const struct addrinfo *p = servinfo; p != nullptr; p = p->ai_next) {
+        if (p->ai_addrlen > sizeof(ResolvedAddress::address)) {
+            continue;
+        }
+
+        ResolvedAddress resolved;
+        resolved.family = p->ai_family;
+        resolved.length = p->ai_addrlen;
+        memcpy(&resolved.address, p->ai_addr, p->ai_addrlen);
+        addresses.push_back(resolved);
+    }
+
+    freeaddrinfo(servinfo);
+
+    timeToLive = _defaultTimeToLive;
+    return addresses.empty() ? ErrorType::NoData : ErrorType::Success;
+}
+
+ErrorType HostResolver::lookupResolverFile(const std::string &path, const std::string &hostname, std::vector<ResolvedAddress> &addresses, Seconds &timeToLive) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return ErrorType::FileNotFound;
+    }
+
+    std::string line;
+    addresses.clear();
+    timeToLive = std::numeric_limits<Seconds>::max();
+
+    while (std::getline(file, line)) {
+        std::istringstream record(line);
+        std::string name, address;
+        Seconds recordTimeToLive;
+
+        if (line.empty() || '#' == line.front()) {
+            continue;
+        }
+
+        if (!(record >> name >> recordTimeToLive >> address) || name != hostname) {
+            continue;
+        }
+
+        ResolvedAddress resolved;
+        if (!parseAddress(address, resolved)) {
+            continue;
+        }
+
+        addresses.push_back(resolved);
+        //Like a DNS answer with several records, the whole answer expires with the shortest lived record.
+        timeToLive = std::min(timeToLive, recordTimeToLive);
+    }
+
+    if (addresses.empty()) {
+        timeToLive = 0;
+        return ErrorType::NoData;
+    }
+
+    return ErrorType::Success;
+}
+
+bool HostResolver::parseAddress(const std::string &address, ResolvedAddress &resolved) {
+    struct sockaddr_in *ipv4 = reinterpret_cast<struct sockaddr_in *>(&resolved.address);
+    struct sockaddr_in6 *ipv6 = reinterpret_cast<struct sockaddr_in6 *>(&resolved.address);
+
+    if (1 == inet_pton(AF_INET, address.c_str(), &ipv4->sin_addr)) {
+        resolved.family = ipv4->sin_family = AF_INET;
+        resolved.length = sizeof(struct sockaddr_in);
+    }
+    else if (1 == inet_pton(AF_INET6, address.c_str(), &ipv6->sin6_addr)) {
+        resolved.family = ipv6->sin6_family = AF_INET6;
+        resolved.length = sizeof(struct sockaddr_in6);
+    }
+    else {
+        return false;
+    }
+
+    return true;
+}
+
+void *HostResolver::runResolver(void *arg) {
+    HostResolver *resolver = static_cast<HostResolver *>(arg);
+    assert(nullptr != resolver);
+
+    while (resolver->_running) {
+        if (ErrorType::Success == OperatingSystem::Instance().waitSemaphore(resolver->_queuedSemaphore, NonBlockingTimeout)) {
+            resolver->mainLoop();
+        }
+    }
+
+    return nullptr;
+}
+
+ErrorType HostResolver::toResolverError(int error) {
+    switch (error) {
+        case 0:
+            return ErrorType::Success;
+        case EAI_NONAME:
+#ifdef EAI_NODATA
+        case EAI_NODATA:
+#endif
+            return ErrorType::NoData;
+        case EAI_AGAIN:
+            return ErrorType::Timeout;
+        case EAI_MEMORY:
+            return ErrorType::NoMemory;
+        case EAI_FAMILY:
+        case EAI_SOCKTYPE:
+        case EAI_SERVICE:
+            return ErrorType::InvalidParameter;
+        case EAI_SYSTEM:
+            return toPlatformError(errno);
+        default:
+            return ErrorType::Failure;
+    }
+}
@@ -0,0 +1,214 @@
+/***************************************************************************//**
+* @author   Ben Haubrich
+* @file     HostResolverModule.hpp
+* @details  Caching hostname resolver for posix compliant systems.
+* @ingroup  PosixModules
+*******************************************************************************/
+#ifndef __HOST_RESOLVER_MODULE_HPP__
+#define __HOST_RESOLVER_MODULE_HPP__
+
+//AbstractionLayer
+#include "Global.hpp"
+#include "EventQueue.hpp"
+#include "Error.hpp"
+#include "Types.hpp"
+//Posix
+#include <sys/socket.h>
+//C++
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @struct ResolvedAddress
+ * @brief An address that a hostname resolved to.
+*/
+struct ResolvedAddress {
+    int family = AF_UNSPEC;                ///< AF_INET or AF_INET6.
+    struct sockaddr_storage address = {};  ///< The address. The port is left as 0 by the resolver.
+    socklen_t length = 0;                  ///< The length of the address.
+
+    /**
+     * @brief Set the port of the address.
+     * @param[in] port The port in host byte order.
+    */
+    void setPort(Port port);
+    /**
+     * @brief Get the address in presentation format (e.g. 192.0.2.1 or 2001:db8::1)
+     * @param[out] ipAddress The address.
+     * @returns ErrorType::Success if the address was converted.
+     * @returns ErrorType::InvalidParameter if the family is not AF_INET or AF_INET6.
+    */
+    ErrorType toString(std::string &ipAddress) const;
+};
+
+/**
+ * @class HostResolver
+ * @brief Resolves hostnames and caches the answers until their time to live expires.
+ * @details Lookups are thread safe. Concurrent lookups for the same hostname are coalesced so that only one of them reaches the
+ *          resolver while the others wait for the answer. Failed lookups are cached too so that a storm of reconnects to an
+ *          unresolvable hostname does not hammer the resolver.
+ *
+ *          Non-blocking lookups are run on the resolver's own thread so that a slow resolver never holds up the caller.
+ *
+ *          getaddrinfo does not report the time to live of the records it returns so system lookups are cached for the
+ *          default time to live. A resolver file can be set as a stand-in for the system resolver which gives each record
+ *          its own time to live. One record per line:
+ * @code
+ * #hostname ttl(seconds) address
+ * cloud.example.com 30 192.0.2.10
+ * cloud.example.com 30 2001:db8::10
+ * @endcode
+*/
+class HostResolver : public Global<HostResolver>, public EventQueue {
+
+    public:
+    HostResolver();
+    ~HostResolver();
+
+    /**
+     * @brief Create the resolver shared by every client and start its thread.
+     * @details Safe to call from any number of threads at once. Only the first call creates the resolver.
+     * @sa Global::Init
+    */
+    static void Init();
+
+    /// @brief The time to live of system lookups since getaddrinfo does not report one.
+    static constexpr Seconds DefaultTimeToLive = 60;
+    /// @brief The time to live of failed lookups.
+    static constexpr Seconds DefaultNegativeTimeToLive = 5;
+    /// @brief How long a non-blocking lookup may wait on another lookup of the same hostname.
+    static constexpr Milliseconds NonBlockingTimeout = 10000;
+
+    /**
+     * @brief Run queued non-blocking lookups.
+     * @details Called by the resolver's thread. There is no need to call it from anywhere else.
+     * @returns ErrorType::NoData if there are no lookups queued.
+     * @returns The error codes of runNextEvent otherwise.
+    */
+    ErrorType mainLoop() override;
+
+    /**
+     * @brief Resolve a hostname, using the cached answer if it has not expired.
+     * @param[in] hostname The hostname to resolve.
+     * @param[out] addresses The addresses that the hostname resolved to in order of preference.
+     * @param[in] timeout The time to wait on a lookup of the same hostname that is already in progress.
+     * @returns ErrorType::Success if the hostname was resolved.
+     * @returns ErrorType::NoData if the hostname does not exist.
+     * @returns ErrorType::Timeout if a lookup of the same hostname was in progress and did not finish in time.
+     * @returns ErrorType::Failure for any other resolver failure.
+     * @note If the answer can't be stored in the cache it is still returned, and the hostname is looked up again by whoever asks
+     *       for it next once LookupTimeout has passed.
+    */
+    ErrorType resolveBlocking(const std::string &hostname, std::vector<ResolvedAddress> &addresses, const Milliseconds timeout);
+    /**
+     * @brief Resolve a hostname without blocking the caller.
+     * @param[in] hostname The hostname to resolve.
+     * @param[in] callback Called with the result. Called immediately from the caller's thread if the answer is cached and from
+     *                     the resolver's thread otherwise.
+     * @returns ErrorType::Success if the lookup was queued or answered from the cache.
+     * @returns ErrorType::InvalidParameter if the callback is nullptr.
+     * @returns The errors of EventQueue::addEvent if the lookup could not be queued.
+    */
+    ErrorType resolveNonBlocking(const std::string &hostname, std::function<void(const ErrorType error, std::shared_ptr<std::vector<ResolvedAddress>> addresses)> callback);
+
+    /**
+     * @brief Use a local file as a stand-in for the system resolver.
+     * @param[in] path The path to the resolver file. An empty path restores the system resolver.
+     * @post The cache is flushed.
+     * @returns ErrorType::Success if the resolver file was set.
+     * @returns ErrorType::FileNotFound if the file does not exist.
+     * @returns ErrorType::Timeout if the resolver is too busy to change over.
+    */
+    ErrorType setResolverFile(const std::string &path);
+    /**
+     * @brief Remove all of the cached answers.
+     * @note Lookups that are in progress will still store their answer when they finish.
+    */
+    void flush();
+
+    /// @brief Set the time to live for system lookups.
+    void setDefaultTimeToLive(const Seconds timeToLive) { _defaultTimeToLive = timeToLive; }
+    /// @brief Set the time to live for failed lookups.
+    void setNegativeTimeToLive(const Seconds timeToLive) { _negativeTimeToLive = timeToLive; }
+    /// @brief The number of lookups that were not answered by the cache.
+    Count lookups() const { return _lookups; }
+
+    private:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @struct CacheEntry
+     * @brief An answer from the resolver.
+    */
+    struct CacheEntry {
+        std::vector<ResolvedAddress> addresses; ///< The addresses that the hostname resolved to.
+        ErrorType error = ErrorType::Failure;   ///< The result of the lookup.
+        Clock::time_point expires;              ///< When the answer should no longer be used, or the lookup waited on if it's pending.
+        bool pending = false;                   ///< True while the lookup is in progress.
+    };
+
+    /// @brief The stack size of the resolver's thread. getaddrinfo can use a lot of stack loading the name service modules.
+    static constexpr Bytes ResolverStackSize = 64*1024;
+    /// @brief The timeout for storing an answer in the cache.
+    static constexpr Milliseconds SemaphoreTimeout = 100;
+    /// @brief The number of times to try storing an answer before giving up on it.
+    static constexpr Count StoreAttempts = 10;
+    /// @brief How long a lookup in progress is waited on before someone else looks the hostname up, in case its answer is never stored.
+    static constexpr Milliseconds LookupTimeout = 30000;
+
+    /// @brief The number of semaphores that have been created.
+    static std::atomic<int> semaphoreCount;
+    /// @brief Guards the cache.
+    std::string _cacheSemaphore;
+    /// @brief Counts the lookups queued for the resolver's thread.
+    std::string _queuedSemaphore;
+    /// @brief The name of the resolver's thread.
+    std::string _threadName;
+    /// @brief True until the resolver is destroyed.
+    std::atomic<bool> _running;
+    /// @brief The cached answers keyed by hostname.
+    std::map<std::string, CacheEntry> _cache;
+    /// @brief The stand-in resolver file. Empty when the system resolver is used. Guarded by the cache's semaphore.
+    std::string _resolverFile;
+    /// @brief The time to live of system lookups.
+    Seconds _defaultTimeToLive = DefaultTimeToLive;
+    /// @brief The time to live of failed lookups.
+    Seconds _negativeTimeToLive = DefaultNegativeTimeToLive;
+    /// @brief The number of lookups that were not answered by the cache.
+    Count _lookups = 0;
+
+    /**
+     * @brief Resolve a hostname without consulting the cache.
+     * @param[in] hostname The hostname to resolve.
+     * @param[out] addresses The addresses that the hostname resolved to.
+     * @param[out] timeToLive How long the answer may be cached for.
+     * @returns ErrorType::Success if the hostname was resolved.
+     * @returns ErrorType::NoData if the hostname does not exist.
+     * @returns ErrorType::Timeout if the resolver file in use couldn't be read from the cache.
+    */
+    ErrorType lookup(const std::string &hostname, std::vector<ResolvedAddress> &addresses, Seconds &timeToLive);
+    /// @sa lookup
+    ErrorType lookupSystem(const std::string &hostname, std::vector<ResolvedAddress> &addresses, Seconds &timeToLive);
+    /// @sa lookup
+    ErrorType lookupResolverFile(const std::string &path, const std::string &hostname, std::vector<ResolvedAddress> &addresses, Seconds &timeToLive);
+    /**
+     * @brief Parse an IP address written out in numbers.
+     * @param[in] address The IPv4 or IPv6 address.
+     * @param[out] resolved The parsed address.
+     * @returns True if the address was parsed.
+    */
+    static bool parseAddress(const std::string &address, ResolvedAddress &resolved);
+
+    /// @brief Convert a getaddrinfo error to an ErrorType
+    ErrorType toResolverError(int error);
+    /// @brief Start function of the resolver's thread.
+    static void *runResolver(void *arg);
+};
+
+#endif // __HOST_RESOLVER_MODULE_HPP__
@@ -2,75 +2,247 @@
 #include "IpClientModule.hpp"
 #include "NetworkAbstraction.hpp"
 #include "OperatingSystemModule.hpp"
+#include "HostResolverModule.hpp"
 //Posix
 #include <netdb.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <errno.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/uio.h>
+#include <sys/un.h>
 //C++
 #include <cassert>
 #include <cstring>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
 
-ErrorType IpClient::connectTo(std::string hostname, Port port, IpClientSettings::Protocol protocol, IpClientSettings::Version version, Socket &sock, Milliseconds timeout) {
-    struct addrinfo hints;
-    struct addrinfo *servinfo = nullptr;
-    struct addrinfo *p = nullptr;
-    char portString[] = "65535";
+std::atomic<int> IpClient::semaphoreCount(0);
 
-    //It's actually very important to run a memset on the hints struct before calling getaddrinfo.
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_socktype = toPosixSocktype(protocol);
-    hints.ai_family = toPosixFamily(version);
+IpClient::IpClient() : IpClientAbstraction() {
+    //Every client shares the same resolver cache.
+    HostResolver::Init();
 
-    assert(snprintf(portString, sizeof(portString), "%u", port) > 0);
+    const int instance = ++semaphoreCount;
+    _resolvedSemaphore = std::string("ipClientResolvedSemaphore").append(std::to_string(instance));
+    ErrorType error = OperatingSystem::Instance().createSemaphore(1, 0, _resolvedSemaphore);
+    assert(ErrorType::Success == error);
+}
 
-    int result = getaddrinfo(hostname.c_str(), portString, &hints, &servinfo);
-    if (result != 0) {
-        return toPlatformError(result);
-    }
+IpClient::~IpClient() {
+    disconnect();
+    OperatingSystem::Instance().deleteSemaphore(_resolvedSemaphore);
+}
 
-    for (p = servinfo; p != nullptr; p = p->ai_next) {
-        if (-1 == (sock = socket(p->ai_family, p->ai_socktype, p->ai_protocol))) {
-            continue;
-        }
-        if (-1 == connect(sock, p->ai_addr, p->ai_addrlen)) {
-            close(sock);
-            sock = -1;
-            return toPlatformError(errno);
-        }
+ErrorType IpClient::connectTo(std::string hostname, Port port, IpClientSettings::Protocol protocol, IpClientSettings::Version version, Socket &sock, Milliseconds timeout) {
+    ErrorType error;
 
-        break;
+    if (isLocal(protocol)) {
+        error = connectLocal(hostname, toPosixSocktype(protocol), sock);
     }
-
-    if (p == nullptr) {
-        return toPlatformError(errno);
+    else {
+        error = connectRemote(hostname, port, toPosixFamily(version), toPosixSocktype(protocol), sock, timeout);
     }
 
-    freeaddrinfo(servinfo);
+    if (ErrorType::Success != error) {
+        sock = -1;
+        return error;
+    }
 
     assert(-1 != sock);
+    if (!isLocal(protocol)) {
+        //Tuning is best effort. A connection with the default options is still better than no connection.
+        TcpTuning::apply(sock, _tuning);
+    }
     _socket = sock;
+    _sendQueue->setSocket(sock);
     _protocol = protocol;
+    _version = version;
+    _hostname = hostname;
+    _port = port;
 
     _status.connected = true;
     return ErrorType::Success;
 }
 
+ErrorType IpClient::connectRemote(const std::string &hostname, const Port port, const int family, const int socktype, Socket &sock, const Milliseconds timeout) {
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<ResolvedAddress> addresses;
+
+    ErrorType error = resolve(hostname, addresses, timeout);
+    if (ErrorType::Success != error) {
+        return error;
+    }
+
+    //Only keep the addresses of the version that was asked for.
+    std::erase_if(addresses, [family](const ResolvedAddress &address) { return AF_UNSPEC != family && address.family != family; });
+    for (ResolvedAddress &address : addresses) {
+        address.setPort(port);
+    }
+
+    std::vector<const ResolvedAddress *> candidates;
+    interleaveAddressFamilies(addresses, candidates);
+
+    //Resolving may have taken some of the time we were given.
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    const Milliseconds remaining = elapsed >= timeout ? 0 : timeout - elapsed;
+
+    return raceConnections(candidates, socktype, sock, remaining);
+}
+
+ErrorType IpClient::resolve(const std::string &hostname, std::vector<ResolvedAddress> &addresses, const Milliseconds timeout) {
+    //The answer to this lookup. Shared with the callback since it can still be called after we've given up waiting.
+    struct Resolution {
+        std::atomic<bool> done = false;
+        ErrorType error = ErrorType::Failure;
+        std::vector<ResolvedAddress> addresses;
+    };
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+    auto resolution = std::make_shared<Resolution>();
+
+    auto callback = [resolution, semaphore = _resolvedSemaphore](const ErrorType error, std::shared_ptr<std::vector<ResolvedAddress>> addresses) mutable {
+        resolution->addresses = std::move(*addresses);
+        resolution->error = error;
+        resolution->done = true;
+        //Does nothing if the client is gone.
+        OperatingSystem::Instance().incrementSemaphore(semaphore);
+    };
+
+    ErrorType error = HostResolver::Instance().resolveNonBlocking(hostname, callback);
+    if (ErrorType::Success != error) {
+        return error;
+    }
+
+    //An answer to an earlier lookup that was given up on can wake us early, so the answer is checked for every time.
+    while (!resolution->done) {
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            return ErrorType::Timeout;
+        }
+
+        OperatingSystem::Instance().waitSemaphore(_resolvedSemaphore, std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count());
+    }
+
+    addresses = std::move(resolution->addresses);
+    return resolution->error;
+}
+
+ErrorType IpClient::connectLocal(const std::string &path, const int socktype, Socket &sock) {
+    struct sockaddr_un address = {};
+
+    sock = -1;
+
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        return ErrorType::InvalidParameter;
+    }
+
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path.data(), path.size());
+
+    const Socket attempt = socket(AF_UNIX, socktype, 0);
+    if (-1 == attempt) {
+        return toPlatformError(errno);
+    }
+
+    //A local connect either completes or fails right away so there is nothing to race or time out.
+    if (-1 == connect(attempt, reinterpret_cast<const struct sockaddr *>(&address), sizeof(address))) {
+        const ErrorType error = toPlatformError(errno);
+        close(attempt);
+        return error;
+    }
+
+    sock = attempt;
+    return ErrorType::Success;
+}
+
 ErrorType IpClient::disconnect() {
-    return ErrorType::NotImplemented;
+    _sendQueue->setSocket(-1);
+
+    if (_socket != -1) {
+        shutdown(_socket, SHUT_RDWR);
+        close(_socket);
+        _socket = -1;
+    }
+
+    _status.connected = false;
+    return ErrorType::Success;
+}
+
+ErrorType IpClient::setTuning(const TcpTuningSettings::Settings &settings) {
+    _tuning = settings;
+
+    if (-1 == _socket || isLocal(_protocol)) {
+        return ErrorType::Success;
+    }
+
+    return TcpTuning::apply(_socket, _tuning);
+}
+
+ErrorType IpClient::tcpStatistics(TcpTuningSettings::Statistics &statistics) {
+    if (-1 == _socket || !_status.connected) {
+        return ErrorType::PrerequisitesNotMet;
+    }
+    else if (isLocal(_protocol)) {
+        return ErrorType::NotSupported;
+    }
+
+    return TcpTuning::statistics(_socket, statistics);
+}
+
+ErrorType IpClient::checkHealth() {
+    struct pollfd descriptor = {.fd = _socket, .events = POLLIN, .revents = 0};
+    char peek;
+
+    if (-1 == _socket || !_status.connected) {
+        return ErrorType::PrerequisitesNotMet;
+    }
+
+    const int ready = poll(&descriptor, 1, 0);
+    if (-1 == ready) {
+        return toPlatformError(errno);
+    }
+    else if (0 == ready) {
+        //Nothing to read and no error. This is what an idle connection should look like.
+        return ErrorType::Success;
+    }
+
+    if (descriptor.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+        _status.connected = false;
+        return ErrorType::Failure;
+    }
+
+    const ssize_t bytesPeeked = recv(_socket, &peek, sizeof(peek), MSG_PEEK | MSG_DONTWAIT);
+    if (0 == bytesPeeked) {
+        //Orderly shutdown from the peer.
+        _status.connected = false;
+        return ErrorType::Failure;
+    }
+    else if (-1 == bytesPeeked) {
+        if (EAGAIN == errno || EWOULDBLOCK == errno) {
+            return ErrorType::Success;
+        }
+
+        _status.connected = false;
+        return toPlatformError(errno);
+    }
+
+    //Data that nobody asked for is waiting. Whoever reads next would get a reply that isn't theirs.
+    return ErrorType::LimitReached;
 }
 
-//TODO: Timeout is not implemented
 ErrorType IpClient::sendBlocking(const std::string &data, const Milliseconds timeout) {
     assert(0 != _socket);
 
-    if (-1 == send(_socket, data.data(), data.size(), 0)) {
+    const ErrorType error = _sendQueue->sendBlocking(data, timeout);
+    if (ErrorType::Success != error && ErrorType::Timeout != error) {
         _status.connected = false;
-        return toPlatformError(errno);
     }
 
-    return ErrorType::Success;
+    return error;
 }
 
 ErrorType IpClient::receiveBlocking(std::string &buffer, const Milliseconds timeout) {
@@ -79,25 +251,25 @@ ErrorType IpClient::receiveBlocking(std::string &buffer, const Milliseconds time
     ErrorType error = ErrorType::Failure;
     ssize_t bytesReceived = 0;
 
-    struct timeval timeoutval = {
-        .tv_sec = timeout / 1000,
-        .tv_usec = 0
-    };
-    fd_set readfds;
+    //Anything already read into the receive buffer comes before what is still in the socket.
+    if (!_receiveBuffer.empty()) {
+        const std::string_view buffered = _receiveBuffer.contiguous();
+        const Bytes bytesToCopy = std::min<Bytes>(buffer.size(), buffered.size());
+        buffer.assign(buffered.substr(0, bytesToCopy));
+        _receiveBuffer.consume(bytesToCopy);
+        _framer.reset();
+        return ErrorType::Success;
+    }
 
-    FD_ZERO(&readfds);
-    FD_SET(_socket, &readfds);
+    struct pollfd descriptor = {.fd = _socket, .events = POLLIN, .revents = 0};
 
     //Wait for input from the socket until the timeout
-    {
-    int ret;
-    ret = select(_socket + 1, &readfds, NULL, NULL, &timeoutval);
-    if (ret < 0) {
+    const int ready = poll(&descriptor, 1, timeout);
+    if (ready < 0) {
         return toPlatformError(errno);
     }
-    }
 
-    if (FD_ISSET(_socket, &readfds)) {
+    if (ready > 0) {
         if (-1 == (bytesReceived = recv(_socket, buffer.data(), buffer.size(), 0))) {
             error = toPlatformError(errno);
         }
@@ -114,63 +286,74 @@ ErrorType IpClient::receiveBlocking(std::string &buffer, const Milliseconds time
     }
 
     buffer.resize(0);
-    _status.connected = false;
+    //Nothing arriving in time says nothing about the connection.
+    if (ErrorType::Timeout != error) {
+        _status.connected = false;
+    }
 
     return error;
 }
 
 ErrorType IpClient::sendNonBlocking(const std::shared_ptr<std::string> data, const Milliseconds timeout, std::function<void(const ErrorType error, const Bytes bytesWritten)> callback) {
-    bool sent = false;
-
-    auto tx = [this, callback, &sent](const std::shared_ptr<std::string> frame, const Milliseconds timeout) -> ErrorType {
+    struct Result {
+        std::atomic<bool> sent = false;
         ErrorType error = ErrorType::Failure;
+    };
 
-        if (nullptr == frame.get()) {
-            assert(false);
-            return ErrorType::NoData;
-        }
+    //Shared with the queue since the message can outlive this call if the caller stops waiting.
+    auto result = std::make_shared<Result>();
 
-        error = sendBlocking(*frame, timeout);
+    auto tx = [this, callback, result](const ErrorType error, const Bytes bytesWritten) {
+        if (ErrorType::Success != error && ErrorType::Timeout != error) {
+            _status.connected = false;
+        }
 
         if (nullptr != callback) {
-            callback(error, frame->size());
+            callback(error, bytesWritten);
         }
 
-        sent = true;
-        return error;
+        result->error = error;
+        result->sent = true;
     };
 
-    std::unique_ptr<EventAbstraction> event = std::make_unique<EventQueue::Event<IpClient>>(std::bind(tx, data, timeout));
-    ErrorType error = network().addEvent(event);
+    ErrorType error = _sendQueue->enqueue(data, timeout, tx);
     if (ErrorType::Success != error) {
         return error;
     }
 
+    if (ErrorType::Success != (error = SendQueue::scheduleFlush(_sendQueue, network()))) {
+        //Nothing else will write the message out.
+        _sendQueue->cancel(error);
+        return error;
+    }
+
     //Block for the timeout specified if no callback is provided
     if (nullptr == callback) {
         Milliseconds i;
-        for (i = 0; i < timeout / 10 && !sent; i++) {
+        for (i = 0; i < timeout / 10 && !result->sent; i++) {
             OperatingSystem::Instance().delay(10);
         }
 
-        if (!sent && (timeout / 10) == i) {
+        if (!result->sent) {
             return ErrorType::Timeout;
         }
-        else if (!sent) {
-            return ErrorType::Failure;
-        }
-        else {
-            return ErrorType::Success;
-        }
+
+        return result->error;
     }
 
     return ErrorType::Success;
 }
 
 ErrorType IpClient::receiveNonBlocking(std::shared_ptr<std::string> buffer, const Milliseconds timeout, std::function<void(const ErrorType error, std::shared_ptr<std::string> buffer)> callback) {
-    bool received = false;
+    struct Result {
+        std::atomic<bool> received = false;
+        ErrorType error = ErrorType::Failure;
+    };
+
+    //Shared with the event since it runs after this returns when there is a callback.
+    auto result = std::make_shared<Result>();
 
-    auto rx = [this, callback, &received](const std::shared_ptr<std::string> buffer, const Milliseconds timeout) -> ErrorType {
+    auto rx = [this, callback, result](const std::shared_ptr<std::string> buffer, const Milliseconds timeout) -> ErrorType {
         ErrorType error = ErrorType::Failure;
 
         if (nullptr == buffer.get()) {
@@ -184,7 +367,8 @@ ErrorType IpClient::receiveNonBlocking(std::shared_ptr<std::string> buffer, cons
             callback(error, buffer);
         }
 
-        received = true;
+        result->error = error;
+        result->received = true;
         return error;
     };
 
@@ -197,20 +381,255 @@ ErrorType IpClient::receiveNonBlocking(std::shared_ptr<std::string> buffer, cons
     //Block for the timeout specified if no callback is provided
     if (nullptr == callback) {
         Milliseconds i;
-        for (i = 0; i < timeout / 10 && !received; i++) {
+        for (i = 0; i < timeout / 10 && !result->received; i++) {
             OperatingSystem::Instance().delay(10);
         }
 
-        if (!received && (timeout / 10) == i) {
+        if (!result->received) {
             return ErrorType::Timeout;
         }
-        else if (!received) {
-            return ErrorType::Failure;
+
+        return result->error;
+    }
+
+    return ErrorType::Success;
+}
+
+void IpClient::interleaveAddressFamilies(const std::vector<ResolvedAddress> &addresses, std::vector<const ResolvedAddress *> &candidates) {
+    std::vector<const ResolvedAddress *> preferredFamily;
+    std::vector<const ResolvedAddress *> otherFamily;
+
+    candidates.clear();
+    if (addresses.empty()) {
+        return;
+    }
+
+    //The resolver keeps the order from getaddrinfo which has already sorted them by destination address selection
+    //rules (RFC 6724) so the family of the first address is the one that we prefer.
+    for (const ResolvedAddress &address : addresses) {
+        if (address.family == addresses.front().family) {
+            preferredFamily.push_back(&address);
         }
         else {
+            otherFamily.push_back(&address);
+        }
+    }
+
+    //RFC 8305, Sect. 4. Alternate between families so that a broken family costs at most one connection attempt delay.
+    candidates.reserve(preferredFamily.size() + otherFamily.size());
+    for (size_t i = 0; i < std::max(preferredFamily.size(), otherFamily.size()); i++) {
+        if (i < preferredFamily.size()) {
+            candidates.push_back(preferredFamily[i]);
+        }
+        if (i < otherFamily.size()) {
+            candidates.push_back(otherFamily[i]);
+        }
+    }
+}
+
+ErrorType IpClient::raceConnections(const std::vector<const ResolvedAddress *> &candidates, const int socktype, Socket &sock, const Milliseconds timeout) {
+    using Clock = std::chrono::steady_clock;
+
+    const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout);
+    Clock::time_point nextAttempt = Clock::now();
+    std::vector<struct pollfd> attempts;
+    size_t nextCandidate = 0;
+    ErrorType error = ErrorType::Failure;
+
+    sock = -1;
+
+    if (candidates.empty()) {
+        return ErrorType::NoData;
+    }
+
+    auto closeAttempts = [&attempts]() {
+        for (const struct pollfd &attempt : attempts) {
+            close(attempt.fd);
+        }
+        attempts.clear();
+    };
+
+    while (-1 == sock) {
+        const Clock::time_point now = Clock::now();
+
+        if (now >= deadline) {
+            error = ErrorType::Timeout;
+            break;
+        }
+
+        //Start the next attempt when the previous one has had its head start or when there is nothing left in flight.
+        if (nextCandidate < candidates.size() && (attempts.empty() || now >= nextAttempt)) {
+            const ResolvedAddress *candidate = candidates[nextCandidate++];
+            nextAttempt = now + std::chrono::milliseconds(ConnectionAttemptDelay);
+
+            const Socket attempt = socket(candidate->family, socktype, 0);
+            if (-1 == attempt) {
+                error = toPlatformError(errno);
+                continue;
+            }
+
+            const int flags = fcntl(attempt, F_GETFL, 0);
+            if (-1 == flags || -1 == fcntl(attempt, F_SETFL, flags | O_NONBLOCK)) {
+                error = toPlatformError(errno);
+                close(attempt);
+                continue;
+            }
+
+            if (0 == connect(attempt, reinterpret_cast<const struct sockaddr *>(&candidate->address), candidate->length)) {
+                sock = attempt;
+                break;
+            }
+            else if (EINPROGRESS == errno) {
+                attempts.push_back({.fd = attempt, .events = POLLOUT, .revents = 0});
+            }
+            else {
+                error = toPlatformError(errno);
+                close(attempt);
+                //Nothing to wait for from this one so there is no reason to delay the next.
+                nextAttempt = now;
+            }
+
+            continue;
+        }
+
+        if (attempts.empty()) {
+            //Every candidate has failed.
+            break;
+        }
+
+        Clock::time_point wakeUp = deadline;
+        if (nextCandidate < candidates.size() && nextAttempt < wakeUp) {
+            wakeUp = nextAttempt;
+        }
+        const int pollTimeout = std::chrono::ceil<std::chrono::milliseconds>(wakeUp - now).count();
+
+        const int ready = poll(attempts.data(), attempts.size(), pollTimeout);
+        if (-1 == ready && EINTR != errno) {
+            error = toPlatformError(errno);
+            break;
+        }
+
+        for (size_t i = 0; i < attempts.size() && ready > 0;) {
+            if (0 == attempts[i].revents) {
+                i++;
+                continue;
+            }
+
+            int socketError = 0;
+            socklen_t socketErrorLength = sizeof(socketError);
+            if (-1 == getsockopt(attempts[i].fd, SOL_SOCKET, SO_ERROR, &socketError, &socketErrorLength)) {
+                socketError = errno;
+            }
+
+            if (0 == socketError) {
+                sock = attempts[i].fd;
+                attempts.erase(attempts.begin() + i);
+                break;
+            }
+
+            error = toPlatformError(socketError);
+            close(attempts[i].fd);
+            attempts.erase(attempts.begin() + i);
+            nextAttempt = Clock::now();
+        }
+    }
+
+    //The losers of the race are no longer needed.
+    closeAttempts();
+
+    if (-1 == sock) {
+        return error;
+    }
+
+    //The rest of the client uses blocking calls on the socket.
+    const int flags = fcntl(sock, F_GETFL, 0);
+    if (-1 == flags || -1 == fcntl(sock, F_SETFL, flags & ~O_NONBLOCK)) {
+        error = toPlatformError(errno);
+        close(sock);
+        sock = -1;
+        return error;
+    }
+
+    return ErrorType::Success;
+}
+
+ErrorType IpClient::setFraming(const FramingSettings::Settings &settings) {
+    _framer = StreamFramer(settings);
+    _receiveBuffer.clear();
+
+    return ErrorType::Success;
+}
+
+ErrorType IpClient::receiveFrame(std::string_view &frame, const Milliseconds timeout) {
+    using Clock = std::chrono::steady_clock;
+
+    const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout);
+
+    while (true) {
+        ErrorType error = _framer.nextFrame(_receiveBuffer, frame);
+        if (ErrorType::NoData != error) {
+            return error;
+        }
+
+        const Clock::time_point now = Clock::now();
+        if (now >= deadline) {
+            return ErrorType::Timeout;
+        }
+
+        error = fillReceiveBuffer(std::chrono::ceil<std::chrono::milliseconds>(deadline - now).count());
+        if (ErrorType::Success != error) {
+            return error;
+        }
+    }
+}
+
+void IpClient::releaseFrame() {
+    _framer.release(_receiveBuffer);
+}
+
+ErrorType IpClient::fillReceiveBuffer(const Milliseconds timeout) {
+    struct pollfd descriptor = {.fd = _socket, .events = POLLIN, .revents = 0};
+    std::array<std::span<char>, 2> regions;
+    std::array<struct iovec, 2> iov;
+
+    if (-1 == _socket) {
+        return ErrorType::PrerequisitesNotMet;
+    }
+
+    const int ready = poll(&descriptor, 1, timeout);
+    if (-1 == ready) {
+        return toPlatformError(errno);
+    }
+    else if (0 == ready) {
+        return ErrorType::Timeout;
+    }
+
+    ErrorType error = _receiveBuffer.reserve(MinimumReadSize);
+    if (ErrorType::Success != error && 0 == _receiveBuffer.available()) {
+        return error;
+    }
+
+    const Count regionCount = _receiveBuffer.freeRegions(regions);
+    for (Count i = 0; i < regionCount; i++) {
+        iov[i].iov_base = regions[i].data();
+        iov[i].iov_len = regions[i].size();
+    }
+
+    const ssize_t bytesReceived = readv(_socket, iov.data(), regionCount);
+    if (0 == bytesReceived) {
+        //Orderly shutdown from the peer.
+        _status.connected = false;
+        return ErrorType::Failure;
+    }
+    else if (-1 == bytesReceived) {
+        if (EINTR == errno || EAGAIN == errno) {
             return ErrorType::Success;
         }
+
+        _status.connected = false;
+        return toPlatformError(errno);
     }
 
+    _receiveBuffer.commit(bytesReceived);
     return ErrorType::Success;
 }
@@ -9,24 +9,182 @@
 
 //AbstractionLayer
 #include "IpClientAbstraction.hpp"
+//Modules
+#include "HostResolverModule.hpp"
+#include "SendQueueModule.hpp"
+#include "TcpTuningModule.hpp"
+//Applications
+#include "RingBuffer.hpp"
+#include "StreamFramer.hpp"
 //Posix
 #include <sys/socket.h>
+//C++
+#include <atomic>
+#include <memory>
+#include <vector>
 
 class IpClient : public IpClientAbstraction {
 
     public:
-    IpClient() : IpClientAbstraction() {};
-    ~IpClient() = default;
+    IpClient();
+    ~IpClient();
 
     ErrorType connectTo(std::string hostname, Port port, IpClientSettings::Protocol protocol, IpClientSettings::Version version, Socket &socket, Milliseconds timeout) override;
     ErrorType disconnect() override;
+    /**
+     * @brief Queue data to be sent by the network.
+     * @details The data is written as the socket accepts it, so a slow peer never blocks the network's event loop.
+     * @param[in] data The data to send
+     * @param[in] timeout The time allowed for all of the data to be written. The data is abandoned if it has not been written in time.
+     * @param[in] callback Called from the network's thread once the data has been sent or abandoned.
+     * @post If no callback is provided, the caller is blocked until the data is sent or the timeout expires.
+     * @returns ErrorType::Success if the data was queued, or sent if there is no callback.
+     * @returns ErrorType::LimitReached if the send queue is above its high watermark. Wait for the backpressure callback and try again.
+     * @returns ErrorType::Timeout if there is no callback and the data was not sent in time.
+     * @returns ErrorType::PrerequisitesNotMet if the client is not connected.
+     * @sa sendQueue
+    */
     ErrorType sendNonBlocking(const std::shared_ptr<std::string> data, const Milliseconds timeout, std::function<void(const ErrorType error, const Bytes bytesWritten)> callback = nullptr) override;
     ErrorType receiveNonBlocking(std::shared_ptr<std::string> buffer, const Milliseconds timeout, std::function<void(const ErrorType error, std::shared_ptr<std::string> buffer)> callback = nullptr) override;
 
+    /**
+     * @brief Check that the connection is still usable without blocking.
+     * @returns ErrorType::Success if the connection is open and has no unread data.
+     * @returns ErrorType::Failure if the peer has closed the connection or the socket has an error.
+     * @returns ErrorType::LimitReached if the connection is open but there is unread data waiting on it.
+     * @returns ErrorType::PrerequisitesNotMet if the client is not connected.
+    */
+    ErrorType checkHealth();
+
+    /**
+     * @brief Set how the received byte stream is split into messages for receiveFrame.
+     * @param[in] settings How to split the stream.
+     * @post Any bytes that were received but not yet framed are discarded.
+     * @returns ErrorType::Success
+    */
+    ErrorType setFraming(const FramingSettings::Settings &settings);
+    /**
+     * @brief Receive the next complete message.
+     * @details Reads as much as the socket has available into the receive buffer in one call so that messages that arrive together
+     *          are all framed from a single read.
+     * @param[out] frame The message. A view of the receive buffer that is valid until releaseFrame is called.
+     * @param[in] timeout The time to wait for a complete message.
+     * @returns ErrorType::Success if a message was received.
+     * @returns ErrorType::Timeout if a complete message was not received in time.
+     * @returns ErrorType::LimitReached if the message is too big for the frame settings or the receive buffer.
+     * @returns ErrorType::Failure if the connection was closed.
+     * @returns ErrorType::PrerequisitesNotMet if framing was not set.
+     * @sa setFraming
+    */
+    ErrorType receiveFrame(std::string_view &frame, const Milliseconds timeout);
+    /**
+     * @brief Release the message returned by receiveFrame so that the next message can be received.
+    */
+    void releaseFrame();
+
+    /**
+     * @brief Set the socket options of the connection.
+     * @param[in] settings The settings. Use TcpTuning::profile to start from one of the named profiles.
+     * @post The settings are applied by every connectTo after this and to the current connection if there is one.
+     * @returns ErrorType::Success if the settings were stored and applied to the current connection if there is one.
+     * @returns The errors of TcpTuning::apply otherwise. The settings are still used for later connections.
+    */
+    ErrorType setTuning(const TcpTuningSettings::Settings &settings);
+    /**
+     * @brief Get the kernel's statistics for the connection.
+     * @param[out] statistics The round trip time, congestion window, retransmits and byte counts of the connection.
+     * @returns ErrorType::PrerequisitesNotMet if there is no connection.
+     * @returns The errors of TcpTuning::statistics otherwise.
+    */
+    ErrorType tcpStatistics(TcpTuningSettings::Statistics &statistics);
+
+    /// @brief Get the send queue to set its watermarks and backpressure callback.
+    SendQueue &sendQueue() { return *_sendQueue; }
+
     private:
+    /// @brief The least amount of free space to give the socket on each read.
+    static constexpr Bytes MinimumReadSize = 2048;
+    /// @brief The number of semaphores that have been created.
+    static std::atomic<int> semaphoreCount;
+
+    /// @brief Incremented by the resolver's thread when it has answered a lookup for connectTo.
+    std::string _resolvedSemaphore;
+
+    /// @brief Bytes received from the socket that have not been handed out yet.
+    RingBuffer _receiveBuffer;
+    /// @brief Splits the received bytes into messages.
+    StreamFramer _framer;
+    /// @brief Data waiting for the socket to accept it. Shared with the flushes waiting on the network's event queue.
+    std::shared_ptr<SendQueue> _sendQueue = std::make_shared<SendQueue>();
+    /// @brief The socket options applied to each connection.
+    TcpTuningSettings::Settings _tuning;
+
+    /// @brief RFC 8305, Sect. 5. The head start given to a connection attempt before the next candidate address is tried.
+    static constexpr Milliseconds ConnectionAttemptDelay = 250;
+
     ErrorType sendBlocking(const std::string &data, const Milliseconds timeout) override;
     ErrorType receiveBlocking(std::string &buffer, const Milliseconds timeout) override;
 
+    /**
+     * @brief Resolve the hostname and connect to the first address that answers.
+     * @param[in] hostname The hostname to connect to
+     * @param[in] port The port to connect to
+     * @param[in] family The posix address family to connect with, or AF_UNSPEC for any.
+     * @param[in] socktype The posix socket type to connect with.
+     * @param[out] sock The connected socket.
+     * @param[in] timeout The time allowed for resolving and connecting.
+     * @returns The errors of resolve and raceConnections.
+    */
+    ErrorType connectRemote(const std::string &hostname, const Port port, const int family, const int socktype, Socket &sock, const Milliseconds timeout);
+    /**
+     * @brief Resolve a hostname on the resolver's thread so that a slow resolver can be given up on once the timeout expires.
+     * @param[in] hostname The hostname to resolve.
+     * @param[out] addresses The addresses that the hostname resolved to.
+     * @param[in] timeout The time to wait for the answer.
+     * @returns ErrorType::Timeout if the resolver did not answer in time. The answer is still cached for the next attempt.
+     * @returns The errors of HostResolver::resolveNonBlocking and its callback otherwise.
+    */
+    ErrorType resolve(const std::string &hostname, std::vector<ResolvedAddress> &addresses, const Milliseconds timeout);
+    /**
+     * @brief Connect to a Unix domain socket.
+     * @param[in] path The path of the socket.
+     * @param[in] socktype The posix socket type to connect with.
+     * @param[out] sock The connected socket.
+     * @returns ErrorType::Success if the connection was made.
+     * @returns ErrorType::InvalidParameter if the path is empty or too long.
+     * @returns The error of connect otherwise.
+    */
+    ErrorType connectLocal(const std::string &path, const int socktype, Socket &sock);
+    /**
+     * @brief Order the resolved addresses so that the address families alternate.
+     * @param[in] addresses The addresses returned by the resolver.
+     * @param[out] candidates The addresses in the order that connections should be attempted.
+    */
+    void interleaveAddressFamilies(const std::vector<ResolvedAddress> &addresses, std::vector<const ResolvedAddress *> &candidates);
+    /**
+     * @brief Race non-blocking connections to the candidate addresses (Happy Eyeballs, RFC 8305).
+     * @details A new attempt is started every ConnectionAttemptDelay, or as soon as an attempt fails, while the earlier attempts
+     *          are still in flight. The first attempt to complete wins and all of the others are closed.
+     * @param[in] candidates The addresses to connect to in order of preference.
+     * @param[in] socktype The posix socket type to connect with.
+     * @param[out] sock The connected socket. Set to -1 if no connection could be made.
+     * @param[in] timeout The time allowed for the whole race.
+     * @returns ErrorType::Success if a connection was made.
+     * @returns ErrorType::Timeout if no connection was made before the timeout.
+     * @returns ErrorType::NoData if there are no candidates.
+     * @returns The error of the last failed attempt if every candidate failed.
+    */
+    ErrorType raceConnections(const std::vector<const ResolvedAddress *> &candidates, const int socktype, Socket &sock, const Milliseconds timeout);
+    /**
+     * @brief Wait for the socket to be readable and read everything available into the receive buffer with a single scatter read.
+     * @param[in] timeout The time to wait for the socket to be readable.
+     * @returns ErrorType::Success if at least one byte was read.
+     * @returns ErrorType::Timeout if nothing was received in time.
+     * @returns ErrorType::LimitReached if the receive buffer is full.
+     * @returns ErrorType::Failure if the connection was closed.
+    */
+    ErrorType fillReceiveBuffer(const Milliseconds timeout);
+
     int toPosixFamily(IpClientSettings::Version version) {
         switch (version) {
             case IpClientSettings::Version::IPv4:
@@ -44,10 +202,18 @@ class IpClient : public IpClientAbstraction {
                 return SOCK_STREAM;
             case IpClientSettings::Protocol::Udp:
                 return SOCK_DGRAM;
+            case IpClientSettings::Protocol::UnixStream:
+                return SOCK_STREAM;
+            case IpClientSettings::Protocol::UnixSeqpacket:
+                return SOCK_SEQPACKET;
             default:
                 return SOCK_RAW;
         }
     }
+
+    bool isLocal(IpClientSettings::Protocol protocol) {
+        return IpClientSettings::Protocol::UnixStream == protocol || IpClientSettings::Protocol::UnixSeqpacket == protocol;
+    }
 };
 
 #endif // __IP_CLIENT_MODULE_HPP__
\ No newline at end of file
@@ -0,0 +1,195 @@
+//Modules
+#include "IpClientPoolModule.hpp"
+#include "OperatingSystemModule.hpp"
+//C++
+#include <cassert>
+
+std::atomic<int> IpClientPool::semaphoreCount(0);
+
+IpClientPool::IpClientPool(NetworkAbstraction &network, Count maxPerHost, Milliseconds idleTimeout) : EventQueue(), _network(network), _maxPerHost(maxPerHost), _idleTimeout(idleTimeout) {
+    assert(maxPerHost > 0);
+
+    const int instance = ++semaphoreCount;
+    _poolSemaphore = std::string("ipClientPoolSemaphore").append(std::to_string(instance));
+    ErrorType error = OperatingSystem::Instance().createSemaphore(1, 1, _poolSemaphore);
+    assert(ErrorType::Success == error);
+}
+
+IpClientPool::~IpClientPool() {
+    OperatingSystem::Instance().deleteSemaphore(_poolSemaphore);
+}
+
+ErrorType IpClientPool::mainLoop() {
+    reapIdle();
+    return runNextEvent();
+}
+
+ErrorType IpClientPool::lease(const std::string &hostname, Port port, IpClientSettings::Protocol protocol, IpClientSettings::Version version, std::unique_ptr<IpClient> &client, Milliseconds timeout) {
+    constexpr Milliseconds limitDelay = 10;
+    const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout);
+    const Key key(hostname, port, protocol);
+
+    while (true) {
+        const Clock::time_point now = Clock::now();
+
+        if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(_poolSemaphore, SemaphoreTimeout)) {
+            return ErrorType::Timeout;
+        }
+
+        Host &host = _hosts[key];
+
+        client = takeIdle(host, now);
+        if (nullptr != client) {
+            host.leased++;
+            OperatingSystem::Instance().incrementSemaphore(_poolSemaphore);
+            return ErrorType::Success;
+        }
+
+        //takeIdle leaves no idle clients behind, but they count towards the limit all the same.
+        if (host.leased + host.idle.size() < _maxPerHost) {
+            //Reserve our place before connecting so that the limit still holds while the semaphore is released.
+            host.leased++;
+            OperatingSystem::Instance().incrementSemaphore(_poolSemaphore);
+            break;
+        }
+
+        OperatingSystem::Instance().incrementSemaphore(_poolSemaphore);
+
+        if (now >= deadline) {
+            return ErrorType::LimitReached;
+        }
+        OperatingSystem::Instance().delay(limitDelay);
+    }
+
+    const Clock::time_point now = Clock::now();
+    const Milliseconds remaining = now >= deadline ? 0 : std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+    Socket sock = -1;
+
+    client = std::make_unique<IpClient>();
+    client->setNetwork(_network);
+    ErrorType error = client->connectTo(hostname, port, protocol, version, sock, remaining);
+
+    if (ErrorType::Success != error) {
+        client.reset();
+
+        if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(_poolSemaphore, SemaphoreTimeout)) {
+            return ErrorType::Timeout;
+        }
+
+        assert(_hosts[key].leased > 0);
+        _hosts[key].leased--;
+        OperatingSystem::Instance().incrementSemaphore(_poolSemaphore);
+    }
+
+    return error;
+}
+
+ErrorType IpClientPool::giveBack(std::unique_ptr<IpClient> &client) {
+    if (nullptr == client) {
+        return ErrorType::InvalidParameter;
+    }
+
+    const Key key(client->hostnameConst(), client->portConst(), client->protocolConst());
+    const bool healthy = ErrorType::Success == client->checkHealth();
+
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(_poolSemaphore, SemaphoreTimeout)) {
+        return ErrorType::Timeout;
+    }
+
+    auto host = _hosts.find(key);
+    if (host == _hosts.end() || 0 == host->second.leased) {
+        OperatingSystem::Instance().incrementSemaphore(_poolSemaphore);
+        return ErrorType::InvalidParameter;
+    }
+
+    host->second.leased--;
+    if (healthy) {
+        host->second.idle.push_back({std::move(client), Clock::now()});
+    }
+
+    OperatingSystem::Instance().incrementSemaphore(_poolSemaphore);
+
+    //Destroying the client closes the connection.
+    client.reset();
+    return healthy ? ErrorType::Success : ErrorType::Failure;
+}
+
+Count IpClientPool::idleConnections() {
+    Count idle = 0;
+
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(_poolSemaphore, SemaphoreTimeout)) {
+        return 0;
+    }
+
+    for (const auto &host : _hosts) {
+        idle += host.second.idle.size();
+    }
+    OperatingSystem::Instance().incrementSemaphore(_poolSemaphore);
+
+    return idle;
+}
+
+Count IpClientPool::leasedConnections() {
+    Count leased = 0;
+
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(_poolSemaphore, SemaphoreTimeout)) {
+        return 0;
+    }
+
+    for (const auto &host : _hosts) {
+        leased += host.second.leased;
+    }
+    OperatingSystem::Instance().incrementSemaphore(_poolSemaphore);
+
+    return leased;
+}
+
+std::unique_ptr<IpClient> IpClientPool::takeIdle(Host &host, const Clock::time_point now) {
+    //Take the most recently used first. It is the least likely to have been dropped by a NAT or the server.
+    while (!host.idle.empty()) {
+        IdleClient idle = std::move(host.idle.back());
+        host.idle.pop_back();
+
+        if (now - idle.idleSince < std::chrono::milliseconds(_idleTimeout) && ErrorType::Success == idle.client->checkHealth()) {
+            return std::move(idle.client);
+        }
+    }
+
+    return nullptr;
+}
+
+Count IpClientPool::reapIdle() {
+    const Clock::time_point now = Clock::now();
+    std::vector<std::unique_ptr<IpClient>> expired;
+
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(_poolSemaphore, SemaphoreTimeout)) {
+        return 0;
+    }
+
+    for (auto host = _hosts.begin(); host != _hosts.end();) {
+        auto &idle = host->second.idle;
+
+        for (auto it = idle.begin(); it != idle.end();) {
+            if (now - it->idleSince >= std::chrono::milliseconds(_idleTimeout)) {
+                expired.push_back(std::move(it->client));
+                it = idle.erase(it);
+            }
+            else {
+                it++;
+            }
+        }
+
+        //Forget about hosts we're no longer talking to.
+        if (idle.empty() && 0 == host->second.leased) {
+            host = _hosts.erase(host);
+        }
+        else {
+            host++;
+        }
+    }
+
+    OperatingSystem::Instance().incrementSemaphore(_poolSemaphore);
+
+    //Close the connections after releasing the semaphore since shutdown can take a while.
+    return expired.size();
+}
@@ -0,0 +1,146 @@
+/***************************************************************************//**
+* @author   Ben Haubrich
+* @file     IpClientPoolModule.hpp
+* @details  Pool of persistent IP client connections for posix compliant systems.
+* @ingroup  PosixModules
+*******************************************************************************/
+#ifndef __IP_CLIENT_POOL_MODULE_HPP__
+#define __IP_CLIENT_POOL_MODULE_HPP__
+
+//AbstractionLayer
+#include "EventQueue.hpp"
+#include "NetworkAbstraction.hpp"
+//Modules
+#include "IpClientModule.hpp"
+//C++
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+/**
+ * @class IpClientPool
+ * @brief Keeps connections open after use so that later requests to the same host skip the handshake.
+ * @details Connections are keyed by hostname, port and protocol. A leased client belongs to the caller until it is given back.
+ *          Clients that are given back are health checked before they are put back in the pool and again before they are leased
+ *          out. Idle clients are closed by mainLoop once they have been idle for longer than the idle timeout.
+ * @code
+ * IpClientPool pool(wifi);
+ * std::unique_ptr<IpClient> client;
+ *
+ * if (ErrorType::Success == pool.lease("cloud.example.com", 443, IpClientSettings::Protocol::Tcp, IpClientSettings::Version::Unknown, client, 5000)) {
+ *     //Use the client...
+ *     pool.giveBack(client);
+ * }
+ * @endcode
+*/
+class IpClientPool : public EventQueue {
+
+    public:
+    /// @brief The default maximum number of connections, leased and idle, to a single host.
+    static constexpr Count DefaultMaxPerHost = 4;
+    /// @brief The default time that a connection can be idle before it is closed.
+    static constexpr Milliseconds DefaultIdleTimeout = 60000;
+
+    /**
+     * @brief Constructor.
+     * @param[in] network The network that the pooled clients communicate on.
+     * @param[in] maxPerHost The maximum number of connections, leased and idle, to a single host.
+     * @param[in] idleTimeout The time that a connection can be idle before it is closed.
+    */
+    IpClientPool(NetworkAbstraction &network, Count maxPerHost = DefaultMaxPerHost, Milliseconds idleTimeout = DefaultIdleTimeout);
+    ~IpClientPool();
+
+    /**
+     * @brief Close idle connections and run queued events.
+     * @returns The error codes of runNextEvent.
+    */
+    ErrorType mainLoop() override;
+
+    /**
+     * @brief Lease a connected client, reusing an idle connection to the host if there is one.
+     * @param[in] hostname The hostname to connect to
+     * @param[in] port The port to connect to
+     * @param[in] protocol The protocol to use
+     * @param[in] version The version to use when a new connection has to be made.
+     * @param[out] client The leased client.
+     * @param[in] timeout The time to wait for a connection, including the time waiting for a connection to be given back when the
+     *                    host is at its limit.
+     * @post The caller owns the client until it is given back.
+     * @returns ErrorType::Success if a connected client was leased.
+     * @returns ErrorType::LimitReached if the host is at its limit and no connection was given back in time.
+     * @returns ErrorType::Timeout if the pool could not be locked in time.
+     * @returns The errors of IpClient::connectTo if a new connection could not be made.
+    */
+    ErrorType lease(const std::string &hostname, Port port, IpClientSettings::Protocol protocol, IpClientSettings::Version version, std::unique_ptr<IpClient> &client, Milliseconds timeout);
+    /**
+     * @brief Give a leased client back to the pool.
+     * @param[in] client The client to give back.
+     * @post Unless the pool could not be locked in time, the client is kept for reuse if it is still healthy and closed otherwise, and client is nullptr.
+     * @returns ErrorType::Success if the client was kept for reuse.
+     * @returns ErrorType::Failure if the client was closed.
+     * @returns ErrorType::InvalidParameter if client is nullptr or was not leased from this pool.
+     * @returns ErrorType::Timeout if the pool could not be locked in time. The client is left with the caller.
+    */
+    ErrorType giveBack(std::unique_ptr<IpClient> &client);
+
+    /// @brief The number of idle connections in the pool. 0 if the pool could not be locked in time.
+    Count idleConnections();
+    /// @brief The number of connections that are leased out. 0 if the pool could not be locked in time.
+    Count leasedConnections();
+
+    private:
+    using Clock = std::chrono::steady_clock;
+    using Key = std::tuple<std::string, Port, IpClientSettings::Protocol>;
+
+    /// @brief The timeout for semaphore operations.
+    static constexpr Milliseconds SemaphoreTimeout = 1000;
+
+    /**
+     * @struct IdleClient
+     * @brief A connection waiting in the pool to be leased.
+    */
+    struct IdleClient {
+        std::unique_ptr<IpClient> client; ///< The connected client.
+        Clock::time_point idleSince;      ///< When the client was given back.
+    };
+
+    /**
+     * @struct Host
+     * @brief The connections to a single host.
+    */
+    struct Host {
+        std::vector<IdleClient> idle; ///< Connections waiting to be leased. The most recently used is at the back.
+        Count leased = 0;             ///< Connections that are leased out, or are being connected for a lease.
+    };
+
+    /// @brief The number of semaphores that have been created.
+    static std::atomic<int> semaphoreCount;
+    /// @brief Guards the hosts.
+    std::string _poolSemaphore;
+    /// @brief The network that the pooled clients communicate on.
+    NetworkAbstraction &_network;
+    /// @brief The maximum number of connections, leased and idle, to a single host.
+    Count _maxPerHost;
+    /// @brief The time that a connection can be idle before it is closed.
+    Milliseconds _idleTimeout;
+    /// @brief The connections to each host.
+    std::map<Key, Host> _hosts;
+
+    /**
+     * @brief Take a healthy idle client for the host, closing any unhealthy or expired ones found along the way.
+     * @pre The pool semaphore is held.
+     * @returns A client, or nullptr if there are no healthy idle clients.
+    */
+    std::unique_ptr<IpClient> takeIdle(Host &host, const Clock::time_point now);
+    /**
+     * @brief Close the connections that have been idle for too long.
+     * @returns The number of connections that were closed. 0 if the pool could not be locked in time.
+    */
+    Count reapIdle();
+};
+
+#endif // __IP_CLIENT_POOL_MODULE_HPP__
@@ -7,57 +7,64 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/un.h>
 //Stdlib
 #include <unistd.h>
 //C++
 #include <cassert>
 #include <cstring>
+#include <array>
 
-ErrorType IpServer::listenTo(IpServerSettings::Protocol protocol, IpServerSettings::Version version, Port port) {
-    Socket sock = -1;
-    struct addrinfo hints;
-    struct addrinfo *servinfo = nullptr;
-    struct addrinfo *p = nullptr;
-    char portString[] = "65535";
+namespace {
+    void toPeerAddress(const struct sockaddr_storage &address, PeerAddress &peer) {
+        char presentation[INET6_ADDRSTRLEN] = {0};
+        peer = PeerAddress();
 
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_family = toPosixFamily(version);
-    hints.ai_socktype = toPosixSocktype(protocol);
-    hints.ai_flags = AI_PASSIVE;
+        if (AF_INET == address.ss_family) {
+            const struct sockaddr_in *ipv4 = reinterpret_cast<const struct sockaddr_in *>(&address);
+            inet_ntop(AF_INET, &ipv4->sin_addr, presentation, sizeof(presentation));
+            peer.version = IpServerSettings::Version::IPv4;
+            peer.port = ntohs(ipv4->sin_port);
+        }
+        else if (AF_INET6 == address.ss_family) {
+            const struct sockaddr_in6 *ipv6 = reinterpret_cast<const struct sockaddr_in6 *>(&address);
+            peer.port = ntohs(ipv6->sin6_port);
 
-    assert(snprintf(portString, sizeof(portString), "%u", port) > 0);
+            if (IN6_IS_ADDR_V4MAPPED(&ipv6->sin6_addr)) {
+                //The last four bytes are the IPv4 address.
+                inet_ntop(AF_INET, &ipv6->sin6_addr.s6_addr[12], presentation, sizeof(presentation));
+                peer.version = IpServerSettings::Version::IPv4;
+            }
+            else {
+                inet_ntop(AF_INET6, &ipv6->sin6_addr, presentation, sizeof(presentation));
+                peer.version = IpServerSettings::Version::IPv6;
+            }
+        }
 
-    if (0 != getaddrinfo(nullptr, portString, &hints, &servinfo)) {
-        return toPlatformError(errno);
+        peer.address = presentation;
     }
+}
 
-    for (p = servinfo; p != nullptr; p = p->ai_next) {
-        if (-1 == (sock = socket(p->ai_family, p->ai_socktype, p->ai_protocol))) {
-            continue;
-        }
-        
-        int enable = 1;
-        if (-1 == setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable))) {
-            return toPlatformError(errno);
-        }
-
-        if (-1 == bind(sock, p->ai_addr, p->ai_addrlen)) {
-            close(sock);
-            continue;
-        }
+ErrorType IpServer::listenTo(IpServerSettings::Protocol protocol, IpServerSettings::Version version, Port port) {
+    Socket sock = -1;
 
-        break;
+    //A dual stack server falls back to IPv4 on hosts without IPv6.
+    ErrorType error = openSocket(protocol, version, port, false, sock);
+    if (ErrorType::Success != error) {
+        return error;
     }
 
     //For more connections, create another instance of this class.
     _status.listening = true;
     if (-1 == listen(sock, 1)) {
+        error = toPlatformError(errno);
+        close(sock);
         _status.listening = false;
-        return toPlatformError(errno);
+        return error;
     }
 
-    freeaddrinfo(servinfo);
-
     //Socket is still invalid. The socket we just had is only for listening for connections.
     //The socket we get from accept can be used to send and received which is the one we want
     //to return to the user.
@@ -68,35 +75,130 @@ ErrorType IpServer::listenTo(IpServerSettings::Protocol protocol, IpServerSettin
 
     return ErrorType::Success;
 }
+ErrorType IpServer::listenToLocal(IpServerSettings::Protocol protocol, const std::string &path) {
+    struct sockaddr_un address = {};
+    ErrorType error;
+
+    if (!isLocal(protocol) || path.empty() || path.size() >= sizeof(address.sun_path)) {
+        return ErrorType::InvalidParameter;
+    }
+
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path.data(), path.size());
+
+    const Socket sock = socket(AF_UNIX, toPosixSocktype(protocol), 0);
+    if (-1 == sock) {
+        return toPlatformError(errno);
+    }
+
+    //The socket file outlives the process that bound it so one left behind by an earlier run would stop us binding.
+    unlink(path.c_str());
+
+    if (-1 == bind(sock, reinterpret_cast<const struct sockaddr *>(&address), sizeof(address)) || -1 == listen(sock, 1)) {
+        error = toPlatformError(errno);
+        close(sock);
+        return error;
+    }
+
+    _socket = sock;
+    _protocol = protocol;
+    _version = IpServerSettings::Version::Unknown;
+    _port = 0;
+    _status.listening = true;
+
+    return ErrorType::Success;
+}
+
 ErrorType IpServer::acceptConnection(Socket &socket) {
     struct sockaddr_storage clientAddress;
-    socklen_t receiveSocketSize;
+    socklen_t receiveSocketSize = sizeof(clientAddress);
 
     if (-1 == (socket = accept(_socket, (struct sockaddr *)&clientAddress, &receiveSocketSize))) {
         return toPlatformError(errno);
     }
 
+    toPeerAddress(clientAddress, _peer);
+
         //Overwrite the socket we used to listen for connections with the one that will be used to send and received
         //Since we only accept one connection per class.
+        close(_socket);
         _socket = socket;
+        _accepted = true;
+        if (!isLocal(_protocol)) {
+            TcpTuning::apply(socket, _tuning);
+        }
+        _sendQueue->setSocket(socket);
     return ErrorType::Success;
 }
 
+ErrorType IpServer::setTuning(const TcpTuningSettings::Settings &settings) {
+    _tuning = settings;
+
+    if (!_accepted || isLocal(_protocol)) {
+        //Only the accepted connection is tuned. The options of the listening socket are left alone.
+        return ErrorType::Success;
+    }
+
+    return TcpTuning::apply(_socket, _tuning);
+}
+
+ErrorType IpServer::tcpStatistics(TcpTuningSettings::Statistics &statistics) {
+    if (!_accepted) {
+        return ErrorType::PrerequisitesNotMet;
+    }
+    else if (isLocal(_protocol)) {
+        return ErrorType::NotSupported;
+    }
+
+    return TcpTuning::statistics(_socket, statistics);
+}
+
 ErrorType IpServer::closeConnection() {
-    return ErrorType::NotImplemented;
+    _sendQueue->setSocket(-1);
+
+    if (-1 != _socket) {
+        if (_accepted) {
+            shutdown(_socket, SHUT_RDWR);
+        }
+        close(_socket);
+        _socket = -1;
+    }
+
+    _accepted = false;
+    _peer = PeerAddress();
+    _status.listening = false;
+    return ErrorType::Success;
 }
 
-ErrorType IpServer::sendBlocking(const std::string &data, const Milliseconds timeout) {
-    ssize_t bytesSent = 0;
-    if (-1 == (bytesSent = send(_socket, data.data(), data.size(), 0))) {
+ErrorType IpServer::peerAddress(const Socket socket, PeerAddress &peer) {
+    struct sockaddr_storage address = {};
+    socklen_t length = sizeof(address);
+
+    if (-1 == getpeername(socket, reinterpret_cast<struct sockaddr *>(&address), &length)) {
         return toPlatformError(errno);
     }
 
+    toPeerAddress(address, peer);
     return ErrorType::Success;
 }
 
+ErrorType IpServer::sendBlocking(const std::string &data, const Milliseconds timeout) {
+    return _sendQueue->sendBlocking(data, timeout);
+}
+
 ErrorType IpServer::receiveBlocking(std::string &buffer, const Milliseconds timeout) {
     ssize_t bytesReceived = 0;
+    struct pollfd descriptor = {.fd = _socket, .events = POLLIN, .revents = 0};
+
+    //Don't hold the network's event loop for longer than the caller asked for.
+    const int ready = poll(&descriptor, 1, timeout);
+    if (-1 == ready) {
+        return toPlatformError(errno);
+    }
+    else if (0 == ready) {
+        buffer.resize(0);
+        return ErrorType::Timeout;
+    }
 
     if (-1 == (bytesReceived = (recv(_socket, buffer.data(), buffer.size(), 0)))) {
         return toPlatformError(errno);
@@ -107,12 +209,60 @@ ErrorType IpServer::receiveBlocking(std::string &buffer, const Milliseconds time
     return ErrorType::Success;
 }
 ErrorType IpServer::sendNonBlocking(const std::shared_ptr<std::string> data, const Milliseconds timeout, std::function<void(const ErrorType error, const Bytes bytesWritten)> callback) {
-    return ErrorType::NotImplemented;
+    struct Result {
+        std::atomic<bool> sent = false;
+        ErrorType error = ErrorType::Failure;
+    };
+
+    //Shared with the queue since the message can outlive this call if the caller stops waiting.
+    auto result = std::make_shared<Result>();
+
+    auto tx = [callback, result](const ErrorType error, const Bytes bytesWritten) {
+        if (nullptr != callback) {
+            callback(error, bytesWritten);
+        }
+
+        result->error = error;
+        result->sent = true;
+    };
+
+    ErrorType error = _sendQueue->enqueue(data, timeout, tx);
+    if (ErrorType::Success != error) {
+        return error;
+    }
+
+    if (ErrorType::Success != (error = SendQueue::scheduleFlush(_sendQueue, network()))) {
+        //Nothing else will write the message out.
+        _sendQueue->cancel(error);
+        return error;
+    }
+
+    //Block for the timeout specified if no callback is provided
+    if (nullptr == callback) {
+        Milliseconds i;
+        for (i = 0; i < timeout / 10 && !result->sent; i++) {
+            OperatingSystem::Instance().delay(10);
+        }
+
+        if (!result->sent) {
+            return ErrorType::Timeout;
+        }
+
+        return result->error;
+    }
+
+    return ErrorType::Success;
 }
 ErrorType IpServer::receiveNonBlocking(std::shared_ptr<std::string> buffer, const Milliseconds timeout, std::function<void(const ErrorType error, std::shared_ptr<std::string> buffer)> callback) {
-    bool received = false;
+    struct Result {
+        std::atomic<bool> received = false;
+        ErrorType error = ErrorType::Failure;
+    };
+
+    //Shared with the event since it runs after this returns when there is a callback.
+    auto result = std::make_shared<Result>();
 
-    auto rx = [this, callback, &received](const std::shared_ptr<std::string> buffer, const Milliseconds timeout) -> ErrorType {
+    auto rx = [this, callback, result](const std::shared_ptr<std::string> buffer, const Milliseconds timeout) -> ErrorType {
         ErrorType error = ErrorType::Failure;
 
         if (nullptr == buffer.get()) {
@@ -126,7 +276,8 @@ ErrorType IpServer::receiveNonBlocking(std::shared_ptr<std::string> buffer, cons
             callback(error, buffer);
         }
 
-        received = true;
+        result->error = error;
+        result->received = true;
         return error;
     };
 
@@ -139,20 +290,242 @@ ErrorType IpServer::receiveNonBlocking(std::shared_ptr<std::string> buffer, cons
     //Block for the timeout specified if no callback is provided
     if (nullptr == callback) {
         Milliseconds i;
-        for (i = 0; i < timeout / 10 && !received; i++) {
+        for (i = 0; i < timeout / 10 && !result->received; i++) {
             OperatingSystem::Instance().delay(10);
         }
 
-        if (!received && (timeout / 10) == i) {
+        if (!result->received) {
             return ErrorType::Timeout;
         }
-        else if (!received) {
-            return ErrorType::Failure;
+
+        return result->error;
+    }
+
+    return ErrorType::Success;
+}
+
+ErrorType IpServer::listenToSharded(IpServerSettings::Protocol protocol, IpServerSettings::Version version, Port port, Count workers, std::function<void(const Socket socket, const Id worker)> onAccept) {
+    ErrorType error = ErrorType::Success;
+
+    if (0 == workers || nullptr == onAccept) {
+        return ErrorType::InvalidParameter;
+    }
+
+    if (_status.listening) {
+        return ErrorType::PrerequisitesNotMet;
+    }
+
+    for (Id worker = 0; worker < workers; worker++) {
+        Socket sock = -1;
+
+        if (ErrorType::Success != (error = openSocket(protocol, version, port, true, sock))) {
+            break;
+        }
+
+        //Accept is called until it would block so that a burst of connections is drained in one wake up.
+        const int flags = fcntl(sock, F_GETFL, 0);
+        if (-1 == flags || -1 == fcntl(sock, F_SETFL, flags | O_NONBLOCK) || -1 == listen(sock, SOMAXCONN)) {
+            error = toPlatformError(errno);
+            close(sock);
+            break;
         }
-        else {
-            return ErrorType::Success;
+
+        _shards.push_back(std::make_unique<Shard>(sock, worker, onAccept));
+    }
+
+    if (ErrorType::Success == error) {
+        for (auto &shard : _shards) {
+            Id threadId;
+            shard->threadName() = std::string("ipServerShard").append(std::to_string(port)).append("_").append(std::to_string(&shard - _shards.data()));
+
+            error = OperatingSystem::Instance().createThread(OperatingSystemConfig::Priority::Normal, shard->threadNameConst(), shard.get(), ShardStackSize, runShard, threadId);
+            if (ErrorType::Success != error) {
+                shard->threadName().clear();
+                break;
+            }
+        }
+    }
+
+    if (ErrorType::Success != error) {
+        stopSharded();
+        return error;
+    }
+
+    _protocol = protocol;
+    _version = version;
+    _port = port;
+    _status.listening = true;
+
+    return ErrorType::Success;
+}
+
+ErrorType IpServer::stopSharded() {
+    for (auto &shard : _shards) {
+        shard->stop();
+    }
+
+    for (auto &shard : _shards) {
+        if (!shard->threadNameConst().empty()) {
+            OperatingSystem::Instance().joinThread(shard->threadNameConst());
+            OperatingSystem::Instance().deleteThread(shard->threadNameConst());
         }
     }
 
+    if (!_shards.empty()) {
+        _shards.clear();
+        _status.listening = false;
+    }
+
     return ErrorType::Success;
-}
\ No newline at end of file
+}
+
+EventQueue *IpServer::shardEventQueue(const Id worker) {
+    if (worker >= _shards.size()) {
+        return nullptr;
+    }
+
+    return _shards[worker].get();
+}
+
+ErrorType IpServer::openSocket(IpServerSettings::Protocol protocol, IpServerSettings::Version &version, Port port, bool reusePort, Socket &sock) {
+    struct addrinfo hints;
+    struct addrinfo *servinfo = nullptr;
+    char portString[] = "65535";
+    ErrorType error = ErrorType::Failure;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = toPosixFamily(version);
+    hints.ai_socktype = toPosixSocktype(protocol);
+    hints.ai_flags = AI_PASSIVE;
+
+    const int written = snprintf(portString, sizeof(portString), "%u", port);
+    assert(written > 0);
+
+    bool familyUnsupported = false;
+    const int result = getaddrinfo(nullptr, portString, &hints, &servinfo);
+    if (0 != result) {
+        familyUnsupported = EAI_FAMILY == result || EAI_ADDRFAMILY == result || EAI_NONAME == result;
+        error = EAI_SYSTEM == result ? toPlatformError(errno) : ErrorType::Failure;
+    }
+
+    sock = -1;
+    for (struct addrinfo *p = servinfo; p != nullptr; p = p->ai_next) {
+        if (-1 == (sock = socket(p->ai_family, p->ai_socktype, p->ai_protocol))) {
+            familyUnsupported = familyUnsupported || EAFNOSUPPORT == errno;
+            error = toPlatformError(errno);
+            continue;
+        }
+
+        int enable = 1;
+        int disable = 0;
+        if (-1 == setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) ||
+            (reusePort && -1 == setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable))) ||
+            //IPv4 clients show up as IPv4-mapped addresses on the same socket.
+            (IpServerSettings::Version::DualStack == version && AF_INET6 == p->ai_family && -1 == setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY, &disable, sizeof(disable)))) {
+            error = toPlatformError(errno);
+            close(sock);
+            sock = -1;
+            break;
+        }
+
+        if (-1 == bind(sock, p->ai_addr, p->ai_addrlen)) {
+            error = toPlatformError(errno);
+            close(sock);
+            sock = -1;
+            continue;
+        }
+
+        error = ErrorType::Success;
+        break;
+    }
+
+    if (nullptr != servinfo) {
+        freeaddrinfo(servinfo);
+    }
+
+    if (ErrorType::Success != error && familyUnsupported && IpServerSettings::Version::DualStack == version) {
+        //No IPv6 on this host so IPv4 is all that can be served.
+        version = IpServerSettings::Version::IPv4;
+        return openSocket(protocol, version, port, reusePort, sock);
+    }
+
+    return error;
+}
+
+void *IpServer::runShard(void *arg) {
+    Shard *shard = static_cast<Shard *>(arg);
+    assert(nullptr != shard);
+
+    while (shard->running()) {
+        shard->mainLoop();
+    }
+
+    return nullptr;
+}
+
+IpServer::Shard::Shard(Socket listener, Id worker, std::function<void(const Socket socket, const Id worker)> onAccept) : EventQueue(), _listener(listener), _worker(worker), _onAccept(onAccept), _running(true) {
+    //Non-blocking so that waking a worker that is already awake never blocks and so that the worker can drain it.
+    int result = pipe(_wakePipe);
+    assert(0 == result);
+    for (const int end : _wakePipe) {
+        result = fcntl(end, F_SETFL, fcntl(end, F_GETFL, 0) | O_NONBLOCK);
+        assert(-1 != result);
+    }
+}
+
+IpServer::Shard::~Shard() {
+    close(_listener);
+    close(_wakePipe[0]);
+    close(_wakePipe[1]);
+}
+
+ErrorType IpServer::Shard::mainLoop() {
+    std::array<struct pollfd, 2> descriptors = {{
+        {.fd = _listener, .events = POLLIN, .revents = 0},
+        {.fd = _wakePipe[0], .events = POLLIN, .revents = 0}
+    }};
+
+    const ErrorType error = runNextEvent();
+
+    //Only wait when there is nothing else for this worker to do.
+    const int timeout = ErrorType::NoData == error ? ShardPollPeriod : 0;
+
+    if (poll(descriptors.data(), descriptors.size(), timeout) > 0) {
+        if (descriptors[0].revents & POLLIN) {
+            Socket sock;
+            while (-1 != (sock = accept(_listener, nullptr, nullptr))) {
+                _onAccept(sock, _worker);
+            }
+        }
+
+        //The events that woke the worker are run the next time around.
+        if (descriptors[1].revents & POLLIN) {
+            std::array<char, 64> drained;
+            while (read(_wakePipe[0], drained.data(), drained.size()) > 0);
+        }
+    }
+
+    return error;
+}
+
+ErrorType IpServer::Shard::addEvent(std::unique_ptr<EventAbstraction> &event) {
+    const ErrorType error = EventQueue::addEvent(event);
+    if (ErrorType::Success == error) {
+        wake();
+    }
+
+    return error;
+}
+
+void IpServer::Shard::stop() {
+    _running = false;
+    wake();
+}
+
+void IpServer::Shard::wake() {
+    const char wake = 0;
+
+    if (sizeof(wake) != write(_wakePipe[1], &wake, sizeof(wake))) {
+        //The pipe is full so the worker is already being woken, or it will still run the event when the poll period expires.
+    }
+}
@@ -3,26 +3,228 @@
 
 //AbstractionLayer
 #include "IpServerAbstraction.hpp"
+#include "EventQueue.hpp"
+//Modules
+#include "SendQueueModule.hpp"
+#include "TcpTuningModule.hpp"
 //Posix
 #include <sys/socket.h>
+//C++
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @struct PeerAddress
+ * @brief The address of a connected peer.
+ * @details IPv4 peers of a dual stack server connect from IPv4-mapped IPv6 addresses (::ffff:192.0.2.1). They are reported as the IPv4
+ *          address they really are so that a peer looks the same whichever kind of socket accepted it.
+*/
+struct PeerAddress {
+    IpServerSettings::Version version = IpServerSettings::Version::Unknown; ///< IPv4 or IPv6. Unknown for Unix domain sockets.
+    std::string address;                                                    ///< The address in presentation format (e.g. 192.0.2.1 or 2001:db8::1)
+    Port port = 0;                                                          ///< The port in host byte order.
+};
 
 class IpServer : public IpServerAbstraction {
 
     public:
+    IpServer() : IpServerAbstraction() {};
+    ~IpServer() { stopSharded(); closeConnection(); }
+
+    /**
+     * @brief Listen for connections on a port
+     * @param[in] protocol The protocol to use
+     * @param[in] version The version to use. IpServerSettings::Version::DualStack listens on one IPv6 socket with IPV6_V6ONLY
+     *                    disabled so that IPv4 and IPv6 clients are served by the same socket and event loop.
+     * @param[in] port The port to listen to
+     * @post If IPv6 is not available on this host a dual stack server listens on IPv4 only and version() is IPv4.
+     * @returns ErrorType::Success if the server is listening.
+     * @returns The errors of the socket calls otherwise.
+    */
     ErrorType listenTo(IpServerSettings::Protocol protocol, IpServerSettings::Version version, Port port) override;
+    /**
+     * @brief Accept a connection from a client.
+     * @param[out] socket The accepted socket.
+     * @post The address of the client can be read with peerConst.
+     * @returns ErrorType::Success if a connection was accepted.
+     * @returns The errors of accept otherwise.
+    */
     ErrorType acceptConnection(Socket &socket) override;
+    /**
+     * @brief Listen on a Unix domain socket for connections from processes on the same host.
+     * @param[in] protocol IpServerSettings::Protocol::UnixStream or IpServerSettings::Protocol::UnixSeqpacket
+     * @param[in] path The path of the socket. A stale socket left at the path by an earlier run is removed.
+     * @post Connections are accepted with acceptConnection the same as for listenTo.
+     * @returns ErrorType::Success if the server is listening.
+     * @returns ErrorType::InvalidParameter if the protocol is not a Unix domain protocol, or the path is empty or too long.
+     * @returns The errors of the socket calls otherwise.
+    */
+    ErrorType listenToLocal(IpServerSettings::Protocol protocol, const std::string &path);
+    /**
+     * @brief Close the accepted connection, or the listening socket if no connection has been accepted.
+     * @returns ErrorType::Success
+    */
     ErrorType closeConnection() override;
     ErrorType sendBlocking(const std::string &data, const Milliseconds timeout) override;
     ErrorType receiveBlocking(std::string &buffer, const Milliseconds timeout) override;
+    /**
+     * @brief Queue data to be sent to the accepted connection by the network.
+     * @details The data is written as the socket accepts it, so a slow peer never blocks the network's event loop.
+     * @param[in] data The data to send
+     * @param[in] timeout The time allowed for all of the data to be written. The data is abandoned if it has not been written in time.
+     * @param[in] callback Called from the network's thread once the data has been sent or abandoned.
+     * @post If no callback is provided, the caller is blocked until the data is sent or the timeout expires.
+     * @returns ErrorType::Success if the data was queued, or sent if there is no callback.
+     * @returns ErrorType::LimitReached if the send queue is above its high watermark. Wait for the backpressure callback and try again.
+     * @returns ErrorType::Timeout if there is no callback and the data was not sent in time.
+     * @returns ErrorType::PrerequisitesNotMet if no connection has been accepted.
+     * @sa sendQueue
+    */
     ErrorType sendNonBlocking(const std::shared_ptr<std::string> data, const Milliseconds timeout, std::function<void(const ErrorType error, const Bytes bytesWritten)> callback = nullptr) override;
     ErrorType receiveNonBlocking(std::shared_ptr<std::string> buffer, const Milliseconds timeout, std::function<void(const ErrorType error, std::shared_ptr<std::string> buffer)> callback = nullptr) override;
 
+    /**
+     * @brief Set the socket options of the accepted connection.
+     * @param[in] settings The settings. Use TcpTuning::profile to start from one of the named profiles.
+     * @post The settings are applied by every acceptConnection after this and to the current connection if there is one.
+     * @returns ErrorType::Success if the settings were stored and applied to the current connection if there is one.
+     * @returns The errors of TcpTuning::apply otherwise. The settings are still used for later connections.
+    */
+    ErrorType setTuning(const TcpTuningSettings::Settings &settings);
+    /**
+     * @brief Get the kernel's statistics for the accepted connection.
+     * @param[out] statistics The round trip time, congestion window, retransmits and byte counts of the connection.
+     * @returns ErrorType::PrerequisitesNotMet if there is no connection.
+     * @returns The errors of TcpTuning::statistics otherwise.
+    */
+    ErrorType tcpStatistics(TcpTuningSettings::Statistics &statistics);
+
+    /// @brief Get the address of the accepted connection as a constant reference
+    const PeerAddress &peerConst() const { return _peer; }
+    /**
+     * @brief Get the address of the peer of a connected socket, such as one given to the onAccept callback of listenToSharded.
+     * @param[in] socket The connected socket.
+     * @param[out] peer The address of the peer. IPv4-mapped IPv6 addresses are reported as IPv4.
+     * @returns ErrorType::Success if the address was found.
+     * @returns The errors of getpeername otherwise.
+    */
+    static ErrorType peerAddress(const Socket socket, PeerAddress &peer);
+
+    /// @brief Get the send queue of the accepted connection to set its watermarks and backpressure callback.
+    SendQueue &sendQueue() { return *_sendQueue; }
+
+    /**
+     * @brief Listen on the same port with one socket per worker thread so that the kernel spreads new connections across the workers.
+     * @details Each worker owns a SO_REUSEPORT socket and runs its own event loop that accepts connections as they arrive and runs
+     *          any events added to that worker. On Linux the kernel load balances connections between the sockets. Other systems may
+     *          deliver every connection to the same socket.
+     * @param[in] protocol The protocol to use
+     * @param[in] version The version to use. With IpServerSettings::Version::DualStack every worker accepts both IPv4 and IPv6 clients.
+     * @param[in] port The port to listen on
+     * @param[in] workers The number of sockets and worker threads.
+     * @param[in] onAccept Called from the worker thread with each accepted socket and the worker that accepted it. The callback owns the socket.
+     * @returns ErrorType::Success if every worker is listening.
+     * @returns ErrorType::InvalidParameter if workers is 0 or onAccept is nullptr.
+     * @returns ErrorType::PrerequisitesNotMet if the server is already listening.
+     * @returns The errors of the socket calls if a socket could not be opened.
+     * @sa stopSharded
+    */
+    ErrorType listenToSharded(IpServerSettings::Protocol protocol, IpServerSettings::Version version, Port port, Count workers, std::function<void(const Socket socket, const Id worker)> onAccept);
+    /**
+     * @brief Stop the workers started by listenToSharded and close their sockets.
+     * @returns ErrorType::Success
+    */
+    ErrorType stopSharded();
+    /**
+     * @brief Get the event queue of a worker so that work can be run on the thread that accepted a connection.
+     * @param[in] worker The worker passed to the onAccept callback.
+     * @returns The event queue or nullptr if there is no such worker.
+    */
+    EventQueue *shardEventQueue(const Id worker);
+
     private:
+    /// @brief The stack size of each worker thread.
+    static constexpr Bytes ShardStackSize = 16*1024;
+    /// @brief How often a worker with nothing to accept checks for events.
+    static constexpr Milliseconds ShardPollPeriod = 10;
+
+    /**
+     * @class Shard
+     * @brief One of the sockets listening on the shared port along with the event loop of the worker that owns it.
+    */
+    class Shard : public EventQueue {
+
+        public:
+        Shard(Socket listener, Id worker, std::function<void(const Socket socket, const Id worker)> onAccept);
+        ~Shard();
+
+        /**
+         * @brief Run the next event, then wait for connections and accept all of them.
+         * @returns The error codes of runNextEvent.
+        */
+        ErrorType mainLoop() override;
+        /// @brief Add the event and wake the worker so that it doesn't wait for the poll period to run it.
+        ErrorType addEvent(std::unique_ptr<EventAbstraction> &event) override;
+        /// @brief Stop the worker and wake it if it is waiting for connections.
+        void stop();
+        /// @brief True until the worker is told to stop.
+        bool running() const { return _running; }
+        /// @brief The name of the worker thread.
+        const std::string &threadNameConst() const { return _threadName; }
+        /// @brief The name of the worker thread.
+        std::string &threadName() { return _threadName; }
+
+        private:
+        /// @brief The listening socket.
+        Socket _listener;
+        /// @brief The worker that this shard belongs to.
+        Id _worker;
+        /// @brief Called with each accepted socket.
+        std::function<void(const Socket socket, const Id worker)> _onAccept;
+        /// @brief Written to by stop and addEvent to wake the worker. [0] is read, [1] is write.
+        int _wakePipe[2] = {-1, -1};
+
+        /// @brief Wake the worker if it is waiting for connections.
+        void wake();
+        /// @brief True until the worker is told to stop.
+        std::atomic<bool> _running;
+        /// @brief The name of the worker thread.
+        std::string _threadName;
+    };
+
+    /// @brief Data waiting for the accepted socket to accept it. Shared with the flushes waiting on the network's event queue.
+    std::shared_ptr<SendQueue> _sendQueue = std::make_shared<SendQueue>();
+    /// @brief The socket options applied to each connection.
+    TcpTuningSettings::Settings _tuning;
+    /// @brief True once _socket is an accepted connection instead of the listening socket.
+    bool _accepted = false;
+    /// @brief The shards created by listenToSharded.
+    std::vector<std::unique_ptr<Shard>> _shards;
+    /// @brief The address of the accepted connection.
+    PeerAddress _peer;
+
+    /**
+     * @brief Open a socket bound to the port.
+     * @param[in] protocol The protocol to use
+     * @param[in,out] version The version to use. Set to IPv4 if a dual stack socket could not be opened because IPv6 is not available.
+     * @param[in] port The port to bind to
+     * @param[in] reusePort True to let other sockets bind to the same port with SO_REUSEPORT.
+     * @param[out] sock The bound socket.
+     * @returns ErrorType::Success if the socket was bound.
+    */
+    ErrorType openSocket(IpServerSettings::Protocol protocol, IpServerSettings::Version &version, Port port, bool reusePort, Socket &sock);
+    /// @brief Start function of the worker threads.
+    static void *runShard(void *arg);
+
     int toPosixFamily(IpServerSettings::Version version) {
         switch (version) {
             case IpServerSettings::Version::IPv4:
                 return AF_INET;
             case IpServerSettings::Version::IPv6:
+            case IpServerSettings::Version::DualStack:
                 return AF_INET6;
             default:
                 return AF_UNSPEC;
@@ -35,10 +237,18 @@ class IpServer : public IpServerAbstraction {
                 return SOCK_STREAM;
             case IpServerSettings::Protocol::Udp:
                 return SOCK_DGRAM;
+            case IpServerSettings::Protocol::UnixStream:
+                return SOCK_STREAM;
+            case IpServerSettings::Protocol::UnixSeqpacket:
+                return SOCK_SEQPACKET;
             default:
                 return SOCK_RAW;
         }
     }
+
+    bool isLocal(IpServerSettings::Protocol protocol) {
+        return IpServerSettings::Protocol::UnixStream == protocol || IpServerSettings::Protocol::UnixSeqpacket == protocol;
+    }
 };
 
 #endif // __IP_SERVER_MODULE_HPP__
\ No newline at end of file
@@ -0,0 +1,562 @@
+//Modules
+#include "SendQueueModule.hpp"
+#include "OperatingSystemModule.hpp"
+//Posix
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+//C++
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <mutex>
+
+namespace {
+    //Writes must never block and a peer that has gone away must not raise SIGPIPE.
+#ifdef MSG_NOSIGNAL
+    constexpr int SendFlags = MSG_DONTWAIT | MSG_NOSIGNAL;
+#else
+    constexpr int SendFlags = MSG_DONTWAIT;
+#endif
+}
+
+SocketWatcher::SocketWatcher() : _running(true) {
+    _watchSemaphore = std::string("socketWatcherSemaphore");
+    ErrorType error = OperatingSystem::Instance().createSemaphore(1, 1, _watchSemaphore);
+    assert(ErrorType::Success == error);
+
+    int result = pipe(_wakePipe);
+    assert(0 == result);
+    //The watcher empties the pipe each time it wakes so the read end must not block once it's empty.
+    result = fcntl(_wakePipe[0], F_SETFL, fcntl(_wakePipe[0], F_GETFL, 0) | O_NONBLOCK);
+    assert(-1 != result);
+
+    Id threadId;
+    _threadName = std::string("socketWatcher");
+    error = OperatingSystem::Instance().createThread(OperatingSystemConfig::Priority::Normal, _threadName, this, WatcherStackSize, runWatcher, threadId);
+    assert(ErrorType::Success == error);
+}
+
+SocketWatcher::~SocketWatcher() {
+    _running = false;
+    const char wake = 0;
+    write(_wakePipe[1], &wake, sizeof(wake));
+    OperatingSystem::Instance().joinThread(_threadName);
+    OperatingSystem::Instance().deleteThread(_threadName);
+
+    close(_wakePipe[0]);
+    close(_wakePipe[1]);
+    OperatingSystem::Instance().deleteSemaphore(_watchSemaphore);
+}
+
+void SocketWatcher::Init() {
+    //Global::Init is not thread safe and every send queue calls this from whichever thread it was created on.
+    static std::once_flag created;
+    std::call_once(created, []() { Global<SocketWatcher>::Init(); });
+}
+
+ErrorType SocketWatcher::whenWritable(const Socket socket, const Clock::time_point deadline, std::function<void(void)> callback) {
+    if (-1 == socket || nullptr == callback) {
+        return ErrorType::InvalidParameter;
+    }
+
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(_watchSemaphore, SemaphoreTimeout)) {
+        return ErrorType::Timeout;
+    }
+
+    _watches.push_back({socket, deadline, callback});
+
+    OperatingSystem::Instance().incrementSemaphore(_watchSemaphore);
+
+    //The watcher has to start polling the new socket and may have to wake up sooner for its deadline.
+    const char wake = 0;
+    write(_wakePipe[1], &wake, sizeof(wake));
+
+    return ErrorType::Success;
+}
+
+void SocketWatcher::watch() {
+    std::vector<struct pollfd> descriptors;
+    Clock::time_point wakeUp = Clock::now() + std::chrono::milliseconds(MaxWait);
+
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(_watchSemaphore, SemaphoreTimeout)) {
+        return;
+    }
+
+    descriptors.push_back({.fd = _wakePipe[0], .events = POLLIN, .revents = 0});
+    for (const Watch &watch : _watches) {
+        descriptors.push_back({.fd = watch.socket, .events = POLLOUT, .revents = 0});
+        wakeUp = std::min(wakeUp, watch.deadline);
+    }
+
+    OperatingSystem::Instance().incrementSemaphore(_watchSemaphore);
+
+    const Clock::time_point now = Clock::now();
+    const int pollTimeout = now >= wakeUp ? 0 : std::chrono::ceil<std::chrono::milliseconds>(wakeUp - now).count();
+    if (poll(descriptors.data(), descriptors.size(), pollTimeout) < 0) {
+        return;
+    }
+
+    if (0 != descriptors[0].revents) {
+        char wake[64];
+        while (read(_wakePipe[0], wake, sizeof(wake)) > 0);
+    }
+
+    std::vector<std::function<void(void)>> callbacks;
+
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(_watchSemaphore, SemaphoreTimeout)) {
+        return;
+    }
+
+    //Watches added while we were polling weren't polled so only their deadline can have been reached.
+    const Clock::time_point expired = Clock::now();
+    std::erase_if(_watches, [&descriptors, &callbacks, expired](const Watch &watch) {
+        //Any event counts. An error or hang up means the next write fails and the send queue needs to find out.
+        auto descriptor = std::find_if(descriptors.begin() + 1, descriptors.end(), [&watch](const struct pollfd &descriptor) {
+            return descriptor.fd == watch.socket && 0 != descriptor.revents;
+        });
+
+        if (descriptors.end() == descriptor && expired < watch.deadline) {
+            return false;
+        }
+
+        callbacks.push_back(watch.callback);
+        return true;
+    });
+
+    OperatingSystem::Instance().incrementSemaphore(_watchSemaphore);
+
+    for (auto &callback : callbacks) {
+        callback();
+    }
+}
+
+void *SocketWatcher::runWatcher(void *arg) {
+    SocketWatcher *watcher = static_cast<SocketWatcher *>(arg);
+    assert(nullptr != watcher);
+
+    while (watcher->_running) {
+        watcher->watch();
+    }
+
+    return nullptr;
+}
+
+std::atomic<int> SendQueue::semaphoreCount(0);
+
+SendQueue::SendQueue(Bytes highWatermark, Bytes lowWatermark) : _highWatermark(highWatermark), _lowWatermark(lowWatermark) {
+    assert(lowWatermark <= highWatermark);
+
+    //Every send queue shares the same watcher.
+    SocketWatcher::Init();
+
+    const int instance = ++semaphoreCount;
+    _queueSemaphore = std::string("sendQueueSemaphore").append(std::to_string(instance));
+    ErrorType error = OperatingSystem::Instance().createSemaphore(1, 1, _queueSemaphore);
+    assert(ErrorType::Success == error);
+}
+
+SendQueue::~SendQueue() {
+    OperatingSystem::Instance().deleteSemaphore(_queueSemaphore);
+}
+
+void SendQueue::setSocket(const Socket socket) {
+    std::vector<Completion> completions;
+
+    ErrorType error = OperatingSystem::Instance().waitSemaphore(_queueSemaphore, SemaphoreTimeout);
+    assert(ErrorType::Success == error);
+
+    failAll(ErrorType::Failure, completions);
+    _socket = socket;
+
+    //Gathering messages into one write would merge them into one datagram or packet on sockets that keep message boundaries.
+    int type = SOCK_STREAM;
+    socklen_t typeLength = sizeof(type);
+    if (-1 != _socket) {
+        getsockopt(_socket, SOL_SOCKET, SO_TYPE, &type, &typeLength);
+    }
+    _messagesPerWrite = SOCK_STREAM == type ? MaxMessagesPerWrite : 1;
+
+#ifdef SO_NOSIGPIPE
+    //Darwin has no MSG_NOSIGNAL so SIGPIPE is turned off for the whole socket instead.
+    if (-1 != _socket) {
+        const int enable = 1;
+        setsockopt(_socket, SOL_SOCKET, SO_NOSIGPIPE, &enable, sizeof(enable));
+    }
+#endif
+
+    const std::function<void()> backpressure = updateThrottle();
+    OperatingSystem::Instance().incrementSemaphore(_queueSemaphore);
+
+    complete(completions, backpressure);
+}
+
+ErrorType SendQueue::setWatermarks(const Bytes highWatermark, const Bytes lowWatermark) {
+    if (lowWatermark > highWatermark) {
+        return ErrorType::InvalidParameter;
+    }
+
+    std::vector<Completion> completions;
+
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(_queueSemaphore, SemaphoreTimeout)) {
+        return ErrorType::Timeout;
+    }
+
+    _highWatermark = highWatermark;
+    _lowWatermark = lowWatermark;
+    const std::function<void()> backpressure = updateThrottle();
+    OperatingSystem::Instance().incrementSemaphore(_queueSemaphore);
+
+    complete(completions, backpressure);
+    return ErrorType::Success;
+}
+
+void SendQueue::setBackpressureCallback(std::function<void(const bool throttle)> callback) {
+    ErrorType error = OperatingSystem::Instance().waitSemaphore(_queueSemaphore, SemaphoreTimeout);
+    assert(ErrorType::Success == error);
+
+    _backpressureCallback = callback;
+
+    OperatingSystem::Instance().incrementSemaphore(_queueSemaphore);
+}
+
+ErrorType SendQueue::enqueue(std::shared_ptr<std::string> data, const Milliseconds timeout, std::function<void(const ErrorType error, const Bytes bytesWritten)> callback) {
+    std::vector<Completion> completions;
+
+    if (nullptr == data) {
+        return ErrorType::InvalidParameter;
+    }
+
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(_queueSemaphore, SemaphoreTimeout)) {
+        return ErrorType::Timeout;
+    }
+
+    if (-1 == _socket) {
+        OperatingSystem::Instance().incrementSemaphore(_queueSemaphore);
+        return ErrorType::PrerequisitesNotMet;
+    }
+
+    if (_throttled) {
+        OperatingSystem::Instance().incrementSemaphore(_queueSemaphore);
+        return ErrorType::LimitReached;
+    }
+
+    push(data, 0, timeout, callback);
+    const std::function<void()> backpressure = updateThrottle();
+    OperatingSystem::Instance().incrementSemaphore(_queueSemaphore);
+
+    complete(completions, backpressure);
+    return ErrorType::Success;
+}
+
+ErrorType SendQueue::flush() {
+    std::vector<Completion> completions;
+    ErrorType error = ErrorType::Success;
+
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(_queueSemaphore, SemaphoreTimeout)) {
+        return ErrorType::Timeout;
+    }
+
+    if (-1 == _socket) {
+        OperatingSystem::Instance().incrementSemaphore(_queueSemaphore);
+        return ErrorType::PrerequisitesNotMet;
+    }
+
+    if (!dropExpired(Clock::now(), completions)) {
+        failAll(ErrorType::Failure, completions);
+        _socket = -1;
+        error = ErrorType::Failure;
+    }
+
+    while (ErrorType::Success == error && !_messages.empty()) {
+        std::array<struct iovec, MaxMessagesPerWrite> vectors;
+        struct msghdr header = {};
+        Count messages = 0;
+
+        //Gather the messages at the front so that a queue of small messages goes out in one system call.
+        for (auto message = _messages.begin(); message != _messages.end() && messages < _messagesPerWrite; message++, messages++) {
+            vectors[messages].iov_base = message->data->data() + message->written;
+            vectors[messages].iov_len = message->data->size() - message->written;
+        }
+        header.msg_iov = vectors.data();
+        header.msg_iovlen = messages;
+
+        const ssize_t bytesSent = sendmsg(_socket, &header, SendFlags);
+        if (-1 == bytesSent) {
+            if (EINTR == errno) {
+                continue;
+            }
+            else if (EAGAIN == errno || EWOULDBLOCK == errno) {
+                error = ErrorType::LimitReached;
+            }
+            else {
+                error = toPlatformError(errno);
+                failAll(error, completions);
+            }
+            break;
+        }
+
+        _queuedBytes -= bytesSent;
+
+        //Retire every message that was completely written and remember where the last one left off.
+        Bytes remaining = bytesSent;
+        while (!_messages.empty()) {
+            Message &front = _messages.front();
+            const Bytes unwritten = front.data->size() - front.written;
+
+            if (unwritten > remaining) {
+                front.written += remaining;
+                break;
+            }
+
+            remaining -= unwritten;
+            completions.push_back({front.callback, ErrorType::Success, static_cast<Bytes>(front.data->size())});
+            _messages.pop_front();
+        }
+    }
+
+    const std::function<void()> backpressure = updateThrottle();
+    OperatingSystem::Instance().incrementSemaphore(_queueSemaphore);
+
+    complete(completions, backpressure);
+    return error;
+}
+
+ErrorType SendQueue::sendBlocking(const std::string &data, const Milliseconds timeout) {
+    struct Result {
+        std::atomic<bool> done = false;
+        ErrorType error = ErrorType::Failure;
+    };
+
+    const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout);
+    auto result = std::make_shared<Result>();
+    std::vector<Completion> completions;
+    Bytes bytesSent = 0;
+
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(_queueSemaphore, SemaphoreTimeout)) {
+        return ErrorType::Timeout;
+    }
+
+    const Socket sock = _socket;
+    if (-1 == sock) {
+        OperatingSystem::Instance().incrementSemaphore(_queueSemaphore);
+        return ErrorType::PrerequisitesNotMet;
+    }
+
+    //With nothing queued ahead of it the message can be written straight from the caller's buffer. It only needs to be copied
+    //into the queue if the socket doesn't take all of it.
+    if (_messages.empty()) {
+        ssize_t sent;
+        do {
+            sent = send(sock, data.data(), data.size(), SendFlags);
+        } while (-1 == sent && EINTR == errno);
+
+        if (-1 != sent) {
+            bytesSent = sent;
+        }
+        else if (EAGAIN != errno && EWOULDBLOCK != errno) {
+            const ErrorType error = toPlatformError(errno);
+            OperatingSystem::Instance().incrementSemaphore(_queueSemaphore);
+            return error;
+        }
+
+        if (data.size() == bytesSent) {
+            OperatingSystem::Instance().incrementSemaphore(_queueSemaphore);
+            return ErrorType::Success;
+        }
+    }
+
+    push(std::make_shared<std::string>(data), bytesSent, timeout, [result](const ErrorType error, const Bytes) {
+        result->error = error;
+        result->done = true;
+    });
+    const std::function<void()> backpressure = updateThrottle();
+    OperatingSystem::Instance().incrementSemaphore(_queueSemaphore);
+
+    complete(completions, backpressure);
+
+    while (!result->done) {
+        const ErrorType error = flush();
+        if (result->done) {
+            break;
+        }
+        else if (ErrorType::LimitReached != error && ErrorType::Timeout != error) {
+            return error;
+        }
+
+        //Once the deadline has passed the next flush reports the message as expired.
+        const Clock::time_point now = Clock::now();
+        const int pollTimeout = now >= deadline ? 0 : std::chrono::ceil<std::chrono::milliseconds>(deadline - now).count();
+        struct pollfd descriptor = {.fd = sock, .events = POLLOUT, .revents = 0};
+        poll(&descriptor, 1, pollTimeout);
+    }
+
+    return result->error;
+}
+
+ErrorType SendQueue::scheduleFlush(std::shared_ptr<SendQueue> queue, EventQueue &eventQueue) {
+    assert(nullptr != queue);
+
+    if (queue->_flushScheduled.exchange(true)) {
+        return ErrorType::Success;
+    }
+
+    return addFlush(queue, eventQueue);
+}
+
+ErrorType SendQueue::addFlush(std::shared_ptr<SendQueue> queue, EventQueue &eventQueue) {
+    auto flush = [&eventQueue](std::shared_ptr<SendQueue> queue) -> ErrorType {
+        //Cleared first so that a message queued while we're writing gets a flush of its own.
+        queue->_flushScheduled = false;
+
+        const ErrorType error = queue->flush();
+        if (ErrorType::Timeout == error) {
+            //Another thread had the queue. Try again the next time the events are run.
+            scheduleFlush(queue, eventQueue);
+        }
+        else if (ErrorType::LimitReached == error && !queue->_flushScheduled.exchange(true)) {
+            //The socket is full. Nothing can be written until the peer reads, so wait for that instead of retrying.
+            const ErrorType watchError = addFlushWhenWritable(queue, eventQueue);
+            if (ErrorType::Success != watchError && ErrorType::PrerequisitesNotMet != watchError) {
+                addFlush(queue, eventQueue);
+            }
+        }
+
+        return error;
+    };
+
+    std::unique_ptr<EventAbstraction> event = std::make_unique<EventQueue::Event<SendQueue>>(std::bind(flush, queue));
+    //The event queue doesn't wait for its lock, so another thread adding or running an event at the same moment makes it time out.
+    //Nothing else would flush the queue so try again instead of leaving the data sitting there.
+    ErrorType error;
+    Count attempts = 0;
+    while (ErrorType::Timeout == (error = eventQueue.addEvent(event)) && ++attempts < ScheduleAttempts) {
+        OperatingSystem::Instance().delay(0);
+    }
+
+    if (ErrorType::Success != error) {
+        queue->_flushScheduled = false;
+    }
+
+    return error;
+}
+
+ErrorType SendQueue::addFlushWhenWritable(std::shared_ptr<SendQueue> queue, EventQueue &eventQueue) {
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(queue->_queueSemaphore, SemaphoreTimeout)) {
+        return ErrorType::Timeout;
+    }
+
+    const Socket socket = queue->_socket;
+    //The flush has to run by the first deadline to report the message as expired even if the socket never drains.
+    Clock::time_point deadline = Clock::time_point::max();
+    for (const Message &message : queue->_messages) {
+        deadline = std::min(deadline, message.deadline);
+    }
+
+    OperatingSystem::Instance().incrementSemaphore(queue->_queueSemaphore);
+
+    if (-1 == socket || Clock::time_point::max() == deadline) {
+        queue->_flushScheduled = false;
+        return ErrorType::PrerequisitesNotMet;
+    }
+
+    return SocketWatcher::Instance().whenWritable(socket, deadline, [queue, &eventQueue]() { addFlush(queue, eventQueue); });
+}
+
+void SendQueue::cancel(const ErrorType error) {
+    std::vector<Completion> completions;
+
+    ErrorType semaphoreError = OperatingSystem::Instance().waitSemaphore(_queueSemaphore, SemaphoreTimeout);
+    assert(ErrorType::Success == semaphoreError);
+
+    failAll(error, completions);
+    const std::function<void()> backpressure = updateThrottle();
+    OperatingSystem::Instance().incrementSemaphore(_queueSemaphore);
+
+    complete(completions, backpressure);
+}
+
+Bytes SendQueue::queuedBytes() {
+    OperatingSystem::Instance().waitSemaphore(_queueSemaphore, SemaphoreTimeout);
+    const Bytes queued = _queuedBytes;
+    OperatingSystem::Instance().incrementSemaphore(_queueSemaphore);
+
+    return queued;
+}
+
+bool SendQueue::throttled() {
+    OperatingSystem::Instance().waitSemaphore(_queueSemaphore, SemaphoreTimeout);
+    const bool throttle = _throttled;
+    OperatingSystem::Instance().incrementSemaphore(_queueSemaphore);
+
+    return throttle;
+}
+
+void SendQueue::push(std::shared_ptr<std::string> data, const Bytes written, const Milliseconds timeout, std::function<void(const ErrorType error, const Bytes bytesWritten)> callback) {
+    assert(written <= data->size());
+
+    _queuedBytes += data->size() - written;
+    _messages.push_back({data, written, Clock::now() + std::chrono::milliseconds(timeout), callback});
+}
+
+void SendQueue::failAll(const ErrorType error, std::vector<Completion> &completions) {
+    for (const Message &message : _messages) {
+        completions.push_back({message.callback, error, message.written});
+    }
+
+    _messages.clear();
+    _queuedBytes = 0;
+}
+
+bool SendQueue::dropExpired(const Clock::time_point now, std::vector<Completion> &completions) {
+    for (auto message = _messages.begin(); message != _messages.end();) {
+        if (now < message->deadline) {
+            message++;
+            continue;
+        }
+
+        if (0 != message->written) {
+            return false;
+        }
+
+        completions.push_back({message->callback, ErrorType::Timeout, 0});
+        _queuedBytes -= message->data->size();
+        message = _messages.erase(message);
+    }
+
+    return true;
+}
+
+std::function<void()> SendQueue::updateThrottle() {
+    if (!_throttled && _queuedBytes >= _highWatermark) {
+        _throttled = true;
+    }
+    else if (_throttled && _queuedBytes <= _lowWatermark) {
+        _throttled = false;
+    }
+    else {
+        return nullptr;
+    }
+
+    if (nullptr == _backpressureCallback) {
+        return nullptr;
+    }
+
+    return std::bind(_backpressureCallback, _throttled);
+}
+
+void SendQueue::complete(std::vector<Completion> &completions, const std::function<void()> &backpressure) {
+    for (const Completion &completion : completions) {
+        if (nullptr != completion.callback) {
+            completion.callback(completion.error, completion.bytesWritten);
+        }
+    }
+
+    if (nullptr != backpressure) {
+        backpressure();
+    }
+}
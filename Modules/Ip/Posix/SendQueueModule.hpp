@@ -0,0 +1,307 @@
+/***************************************************************************//**
+* @author   Ben Haubrich
+* @file     SendQueueModule.hpp
+* @details  Outbound message queue for a connected socket on posix compliant systems.
+* @ingroup  PosixModules
+*******************************************************************************/
+#ifndef __SEND_QUEUE_MODULE_HPP__
+#define __SEND_QUEUE_MODULE_HPP__
+
+//AbstractionLayer
+#include "Error.hpp"
+#include "Types.hpp"
+#include "EventQueue.hpp"
+#include "Global.hpp"
+//C++
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @class SocketWatcher
+ * @brief Waits on its own thread for sockets to become writable so that nobody has to keep retrying a write to a full socket.
+ * @details Each watch is one-shot. The callback is called from the watcher's thread once the socket is writable, has an error or has
+ *          been closed, or once the deadline passes, whichever is first. It is called without any locks held.
+*/
+class SocketWatcher : public Global<SocketWatcher> {
+
+    public:
+    using Clock = std::chrono::steady_clock;
+
+    SocketWatcher();
+    ~SocketWatcher();
+
+    /**
+     * @brief Create the watcher shared by every send queue and start its thread.
+     * @details Safe to call from any number of threads at once. Only the first call creates the watcher.
+    */
+    static void Init();
+
+    /**
+     * @brief Call back once the socket is writable.
+     * @param[in] socket The socket to watch.
+     * @param[in] deadline The callback is called at this time even if the socket is still full.
+     * @param[in] callback Called from the watcher's thread.
+     * @returns ErrorType::Success if the socket is being watched.
+     * @returns ErrorType::InvalidParameter if the socket is -1 or the callback is nullptr.
+     * @returns ErrorType::Timeout if the watch could not be added in time.
+    */
+    ErrorType whenWritable(const Socket socket, const Clock::time_point deadline, std::function<void(void)> callback);
+
+    private:
+    /// @brief The timeout for semaphore operations.
+    static constexpr Milliseconds SemaphoreTimeout = 1000;
+    /// @brief The stack size of the watcher's thread.
+    static constexpr Bytes WatcherStackSize = 16*1024;
+    /// @brief The longest the watcher sleeps without a deadline to wake up for.
+    static constexpr Milliseconds MaxWait = 1000;
+
+    /**
+     * @struct Watch
+     * @brief A socket being waited on.
+    */
+    struct Watch {
+        Socket socket;                      ///< The socket.
+        Clock::time_point deadline;         ///< When to give up waiting.
+        std::function<void(void)> callback; ///< Called once the socket is writable or the deadline passes.
+    };
+
+    /// @brief Guards the watches.
+    std::string _watchSemaphore;
+    /// @brief The sockets being waited on.
+    std::vector<Watch> _watches;
+    /// @brief Written to by whenWritable and the destructor to wake the watcher. [0] is read, [1] is write.
+    int _wakePipe[2] = {-1, -1};
+    /// @brief True until the watcher is destroyed.
+    std::atomic<bool> _running;
+    /// @brief The name of the watcher's thread.
+    std::string _threadName;
+
+    /// @brief Wait for any of the sockets to become writable and call back the ones that did or whose deadline has passed.
+    void watch();
+    /// @brief Start function of the watcher's thread.
+    static void *runWatcher(void *arg);
+};
+
+/**
+ * @class SendQueue
+ * @brief Queues outbound messages for a socket and writes them as the socket becomes writable.
+ * @details Writes never block. Whatever the socket does not accept stays queued and is continued from where it left off on the next
+ *          flush, so a slow peer only holds up its own connection.
+ *
+ *          Producers are throttled with a pair of watermarks. Once the queued bytes reach the high watermark enqueue refuses new
+ *          messages and the backpressure callback is called with true. When flushing brings the queue down to the low watermark
+ *          the callback is called with false and messages are accepted again.
+ *
+ *          Every message has a deadline. A message that has not been started by its deadline is dropped and reported as
+ *          ErrorType::Timeout. A message that was partly written when its deadline passed can't be dropped without corrupting the
+ *          stream, so it is reported as ErrorType::Failure and the queue gives up on the socket.
+ *
+ *          Callbacks are called without any locks held so they are free to enqueue more messages.
+ * @code
+ * SendQueue queue;
+ * queue.setSocket(socket);
+ * queue.setBackpressureCallback([](const bool throttle) { producerPaused = throttle; });
+ *
+ * if (ErrorType::LimitReached == queue.enqueue(message, 1000, nullptr)) {
+ *     //Wait for the backpressure callback to say that there is room.
+ * }
+ * //Call whenever the socket is writable.
+ * queue.flush();
+ * @endcode
+*/
+class SendQueue {
+
+    public:
+    /// @brief The default number of queued bytes at which producers are throttled.
+    static constexpr Bytes DefaultHighWatermark = 64*1024;
+    /// @brief The default number of queued bytes at which throttled producers are resumed.
+    static constexpr Bytes DefaultLowWatermark = 16*1024;
+
+    /**
+     * @brief Constructor.
+     * @param[in] highWatermark The number of queued bytes at which producers are throttled.
+     * @param[in] lowWatermark The number of queued bytes at which throttled producers are resumed.
+     * @pre lowWatermark is not greater than highWatermark.
+    */
+    SendQueue(Bytes highWatermark = DefaultHighWatermark, Bytes lowWatermark = DefaultLowWatermark);
+    ~SendQueue();
+
+    /**
+     * @brief Set the socket that messages are written to.
+     * @param[in] socket The connected socket, or -1 if there is no connection.
+     * @post Messages still queued for the previous socket are failed with ErrorType::Failure.
+    */
+    void setSocket(const Socket socket);
+    /**
+     * @brief Set the watermarks.
+     * @param[in] highWatermark The number of queued bytes at which producers are throttled.
+     * @param[in] lowWatermark The number of queued bytes at which throttled producers are resumed.
+     * @returns ErrorType::Success if the watermarks were set.
+     * @returns ErrorType::InvalidParameter if the low watermark is greater than the high watermark.
+    */
+    ErrorType setWatermarks(const Bytes highWatermark, const Bytes lowWatermark);
+    /**
+     * @brief Set the function that is told when producers should stop and start sending.
+     * @param[in] callback Called with true when the high watermark is reached and with false when the queue drains to the low watermark.
+    */
+    void setBackpressureCallback(std::function<void(const bool throttle)> callback);
+
+    /**
+     * @brief Queue a message to be sent.
+     * @param[in] data The message.
+     * @param[in] timeout The time allowed for the whole message to be written to the socket.
+     * @param[in] callback Called with the result and the number of bytes written once the message is done with. May be nullptr.
+     * @returns ErrorType::Success if the message was queued.
+     * @returns ErrorType::LimitReached if producers are throttled. The message was not queued.
+     * @returns ErrorType::PrerequisitesNotMet if there is no socket.
+     * @returns ErrorType::InvalidParameter if data is nullptr.
+    */
+    ErrorType enqueue(std::shared_ptr<std::string> data, const Milliseconds timeout, std::function<void(const ErrorType error, const Bytes bytesWritten)> callback);
+    /**
+     * @brief Write as much of the queue as the socket will accept without blocking.
+     * @returns ErrorType::Success if the queue is empty.
+     * @returns ErrorType::LimitReached if the socket is full and messages are still queued.
+     * @returns ErrorType::Failure if a partly written message expired. The connection can no longer be used.
+     * @returns ErrorType::PrerequisitesNotMet if there is no socket.
+     * @returns The error of the write if the socket failed. Every queued message is failed with the same error.
+    */
+    ErrorType flush();
+    /**
+     * @brief Send a message after everything that is already queued, waiting for the socket to accept all of it.
+     * @details Short writes are continued until the whole message is written or the timeout expires. The watermarks don't apply
+     *          since the caller is already held up until the message is sent.
+     * @param[in] data The message.
+     * @param[in] timeout The time allowed for the message and the messages ahead of it to be written.
+     * @returns ErrorType::Success if the whole message was written.
+     * @returns ErrorType::Timeout if none of the message was written in time.
+     * @returns The errors of flush otherwise.
+    */
+    ErrorType sendBlocking(const std::string &data, const Milliseconds timeout);
+    /**
+     * @brief Put a flush of the queue on an event queue if there isn't one waiting already.
+     * @details While the socket is full the flush is handed to the SocketWatcher, which puts it back on the event queue once the
+     *          socket is writable or the first message's deadline passes. The event keeps the send queue alive so it is safe for the
+     *          owner of the queue to be destroyed first.
+     * @param[in] queue The send queue to flush.
+     * @param[in] eventQueue The event queue of the thread that should do the writing.
+     * @returns ErrorType::Success if a flush is waiting on the event queue.
+     * @returns The errors of EventQueue::addEvent.
+    */
+    static ErrorType scheduleFlush(std::shared_ptr<SendQueue> queue, EventQueue &eventQueue);
+    /**
+     * @brief Fail every queued message.
+     * @param[in] error The error to report to the callbacks of the queued messages.
+    */
+    void cancel(const ErrorType error);
+
+    /// @brief The number of bytes waiting to be written.
+    Bytes queuedBytes();
+    /// @brief True while producers are throttled.
+    bool throttled();
+
+    private:
+    using Clock = std::chrono::steady_clock;
+
+    /// @brief The timeout for semaphore operations.
+    static constexpr Milliseconds SemaphoreTimeout = 1000;
+    /// @brief The most messages that are gathered into a single write.
+    static constexpr Count MaxMessagesPerWrite = 16;
+    /// @brief How many times to try adding the flush to an event queue that is busy with another thread.
+    static constexpr Count ScheduleAttempts = 8;
+
+    /**
+     * @struct Message
+     * @brief A message waiting to be written.
+    */
+    struct Message {
+        std::shared_ptr<std::string> data;                                      ///< The message.
+        Bytes written = 0;                                                      ///< The bytes of the message that have been written.
+        Clock::time_point deadline;                                             ///< When the message must be fully written by.
+        std::function<void(const ErrorType error, const Bytes bytesWritten)> callback; ///< Called when the message is done with.
+    };
+
+    /**
+     * @struct Completion
+     * @brief A callback that is called once the semaphore has been released.
+    */
+    struct Completion {
+        std::function<void(const ErrorType error, const Bytes bytesWritten)> callback; ///< The callback of the message.
+        ErrorType error;                                                               ///< The result of the message.
+        Bytes bytesWritten;                                                            ///< The bytes of the message that were written.
+    };
+
+    /// @brief The number of semaphores that have been created.
+    static std::atomic<int> semaphoreCount;
+    /// @brief Guards the queue.
+    std::string _queueSemaphore;
+    /// @brief The socket that messages are written to.
+    Socket _socket = -1;
+    /// @brief The most messages gathered into a single write for this socket.
+    Count _messagesPerWrite = MaxMessagesPerWrite;
+    /// @brief The messages in the order they are written.
+    std::deque<Message> _messages;
+    /// @brief The number of bytes in the queue that have not been written.
+    Bytes _queuedBytes = 0;
+    /// @brief The number of queued bytes at which producers are throttled.
+    Bytes _highWatermark;
+    /// @brief The number of queued bytes at which throttled producers are resumed.
+    Bytes _lowWatermark;
+    /// @brief True while producers are throttled.
+    bool _throttled = false;
+    /// @brief Told when producers should stop and start sending.
+    std::function<void(const bool throttle)> _backpressureCallback;
+    /// @brief True while a flush is waiting on an event queue.
+    std::atomic<bool> _flushScheduled = false;
+
+    /**
+     * @brief Queue a message.
+     * @param[in] written The bytes of the message that have already been written.
+     * @pre The queue semaphore is held.
+    */
+    void push(std::shared_ptr<std::string> data, const Bytes written, const Milliseconds timeout, std::function<void(const ErrorType error, const Bytes bytesWritten)> callback);
+    /**
+     * @brief Remove every message and report the error for each.
+     * @pre The queue semaphore is held.
+    */
+    void failAll(const ErrorType error, std::vector<Completion> &completions);
+    /**
+     * @brief Drop messages that expired before they were started.
+     * @pre The queue semaphore is held.
+     * @returns False if the message at the front was partly written and has expired.
+    */
+    bool dropExpired(const Clock::time_point now, std::vector<Completion> &completions);
+    /**
+     * @brief Update the throttle state after the queued bytes change.
+     * @pre The queue semaphore is held.
+     * @returns The backpressure callback bound to the new state if the state changed, nullptr otherwise. Taken while the semaphore
+     *          is held since setBackpressureCallback can replace it from another thread.
+    */
+    std::function<void()> updateThrottle();
+    /**
+     * @brief Call the callbacks collected while the semaphore was held.
+     * @param[in] backpressure The backpressure callback returned by updateThrottle.
+     * @pre The queue semaphore is not held.
+    */
+    void complete(std::vector<Completion> &completions, const std::function<void()> &backpressure);
+    /**
+     * @brief Add a flush to the event queue.
+     * @pre _flushScheduled has been set by the caller.
+     * @returns The errors of EventQueue::addEvent.
+    */
+    static ErrorType addFlush(std::shared_ptr<SendQueue> queue, EventQueue &eventQueue);
+    /**
+     * @brief Add a flush to the event queue once the socket is writable.
+     * @pre _flushScheduled has been set by the caller.
+     * @returns ErrorType::Success if the flush will be added.
+     * @returns ErrorType::PrerequisitesNotMet if there is no socket or nothing left to send.
+     * @returns The errors of SocketWatcher::whenWritable.
+    */
+    static ErrorType addFlushWhenWritable(std::shared_ptr<SendQueue> queue, EventQueue &eventQueue);
+};
+
+#endif // __SEND_QUEUE_MODULE_HPP__
@@ -0,0 +1,582 @@
+//Modules
+#include "SharedMemoryClientModule.hpp"
+#include "NetworkAbstraction.hpp"
+#include "OperatingSystemModule.hpp"
+//Posix
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+//C++
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <new>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    //The memory and a pair of doorbells for each direction.
+    constexpr size_t HandoverDescriptors = 5;
+
+    Milliseconds remainingUntil(const Clock::time_point deadline) {
+        const Clock::time_point now = Clock::now();
+        return now >= deadline ? 0 : std::chrono::ceil<std::chrono::milliseconds>(deadline - now).count();
+    }
+
+    ErrorType toUnixAddress(const std::string &path, struct sockaddr_un &address) {
+        if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+            return ErrorType::InvalidParameter;
+        }
+
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        memcpy(address.sun_path, path.data(), path.size());
+
+        return ErrorType::Success;
+    }
+}
+
+SharedMemoryClient::SharedMemoryClient(Bytes ringSize) : IpClientAbstraction(), _ringSize(std::bit_ceil(ringSize)) {
+    assert(ringSize > 0);
+}
+
+#ifdef __linux__
+
+ErrorType SharedMemoryClient::connectTo(std::string hostname, Port, IpClientSettings::Protocol, IpClientSettings::Version, Socket &sock, Milliseconds timeout) {
+    struct sockaddr_un address;
+    ErrorType error;
+
+    sock = -1;
+
+    if (_status.connected) {
+        return ErrorType::PrerequisitesNotMet;
+    }
+
+    if (ErrorType::Success != (error = toUnixAddress(hostname, address))) {
+        return error;
+    }
+
+    const Socket connection = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (-1 == connection) {
+        return toPlatformError(errno);
+    }
+
+    if (-1 == connect(connection, reinterpret_cast<const struct sockaddr *>(&address), sizeof(address))) {
+        error = toPlatformError(errno);
+        close(connection);
+        return error;
+    }
+
+    struct pollfd descriptor = {.fd = connection, .events = POLLIN, .revents = 0};
+    if (1 != poll(&descriptor, 1, timeout)) {
+        close(connection);
+        return ErrorType::Timeout;
+    }
+
+    //The accepting side sends one byte with the descriptors attached.
+    char byte;
+    struct iovec vector = {.iov_base = &byte, .iov_len = sizeof(byte)};
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * HandoverDescriptors)];
+    struct msghdr message = {};
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    if (sizeof(byte) != recvmsg(connection, &message, MSG_CMSG_CLOEXEC)) {
+        close(connection);
+        return ErrorType::Failure;
+    }
+
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    if (nullptr == header || SCM_RIGHTS != header->cmsg_type || CMSG_LEN(sizeof(int) * HandoverDescriptors) != header->cmsg_len) {
+        close(connection);
+        return ErrorType::Failure;
+    }
+
+    int descriptors[HandoverDescriptors];
+    memcpy(descriptors, CMSG_DATA(header), sizeof(descriptors));
+
+    _outbound.dataReady = descriptors[3];
+    _outbound.spaceReady = descriptors[4];
+    _inbound.dataReady = descriptors[1];
+    _inbound.spaceReady = descriptors[2];
+    _socket = connection;
+
+    error = map(descriptors[0], false);
+    //The mapping keeps the memory alive on its own.
+    close(descriptors[0]);
+
+    if (ErrorType::Success != error) {
+        disconnect();
+        return error;
+    }
+
+    _hostname = hostname;
+    _status.connected = true;
+    sock = connection;
+
+    return ErrorType::Success;
+}
+
+ErrorType SharedMemoryClient::acceptOn(const std::string &path, const Milliseconds timeout) {
+    struct sockaddr_un address;
+    ErrorType error;
+
+    if (_status.connected) {
+        return ErrorType::PrerequisitesNotMet;
+    }
+
+    if (ErrorType::Success != (error = toUnixAddress(path, address))) {
+        return error;
+    }
+
+    const Socket listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (-1 == listener) {
+        return toPlatformError(errno);
+    }
+
+    unlink(path.c_str());
+    if (-1 == bind(listener, reinterpret_cast<const struct sockaddr *>(&address), sizeof(address)) || -1 == listen(listener, 1)) {
+        error = toPlatformError(errno);
+        close(listener);
+        return error;
+    }
+
+    struct pollfd descriptor = {.fd = listener, .events = POLLIN, .revents = 0};
+    const int ready = poll(&descriptor, 1, timeout);
+    const Socket connection = 1 == ready ? accept4(listener, nullptr, nullptr, SOCK_CLOEXEC) : -1;
+    error = 0 == ready ? ErrorType::Timeout : toPlatformError(errno);
+
+    //Only one process can connect so there's no reason to keep listening.
+    close(listener);
+    unlink(path.c_str());
+
+    if (-1 == connection) {
+        return error;
+    }
+    _socket = connection;
+
+    const int memory = memfd_create("sharedMemoryClient", MFD_CLOEXEC);
+    if (-1 == memory) {
+        error = toPlatformError(errno);
+        disconnect();
+        return error;
+    }
+
+    const size_t dataOffset = (sizeof(SharedHeader) + CacheLineSize - 1) & ~(CacheLineSize - 1);
+    if (-1 == ftruncate(memory, dataOffset + 2 * static_cast<size_t>(_ringSize))) {
+        error = toPlatformError(errno);
+        close(memory);
+        disconnect();
+        return error;
+    }
+
+    int descriptors[HandoverDescriptors] = {memory, -1, -1, -1, -1};
+    for (size_t i = 1; i < HandoverDescriptors; i++) {
+        if (-1 == (descriptors[i] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))) {
+            error = toPlatformError(errno);
+            for (size_t j = 0; j < i; j++) {
+                close(descriptors[j]);
+            }
+            disconnect();
+            return error;
+        }
+    }
+
+    _outbound.dataReady = descriptors[1];
+    _outbound.spaceReady = descriptors[2];
+    _inbound.dataReady = descriptors[3];
+    _inbound.spaceReady = descriptors[4];
+
+    if (ErrorType::Success != (error = map(memory, true))) {
+        close(memory);
+        disconnect();
+        return error;
+    }
+
+    char byte = 0;
+    struct iovec vector = {.iov_base = &byte, .iov_len = sizeof(byte)};
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(descriptors))] = {};
+    struct msghdr message = {};
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(descriptors));
+    memcpy(CMSG_DATA(header), descriptors, sizeof(descriptors));
+
+    const ssize_t bytesSent = sendmsg(connection, &message, MSG_NOSIGNAL);
+    error = sizeof(byte) == bytesSent ? ErrorType::Success : toPlatformError(errno);
+    close(memory);
+
+    if (ErrorType::Success != error) {
+        disconnect();
+        return error;
+    }
+
+    _hostname = path;
+    _status.connected = true;
+
+    return ErrorType::Success;
+}
+
+ErrorType SharedMemoryClient::disconnect() {
+    if (nullptr != _shared) {
+        munmap(_shared, _sharedSize);
+        _shared = nullptr;
+        _sharedSize = 0;
+    }
+
+    for (Ring *ring : {&_outbound, &_inbound}) {
+        if (-1 != ring->dataReady) {
+            close(ring->dataReady);
+        }
+        if (-1 != ring->spaceReady) {
+            close(ring->spaceReady);
+        }
+        *ring = Ring();
+    }
+
+    if (-1 != _socket) {
+        close(_socket);
+        _socket = -1;
+    }
+
+    _status.connected = false;
+    return ErrorType::Success;
+}
+
+ErrorType SharedMemoryClient::sendBlocking(const std::string &data, const Milliseconds timeout) {
+    const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout);
+    Bytes sent = 0;
+
+    if (!_status.connected) {
+        return ErrorType::PrerequisitesNotMet;
+    }
+
+    RingControl &control = *_outbound.control;
+
+    while (sent < data.size()) {
+        //Only this side stores the tail.
+        const uint64_t tail = control.tail.load(std::memory_order_relaxed);
+        const uint64_t head = control.head.load(std::memory_order_acquire);
+        const Bytes space = _ringSize - static_cast<Bytes>(tail - head);
+
+        if (0 == space) {
+            //Say that we're going to sleep before checking one last time. The reader checks the flag after it moves the head so
+            //either it sees that we're asleep or we see that it has made room.
+            control.writerWaiting.store(true);
+            if (control.head.load() == head) {
+                const Milliseconds remaining = remainingUntil(deadline);
+                const ErrorType error = 0 == remaining ? ErrorType::Timeout : waitFor(_outbound.spaceReady, remaining);
+                control.writerWaiting.store(false);
+
+                if (ErrorType::Success != error) {
+                    return error;
+                }
+            }
+            else {
+                control.writerWaiting.store(false);
+            }
+
+            continue;
+        }
+
+        const Bytes chunk = std::min<Bytes>(space, data.size() - sent);
+        const Bytes offset = static_cast<Bytes>(tail & (_ringSize - 1));
+        const Bytes beforeWrap = std::min<Bytes>(chunk, _ringSize - offset);
+
+        memcpy(_outbound.data + offset, data.data() + sent, beforeWrap);
+        memcpy(_outbound.data, data.data() + sent + beforeWrap, chunk - beforeWrap);
+
+        control.tail.store(tail + chunk);
+        if (control.readerWaiting.load()) {
+            ring(_outbound.dataReady);
+        }
+
+        sent += chunk;
+    }
+
+    return ErrorType::Success;
+}
+
+ErrorType SharedMemoryClient::receiveBlocking(std::string &buffer, const Milliseconds timeout) {
+    const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout);
+    bool peerGone = false;
+
+    if (!_status.connected) {
+        return ErrorType::PrerequisitesNotMet;
+    }
+    else if (buffer.empty()) {
+        return ErrorType::InvalidParameter;
+    }
+
+    RingControl &control = *_inbound.control;
+
+    while (true) {
+        //Only this side stores the head.
+        const uint64_t head = control.head.load(std::memory_order_relaxed);
+        const uint64_t tail = control.tail.load(std::memory_order_acquire);
+        const Bytes available = static_cast<Bytes>(tail - head);
+
+        if (0 == available) {
+            if (peerGone) {
+                buffer.clear();
+                return ErrorType::Failure;
+            }
+
+            //The mirror image of the writer going to sleep in sendBlocking.
+            control.readerWaiting.store(true);
+            if (control.tail.load() == tail) {
+                const Milliseconds remaining = remainingUntil(deadline);
+                const ErrorType error = 0 == remaining ? ErrorType::Timeout : waitFor(_inbound.dataReady, remaining);
+                control.readerWaiting.store(false);
+
+                if (ErrorType::Timeout == error) {
+                    buffer.clear();
+                    return error;
+                }
+                //Anything it sent before it went away is still delivered.
+                peerGone = ErrorType::Failure == error;
+            }
+            else {
+                control.readerWaiting.store(false);
+            }
+
+            continue;
+        }
+
+        const Bytes chunk = std::min<Bytes>(available, buffer.size());
+        const Bytes offset = static_cast<Bytes>(head & (_ringSize - 1));
+        const Bytes beforeWrap = std::min<Bytes>(chunk, _ringSize - offset);
+
+        memcpy(buffer.data(), _inbound.data + offset, beforeWrap);
+        memcpy(buffer.data() + beforeWrap, _inbound.data, chunk - beforeWrap);
+        buffer.resize(chunk);
+
+        control.head.store(head + chunk);
+        if (control.writerWaiting.load()) {
+            ring(_inbound.spaceReady);
+        }
+
+        return ErrorType::Success;
+    }
+}
+
+ErrorType SharedMemoryClient::map(const int memory, const bool accepting) {
+    struct stat information;
+    const size_t dataOffset = (sizeof(SharedHeader) + CacheLineSize - 1) & ~(CacheLineSize - 1);
+
+    if (-1 == fstat(memory, &information)) {
+        return toPlatformError(errno);
+    }
+
+    _sharedSize = information.st_size;
+    if (_sharedSize < dataOffset) {
+        return ErrorType::Failure;
+    }
+
+    void *shared = mmap(nullptr, _sharedSize, PROT_READ | PROT_WRITE, MAP_SHARED, memory, 0);
+    if (MAP_FAILED == shared) {
+        return toPlatformError(errno);
+    }
+    _shared = shared;
+
+    SharedHeader *header = static_cast<SharedHeader *>(_shared);
+    if (accepting) {
+        header = new (_shared) SharedHeader();
+        header->ringSize = _ringSize;
+    }
+
+    if (!std::has_single_bit(header->ringSize) || _sharedSize < dataOffset + 2 * static_cast<size_t>(header->ringSize)) {
+        return ErrorType::Failure;
+    }
+    _ringSize = header->ringSize;
+
+    char *data = static_cast<char *>(_shared) + dataOffset;
+    const size_t written = accepting ? 0 : 1;
+    const size_t read = accepting ? 1 : 0;
+
+    _outbound.control = &header->rings[written];
+    _outbound.data = data + written * _ringSize;
+    _inbound.control = &header->rings[read];
+    _inbound.data = data + read * _ringSize;
+
+    return ErrorType::Success;
+}
+
+ErrorType SharedMemoryClient::waitFor(const int doorbell, const Milliseconds timeout) {
+    std::array<struct pollfd, 2> descriptors = {{
+        {.fd = doorbell, .events = POLLIN, .revents = 0},
+        {.fd = _socket, .events = POLLIN, .revents = 0}
+    }};
+
+    int ready;
+    do {
+        ready = poll(descriptors.data(), descriptors.size(), timeout);
+    } while (-1 == ready && EINTR == errno);
+
+    if (-1 == ready) {
+        return toPlatformError(errno);
+    }
+    else if (0 == ready) {
+        return ErrorType::Timeout;
+    }
+
+    if (descriptors[0].revents & POLLIN) {
+        eventfd_t count;
+        eventfd_read(doorbell, &count);
+        return ErrorType::Success;
+    }
+
+    //Nothing is sent over the socket after the hand over so any activity on it means the other side closed it.
+    return ErrorType::Failure;
+}
+
+void SharedMemoryClient::ring(const int doorbell) {
+    eventfd_write(doorbell, 1);
+}
+
+#else
+
+ErrorType SharedMemoryClient::connectTo(std::string, Port, IpClientSettings::Protocol, IpClientSettings::Version, Socket &, Milliseconds) {
+    return ErrorType::NotSupported;
+}
+
+ErrorType SharedMemoryClient::acceptOn(const std::string &, const Milliseconds) {
+    return ErrorType::NotSupported;
+}
+
+ErrorType SharedMemoryClient::disconnect() {
+    return ErrorType::NotSupported;
+}
+
+ErrorType SharedMemoryClient::sendBlocking(const std::string &, const Milliseconds) {
+    return ErrorType::NotSupported;
+}
+
+ErrorType SharedMemoryClient::receiveBlocking(std::string &, const Milliseconds) {
+    return ErrorType::NotSupported;
+}
+
+ErrorType SharedMemoryClient::map(const int, const bool) {
+    return ErrorType::NotSupported;
+}
+
+ErrorType SharedMemoryClient::waitFor(const int, const Milliseconds) {
+    return ErrorType::NotSupported;
+}
+
+void SharedMemoryClient::ring(const int) {}
+
+#endif
+
+ErrorType SharedMemoryClient::sendNonBlocking(const std::shared_ptr<std::string> data, const Milliseconds timeout, std::function<void(const ErrorType error, const Bytes bytesWritten)> callback) {
+    struct Result {
+        std::atomic<bool> sent = false;
+        ErrorType error = ErrorType::Failure;
+    };
+
+    auto result = std::make_shared<Result>();
+
+    auto tx = [this, callback, result](const std::shared_ptr<std::string> frame, const Milliseconds timeout) -> ErrorType {
+        if (nullptr == frame.get()) {
+            assert(false);
+            return ErrorType::NoData;
+        }
+
+        const ErrorType error = sendBlocking(*frame, timeout);
+
+        if (nullptr != callback) {
+            callback(error, ErrorType::Success == error ? frame->size() : 0);
+        }
+
+        result->error = error;
+        result->sent = true;
+        return error;
+    };
+
+    std::unique_ptr<EventAbstraction> event = std::make_unique<EventQueue::Event<SharedMemoryClient>>(std::bind(tx, data, timeout));
+    ErrorType error = network().addEvent(event);
+    if (ErrorType::Success != error) {
+        return error;
+    }
+
+    //Block for the timeout specified if no callback is provided
+    if (nullptr == callback) {
+        Milliseconds i;
+        for (i = 0; i < timeout / 10 && !result->sent; i++) {
+            OperatingSystem::Instance().delay(10);
+        }
+
+        if (!result->sent) {
+            return ErrorType::Timeout;
+        }
+
+        return result->error;
+    }
+
+    return ErrorType::Success;
+}
+
+ErrorType SharedMemoryClient::receiveNonBlocking(std::shared_ptr<std::string> buffer, const Milliseconds timeout, std::function<void(const ErrorType error, std::shared_ptr<std::string> buffer)> callback) {
+    struct Result {
+        std::atomic<bool> received = false;
+        ErrorType error = ErrorType::Failure;
+    };
+
+    auto result = std::make_shared<Result>();
+
+    auto rx = [this, callback, result](std::shared_ptr<std::string> buffer, const Milliseconds timeout) -> ErrorType {
+        if (nullptr == buffer.get()) {
+            assert(false);
+            return ErrorType::NoData;
+        }
+
+        const ErrorType error = receiveBlocking(*buffer, timeout);
+
+        if (nullptr != callback) {
+            callback(error, buffer);
+        }
+
+        result->error = error;
+        result->received = true;
+        return error;
+    };
+
+    std::unique_ptr<EventAbstraction> event = std::make_unique<EventQueue::Event<SharedMemoryClient>>(std::bind(rx, buffer, timeout));
+    ErrorType error = network().addEvent(event);
+    if (ErrorType::Success != error) {
+        return error;
+    }
+
+    //Block for the timeout specified if no callback is provided
+    if (nullptr == callback) {
+        Milliseconds i;
+        for (i = 0; i < timeout / 10 && !result->received; i++) {
+            OperatingSystem::Instance().delay(10);
+        }
+
+        if (!result->received) {
+            return ErrorType::Timeout;
+        }
+
+        return result->error;
+    }
+
+    return ErrorType::Success;
+}
@@ -0,0 +1,166 @@
+/***************************************************************************//**
+* @author   Ben Haubrich
+* @file     SharedMemoryClientModule.hpp
+* @details  Shared memory transport between processes on the same host for posix compliant systems.
+* @ingroup  PosixModules
+*******************************************************************************/
+#ifndef __SHARED_MEMORY_CLIENT_MODULE_HPP__
+#define __SHARED_MEMORY_CLIENT_MODULE_HPP__
+
+//AbstractionLayer
+#include "IpClientAbstraction.hpp"
+//C++
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @class SharedMemoryClient
+ * @brief A byte stream between two processes on the same host carried by a pair of rings in shared memory.
+ * @details One side calls acceptOn and the other calls connectTo with the same path. The connection is set up over a Unix domain
+ *          socket at the path: the accepting side creates the shared memory and an eventfd doorbell for each direction and passes
+ *          them to the connecting side. After that data is only copied in and out of the rings. A doorbell is only rung when the
+ *          other side is asleep waiting on it so a busy stream makes no system calls at all.
+ *
+ *          The Unix domain socket stays open for the life of the connection so that each side notices if the other goes away.
+ *
+ *          Shared memory and eventfd are Linux only. Everywhere else every call returns ErrorType::NotSupported.
+ * @code
+ * //Process A
+ * SharedMemoryClient server;
+ * server.acceptOn("/run/telemetry.shm", 10000);
+ *
+ * //Process B
+ * SharedMemoryClient client;
+ * Socket sock;
+ * client.connectTo("/run/telemetry.shm", 0, IpClientSettings::Protocol::Unknown, IpClientSettings::Version::Unknown, sock, 1000);
+ * client.sendBlocking(message, 1000);
+ * @endcode
+*/
+class SharedMemoryClient : public IpClientAbstraction {
+
+    public:
+    /// @brief The default size of each ring.
+    static constexpr Bytes DefaultRingSize = 256*1024;
+
+    /**
+     * @brief Constructor.
+     * @param[in] ringSize The size of each ring if this side accepts the connection. Rounded up to a power of two.
+    */
+    SharedMemoryClient(Bytes ringSize = DefaultRingSize);
+    ~SharedMemoryClient() { disconnect(); }
+
+    /**
+     * @brief Connect to a process waiting in acceptOn.
+     * @param[in] hostname The path that the other process is accepting on.
+     * @param[in] port Ignored.
+     * @param[in] protocol Ignored.
+     * @param[in] version Ignored.
+     * @param[out] socket The Unix domain socket that the connection was set up over.
+     * @param[in] timeout The time to wait for the other process to hand over the shared memory.
+     * @returns ErrorType::Success if connected.
+     * @returns ErrorType::InvalidParameter if the path is empty or too long.
+     * @returns ErrorType::Timeout if the shared memory was not handed over in time.
+     * @returns ErrorType::NotSupported if the system does not have shared memory and eventfd.
+    */
+    ErrorType connectTo(std::string hostname, Port port, IpClientSettings::Protocol protocol, IpClientSettings::Version version, Socket &socket, Milliseconds timeout) override;
+    /**
+     * @brief Wait for a process to connect and set up the shared memory.
+     * @param[in] path The path of the Unix domain socket to accept on. It is removed once the connection is made.
+     * @param[in] timeout The time to wait for a process to connect.
+     * @returns ErrorType::Success if connected.
+     * @returns ErrorType::InvalidParameter if the path is empty or too long.
+     * @returns ErrorType::Timeout if no process connected in time.
+     * @returns ErrorType::NotSupported if the system does not have shared memory and eventfd.
+    */
+    ErrorType acceptOn(const std::string &path, const Milliseconds timeout);
+    ErrorType disconnect() override;
+    /**
+     * @brief Copy data into the outbound ring, waiting for the other side to make room as needed.
+     * @param[in] data The data to send
+     * @param[in] timeout The time to wait for room in the ring.
+     * @returns ErrorType::Success if all of the data was sent.
+     * @returns ErrorType::Timeout if the other side did not make room in time. Some of the data may have been sent.
+     * @returns ErrorType::Failure if the other side has gone away.
+     * @returns ErrorType::PrerequisitesNotMet if not connected.
+    */
+    ErrorType sendBlocking(const std::string &data, const Milliseconds timeout) override;
+    /**
+     * @brief Copy whatever is waiting in the inbound ring, waiting for data if there is none.
+     * @param[out] buffer Filled with up to buffer.size() bytes and resized to the number received.
+     * @param[in] timeout The time to wait for data.
+     * @returns ErrorType::Success if at least one byte was received.
+     * @returns ErrorType::Timeout if nothing was received in time.
+     * @returns ErrorType::Failure if the other side has gone away and everything it sent has been received.
+     * @returns ErrorType::PrerequisitesNotMet if not connected.
+    */
+    ErrorType receiveBlocking(std::string &buffer, const Milliseconds timeout) override;
+    ErrorType sendNonBlocking(const std::shared_ptr<std::string> data, const Milliseconds timeout, std::function<void(const ErrorType error, const Bytes bytesWritten)> callback = nullptr) override;
+    ErrorType receiveNonBlocking(std::shared_ptr<std::string> buffer, const Milliseconds timeout, std::function<void(const ErrorType error, std::shared_ptr<std::string> buffer)> callback = nullptr) override;
+
+    private:
+    /// @brief Size of a cache line. The indexes that each side writes are kept on separate lines so they don't false share.
+    static constexpr Bytes CacheLineSize = 64;
+
+    /**
+     * @struct RingControl
+     * @brief The shared indexes of one ring. The writer only stores tail and the reader only stores head.
+    */
+    struct RingControl {
+        alignas(CacheLineSize) std::atomic<uint64_t> head;        ///< Total bytes read.
+        std::atomic<bool> writerWaiting;                         ///< True while the writer is asleep waiting for room.
+        alignas(CacheLineSize) std::atomic<uint64_t> tail;        ///< Total bytes written.
+        std::atomic<bool> readerWaiting;                         ///< True while the reader is asleep waiting for data.
+    };
+
+    /**
+     * @struct SharedHeader
+     * @brief The start of the shared memory. The data of both rings follows.
+    */
+    struct SharedHeader {
+        uint32_t ringSize;                 ///< The size of each ring in bytes.
+        std::array<RingControl, 2> rings;  ///< [0] is written by the accepting side, [1] by the connecting side.
+    };
+
+    /**
+     * @struct Ring
+     * @brief One direction of the connection as seen from this process.
+    */
+    struct Ring {
+        RingControl *control = nullptr; ///< The shared indexes.
+        char *data = nullptr;           ///< The shared data.
+        int dataReady = -1;             ///< eventfd rung by the writer when there is new data.
+        int spaceReady = -1;            ///< eventfd rung by the reader when it has made room.
+    };
+
+    /// @brief The size of each ring if this side accepts the connection.
+    Bytes _ringSize;
+    /// @brief The shared memory.
+    void *_shared = nullptr;
+    /// @brief The size of the shared memory.
+    size_t _sharedSize = 0;
+    /// @brief The ring that this side writes to.
+    Ring _outbound;
+    /// @brief The ring that this side reads from.
+    Ring _inbound;
+
+    /**
+     * @brief Map the shared memory and point the rings at it.
+     * @param[in] memory The shared memory file.
+     * @param[in] accepting True if this side accepted the connection.
+    */
+    ErrorType map(const int memory, const bool accepting);
+    /**
+     * @brief Wait for a doorbell.
+     * @param[in] doorbell The eventfd to wait on.
+     * @param[in] timeout The time to wait.
+     * @returns ErrorType::Success if the doorbell rang.
+     * @returns ErrorType::Timeout if the doorbell did not ring in time.
+     * @returns ErrorType::Failure if the other side went away.
+    */
+    ErrorType waitFor(const int doorbell, const Milliseconds timeout);
+    /// @brief Ring a doorbell.
+    void ring(const int doorbell);
+};
+
+#endif // __SHARED_MEMORY_CLIENT_MODULE_HPP__
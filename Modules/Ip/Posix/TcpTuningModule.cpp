@@ -0,0 +1,177 @@
+//Modules
+#include "TcpTuningModule.hpp"
+//Posix
+#include <sys/socket.h>
+#include <netinet/in.h>
+#ifdef __linux__
+//The glibc copy of tcp_info stops before the byte counters.
+#include <linux/tcp.h>
+#else
+#include <netinet/tcp.h>
+#endif
+#include <errno.h>
+//C++
+#include <cstring>
+
+namespace {
+    ErrorType setOption(const Socket socket, const int level, const int option, const int value, ErrorType &firstError) {
+        if (-1 == setsockopt(socket, level, option, &value, sizeof(value))) {
+            const ErrorType error = toPlatformError(errno);
+            if (ErrorType::Success == firstError) {
+                firstError = error;
+            }
+            return error;
+        }
+
+        return ErrorType::Success;
+    }
+}
+
+TcpTuningSettings::Settings TcpTuning::profile(const TcpTuningSettings::Profile profile) {
+    TcpTuningSettings::Settings settings;
+
+    switch (profile) {
+        case TcpTuningSettings::Profile::LowLatency:
+            settings.noDelay = true;
+            settings.keepAlive = true;
+            settings.keepAliveIdle = 30;
+            settings.keepAliveInterval = 5;
+            settings.keepAliveProbes = 3;
+            settings.userTimeout = 10000;
+            break;
+        case TcpTuningSettings::Profile::Bulk:
+            //The buffers are left to the kernel's auto tuning which grows them to the bandwidth delay product on its own.
+            //Nagle is enough to coalesce the writes into full segments. Corking would also hold back the last partial segment of
+            //every message for up to 200ms since nothing uncorks the socket after a send.
+            settings.keepAlive = true;
+            settings.keepAliveIdle = 60;
+            settings.keepAliveInterval = 10;
+            settings.keepAliveProbes = 5;
+            break;
+        case TcpTuningSettings::Profile::Cellular:
+            //Nagle and delayed acknowledgements together cost a whole round trip on small writes, which hurts the most when the
+            //round trip is half a second.
+            settings.noDelay = true;
+            //Carrier NATs commonly forget idle TCP flows after a few minutes so probe well before that.
+            settings.keepAlive = true;
+            settings.keepAliveIdle = 60;
+            settings.keepAliveInterval = 15;
+            settings.keepAliveProbes = 4;
+            //Ride out handovers and coverage gaps instead of giving up after the first few retransmits.
+            settings.userTimeout = 120000;
+            break;
+        default:
+            break;
+    }
+
+    return settings;
+}
+
+ErrorType TcpTuning::apply(const Socket socket, const TcpTuningSettings::Settings &settings) {
+    ErrorType firstError = ErrorType::Success;
+    int type = 0;
+    socklen_t typeLength = sizeof(type);
+
+    if (-1 == getsockopt(socket, SOL_SOCKET, SO_TYPE, &type, &typeLength)) {
+        return toPlatformError(errno);
+    }
+
+    if (0 != settings.sendBufferSize) {
+        setOption(socket, SOL_SOCKET, SO_SNDBUF, settings.sendBufferSize, firstError);
+    }
+    if (0 != settings.receiveBufferSize) {
+        setOption(socket, SOL_SOCKET, SO_RCVBUF, settings.receiveBufferSize, firstError);
+    }
+
+    if (SOCK_STREAM != type) {
+        return firstError;
+    }
+
+    setOption(socket, IPPROTO_TCP, TCP_NODELAY, settings.noDelay, firstError);
+#if defined(TCP_CORK)
+    setOption(socket, IPPROTO_TCP, TCP_CORK, settings.cork, firstError);
+#elif defined(TCP_NOPUSH)
+    setOption(socket, IPPROTO_TCP, TCP_NOPUSH, settings.cork, firstError);
+#endif
+
+    setOption(socket, SOL_SOCKET, SO_KEEPALIVE, settings.keepAlive, firstError);
+    if (settings.keepAlive) {
+        if (0 != settings.keepAliveIdle) {
+#if defined(TCP_KEEPIDLE)
+            setOption(socket, IPPROTO_TCP, TCP_KEEPIDLE, settings.keepAliveIdle, firstError);
+#elif defined(TCP_KEEPALIVE)
+            setOption(socket, IPPROTO_TCP, TCP_KEEPALIVE, settings.keepAliveIdle, firstError);
+#endif
+        }
+#if defined(TCP_KEEPINTVL)
+        if (0 != settings.keepAliveInterval) {
+            setOption(socket, IPPROTO_TCP, TCP_KEEPINTVL, settings.keepAliveInterval, firstError);
+        }
+#endif
+#if defined(TCP_KEEPCNT)
+        if (0 != settings.keepAliveProbes) {
+            setOption(socket, IPPROTO_TCP, TCP_KEEPCNT, settings.keepAliveProbes, firstError);
+        }
+#endif
+    }
+
+#if defined(TCP_USER_TIMEOUT)
+    if (0 != settings.userTimeout) {
+        setOption(socket, IPPROTO_TCP, TCP_USER_TIMEOUT, settings.userTimeout, firstError);
+    }
+#endif
+
+    return firstError;
+}
+
+ErrorType TcpTuning::statistics(const Socket socket, TcpTuningSettings::Statistics &statistics) {
+    statistics = TcpTuningSettings::Statistics();
+
+#if defined(TCP_INFO)
+    struct tcp_info info;
+    socklen_t length = sizeof(info);
+
+    //Older kernels fill in less of the structure so anything they leave out stays 0.
+    memset(&info, 0, sizeof(info));
+    if (-1 == getsockopt(socket, IPPROTO_TCP, TCP_INFO, &info, &length)) {
+        return toPlatformError(errno);
+    }
+
+    statistics.roundTripTime = info.tcpi_rtt;
+    statistics.roundTripTimeVariance = info.tcpi_rttvar;
+    statistics.congestionWindow = info.tcpi_snd_cwnd;
+    statistics.slowStartThreshold = info.tcpi_snd_ssthresh;
+    statistics.maxSegmentSize = info.tcpi_snd_mss;
+    statistics.retransmits = info.tcpi_retransmits;
+    statistics.totalRetransmits = info.tcpi_total_retrans;
+    statistics.bytesAcked = info.tcpi_bytes_acked;
+    statistics.bytesReceived = info.tcpi_bytes_received;
+
+    return ErrorType::Success;
+#elif defined(TCP_CONNECTION_INFO)
+    struct tcp_connection_info info;
+    socklen_t length = sizeof(info);
+
+    memset(&info, 0, sizeof(info));
+    if (-1 == getsockopt(socket, IPPROTO_TCP, TCP_CONNECTION_INFO, &info, &length)) {
+        return toPlatformError(errno);
+    }
+
+    //Darwin reports times in milliseconds and the windows in bytes.
+    statistics.roundTripTime = info.tcpi_srtt * 1000;
+    statistics.roundTripTimeVariance = info.tcpi_rttvar * 1000;
+    statistics.maxSegmentSize = info.tcpi_maxseg;
+    if (0 != info.tcpi_maxseg) {
+        statistics.congestionWindow = info.tcpi_snd_cwnd / info.tcpi_maxseg;
+        statistics.slowStartThreshold = info.tcpi_snd_ssthresh / info.tcpi_maxseg;
+    }
+    statistics.totalRetransmits = info.tcpi_txretransmitpackets;
+    //Darwin doesn't count acknowledged bytes. Bytes that went out without needing a retransmit are the closest it has.
+    statistics.bytesAcked = info.tcpi_txbytes - info.tcpi_txretransmitbytes;
+    statistics.bytesReceived = info.tcpi_rxbytes;
+
+    return ErrorType::Success;
+#else
+    return ErrorType::NotSupported;
+#endif
+}
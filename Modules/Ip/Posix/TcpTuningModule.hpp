@@ -0,0 +1,107 @@
+/***************************************************************************//**
+* @author   Ben Haubrich
+* @file     TcpTuningModule.hpp
+* @details  TCP socket options and kernel statistics for posix compliant systems.
+* @ingroup  PosixModules
+*******************************************************************************/
+#ifndef __TCP_TUNING_MODULE_HPP__
+#define __TCP_TUNING_MODULE_HPP__
+
+//AbstractionLayer
+#include "Error.hpp"
+#include "Types.hpp"
+
+/**
+ * @namespace TcpTuningSettings
+ * @brief Settings for tuning TCP connections
+*/
+namespace TcpTuningSettings {
+
+    /**
+     * @enum Profile
+     * @brief Named sets of socket options for the links we run on.
+    */
+    enum class Profile : uint8_t {
+        Unknown = 0, ///< Leave every option at the system default.
+        LowLatency,  ///< Small request/response messages on a LAN. Nagle is off and dead peers are noticed quickly.
+        Bulk,        ///< Large transfers. Nagle coalesces writes into full segments and dead peers are noticed slowly.
+        Cellular     ///< High and variable RTT with carrier NATs that drop idle flows. Tolerates long stalls during handovers.
+    };
+
+    /**
+     * @struct Settings
+     * @brief Socket options applied to a connection. Numeric options that are 0 are left at the system default.
+    */
+    struct Settings {
+        bool noDelay = false;                 ///< Disable Nagle's algorithm (TCP_NODELAY).
+        bool cork = false;                    ///< Only send full segments until uncorked (TCP_CORK on Linux, TCP_NOPUSH on Darwin). The last partial segment waits up to 200ms unless the caller uncorks after each burst.
+        bool keepAlive = false;               ///< Probe idle connections so that dead peers and expired NAT mappings are noticed (SO_KEEPALIVE).
+        Seconds keepAliveIdle = 0;            ///< Idle time before the first keep alive probe.
+        Seconds keepAliveInterval = 0;        ///< Time between keep alive probes.
+        Count keepAliveProbes = 0;            ///< Unanswered probes before the connection is dropped.
+        Bytes sendBufferSize = 0;             ///< SO_SNDBUF. Setting it turns off the kernel's send buffer auto tuning.
+        Bytes receiveBufferSize = 0;          ///< SO_RCVBUF. Setting it turns off the kernel's receive buffer auto tuning.
+        Milliseconds userTimeout = 0;         ///< How long sent data may go unacknowledged before the connection is dropped (TCP_USER_TIMEOUT). Linux only.
+    };
+
+    /**
+     * @struct Statistics
+     * @brief What the kernel knows about a connection (TCP_INFO on Linux, TCP_CONNECTION_INFO on Darwin).
+     * @details Fields the system doesn't report are left as 0.
+    */
+    struct Statistics {
+        Microseconds roundTripTime = 0;         ///< Smoothed round trip time.
+        Microseconds roundTripTimeVariance = 0; ///< Round trip time variance.
+        Count congestionWindow = 0;             ///< Send congestion window in segments.
+        Count slowStartThreshold = 0;           ///< Slow start threshold in segments.
+        Bytes maxSegmentSize = 0;               ///< Send maximum segment size.
+        Count retransmits = 0;                  ///< Retransmits of the segment currently being retransmitted.
+        Count totalRetransmits = 0;             ///< Segments retransmitted over the life of the connection.
+        uint64_t bytesAcked = 0;                ///< Bytes sent and acknowledged by the peer.
+        uint64_t bytesReceived = 0;             ///< Bytes received from the peer.
+    };
+}
+
+/**
+ * @class TcpTuning
+ * @brief Applies socket options and reads connection statistics.
+ * @code
+ * TcpTuning::apply(socket, TcpTuning::profile(TcpTuningSettings::Profile::Cellular));
+ *
+ * TcpTuningSettings::Statistics statistics;
+ * if (ErrorType::Success == TcpTuning::statistics(socket, statistics)) {
+ *     CBT_LOGI(TAG, "rtt:%uus cwnd:%u retransmits:%u", statistics.roundTripTime, statistics.congestionWindow, statistics.totalRetransmits);
+ * }
+ * @endcode
+*/
+class TcpTuning {
+
+    public:
+    /**
+     * @brief Get the settings of a profile.
+     * @param[in] profile The profile.
+     * @returns The settings.
+    */
+    static TcpTuningSettings::Settings profile(const TcpTuningSettings::Profile profile);
+    /**
+     * @brief Apply settings to a socket.
+     * @details Options that only make sense for TCP are skipped on other socket types and options that the system does not
+     *          support are skipped.
+     * @param[in] socket The socket.
+     * @param[in] settings The settings to apply.
+     * @returns ErrorType::Success if every supported option was applied.
+     * @returns The error of the first option that could not be applied otherwise. The remaining options are still applied.
+    */
+    static ErrorType apply(const Socket socket, const TcpTuningSettings::Settings &settings);
+    /**
+     * @brief Read the kernel's statistics for a TCP connection.
+     * @param[in] socket The connected socket.
+     * @param[out] statistics The statistics.
+     * @returns ErrorType::Success if the statistics were read.
+     * @returns ErrorType::NotSupported if the system does not report connection statistics.
+     * @returns The error of getsockopt otherwise.
+    */
+    static ErrorType statistics(const Socket socket, TcpTuningSettings::Statistics &statistics);
+};
+
+#endif // __TCP_TUNING_MODULE_HPP__
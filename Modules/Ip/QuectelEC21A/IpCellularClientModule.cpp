@@ -5,8 +5,10 @@
 //AbstractionLayer Applications
 #include "Log.hpp"
 //C++
-#include <cstring>
-#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
 
 #define IP_CELLULAR_CLIENT_DEBUG 0
 
@@ -59,7 +61,7 @@ ErrorType IpCellularClient::connectTo(std::string hostname, Port port, IpClientS
             return ErrorType::NotSupported;
         }
 
-        disconnect();
+        close();
 
         if (version != IpClientSettings::Version::IPv4) {
             CBT_LOGE(TAG, "only IPv4 is implemented");
@@ -97,18 +99,24 @@ ErrorType IpCellularClient::connectTo(std::string hostname, Port port, IpClientS
         openSocketCommand.append(",").append(std::to_string(0));
         openSocketCommand.append(",").append(std::to_string(ToQuectelAccessMode(_cellNetworkInterface->accessModeConst())));
 
+        //Quectel LTE Standard TCP/IP Application Note. In transparent access mode the modem answers CONNECT and is in data mode.
+        const bool transparent = CellularConfig::AccessMode::Transparent == _cellNetworkInterface->accessModeConst();
         error = _cellNetworkInterface->sendCommand(openSocketCommand, 1000, 10);
-        if (ErrorType::Success != error) {
-            socket = -1;
-            return error;
+        if (ErrorType::Success == error) {
+            error = _cellNetworkInterface->receiveCommand(openSocketCommand, 1000, 10, transparent ? "CONNECT" : "OK");
         }
 
-        error = _cellNetworkInterface->receiveCommand(openSocketCommand, 1000, 10, "OK");
         if (ErrorType::Success != error) {
+            _cellNetworkInterface->releaseConnectionId(socket);
             socket = -1;
             return error;
         }
 
+        _cellNetworkInterface->_multiplexer.open(socket);
+        if (transparent) {
+            _cellNetworkInterface->dataModeEntered(socket);
+        }
+
         CBT_LOGI(TAG, "Connected to %s", hostname.c_str());
         _status.connected = true;
         _socket = socket;
@@ -116,94 +124,75 @@ ErrorType IpCellularClient::connectTo(std::string hostname, Port port, IpClientS
         return ErrorType::Success;
     };
 
-    std::unique_ptr<EventAbstraction> event = std::make_unique<EventQueue::Event<IpCellularClient>>(std::bind(connectCb));
+    //A connect that fails ends the wait as soon as it does instead of leaving it to time out.
+    auto result = std::make_shared<std::atomic<ErrorType>>(ErrorType::Timeout);
+    auto done = std::make_shared<std::atomic<bool>>(false);
+    auto connect = [connectCb, result, done]() -> ErrorType {
+        *result = connectCb();
+        *done = true;
+        return result->load();
+    };
+
+    std::unique_ptr<EventAbstraction> event = std::make_unique<EventQueue::Event<IpCellularClient>>(std::bind(connect));
     if (ErrorType::Success != network().addEvent(event)) {
         return ErrorType::Failure;
     }
 
-    {
-    Milliseconds i;
-    for (i = 0; i < timeout / 10 && !_status.connected; i++) {
+    for (Milliseconds i = 0; i < timeout / 10 && !*done; i++) {
         OperatingSystem::Instance().delay(10);
     }
 
-    if (!_status.connected && (timeout / 10) == i) {
-        return ErrorType::Timeout;
+    return *done ? result->load() : ErrorType::Timeout;
+}
+
+ErrorType IpCellularClient::disconnect() {
+    if (nullptr == _cellNetworkInterface || -1 == _socket) {
+        return ErrorType::Success;
     }
-    else if (!_status.connected) {
+
+    //Closes on the network thread so that it doesn't interrupt a command of another connection.
+    auto result = std::make_shared<std::atomic<ErrorType>>(ErrorType::Timeout);
+    auto done = std::make_shared<std::atomic<bool>>(false);
+    auto disconnectCb = [this, result, done]() -> ErrorType {
+        *result = close();
+        *done = true;
+        return result->load();
+    };
+
+    std::unique_ptr<EventAbstraction> event = std::make_unique<EventQueue::Event<IpCellularClient>>(std::bind(disconnectCb));
+    if (ErrorType::Success != network().addEvent(event)) {
         return ErrorType::Failure;
     }
-    else {
-        return ErrorType::Success;
-    }
+
+    constexpr Milliseconds timeout = 5000;
+    for (Milliseconds i = 0; i < timeout / 10 && !*done; i++) {
+        OperatingSystem::Instance().delay(10);
     }
+
+    return *done ? result->load() : ErrorType::Timeout;
 }
 
-ErrorType IpCellularClient::disconnect() {
-    return ErrorType::NotImplemented;
+ErrorType IpCellularClient::close() {
+    if (-1 == _socket) {
+        return ErrorType::Success;
+    }
+
+    const ErrorType error = _cellNetworkInterface->closeConnection(_socket);
+    _cellNetworkInterface->releaseConnectionId(_socket);
+    _socket = -1;
+    _status.connected = false;
+
+    return error;
 }
 
 ErrorType IpCellularClient::sendBlocking(const std::string &data, const Milliseconds timeout) {
 
     switch (_cellNetworkInterface->accessModeConst()) {
-        case CellularConfig::AccessMode::Transparent: {
-            return _cellNetworkInterface->_ic->txBlocking(data, timeout);
-        }
+        case CellularConfig::AccessMode::Transparent:
         case CellularConfig::AccessMode::Buffer:
         case CellularConfig::AccessMode::DirectPush: {
-            constexpr Milliseconds timeout = 1000;
-            constexpr Count maxRetries = 10;
-
-            ErrorType error = ErrorType::Failure;
-            std::string receiveBuffer(128, 0);
-            Bytes remaining = data.size();
-
-            std::string command("AT+QISEND=");
-            command.append(std::to_string(_socket));
-            command.append(",").append(std::to_string(data.size()));
-
-            error = _cellNetworkInterface->sendCommand(command, timeout, 10);
-            if (ErrorType::Success != error) {
-                CBT_LOGW(TAG, "AT command error:");
-                CBT_LOG_BUFFER_HEXDUMP(TAG, command.c_str(), command.size(), LogType::Warning);
-                return error;
-            }
-
-            error = _cellNetworkInterface->receiveCommand(receiveBuffer, 1000, 10, ">");
-            if (ErrorType::Timeout == error) {
-                CBT_LOGW(TAG, "Failed to receive command:");
-                CBT_LOG_BUFFER_HEXDUMP(TAG, command.c_str(), command.size(), LogType::Warning);
-            }
-
-            const uint16_t maxSegmentSize = 1460;
-            if (data.size() < maxSegmentSize) {
-                error = _cellNetworkInterface->_ic->txBlocking(data, timeout);
-                if (ErrorType::Success != error) {
-                    CBT_LOGW(TAG, "Failed to send data");
-                    return error;
-                }
-
-                error = _cellNetworkInterface->receiveCommand(receiveBuffer, timeout, maxRetries, "SEND OK");
-                if (ErrorType::Timeout == error) {
-                    CBT_LOGW(TAG, "Receive error: SEND OK");
-                    CBT_LOG_BUFFER_HEXDUMP(TAG, receiveBuffer.c_str(), receiveBuffer.size(), LogType::Warning);
-                    return error;
-                }
-            }
-            else {
-                Count sendRetries = 0;
-                do {
-                    _cellNetworkInterface->_ic->txBlocking(data.data() + (data.size() - remaining), remaining > maxSegmentSize ? remaining : maxSegmentSize);
-                    error = _cellNetworkInterface->receiveCommand(receiveBuffer, timeout, maxRetries, "SEND OK");
-                    if (ErrorType::Timeout == error) {
-                        CBT_LOGW(TAG, "Receive error: SEND OK");
-                        CBT_LOG_BUFFER_HEXDUMP(TAG, receiveBuffer.c_str(), receiveBuffer.size(), LogType::Warning);
-                        return error;
-                    }
-                } while (remaining > 0 && sendRetries++ < maxRetries);
-            }
-
-            return ErrorType::Success;
+            //The network thread sends it in turn with the other connections, or straight to the IC while the modem is in data mode.
+            return _cellNetworkInterface->_multiplexer.sendBlocking(_socket, data, timeout);
         }
     }
 
@@ -214,9 +203,6 @@ ErrorType IpCellularClient::receiveBlocking(std::string &buffer, const Milliseco
     constexpr Count maxRetries = 10;
 
     switch (_cellNetworkInterface->accessModeConst()) {
-        case CellularConfig::AccessMode::Transparent: {
-            return _cellNetworkInterface->receiveCommand(buffer, timeout, maxRetries);
-        }
         case CellularConfig::AccessMode::DirectPush: {
             ErrorType error = ErrorType::Failure;
             error = _cellNetworkInterface->receiveCommand(buffer, timeout, maxRetries, "+QIURC:");
@@ -226,95 +212,10 @@ ErrorType IpCellularClient::receiveBlocking(std::string &buffer, const Milliseco
 
             return ErrorType::NotImplemented;
         }
+        case CellularConfig::AccessMode::Transparent:
         case CellularConfig::AccessMode::Buffer: {
-            ErrorType error = pollForData(_socket, timeout);
-            if (ErrorType::Success != error) {
-                return error;
-            }
-
-            constexpr Count maxRetries = 10;
-            constexpr Milliseconds timeout = 1000;
-
-            std::string readCommand("AT+QIRD=");
-            readCommand.append(std::to_string(_socket));
-            readCommand.append(",");
-            const bool needsMultipleReads = buffer.size() > _cellNetworkInterface->_MaxBytesToRead;
-            readCommand.append(std::to_string(needsMultipleReads ? _cellNetworkInterface->_MaxBytesToRead : buffer.size()));
-
-            error = _cellNetworkInterface->sendCommand(readCommand, maxRetries, timeout);
-            if (ErrorType::Success != error) {
-                CBT_LOGW(TAG, "AT command error:");
-                CBT_LOG_BUFFER_HEXDUMP(TAG, readCommand.c_str(), readCommand.size(), LogType::Warning);
-                return error;
-            }
-
-            if (needsMultipleReads) {
-                const Bytes totalToRead = buffer.size();
-                buffer.resize(0);
-                const Count numberOfReadsNeeded = std::ceil(totalToRead / _cellNetworkInterface->_MaxBytesToRead);
-
-                for (Count i = 0; i < numberOfReadsNeeded; i++) {
-                    std::string multipleReadBuffer(_cellNetworkInterface->_MaxBytesToRead, 0);
-
-                    error = _cellNetworkInterface->receiveCommand(multipleReadBuffer, maxRetries, timeout, "OK");
-
-                    if (ErrorType::Timeout == error) {
-                        CBT_LOGW(TAG, "AT command error:");
-                        CBT_LOG_BUFFER_HEXDUMP(TAG, readCommand.c_str(), readCommand.size(), LogType::Warning);
-                        return error;
-                    }
-
-                    buffer.append(multipleReadBuffer);
-                }
-            }
-            else {
-                error = _cellNetworkInterface->receiveCommand(buffer, maxRetries, timeout, "OK");
-
-                if (ErrorType::Timeout == error) {
-                    CBT_LOGW(TAG, "AT command error:");
-                    CBT_LOG_BUFFER_HEXDUMP(TAG, readCommand.c_str(), readCommand.size(), LogType::Warning);
-                    return error;
-                }
-            }
-
-            //Pg. 20, Sec. 2.1.8, Quectel LTE TCP/IP standard.
-            //Incoming payload response begins with a preamble of "+QIRD: <bytesReceived>". So from the beginning of the buffer remove everything until the first " ".
-            for (size_t i = 0; i < buffer.size(); i++) {
-                if (buffer.at(i) == ' ') {
-                    i++;
-                    memmove(&buffer.at(0), &buffer.at(i), buffer.size() - i);
-                    buffer.resize(buffer.size() - i);
-                    break;
-                }
-            }
-            //This leaves us with the buffer beginning with "<bytesReceived>". Replace the command line termination character with a null terminator
-            //so that we can use the std::strtoul function to parse the number of bytes received.
-            for (size_t i = 0; i < buffer.size(); i++) {
-                if (buffer.at(i) == _cellNetworkInterface->_commandLineTerminationCharacter) {
-                    buffer.at(i) = '\0';
-
-                    const Bytes toRead = std::strtoul(buffer.c_str(), nullptr, 10);
-                    if (toRead > buffer.size()) {
-                        CBT_LOGW(TAG, "Bytes to read is larger than the buffer size <toRead:%u, bufferSize:%u>", toRead, buffer.size());
-                        return ErrorType::PrerequisitesNotMet;
-                    }
-                    if (0 == toRead) {
-                        buffer.resize(0);
-                        return ErrorType::NoData;
-                    }
-#if IP_CELLULAR_CLIENT_DEBUG
-                    CBT_LOGI(TAG, "Bytes to read: %u", toRead);
-#endif
-                    //Move the payload over and overwrite the remaining preamble so that all we've got left is the payload.
-                    //There is still the OK message at the end, but we can just reduce the buffer size to remove it.
-                    i += 2;
-                    memmove(&buffer.at(0), &buffer.at(i), buffer.size() - i);
-                    buffer.resize(toRead);
-                    return ErrorType::Success;
-                }
-            }
-
-            return ErrorType::Failure;
+            //Read from the modem by the network thread in turn with the other connections, or straight from the IC in data mode.
+            return _cellNetworkInterface->_multiplexer.receiveBlocking(_socket, buffer, timeout);
         }
         default:
             return ErrorType::NotSupported;
@@ -322,54 +223,38 @@ ErrorType IpCellularClient::receiveBlocking(std::string &buffer, const Milliseco
 }
 
 ErrorType IpCellularClient::sendNonBlocking(const std::shared_ptr<std::string> data, const Milliseconds timeout, std::function<void(const ErrorType error, const Bytes bytesWritten)> callback) {
-    bool sent = false;
-
-    auto tx = [this, callback, &sent](const std::shared_ptr<std::string> frame, const Milliseconds timeout) -> ErrorType {
-        ErrorType error = ErrorType::Failure;
+    if (nullptr == _cellNetworkInterface) {
+        return ErrorType::PrerequisitesNotMet;
+    }
+    else if (nullptr == data) {
+        return ErrorType::NoData;
+    }
 
-        if (nullptr == frame.get()) {
-            assert(false);
-            return ErrorType::NoData;
-        }
+    //The network thread sends it in turn with the other connections. Waiting for it on the network thread would keep it from ever
+    //being sent, so without a callback it's waited for on this thread instead.
+    if (nullptr == callback) {
+        return sendBlocking(*data, timeout);
+    }
 
-        error = sendBlocking(*frame, timeout);
+    return _cellNetworkInterface->_multiplexer.send(_socket, data, timeout, callback);
+}
 
+ErrorType IpCellularClient::receiveNonBlocking(std::shared_ptr<std::string> buffer, const Milliseconds timeout, std::function<void(const ErrorType error, std::shared_ptr<std::string> buffer)> callback) {
+    //Waiting for data on the network thread would keep it from reading the data for every connection.
+    const bool multiplexed = nullptr != _cellNetworkInterface && (CellularConfig::AccessMode::Buffer == _cellNetworkInterface->accessModeConst() ||
+                                                                  CellularConfig::AccessMode::Transparent == _cellNetworkInterface->accessModeConst());
+    if (multiplexed) {
         if (nullptr != callback) {
-            callback(error, frame->size());
+            return _cellNetworkInterface->_multiplexer.receive(_socket, buffer, timeout, callback);
         }
 
-        sent = true;
-        return error;
-    };
-
-    std::unique_ptr<EventAbstraction> event = std::make_unique<EventQueue::Event<IpCellularClient>>(std::bind(tx, data, timeout));
-    ErrorType error = network().addEvent(event);
-    if (ErrorType::Success != error) {
-        return error;
-    }
-
-    //Block for the timeout specified if no callback is provided
-    if (nullptr == callback) {
-        Milliseconds i;
-        for (i = 0; i < timeout / 10 && !sent; i++) {
-            OperatingSystem::Instance().delay(10);
+        if (nullptr == buffer) {
+            return ErrorType::NoData;
         }
 
-        if (!sent && (timeout / 10) == i) {
-            return ErrorType::Timeout;
-        }
-        else if (!sent) {
-            return ErrorType::Failure;
-        }
-        else {
-            return ErrorType::Success;
-        }
+        return receiveBlocking(*buffer, timeout);
     }
 
-    return ErrorType::Success;
-}
-
-ErrorType IpCellularClient::receiveNonBlocking(std::shared_ptr<std::string> buffer, const Milliseconds timeout, std::function<void(const ErrorType error, std::shared_ptr<std::string> buffer)> callback) {
     bool received = false;
 
     auto rx = [this, callback, &received](const std::shared_ptr<std::string> buffer, const Milliseconds timeout) -> ErrorType {
@@ -416,35 +301,3 @@ ErrorType IpCellularClient::receiveNonBlocking(std::shared_ptr<std::string> buff
 
     return ErrorType::Success;
 }
-
-ErrorType IpCellularClient::pollForData(const Socket socket, const Milliseconds timeout) {
-    if (CellularConfig::AccessMode::Buffer != _cellNetworkInterface->accessModeConst()) {
-        return ErrorType::PrerequisitesNotMet;
-    }
-
-    Ticks timeoutTicks;
-    Milliseconds waitForIncomingMessage;
-    Milliseconds timeNow;
-
-    OperatingSystem::Instance().getSystemTick(timeoutTicks);
-    OperatingSystem::Instance().ticksToMilliseconds(timeoutTicks, waitForIncomingMessage);
-    timeNow = waitForIncomingMessage;
-    waitForIncomingMessage += timeout;
-
-    while(timeNow <= timeout) {
-        if (ErrorType::Success == _cellNetworkInterface->dataIsAvailable(socket)) {
-            break;
-        }
-
-        Ticks tick;
-        OperatingSystem::Instance().getSystemTick(tick);
-        OperatingSystem::Instance().ticksToMilliseconds(tick, timeNow);
-    }
-
-    if (timeNow > timeout) {
-        CBT_LOGW(TAG, "No data available to read.");
-        return ErrorType::Timeout;
-    }
-
-    return ErrorType::Success;
-}
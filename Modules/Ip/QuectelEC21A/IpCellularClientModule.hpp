@@ -30,13 +30,12 @@ class IpCellularClient : public IpClientAbstraction {
     ErrorType receiveBlocking(std::string &buffer, const Milliseconds timeout) override;
 
     /**
-     * @brief block and poll for data.
-     * @pre The access mode must be buffer access mode to poll for data.
-     * @returns ErrorType::Success if there is data avilable.
-     * @returns ErrorType::Timeout if the time ran out before any data was avilable
-     * @returns ErrorType::PrerequisitesNotMet if the current access mode is not buffer access mode.
-     */
-    ErrorType pollForData(const Socket socket, const Milliseconds timeout);
+     * @brief Close the connection on the modem and release its connection id.
+     * @pre Called from the network thread.
+     * @returns ErrorType::Success if there was no connection or it was closed.
+     * @returns The error of AT+QICLOSE otherwise. The connection id is released anyway.
+    */
+    ErrorType close();
 };
 
 #endif // __IP_CELLULAR_CLIENT_MODULE_HPP__
\ No newline at end of file
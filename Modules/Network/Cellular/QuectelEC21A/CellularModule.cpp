@@ -2,12 +2,35 @@
 #include "CellularModule.hpp"
 #include "OperatingSystemModule.hpp"
 //AbstractionLayer Applications
-#include "log.hpp"
+#include "Log.hpp"
 //C++
+#include <algorithm>
+#include <charconv>
+#include <chrono>
 #include <cstring>
 
 #define CELLULAR_MODULE_DEBUGGING_ON 0
 
+std::atomic<int> Cellular::instanceCount(0);
+
+Cellular::Cellular() : CellularAbstraction() {
+    _status.isUp = false;
+    _status.technology = NetworkTypes::Technology::Cellular;
+    _status.signalStrength = 0;
+    _connectionIds.fill(-1);
+
+    _statusSemaphore.assign("cellularStatus").append(std::to_string(instanceCount++));
+    ErrorType error = OperatingSystem::Instance().createSemaphore(1, 1, _statusSemaphore);
+    assert(ErrorType::Success == error);
+
+    _parser.addUrcHandler("+QIURC:", [this](std::string_view urc) { _multiplexer.urc(urc); });
+    _parser.addUrcHandler("+CREG:", [this](std::string_view urc) { registrationUrc(urc); });
+}
+
+Cellular::~Cellular() {
+    OperatingSystem::Instance().deleteSemaphore(_statusSemaphore);
+}
+
 ErrorType Cellular::init() {
     assert(nullptr != _ic);
     assert(-1 != _resetPin);
@@ -32,31 +55,45 @@ ErrorType Cellular::init() {
         return error;
     }
 
-    std::string mfgName(32, 0);
-    if (ErrorType::Success == getManufacturerName(mfgName)) {
-        if (std::string::npos != mfgName.find("Quectel")) {
+    //None of these depend on each other so they are sent together.
+    std::vector<AtCommand> identify(4);
+    AtCommand &manufacturer = identify[0];
+    AtCommand &echo = identify[1];
+    AtCommand &terminatingCharacter = identify[2];
+    AtCommand &formattingCharacter = identify[3];
+    manufacturer.command.assign("ATI");
+    echo.command.assign("ATE0");
+    //Pg. 23 and 24 EC21A AT Command Manual.
+    terminatingCharacter.command.assign("ATS3?");
+    formattingCharacter.command.assign("ATS4?");
+
+    sendCommands(identify);
+
+    if (ErrorType::Success != manufacturer.error) {
+        return ErrorType::PrerequisitesNotMet;
+    }
+
+    for (const std::string &line : manufacturer.response.lines) {
+        if (std::string::npos != line.find("Quectel")) {
             _status.manufacturerName.assign("Quectel");
         }
     }
-    else if (mfgName.empty()) {
-        return ErrorType::PrerequisitesNotMet;
-    }
 
-    //Parsing of responses depends on echo mode being disabled.
-    if (ErrorType::Success != echoMode(false)) {
+    if (ErrorType::Success != echo.error) {
         CBT_LOGE(TAG, "Failed to disable echo mode.");
-        return error;
+        return echo.error;
     }
 
-    error = terminatingCharacter(_commandLineTerminationCharacter);
-    if (ErrorType::Success != error) {
-        return error;
+    //The response is the value of the S register alone, e.g. 013
+    if (ErrorType::Success != terminatingCharacter.error || terminatingCharacter.response.lines.empty()) {
+        return ErrorType::Success != terminatingCharacter.error ? terminatingCharacter.error : ErrorType::Failure;
     }
+    _commandLineTerminationCharacter = strtoul(terminatingCharacter.response.lines.back().c_str(), nullptr, 10);
 
-    error = responseFormattingCharacter(_responseFormattingCharacter);
-    if (ErrorType::Success != error) {
-        return error;
+    if (ErrorType::Success != formattingCharacter.error || formattingCharacter.response.lines.empty()) {
+        return ErrorType::Success != formattingCharacter.error ? formattingCharacter.error : ErrorType::Failure;
     }
+    _responseFormattingCharacter = strtoul(formattingCharacter.response.lines.back().c_str(), nullptr, 10);
 
     error = networkUp();
     if (ErrorType::Success != error) {
@@ -67,78 +104,82 @@ ErrorType Cellular::init() {
 }
 
 ErrorType Cellular::networkUp() {
-    constexpr Milliseconds timeout = 1000;
-    constexpr Count maxRetries = 10;
     ErrorType error = ErrorType::Failure;
-    std::string responseBuffer(64, 0);
 
-    error = simCardIsInserted();
+    //Automatic operator selection is harmless if there is no SIM card so it doesn't need to wait for the answer.
+    //It can be aborted by anything the modem receives while it runs so it's sent on its own.
+    //Pg. 76 EC21A AT Command Manual. AT+CREG=1 has the modem report each change to the registration with +CREG: <stat>.
+    std::vector<AtCommand> prepare(3);
+    prepare[0].command.assign("AT+QSIMSTAT?");
+    prepare[1].command.assign("AT+CREG=1");
+    prepare[1].expectedResponse.assign("OK");
+    prepare[2].command.assign("AT+COPS=0");
+    prepare[2].expectedResponse.assign("OK");
+    prepare[2].timeout = _OperatorSelectionTimeout;
+    prepare[2].stopAndWait = true;
+
+    sendCommands(prepare);
+
+    error = ErrorType::Success == prepare[0].error ? simCardIsInserted(prepare[0].response) : prepare[0].error;
     if (ErrorType::Success != error) {
         CBT_LOGW(TAG, "SIM card not inserted.");
         return error;
     }
 
-    error = sendCommand("AT+COPS=0", timeout, maxRetries);
-    if (ErrorType::Success != error) {
-        return error;
+    for (const AtCommand &command : prepare) {
+        if (ErrorType::Success != command.error) {
+            CBT_LOGW(TAG, "AT command error: %s <response:%s>", command.command.c_str(), command.response.finalLine.c_str());
+            return command.error;
+        }
     }
 
-    error = receiveCommand(responseBuffer, timeout, maxRetries, "OK");
-    if (ErrorType::Success != error) {
-        CBT_LOGW(TAG, "AT command error: AT+COPS=0");
-        CBT_LOG_BUFFER_HEXDUMP(TAG, responseBuffer.data(), responseBuffer.size(), LogType::Warning);
-        return error;
-    }
+    //Rather than asking every second, wait for the modem to report that it has registered.
+    RegistrationStatus registration = RegistrationStatus::Unknown;
+    const auto start = std::chrono::steady_clock::now();
+    auto lastQuery = start;
+    sampleStatus();
 
-    //Quectel LTE Standard TCP/IP Application Note, Pg. 7.
-    //It can take up to 90 seconds for the module to register to the network.
-    {
-    int registerToNetworkRetries = 0;
-    do {
-        OperatingSystem::Instance().delay(1000);
-        error = sendCommand("AT+CREG?", timeout, 1);
-        if (ErrorType::Success != error) {
-            return error;
+    while (ErrorType::Success == getRegistrationStatus(registration) && !isRegistered(registration)) {
+        const auto now = std::chrono::steady_clock::now();
+        if (now - start >= std::chrono::milliseconds(_RegistrationTimeout)) {
+            break;
         }
 
-        error = receiveCommand(responseBuffer, timeout, 1, "+CREG: 0,5");
-        if (ErrorType::Success != error) {
-            CBT_LOGW(TAG, "Not registered to network.");
-            CBT_LOG_BUFFER_HEXDUMP(TAG, responseBuffer.data(), responseBuffer.size(), LogType::Warning);
+        if (now - lastQuery >= std::chrono::milliseconds(_RegistrationQueryPeriod)) {
+            lastQuery = now;
+            sampleStatus();
+        }
+        else {
+            receiveUnsolicited(_SemaphoreTimeout);
         }
-
-    } while (registerToNetworkRetries < 90 && ErrorType::Success != error);
     }
 
-    if (ErrorType::Success != error) {
+    if (!isRegistered(registration)) {
+        CBT_LOGW(TAG, "Not registered to network. <stat:%u>", static_cast<uint8_t>(registration));
         //If it does not register in 90s, then reboot the module.
         reset();
-        return error;
+        return ErrorType::Timeout;
     }
 
     assert(false == accessPointNameConst().empty());
-    assert(snprintf(responseBuffer.data(), responseBuffer.size(), "AT+CGDCONT=%d,\"IP\",\"%s\"", _IpContext, accessPointNameConst().c_str()));
-    error = sendCommand(responseBuffer, timeout, maxRetries);
-    if (ErrorType::Success != error) {
-        return error;
-    }
-    error = receiveCommand(responseBuffer, timeout, maxRetries, "OK");
-    if (ErrorType::Success != error) {
-        CBT_LOGW(TAG, "AT command error: AT+CGDCONT");
-        CBT_LOG_BUFFER_HEXDUMP(TAG, responseBuffer.data(), responseBuffer.size(), LogType::Warning);
-        return error;
+    std::vector<AtCommand> attach(2);
+    attach[0].command.assign("AT+CGDCONT=").append(std::to_string(_IpContext)).append(",\"IP\",\"").append(accessPointNameConst()).append("\"");
+    attach[0].expectedResponse.assign("OK");
+    attach[1].command.assign("AT+CGATT=1");
+    attach[1].expectedResponse.assign("OK");
+    attach[1].timeout = _AttachTimeout;
+    attach[1].stopAndWait = true;
+
+    error = sendCommands(attach);
+    for (const AtCommand &command : attach) {
+        if (ErrorType::Success != command.error) {
+            CBT_LOGW(TAG, "AT command error: %s <response:%s>", command.command.c_str(), command.response.finalLine.c_str());
+            return error;
+        }
     }
 
-    error = sendCommand("AT+CGATT=1", timeout, maxRetries);
-    if (ErrorType::Success != error) {
-        return error;
-    }
-    error = receiveCommand(responseBuffer, timeout, maxRetries, "OK");
-    if (ErrorType::Success != error) {
-        CBT_LOGW(TAG, "AT command error: AT+CGATT");
-        CBT_LOG_BUFFER_HEXDUMP(TAG, responseBuffer.data(), responseBuffer.size(), LogType::Warning);
-        return error;
-    }
+    //The monitor takes over sampling the status from here.
+    sampleStatus();
 
     _status.isUp = true;
     return error;
@@ -171,58 +212,70 @@ ErrorType Cellular::getMacAddress(std::string &macAddress) {
     return ErrorType::NotAvailable;
 }
 
-//Pg. 78, sect. 6.3,Quectel AT command manual.
 ErrorType Cellular::getSignalStrength(DecibelMilliWatts &signalStrength) {
-    constexpr Milliseconds timeout = 1000;
-    constexpr Count maxRetries = 10;
-    std::string responseBuffer(64, 0);
+    if (!_sampled) {
+        return ErrorType::NoData;
+    }
 
-    ErrorType error = sendCommand("AT+CSQ", timeout, maxRetries);
-    if (ErrorType::Success != error) {
-        return error;
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(_statusSemaphore, _SemaphoreTimeout)) {
+        return ErrorType::Timeout;
     }
 
-    error = receiveCommand(responseBuffer, timeout, maxRetries, "OK");
-    if (ErrorType::Success != error) {
-        CBT_LOGW(TAG, "AT command error: AT+CSQ");
-        CBT_LOG_BUFFER_HEXDUMP(TAG, responseBuffer.data(), responseBuffer.size(), LogType::Warning);
-        return error;
+    signalStrength = _status.signalStrength;
+    OperatingSystem::Instance().incrementSemaphore(_statusSemaphore);
+
+    return ErrorType::Success;
+}
+
+ErrorType Cellular::getRegistrationStatus(RegistrationStatus &registration) {
+    if (!_sampled) {
+        return ErrorType::NoData;
     }
 
-    for (size_t i = 0; i < responseBuffer.size(); i++) {
-        if (',' == responseBuffer.at(i)) {
-            responseBuffer.at(i) = '\0';
-            const size_t sizeOfSignalQualityResponsePreamble = sizeof(_commandLineTerminationCharacter) + sizeof(_responseFormattingCharacter) + sizeof("+CSQ: ")-1;
-            signalStrength = strtod(responseBuffer.c_str() + sizeOfSignalQualityResponsePreamble, nullptr);
-            break;
-        }
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(_statusSemaphore, _SemaphoreTimeout)) {
+        return ErrorType::Timeout;
     }
 
-    if (signalStrength != 199 && signalStrength != 99) {
-        if (signalStrength <= 31) {
-            signalStrength = (signalStrength * 2) - 113;
-        }
-        else if (signalStrength >= 100) {
-            signalStrength -= 216;
-        }
+    registration = _registration;
+    OperatingSystem::Instance().incrementSemaphore(_statusSemaphore);
+
+    return ErrorType::Success;
+}
+
+ErrorType Cellular::getOperatorName(std::string &operatorName) {
+    if (!_sampled) {
+        return ErrorType::NoData;
+    }
+
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(_statusSemaphore, _SemaphoreTimeout)) {
+        return ErrorType::Timeout;
     }
 
-    _status.signalStrength = signalStrength;
+    operatorName.assign(_operatorName);
+    OperatingSystem::Instance().incrementSemaphore(_statusSemaphore);
 
     return ErrorType::Success;
 }
 
 ErrorType Cellular::mainLoop() {
-    ErrorType error;
+    ErrorType error = runNextEvent();
 
-    if (ErrorType::NoData == (error = runNextEvent())) {
-        return error;
+    if (ErrorType::NoData != error && ErrorType::Success != error) {
+        return ErrorType::Failure;
     }
-    else if (ErrorType::Success == error) {
-        return error;
+
+    //The connections get their turn on the modem after any connects or disconnects that are waiting, and the monitor goes last.
+    if (_status.isUp) {
+        //Anything that needed command mode is done so the connection in transparent access mode can have the modem back.
+        if (!_dataMode && -1 != _transparentSocket) {
+            enterDataMode();
+        }
+
+        const bool idle = ErrorType::NoData == _multiplexer.service();
+        monitor(idle);
     }
 
-    return ErrorType::Failure;
+    return error;
 }
 
 //See Reset, Section 3.8, Quectel hardware design
@@ -239,11 +292,17 @@ ErrorType Cellular::reset() {
     return ErrorType::Success;
 }
 
-ErrorType Cellular::sendCommand(const std::string &atCommand, const Milliseconds timeout, const Count maxRetries) {
+ErrorType Cellular::sendCommand(const std::string &atCommand, const Milliseconds timeout, const Count maxRetries, const AtResponseSettings::Expectation &expectation) {
     std::string commandBuffer(atCommand.size() + sizeof(_commandLineTerminationCharacter), 0);
     ErrorType error = ErrorType::Failure;
     Count retries = 0;
 
+    if (_dataMode && ErrorType::Success != leaveDataMode()) {
+        return ErrorType::Timeout;
+    }
+
+    _parser.beginCommand(atCommand, expectation);
+
     do {
         commandBuffer.assign(atCommand + _commandLineTerminationCharacter);
         error = _ic->txBlocking(commandBuffer, timeout);
@@ -261,6 +320,7 @@ ErrorType Cellular::sendCommand(const std::string &atCommand, const Milliseconds
 
     if (retries >= maxRetries) {
         error = ErrorType::Timeout;
+        _parser.endCommand();
     }
     else {
         error = ErrorType::Success;
@@ -270,119 +330,333 @@ ErrorType Cellular::sendCommand(const std::string &atCommand, const Milliseconds
 }
 
 ErrorType Cellular::receiveCommand(std::string &responseBuffer, const Milliseconds timeout, const Count maxRetries, const std::string expectedResponse) {
-    ErrorType error = ErrorType::Failure;
-    Count retries = 0;
-
+    ErrorType error = receiveResponse(timeout, maxRetries);
     responseBuffer.clear();
-    responseBuffer.resize(0);
-    std::string bytesRead(16, 0);
-    bool endOfResponse = false;
-    const bool specialCaseQiSend = 0 == expectedResponse.compare(">");
 
-    do {
-        bytesRead.clear();
-        bytesRead.resize(bytesRead.capacity());
+    if (ErrorType::Success != error) {
+        _parser.endCommand();
+        return error;
+    }
 
-        error = _ic->rxBlocking(bytesRead, timeout);
+    const AtResponseSettings::Response &response = _parser.responseConst();
 #if CELLULAR_MODULE_DEBUGGING_ON
-        CBT_LOGI(TAG, "Receiving...");
+    CBT_LOGI(TAG, "Response ended with %s", response.finalLine.c_str());
 #endif
-        if (ErrorType::Success != error) {
-            retries++;
+
+    if (!response.succeeded()) {
+        responseBuffer.assign(response.finalLine);
+        _parser.endCommand();
+        return ErrorType::Failure;
+    }
+
+    if (_parser.expectationConst().payload) {
+        responseBuffer.assign(_parser.payload());
+    }
+    else {
+        for (const std::string &line : response.lines) {
+            if (!responseBuffer.empty()) {
+                responseBuffer.push_back(_responseFormattingCharacter);
+            }
+            responseBuffer.append(line);
+        }
+    }
+
+    error = checkResponse(response, expectedResponse);
+
+    _parser.endCommand();
+    return error;
+}
+
+ErrorType Cellular::receivePayload(std::string &buffer, const Milliseconds timeout, const Count maxRetries) {
+    ErrorType error = receiveResponse(timeout, maxRetries);
+
+    if (ErrorType::Success == error) {
+        if (_parser.responseConst().succeeded()) {
+            //The only copy of the payload is from the receive ring to the buffer.
+            buffer.append(_parser.payload());
         }
         else {
+            error = ErrorType::Failure;
+        }
+    }
+
+    _parser.endCommand();
+    return error;
+}
+
+ErrorType Cellular::receiveResponse(const Milliseconds timeout, const Count maxRetries) {
+    Count retries = 0;
+
+    //Waiting for another final result code for the last command, such as SEND OK after the data for AT+QISEND.
+    if (!_parser.commandPending()) {
+        _parser.beginCommand(std::string_view());
+    }
+
+    //Whatever was received after the end of the last response may already hold this one.
+    if (ErrorType::LimitReached == _parser.process()) {
+        CBT_LOGW(TAG, "Discarded a line that was too long.");
+    }
+
+    while (!_parser.responseComplete() && retries < maxRetries) {
 #if CELLULAR_MODULE_DEBUGGING_ON
-            CBT_LOGI(TAG, "Partial response...");
-            CBT_LOG_BUFFER_HEXDUMP(TAG, bytesRead.data(), bytesRead.size(), LogType::Info);
+        CBT_LOGI(TAG, "Receiving...");
 #endif
-            responseBuffer.append(bytesRead);
+        if (ErrorType::Success != receiveIntoParser(timeout)) {
+            retries++;
         }
+    }
+
+    return _parser.responseComplete() ? ErrorType::Success : ErrorType::Timeout;
+}
 
-        //Special case - There is no response formatting character for AT+QISEND
-        if (specialCaseQiSend) {
-            endOfResponse = std::string::npos != responseBuffer.find(">");
+ErrorType Cellular::sendCommands(std::vector<AtCommand> &commands) {
+    std::vector<Count> attempts(commands.size(), 0);
+    size_t sent = 0;
+    size_t done = 0;
+
+    //Everything that has been sent is thrown away. The command at the front gives up once it has been sent too many times.
+    auto noResponse = [this, &commands, &attempts, &sent, &done]() {
+        _parser.reset();
+        _ic->flushRxBuffer();
+        //Along with any unsolicited result codes that were received behind the lost response.
+        _multiplexer.unsolicitedLost();
+
+        if (attempts[done] > commands[done].retries) {
+            commands[done].error = ErrorType::Timeout;
+            done++;
         }
-        else {
-            endOfResponse = responseBuffer.back() == _responseFormattingCharacter || specialCaseQiSend;
+
+        sent = done;
+    };
+
+    if (_dataMode && ErrorType::Success != leaveDataMode()) {
+        for (AtCommand &command : commands) {
+            command.error = ErrorType::Timeout;
         }
 
-    } while (retries < maxRetries && !endOfResponse);
+        return ErrorType::Timeout;
+    }
+
+    while (done < commands.size()) {
+        std::string batch;
+        for (; sent < commands.size() && sent - done < _PipelineDepth; sent++) {
+            //Nothing is outstanding while a command that must be sent on its own runs.
+            if (sent > done && (commands[sent].stopAndWait || commands[sent - 1].stopAndWait)) {
+                break;
+            }
+
+            batch.append(commands[sent].command).push_back(_commandLineTerminationCharacter);
+            attempts[sent]++;
+        }
 
+        if (!batch.empty()) {
 #if CELLULAR_MODULE_DEBUGGING_ON
-    CBT_LOGI(TAG, "Full response...");
-    CBT_LOG_BUFFER_HEXDUMP(TAG, responseBuffer.data(), responseBuffer.size(), LogType::Info);
+            CBT_LOGI(TAG, "Sending...");
+            CBT_LOG_BUFFER_HEXDUMP(TAG, batch.data(), batch.size(), LogType::Info);
 #endif
+            if (ErrorType::Success != _ic->txBlocking(batch, commands[done].timeout)) {
+                noResponse();
+                continue;
+            }
+        }
 
-    if (retries >= maxRetries) {
-        error = ErrorType::Timeout;
+        //The modem answers in the order the commands were sent so the next response is for the command at the front.
+        AtCommand &command = commands[done];
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(command.timeout);
+        _parser.beginCommand(command.command, command.expectation);
+        _parser.process();
+
+        while (!_parser.responseComplete()) {
+            const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+            if (remaining <= 0) {
+                break;
+            }
+
+            receiveIntoParser(remaining);
+        }
+
+        if (!_parser.responseComplete()) {
+            noResponse();
+            continue;
+        }
+
+        command.response = _parser.responseConst();
+        command.error = checkResponse(command.response, command.expectedResponse);
+        _parser.endCommand();
+        done++;
     }
-    else if (!specialCaseQiSend && responseBuffer.back() != _responseFormattingCharacter) {
-        //You can try increasing the buffer size in case it wasn't big enough to read all the data until the response formatting character was found.
-        CBT_LOGE(TAG, "Response formatting character not found.");
-        error = ErrorType::Failure;
+
+    for (const AtCommand &command : commands) {
+        if (ErrorType::Success != command.error) {
+            return command.error;
+        }
     }
-    else {
-        error = ErrorType::Success;
+
+    return ErrorType::Success;
+}
+
+ErrorType Cellular::checkResponse(const AtResponseSettings::Response &response, const std::string &expectedResponse) {
+    if (!response.succeeded()) {
+        return ErrorType::Failure;
     }
 
-    if (!expectedResponse.empty() && std::string::npos != responseBuffer.find(expectedResponse)) {
-        error = ErrorType::Success;
+    if (!expectedResponse.empty() && expectedResponse != response.finalLine) {
+        const bool found = std::any_of(response.lines.begin(), response.lines.end(), [&expectedResponse](const std::string &line) {
+            return line.starts_with(expectedResponse);
+        });
+
+        return found ? ErrorType::Success : ErrorType::Failure;
     }
-    else {
-        error = ErrorType::Failure;
+
+    return ErrorType::Success;
+}
+
+ErrorType Cellular::simCardIsInserted(const AtResponseSettings::Response &response) {
+    //+QSIMSTAT: <enable>,<inserted_status>
+    for (const std::string &line : response.lines) {
+        if (line.starts_with("+QSIMSTAT:")) {
+            const size_t comma = line.find(',');
+            if (std::string::npos == comma) {
+                return ErrorType::Failure;
+            }
+
+            const bool isInserted = strtoul(line.c_str() + comma + 1, nullptr, 10);
+            return isInserted ? ErrorType::Success : ErrorType::Failure;
+        }
     }
 
-    return error;
+    return ErrorType::Failure;
 }
 
-ErrorType Cellular::getManufacturerName(std::string &mfgName) {
-    ErrorType error;
-    error = sendCommand("ATI", 1000, 10);
-    if (ErrorType::Success == error) {
-        error = receiveCommand(mfgName, 1000, 10, "OK");
+ErrorType Cellular::sampleStatus() {
+    std::vector<AtCommand> sample(3);
+    AtCommand &signalQuality = sample[0];
+    AtCommand &registration = sample[1];
+    AtCommand &currentOperator = sample[2];
+    signalQuality.command.assign("AT+CSQ");
+    signalQuality.expectedResponse.assign("+CSQ:");
+    registration.command.assign("AT+CREG?");
+    registration.expectedResponse.assign("+CREG:");
+    currentOperator.command.assign("AT+COPS?");
+    currentOperator.expectedResponse.assign("+COPS:");
+
+    const ErrorType error = sendCommands(sample);
+    _nextSample = std::chrono::steady_clock::now() + std::chrono::milliseconds(_monitorPeriod);
+
+    const auto informationLine = [](const AtCommand &command) -> std::string_view {
+        for (const std::string &line : command.response.lines) {
+            if (ErrorType::Success == command.error && line.starts_with(command.expectedResponse)) {
+                return line;
+            }
+        }
+
+        return std::string_view();
+    };
+
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(_statusSemaphore, _SemaphoreTimeout)) {
+        return ErrorType::Timeout;
     }
 
+    //+CSQ: <rssi>,<ber>
+    long rssi;
+    if (ErrorType::Success == numberAt(informationLine(signalQuality), 0, rssi)) {
+        _status.signalStrength = toSignalStrength(rssi);
+    }
+
+    //+CREG: <n>,<stat>
+    long stat;
+    if (ErrorType::Success == numberAt(informationLine(registration), 1, stat)) {
+        _registration = static_cast<RegistrationStatus>(stat);
+    }
+
+    //+COPS: <mode>[,<format>,<oper>[,<Act>]]. There's no operator unless the modem is registered.
+    const std::string_view line = informationLine(currentOperator);
+    if (!line.empty()) {
+        const size_t open = line.find('"');
+        const size_t close = line.rfind('"');
+
+        if (std::string_view::npos != open && close > open) {
+            _operatorName.assign(line.substr(open + 1, close - open - 1));
+        }
+        else {
+            _operatorName.clear();
+        }
+    }
+
+    _sampled = true;
+    OperatingSystem::Instance().incrementSemaphore(_statusSemaphore);
+
     return error;
 }
 
-ErrorType Cellular::simCardIsInserted() {
-    std::string commandBuffer(64, 0);
-    constexpr int numRetries = 10;
-    constexpr Milliseconds timeout = 1000;
-    ErrorType error = ErrorType::Failure;
+void Cellular::monitor(const bool idle) {
+    const auto now = std::chrono::steady_clock::now();
 
-    error = sendCommand("AT+QSIMSTAT?", timeout, numRetries);
-    if (ErrorType::Success != error) {
-        return error;
+    if (now < _nextSample) {
+        return;
     }
 
-    std::string &responseBuffer = commandBuffer;
-    error = receiveCommand(responseBuffer, timeout, numRetries, "OK");
-    if (ErrorType::Success != error) {
-        return error;
+    //Sampling takes the modem away from the connections so it waits for them to have nothing to do, but not forever.
+    if (idle || now >= _nextSample + std::chrono::milliseconds(_monitorPeriod)) {
+        sampleStatus();
+    }
+}
+
+void Cellular::registrationUrc(std::string_view urc) {
+    //+CREG: <stat>
+    long stat;
+    if (ErrorType::Success == numberAt(urc, 0, stat)) {
+        cacheRegistration(static_cast<RegistrationStatus>(stat));
     }
+}
 
-    responseBuffer.erase(std::remove(responseBuffer.begin(), responseBuffer.end(), '\r'), responseBuffer.end());
-    responseBuffer.erase(std::remove(responseBuffer.begin(), responseBuffer.end(), '\n'), responseBuffer.end());
-    responseBuffer.replace(responseBuffer.find("OK"), 2, "");
-    responseBuffer.replace(responseBuffer.find("+QSIMSTAT:"), 2, "");
+ErrorType Cellular::cacheRegistration(const RegistrationStatus registration) {
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(_statusSemaphore, _SemaphoreTimeout)) {
+        return ErrorType::Timeout;
+    }
 
-    const char *delim = ",";
-    char *save_ptr = responseBuffer.data();
-    char *token = strtok_r(save_ptr, delim, &save_ptr);
+    _registration = registration;
+    OperatingSystem::Instance().incrementSemaphore(_statusSemaphore);
 
-    bool cardDetectedUrcEnabled = strtoul(token, nullptr, 10);
-    token = strtok_r(save_ptr, delim, &save_ptr);
-    bool isInserted = strtoul(token, nullptr, 10);
+    return ErrorType::Success;
+}
 
-    if (isInserted) {
-        error = ErrorType::Success;
+ErrorType Cellular::numberAt(std::string_view line, const Count index, long &value) {
+    const size_t colon = line.find(':');
+    if (std::string_view::npos == colon) {
+        return ErrorType::Failure;
     }
-    else {
-        error = ErrorType::Failure;
+
+    size_t start = colon + 1;
+    for (Count i = 0; i < index; i++) {
+        start = line.find(',', start);
+        if (std::string_view::npos == start) {
+            return ErrorType::Failure;
+        }
+        start++;
     }
 
-    return error;
+    while (start < line.size() && ' ' == line[start]) {
+        start++;
+    }
+
+    const auto [end, conversionError] = std::from_chars(line.data() + start, line.data() + line.size(), value);
+    if (std::errc() != conversionError) {
+        return ErrorType::Failure;
+    }
+
+    return ErrorType::Success;
+}
+
+DecibelMilliWatts Cellular::toSignalStrength(const long rssi) {
+    if (rssi <= 31) {
+        return (rssi * 2) - 113;
+    }
+    else if (rssi >= 100 && rssi != 199) {
+        return rssi - 216;
+    }
+
+    return rssi;
 }
 
 ErrorType Cellular::pdpContextIsActive(const PdpContext context) {
@@ -431,13 +705,16 @@ ErrorType Cellular::dataIsAvailable(const Socket socket) {
         return error;
     }
 
+    //+QIRD: <total_receive_length>,<have_read_length>,<unread_length>
     const char *delim = ",";
     char *save_ptr = receiveBuffer.data();
     char *token = strtok_r(save_ptr, delim, &save_ptr);
     token = strtok_r(save_ptr, delim, &save_ptr);
     token = strtok_r(save_ptr, delim, &save_ptr);
 
-    assert(nullptr != token);
+    if (nullptr == token) {
+        return ErrorType::Failure;
+    }
 
     const Bytes unread = strtoul(token, nullptr, 10);
 
@@ -449,6 +726,305 @@ ErrorType Cellular::dataIsAvailable(const Socket socket) {
     }
 }
 
+void Cellular::receiveUnsolicited(const Milliseconds timeout) {
+    //Notifications may have been received after the end of the last response.
+    _parser.process();
+
+    //Notifications are handled by their URC handlers as they are parsed.
+    receiveIntoParser(timeout);
+}
+
+ErrorType Cellular::receiveIntoParser(const Milliseconds timeout) {
+    RingBuffer &ring = _parser.ring();
+    std::array<std::span<char>, 2> regions;
+    Bytes bytesReceived = 0;
+
+    //Grows the ring buffer if it is holding a payload or a long line. Receives into whatever room there is if it can't grow.
+    ring.reserve(_RxChunkSize);
+    if (0 == ring.freeRegions(regions)) {
+        return ErrorType::NoMemory;
+    }
+
+    //The first region is where the next byte goes.
+    const std::span<char> region = regions[0].first(std::min<Bytes>(regions[0].size(), _RxChunkSize));
+    const ErrorType error = _ic->rxBlockingInto(region, bytesReceived, timeout);
+    if (ErrorType::Success != error) {
+        return error;
+    }
+
+#if CELLULAR_MODULE_DEBUGGING_ON
+    CBT_LOGI(TAG, "Partial response...");
+    CBT_LOG_BUFFER_HEXDUMP(TAG, region.data(), bytesReceived, LogType::Info);
+#endif
+    ring.commit(bytesReceived);
+
+    if (ErrorType::LimitReached == _parser.process()) {
+        CBT_LOGW(TAG, "Discarded a line that was too long.");
+    }
+
+    return ErrorType::Success;
+}
+
+ErrorType Cellular::readData(const Socket socket, std::string &buffer, const Bytes length, const Milliseconds timeout) {
+    constexpr Count maxRetries = 10;
+
+    //Pg. 20, Sec. 2.1.8, Quectel LTE TCP/IP standard.
+    //The payload follows a "+QIRD: <read_actual_length>" line and the parser hands it back on its own.
+    AtResponseSettings::Expectation expectation;
+    expectation.payload = true;
+
+    std::string readCommand("AT+QIRD=");
+    readCommand.append(std::to_string(socket));
+    readCommand.append(",").append(std::to_string(length));
+
+    ErrorType error = sendCommand(readCommand, timeout, maxRetries, expectation);
+    if (ErrorType::Success == error) {
+        error = receivePayload(buffer, timeout, maxRetries);
+    }
+
+    if (ErrorType::Success != error) {
+        CBT_LOGW(TAG, "AT command error: %s", readCommand.c_str());
+    }
+
+    return error;
+}
+
+ErrorType Cellular::sendData(const Socket socket, std::string_view data, const Milliseconds timeout) {
+    constexpr Count maxRetries = 10;
+    std::string receiveBuffer;
+
+    std::string command("AT+QISEND=");
+    command.append(std::to_string(socket));
+    command.append(",").append(std::to_string(data.size()));
+
+    AtResponseSettings::Expectation expectation;
+    expectation.prompt = true;
+    ErrorType error = sendCommand(command, timeout, maxRetries, expectation);
+    if (ErrorType::Success != error) {
+        CBT_LOGW(TAG, "AT command error: %s", command.c_str());
+        return error;
+    }
+
+    error = receiveCommand(receiveBuffer, timeout, maxRetries, ">");
+    if (ErrorType::Success != error) {
+        CBT_LOGW(TAG, "No prompt for %s <response:%s>", command.c_str(), receiveBuffer.c_str());
+        return error;
+    }
+
+    error = _ic->txBlocking(std::string(data), timeout);
+    if (ErrorType::Success != error) {
+        CBT_LOGW(TAG, "Failed to send data");
+        return error;
+    }
+
+    error = receiveCommand(receiveBuffer, timeout, maxRetries, "SEND OK");
+    if (ErrorType::Success != error) {
+        //Pg. 19, Sect. 2.1.7 Quectel LTE TCP/IP Standard. The send buffer is full.
+        if ("SEND FAIL" == receiveBuffer) {
+            return ErrorType::LimitReached;
+        }
+
+        CBT_LOGW(TAG, "Receive error: SEND OK <response:%s>", receiveBuffer.c_str());
+        return error;
+    }
+
+    return ErrorType::Success;
+}
+
+ErrorType Cellular::unacknowledgedBytes(const Socket socket, Bytes &unacknowledged, const Milliseconds timeout) {
+    constexpr Count maxRetries = 10;
+    std::string responseBuffer;
+
+    std::string command("AT+QISEND=");
+    command.append(std::to_string(socket)).append(",0");
+
+    ErrorType error = sendCommand(command, timeout, maxRetries);
+    if (ErrorType::Success != error) {
+        return error;
+    }
+
+    error = receiveCommand(responseBuffer, timeout, maxRetries, "+QISEND:");
+    if (ErrorType::Success != error) {
+        return error;
+    }
+
+    //+QISEND: <total_send_length>,<ackedbytes>,<unackedbytes>
+    const size_t prefix = responseBuffer.find("+QISEND:");
+    const size_t lastComma = responseBuffer.find_last_of(',');
+    if (std::string::npos == prefix || std::string::npos == lastComma || lastComma < prefix) {
+        return ErrorType::Failure;
+    }
+
+    const char *start = responseBuffer.data() + lastComma + 1;
+    const auto [end, conversionError] = std::from_chars(start, responseBuffer.data() + responseBuffer.size(), unacknowledged);
+    if (std::errc() != conversionError || end == start) {
+        return ErrorType::Failure;
+    }
+
+    return ErrorType::Success;
+}
+
+ErrorType Cellular::closeConnection(const Socket socket) {
+    constexpr Milliseconds timeout = 1000;
+    constexpr Count maxRetries = 10;
+    std::string responseBuffer;
+
+    std::string command("AT+QICLOSE=");
+    command.append(std::to_string(socket));
+
+    ErrorType error = sendCommand(command, timeout, maxRetries);
+    if (ErrorType::Success != error) {
+        return error;
+    }
+
+    error = receiveCommand(responseBuffer, timeout, maxRetries, "OK");
+    if (ErrorType::Success != error) {
+        CBT_LOGW(TAG, "AT command error: %s <response:%s>", command.c_str(), responseBuffer.c_str());
+    }
+
+    return error;
+}
+
+void Cellular::dataModeEntered(const Socket socket) {
+    std::string_view data = _parser.ring().contiguous();
+
+    //CONNECT ended at the carriage return so its line feed is still to come unless it's already here.
+    _skipLineFeed = data.empty();
+    if (!data.empty() && '\n' == data.front()) {
+        data.remove_prefix(1);
+    }
+
+    _multiplexer.deliver(socket, data);
+    _parser.reset();
+    _carrierCheck.clear();
+    _transparentSocket = socket;
+    _lastDataWritten = std::chrono::steady_clock::now();
+    _dataMode = true;
+}
+
+ErrorType Cellular::leaveDataMode() {
+    constexpr std::string_view ok("\r\nOK\r\n");
+    const auto guardTime = std::chrono::milliseconds(_escapeGuardTime);
+    const Socket socket = _transparentSocket;
+    std::string received;
+    ErrorType error = ErrorType::Success;
+
+    //The connection's data keeps arriving while the guard time before +++ passes.
+    while (std::chrono::steady_clock::now() < _lastDataWritten + guardTime) {
+        const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(_lastDataWritten + guardTime - std::chrono::steady_clock::now()).count();
+        if (ErrorType::EndOfFile == (error = readDataMode(received, _DataModeChunkSize, std::max<Milliseconds>(1, remaining)))) {
+            //The remote closed the connection so the modem has left data mode by itself.
+            _multiplexer.deliver(socket, received, true);
+            return ErrorType::Success;
+        }
+    }
+
+    error = _ic->txBlocking("+++", _escapeGuardTime);
+    _lastDataWritten = std::chrono::steady_clock::now();
+    if (ErrorType::Success != error) {
+        _multiplexer.deliver(socket, received);
+        return ErrorType::Timeout;
+    }
+
+    //Anything before OK was sent by the remote before the modem saw the escape sequence.
+    std::string tail(std::move(_carrierCheck));
+    _carrierCheck.clear();
+    const auto deadline = _lastDataWritten + guardTime + std::chrono::milliseconds(_SemaphoreTimeout);
+    while (!tail.ends_with(ok) && std::chrono::steady_clock::now() < deadline) {
+        std::string bytesRead(_DataModeChunkSize, 0);
+        if (ErrorType::Success == _ic->rxBlocking(bytesRead, _SemaphoreTimeout)) {
+            tail.append(bytesRead);
+        }
+    }
+
+    if (!tail.ends_with(ok)) {
+        _multiplexer.deliver(socket, received.append(tail));
+        return ErrorType::Timeout;
+    }
+
+    tail.resize(tail.size() - ok.size());
+    _multiplexer.deliver(socket, received.append(tail));
+    _parser.reset();
+    _dataMode = false;
+
+    return ErrorType::Success;
+}
+
+ErrorType Cellular::enterDataMode() {
+    constexpr Milliseconds timeout = 1000;
+    constexpr Count maxRetries = 10;
+    std::string responseBuffer;
+
+    ErrorType error = sendCommand("ATO", timeout, maxRetries);
+    if (ErrorType::Success != error) {
+        return error;
+    }
+
+    error = receiveCommand(responseBuffer, timeout, maxRetries, "CONNECT");
+    if (ErrorType::Success != error) {
+        if ("NO CARRIER" == responseBuffer) {
+            _multiplexer.deliver(_transparentSocket, std::string_view(), true);
+            _transparentSocket = -1;
+            return ErrorType::EndOfFile;
+        }
+
+        CBT_LOGW(TAG, "AT command error: ATO <response:%s>", responseBuffer.c_str());
+        return error;
+    }
+
+    dataModeEntered(_transparentSocket);
+    return ErrorType::Success;
+}
+
+ErrorType Cellular::readDataMode(std::string &buffer, const Bytes length, const Milliseconds timeout) {
+    //The modem leaves data mode when the remote closes the connection and says so in the middle of the data.
+    constexpr std::string_view noCarrier("\r\nNO CARRIER\r\n");
+    std::string bytesRead(std::min(length, _DataModeChunkSize), 0);
+
+    const ErrorType error = _ic->rxBlocking(bytesRead, timeout);
+    if (ErrorType::Success != error && _carrierCheck.empty()) {
+        return ErrorType::Timeout;
+    }
+
+    if (_skipLineFeed && !bytesRead.empty()) {
+        _skipLineFeed = false;
+        if ('\n' == bytesRead.front()) {
+            bytesRead.erase(0, 1);
+        }
+    }
+
+    _carrierCheck.append(ErrorType::Success == error ? bytesRead : std::string());
+
+    if (_carrierCheck.ends_with(noCarrier)) {
+        buffer.append(_carrierCheck, 0, _carrierCheck.size() - noCarrier.size());
+        _carrierCheck.clear();
+        _dataMode = false;
+        //There's nothing to return to data mode for.
+        _transparentSocket = -1;
+        return ErrorType::EndOfFile;
+    }
+
+    //Anything that could be the start of NO CARRIER is kept back until more arrives, or nothing does.
+    Bytes kept = 0;
+    if (ErrorType::Success == error) {
+        for (Bytes i = std::min(_carrierCheck.size(), noCarrier.size() - 1); i > 0 && 0 == kept; i--) {
+            kept = _carrierCheck.ends_with(noCarrier.substr(0, i)) ? i : 0;
+        }
+    }
+
+    buffer.append(_carrierCheck, 0, _carrierCheck.size() - kept);
+    _carrierCheck.erase(0, _carrierCheck.size() - kept);
+
+    return ErrorType::Success;
+}
+
+ErrorType Cellular::writeDataMode(std::string_view data, const Milliseconds timeout) {
+    const ErrorType error = _ic->txBlocking(std::string(data), timeout);
+    _lastDataWritten = std::chrono::steady_clock::now();
+
+    return error;
+}
+
 ErrorType Cellular::activatePdpContext(const PdpContext context, const Socket socket, const ContextType contextType, const std::string &accessPointName) {
     constexpr Milliseconds timeout = 1000;
     constexpr Count numRetries = 10;
@@ -539,43 +1115,3 @@ ErrorType Cellular::echoMode(const bool enable) {
 
     return error;
 }
-
-ErrorType Cellular::terminatingCharacter(char &terminatingCharacter) {
-    std::string responseBuffer(16, 0);
-    ErrorType error;
-    error = sendCommand("ATS3?", 1000, 10);
-    if (ErrorType::Success == error) {
-        error = receiveCommand(responseBuffer, 1000, 10, "OK");
-    }
-    else {
-        CBT_LOGW(TAG, "Error sending to <command:ATS3?>");
-    }
-
-    responseBuffer.erase(std::remove(responseBuffer.begin(), responseBuffer.end(), _commandLineTerminationCharacter), responseBuffer.end());
-    responseBuffer.erase(std::remove(responseBuffer.begin(), responseBuffer.end(), _responseFormattingCharacter), responseBuffer.end());
-    responseBuffer.replace(responseBuffer.find("OK"), sizeof("OK") - 1, "");
-
-    terminatingCharacter = strtoul(responseBuffer.c_str(), nullptr, 10);
-
-    return error;
-}
-
-ErrorType Cellular::responseFormattingCharacter(char &responseFormattingCharacter) {
-    std::string responseBuffer(16, 0);
-    ErrorType error;
-    error = sendCommand("ATS4?", 500, 10);
-    if (ErrorType::Success == error) {
-        error = receiveCommand(responseBuffer, 500, 10, "OK");
-    }
-    else {
-        CBT_LOGW(TAG, "Error sending to <command:ATS4?>");
-    }
-
-    responseBuffer.erase(std::remove(responseBuffer.begin(), responseBuffer.end(), _commandLineTerminationCharacter), responseBuffer.end());
-    responseBuffer.erase(std::remove(responseBuffer.begin(), responseBuffer.end(), _responseFormattingCharacter), responseBuffer.end());
-    responseBuffer.replace(responseBuffer.find("OK"), sizeof("OK") - 1, "");
-
-    responseFormattingCharacter = strtoul(responseBuffer.c_str(), nullptr, 10);
-
-    return error;
-}
\ No newline at end of file
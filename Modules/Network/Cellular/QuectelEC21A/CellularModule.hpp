@@ -9,6 +9,15 @@
 
 #include "CellularAbstraction.hpp"
 #include "GpioModule.hpp"
+#include "SocketMultiplexerModule.hpp"
+//Applications
+#include "AtResponseParser.hpp"
+//C++
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <span>
+#include <vector>
 
 class IpCellularClient;
 
@@ -21,14 +30,39 @@ enum class ContextType : uint8_t {
     Ipv4v6
 };
 
+/**
+ * @enum RegistrationStatus
+ * @brief <stat> of +CREG. Pg. 76, Sect. 6.2 EC21A AT Command Manual.
+*/
+enum class RegistrationStatus : uint8_t {
+    NotRegistered = 0, ///< Not registered and not searching for an operator.
+    Home,              ///< Registered to the home network.
+    Searching,         ///< Not registered but searching for an operator.
+    Denied,            ///< Registration was denied.
+    Unknown,           ///< Unknown.
+    Roaming            ///< Registered and roaming.
+};
+
+/**
+ * @struct AtCommand
+ * @brief An AT command to send as part of a pipeline, and its result.
+ * @sa Cellular::sendCommands
+*/
+struct AtCommand {
+    std::string command;                          ///< The command without the command line termination character.
+    Milliseconds timeout = 1000;                  ///< The time allowed for the response once every command before it has been answered.
+    Count retries = 2;                            ///< The number of times to send the command again if there is no response.
+    AtResponseSettings::Expectation expectation;  ///< How the response ends if it isn't just a final result code.
+    std::string expectedResponse;                 ///< Optional. The final result code or the start of an information line expected.
+    bool stopAndWait = false;                     ///< Sent once every command before it has been answered, and nothing is sent behind it until it has been. For commands that run for a long time or are aborted by anything received while they run. V.250 5.6.1.
+    AtResponseSettings::Response response;        ///< The response once the command has been sent.
+    ErrorType error = ErrorType::Failure;         ///< The result of the command. ErrorType::Timeout if there was no response.
+};
+
 class Cellular : public CellularAbstraction {
     public:
-    Cellular() : CellularAbstraction() {
-        _status.isUp = false;
-        _status.technology = NetworkTypes::Technology::Cellular;
-        _connectionIds.fill(-1);
-    }
-    ~Cellular() = default;
+    Cellular();
+    ~Cellular();
 
     ErrorType init() override;
     ErrorType networkUp() override;
@@ -39,17 +73,61 @@ class Cellular : public CellularAbstraction {
     ErrorType rxBlocking(std::string &frameBuffer, const Milliseconds timeout) override;
     ErrorType rxNonBlocking(std::shared_ptr<std::string> frameBuffer, std::function<void(const ErrorType error, std::shared_ptr<std::string> frameBuffer)> callback = nullptr) override;
     ErrorType getMacAddress(std::string &macAddress) override;
+    /**
+     * @brief Get the signal strength from the last time the monitor sampled it.
+     * @details Doesn't talk to the modem so it can be called from any thread without holding up the connections.
+     * @returns ErrorType::Success if the signal strength was sampled.
+     * @returns ErrorType::NoData if it hasn't been sampled yet because the network hasn't been brought up.
+     * @returns ErrorType::Timeout if the cache couldn't be read.
+    */
     ErrorType getSignalStrength(DecibelMilliWatts &signalStrength) override;
+    /**
+     * @brief Get the registration status from the last time the monitor sampled it or the modem reported a change.
+     * @returns The same as getSignalStrength.
+    */
+    ErrorType getRegistrationStatus(RegistrationStatus &registration);
+    /**
+     * @brief Get the name of the operator from the last time the monitor sampled it.
+     * @param[out] operatorName The name. Empty if the modem isn't registered to an operator.
+     * @returns The same as getSignalStrength.
+    */
+    ErrorType getOperatorName(std::string &operatorName);
 
+    /**
+     * @brief Run the next event and move the data of the connections.
+     * @details While the network is up, the monitor samples the signal strength, registration and operator every monitor period at a time
+     *          when no connection has anything to do. If the connections are never idle then it samples once it is a whole period late.
+    */
     ErrorType mainLoop() override;
 
+    /// @brief Get how often the monitor samples the status of the network
+    Milliseconds &monitorPeriod() { return _monitorPeriod; }
+    /// @brief Get how often the monitor samples the status of the network as a constant reference
+    const Milliseconds &monitorPeriodConst() const { return _monitorPeriod; }
+    /// @brief Get the silence kept before and after the +++ escape sequence that leaves data mode
+    Milliseconds &escapeGuardTime() { return _escapeGuardTime; }
+    /// @brief Get the silence kept before and after the +++ escape sequence that leaves data mode as a constant reference
+    const Milliseconds &escapeGuardTimeConst() const { return _escapeGuardTime; }
+
     ErrorType reset() override;
 
+    /**
+     * @brief Call a handler for each unsolicited result code from the modem that begins with the prefix.
+     * @details Handlers are called while a response is being received so they should not send AT commands.
+     *          +QIURC: is handled by Cellular for the IP clients.
+     * @sa AtResponseParser::addUrcHandler
+    */
+    ErrorType addUrcHandler(const std::string &prefix, std::function<void(std::string_view urc)> handler) {
+        return _parser.addUrcHandler(prefix, handler);
+    }
+
     /**
      * @brief Allow the IpCellularClient to access the private members of Cellular
      * @details In order for the client to connect, it will need to be able to send AT commands to the modem.
     */
     friend IpCellularClient;
+    /// @brief The multiplexer sends and receives the data of the connections.
+    friend SocketMultiplexer;
 
     private:
     /**
@@ -65,10 +143,36 @@ class Cellular : public CellularAbstraction {
     static constexpr PdpContext _HttpContext = 2;
     /// @brief The maximum number of contexts.
     static constexpr PdpContext _MaxContexts = 3;
-    /// @brief The maximum number of sockets per context.
-    static constexpr Socket _MaxSocketsPerContext = 11;
+    /// @brief The maximum number of sockets. Pg. 11 Quectel LTE Standard TCP/IP Application Note. <connectID> is 0 to 11.
+    static constexpr Socket _MaxSocketsPerContext = SocketMultiplexer::MaxConnections;
     /// @brief Pg.20, Sect. 2.1.8 Quectel LTE TCP/IP Standard. Maximum number of bytes that can be read at a time.
     static constexpr Bytes _MaxBytesToRead = 1500;
+    /// @brief Pg.19, Sect. 2.1.7 Quectel LTE TCP/IP Standard. Maximum number of bytes that can be sent at a time.
+    static constexpr Bytes _MaxBytesToSend = 1460;
+    /// @brief The most bytes that are sent and not acknowledged by the remote before waiting for acknowledgement. Fits in the modem's send buffer.
+    static constexpr Bytes _SendWindow = 4 * _MaxBytesToSend;
+    /// @brief The most bytes received from the IC at a time when receiving a response. Enough for the response to AT+QIRD in one go.
+    static constexpr Bytes _RxChunkSize = 2048;
+    /// @brief The most commands that sendCommands has sent and not received the response for.
+    static constexpr Count _PipelineDepth = 4;
+    /// @brief The most bytes written to or read from the IC at a time in data mode.
+    static constexpr Bytes _DataModeChunkSize = 4096;
+    /// @brief The default guard time for the +++ escape sequence. Quectel LTE Standard TCP/IP Application Note.
+    static constexpr Milliseconds _EscapeGuardTime = 1000;
+    /// @brief The default monitor period.
+    static constexpr Milliseconds _MonitorPeriod = 30000;
+    /// @brief Quectel LTE Standard TCP/IP Application Note, Pg. 7. It can take up to 90 seconds for the module to register to the network.
+    static constexpr Milliseconds _RegistrationTimeout = 90000;
+    /// @brief How often networkUp asks for the registration status in case a +CREG: URC was missed while waiting to be registered.
+    static constexpr Milliseconds _RegistrationQueryPeriod = 10000;
+    /// @brief The maximum response time of AT+COPS=<mode>. EC21A AT Command Manual.
+    static constexpr Milliseconds _OperatorSelectionTimeout = 180000;
+    /// @brief The maximum response time of AT+CGATT=<state>. EC21A AT Command Manual.
+    static constexpr Milliseconds _AttachTimeout = 140000;
+    /// @brief The timeout for semaphore operations.
+    static constexpr Milliseconds _SemaphoreTimeout = 1000;
+    /// @brief The number of modules that have been created.
+    static std::atomic<int> instanceCount;
     /// @brief The GPIO pin for the reset pin.
     std::unique_ptr<Gpio> _gpioReset;
     /**
@@ -83,47 +187,158 @@ class Cellular : public CellularAbstraction {
      */
     char _responseFormattingCharacter = '\n';
     /// @brief The connection ids.
-    std::array<Socket, 11> _connectionIds;
+    std::array<Socket, _MaxSocketsPerContext> _connectionIds;
+    /// @brief Splits what the modem sends into responses and unsolicited result codes.
+    AtResponseParser _parser;
+    /// @brief Moves the data of the connections in buffer access mode.
+    SocketMultiplexer _multiplexer{*this};
+    /// @brief Guards the cached status. _status.signalStrength, _registration and _operatorName.
+    std::string _statusSemaphore;
+    /// @brief The registration status. Cached.
+    RegistrationStatus _registration = RegistrationStatus::Unknown;
+    /// @brief The name of the operator. Cached.
+    std::string _operatorName;
+    /// @brief True once the status has been sampled.
+    std::atomic<bool> _sampled = false;
+    /// @brief How often the monitor samples the status of the network.
+    Milliseconds _monitorPeriod = _MonitorPeriod;
+    /// @brief Network thread only. When the monitor is next due to sample.
+    std::chrono::steady_clock::time_point _nextSample;
+    /**
+     * @brief The connection in transparent access mode. -1 if there isn't one.
+     * @details Quectel LTE Standard TCP/IP Application Note. Only one connection can be in transparent access mode.
+    */
+    Socket _transparentSocket = -1;
+    /// @brief True while the modem is in data mode and everything on the IC is data for the connection in transparent access mode.
+    std::atomic<bool> _dataMode = false;
+    /// @brief The silence kept before and after the +++ escape sequence.
+    Milliseconds _escapeGuardTime = _EscapeGuardTime;
+    /// @brief Network thread only. When data was last written to the IC in data mode.
+    std::chrono::steady_clock::time_point _lastDataWritten;
+    /// @brief Network thread only. True if the line feed that ends the CONNECT line hasn't been received yet.
+    bool _skipLineFeed = false;
+    /// @brief Network thread only. Bytes received in data mode that could be the start of NO CARRIER.
+    std::string _carrierCheck;
 
     /**
      * @brief Send an AT command to the modem and wait for a response.
      * @param[in] atCommand The AT command to send.
      * @param[in] timeout The timeout for the command.
      * @param[in] maxRetries The maximum number of retries to send the command.
-     * @param[out] responseBuffer The buffer to store the response in.
-     * @returns ErrorType::Success if the command was sent and a response was received.
-     * @returns ErrorType::Failure if the command was not sent or no response was received.
+     * @param[in] expectation Optional. How the response ends if it isn't just a final result code, such as the prompt for AT+QISEND.
+     * @returns ErrorType::Success if the command was sent.
+     * @returns ErrorType::Timeout if the command could not be sent after maxRetries.
     */
-    ErrorType sendCommand(const std::string &atCommand, const Milliseconds timeout, const Count maxRetries);
+    ErrorType sendCommand(const std::string &atCommand, const Milliseconds timeout, const Count maxRetries, const AtResponseSettings::Expectation &expectation = AtResponseSettings::Expectation());
 
     /**
-     * @brief Receive a response from the modem.
-     * @details If ErrorType::Failure is returned, then you may want to try calling this function again until the response is received.
-     * @param[out] responseBuffer The buffer to store the response in.
-     * @param[in] timeout The timeout for the response.
-     * @param[in] maxRetries The maximum number of retries to receive the response.
-     * @param[in] expectedResponse Optional. The expected response from the modem. If not provided, this function will ensure that the response ends with the response formatting character.
-     *            but will not check for response messages such as "OK" or "ERROR".
+     * @brief Receive the response to the last command sent.
+     * @details Receives until the final result code. Unsolicited result codes that arrive in the meantime go to their handlers instead
+     *          of the response. If the last response has already been received (e.g. after the prompt for AT+QISEND) then this receives
+     *          the next final result code, such as SEND OK.
+     * @param[out] responseBuffer The information lines of the response separated by the response formatting character, or the payload
+     *             if the command expects one. The final result code if the command failed.
+     * @param[in] timeout The timeout for each read from the IC.
+     * @param[in] maxRetries The maximum number of reads from the IC that can time out.
+     * @param[in] expectedResponse Optional. The final result code (e.g. "OK", "SEND OK", ">") or the start of an information line (e.g. "+CREG: 0,5")
+     *            that is expected. If not provided then any successful final result code will do.
      * @returns ErrorType::Success if the response was received.
      * @returns ErrorType::Timeout if receiving from the IC failed more times than maxRetries.
-     * @returns ErrorType::Failure if the expected response was not found.
+     * @returns ErrorType::Failure if the command failed or the expected response was not found.
     */
     ErrorType receiveCommand(std::string &responseBuffer, const Milliseconds timeout, const Count maxRetries, const std::string expectedResponse = std::string());
 
     /**
-     * @brief Get the manufacturer name of the modem.
-     * @param[out] mfgName The string to store the manufacturer name in.
-     * @returns ErrorType::Success if the manufacturer name was retrieved successfully.
-     * @returns ErrorType::Failure if the manufacturer name was not retrieved successfully.
+     * @brief Receive the response to a command that expects a payload, such as AT+QIRD.
+     * @details The payload is appended to the buffer straight from the receive ring.
+     * @param[out] buffer The buffer to append the payload to.
+     * @param[in] timeout The timeout for each attempt to receive from the IC.
+     * @param[in] maxRetries The maximum number of times to receive from the IC without getting anything.
+     * @returns ErrorType::Success if the response was received. The payload may be empty.
+     * @returns ErrorType::Failure if the command failed.
+     * @returns ErrorType::Timeout if the response was not received.
     */
-    ErrorType getManufacturerName(std::string &mfgName);
+    ErrorType receivePayload(std::string &buffer, const Milliseconds timeout, const Count maxRetries);
+
+    /**
+     * @brief Receive bytes from the IC until the response to the pending command is complete.
+     * @param[in] timeout The timeout for each attempt to receive from the IC.
+     * @param[in] maxRetries The maximum number of times to receive from the IC without getting anything.
+     * @returns ErrorType::Success if the response is complete.
+     * @returns ErrorType::Timeout if the response was not received.
+     * @post The command is still pending.
+    */
+    ErrorType receiveResponse(const Milliseconds timeout, const Count maxRetries);
+
+    /**
+     * @brief Send several AT commands without waiting for each response before sending the next.
+     * @details Up to _PipelineDepth commands are outstanding at a time and their responses are paired with them in the order they were
+     *          sent. If a command gets no response in its timeout then the responses to the commands behind it can't be told apart from
+     *          a late one, so everything outstanding is thrown away and sent again starting from that command.
+     *
+     *          A command marked stopAndWait is sent on its own. V.250 lets the modem abort a command, or ignore what it receives, while
+     *          a command runs, so nothing may arrive while a long running or abortable command is being executed.
+     * @param[in,out] commands The commands to send. The response and error of each are filled in.
+     * @returns ErrorType::Success if every command succeeded.
+     * @returns The error of the first command that did not succeed otherwise. The commands after it were still sent.
+    */
+    ErrorType sendCommands(std::vector<AtCommand> &commands);
+
+    /**
+     * @brief Check a response for the response that was expected.
+     * @param[in] response The response.
+     * @param[in] expectedResponse The final result code or the start of an information line expected. Any successful final result code if empty.
+     * @returns ErrorType::Success if the command succeeded and the expected response was found.
+     * @returns ErrorType::Failure otherwise.
+    */
+    static ErrorType checkResponse(const AtResponseSettings::Response &response, const std::string &expectedResponse);
 
     /**
      * @brief Check if the SIM card is inserted.
+     * @param[in] response The response to AT+QSIMSTAT?
      * @returns ErrorType::Success if the SIM card is inserted.
-     * @returns ErrorType::Failure if the SIM card is not inserted. 
+     * @returns ErrorType::Failure if the SIM card is not inserted or the response could not be parsed.
+    */
+    ErrorType simCardIsInserted(const AtResponseSettings::Response &response);
+
+    /**
+     * @brief Sample the signal strength, registration and operator with one pipeline of AT+CSQ, AT+CREG? and AT+COPS? and cache them.
+     * @returns ErrorType::Success if all three were sampled.
+     * @returns The errors of sendCommands otherwise. Whatever was sampled is still cached.
+    */
+    ErrorType sampleStatus();
+    /**
+     * @brief Sample the status if the monitor is due to.
+     * @param[in] idle True if no connection had anything to do.
+    */
+    void monitor(const bool idle);
+    /**
+     * @brief Handle the +CREG: <stat> unsolicited result code.
+     * @param[in] urc The whole line.
+    */
+    void registrationUrc(std::string_view urc);
+    /**
+     * @brief Cache the registration status.
+     * @returns ErrorType::Success if the status was cached.
+     * @returns ErrorType::Timeout if the cache couldn't be written.
+    */
+    ErrorType cacheRegistration(const RegistrationStatus registration);
+    /// @brief True if the modem is registered to a network, either its home network or roaming.
+    static bool isRegistered(const RegistrationStatus registration) { return RegistrationStatus::Home == registration || RegistrationStatus::Roaming == registration; }
+    /**
+     * @brief Get one of the comma separated numbers that follow the prefix of an information line or URC.
+     * @param[in] line The line, such as "+CSQ: 20,99".
+     * @param[in] index The index of the number. 0 is the first.
+     * @param[out] value The number.
+     * @returns ErrorType::Success if the number was found.
+     * @returns ErrorType::Failure otherwise.
     */
-    ErrorType simCardIsInserted();
+    static ErrorType numberAt(std::string_view line, const Count index, long &value);
+    /**
+     * @brief Convert the <rssi> of +CSQ to a signal strength.
+     * @details Pg. 78, Sect. 6.3 EC21A AT Command Manual. 99 and 199 (unknown) are returned as they are.
+    */
+    static DecibelMilliWatts toSignalStrength(const long rssi);
 
     /**
      * @brief Check if the pdp context is active.
@@ -144,6 +359,107 @@ class Cellular : public CellularAbstraction {
      */
     ErrorType dataIsAvailable(const Socket socket);
 
+    /**
+     * @brief Receive from the IC for unsolicited result codes while no command is pending.
+     * @param[in] timeout The longest to wait for the IC.
+    */
+    void receiveUnsolicited(const Milliseconds timeout);
+    /**
+     * @brief Receive from the IC straight into the free space of the parser's ring buffer and parse what was received.
+     * @param[in] timeout The longest to wait for the IC.
+     * @returns ErrorType::Success if anything was received.
+     * @returns ErrorType::NoMemory if the ring buffer is full and can't grow.
+     * @returns The errors of IcCommunicationProtocol::rxBlockingInto otherwise.
+    */
+    ErrorType receiveIntoParser(const Milliseconds timeout);
+
+    /**
+     * @brief Read data received on a connection in buffer access mode.
+     * @details Pg. 20, Sect. 2.1.8 Quectel LTE TCP/IP Standard. AT+QIRD=<connectID>,<read_length>
+     * @param[in] socket The connection id.
+     * @param[out] buffer The buffer to append the data to.
+     * @param[in] length The most to read. No more than _MaxBytesToRead.
+     * @param[in] timeout The timeout for the command.
+     * @returns ErrorType::Success if the data was read. Less than length means there was nothing more to read.
+     * @returns ErrorType::Failure or ErrorType::Timeout if the command failed.
+    */
+    ErrorType readData(const Socket socket, std::string &buffer, const Bytes length, const Milliseconds timeout);
+
+    /**
+     * @brief Send data on a connection in buffer access mode.
+     * @details Pg. 19, Sect. 2.1.7 Quectel LTE TCP/IP Standard. AT+QISEND=<connectID>,<send_length>
+     * @param[in] socket The connection id.
+     * @param[in] data The data. No more than _MaxBytesToSend.
+     * @param[in] timeout The timeout for each of the prompt, the data and the result.
+     * @returns ErrorType::Success if the modem took the data.
+     * @returns ErrorType::LimitReached if the modem's send buffer was full (SEND FAIL).
+     * @returns ErrorType::Failure or ErrorType::Timeout if the data could not be sent.
+    */
+    ErrorType sendData(const Socket socket, std::string_view data, const Milliseconds timeout);
+
+    /**
+     * @brief Ask the modem how many of the bytes sent on a connection have not been acknowledged by the remote yet.
+     * @details Pg. 19, Sect. 2.1.7 Quectel LTE TCP/IP Standard. AT+QISEND=<connectID>,0
+     * @param[in] socket The connection id.
+     * @param[out] unacknowledged The number of bytes.
+     * @param[in] timeout The timeout for the command.
+     * @returns ErrorType::Success if the number was received.
+     * @returns ErrorType::Failure or ErrorType::Timeout otherwise.
+    */
+    ErrorType unacknowledgedBytes(const Socket socket, Bytes &unacknowledged, const Milliseconds timeout);
+
+    /**
+     * @brief Close a connection.
+     * @details Pg. 18, Sect. 2.1.5 Quectel LTE TCP/IP Standard. AT+QICLOSE=<connectID>
+     * @param[in] socket The connection id.
+     * @returns ErrorType::Success if the connection was closed.
+     * @returns ErrorType::Failure or ErrorType::Timeout otherwise.
+    */
+    ErrorType closeConnection(const Socket socket);
+
+    /**
+     * @brief Start moving the data of a connection in transparent access mode once the modem has answered CONNECT.
+     * @details Whatever was received after CONNECT is the connection's data.
+     * @param[in] socket The connection id.
+     * @pre The response to the command that was answered with CONNECT has been received.
+    */
+    void dataModeEntered(const Socket socket);
+    /**
+     * @brief Switch the modem from data mode to command mode with the +++ escape sequence.
+     * @details Quectel LTE Standard TCP/IP Application Note. Nothing is written for the guard time before and after
+     *          +++. Data that arrives until the modem answers OK is given to the connection. Called by sendCommand and sendCommands so that
+     *          commands can be sent at any time. The main loop returns to data mode afterwards.
+     * @returns ErrorType::Success if the modem is in command mode.
+     * @returns ErrorType::Timeout if the modem did not leave data mode.
+    */
+    ErrorType leaveDataMode();
+    /**
+     * @brief Return to data mode with ATO.
+     * @details Quectel LTE Standard TCP/IP Application Note. Unlike reopening the connection, nothing the remote sent
+     *          in the meantime is lost.
+     * @returns ErrorType::Success if the modem is in data mode.
+     * @returns ErrorType::EndOfFile if the remote closed the connection (NO CARRIER).
+     * @returns The errors of sendCommand and receiveCommand otherwise.
+    */
+    ErrorType enterDataMode();
+    /**
+     * @brief Read data in data mode.
+     * @param[out] buffer The buffer to append the data to.
+     * @param[in] length The most to read.
+     * @param[in] timeout The longest to wait for the IC.
+     * @returns ErrorType::Success if anything was read.
+     * @returns ErrorType::EndOfFile if the remote closed the connection and the modem left data mode (NO CARRIER). Data before it was read.
+     * @returns ErrorType::Timeout if nothing was read.
+    */
+    ErrorType readDataMode(std::string &buffer, const Bytes length, const Milliseconds timeout);
+    /**
+     * @brief Write data in data mode.
+     * @param[in] data The data. No more than _DataModeChunkSize.
+     * @param[in] timeout The timeout for the IC.
+     * @returns The errors of the IC's txBlocking.
+    */
+    ErrorType writeDataMode(std::string_view data, const Milliseconds timeout);
+
     /**
      * @brief Activate a pdp context.
      * @param[in] context The pdp context to activate.
@@ -170,25 +486,7 @@ class Cellular : public CellularAbstraction {
     ErrorType echoMode(const bool enable);
 
     /**
-     * @brief terminatingCharacter
-     * @details Pg. 23 EC21A AT Command Manual
-     * @param[out] terminatingCharacter The character that the modem will use to terminate the response.
-     * @returns ErrorType::Success if the terminating character was retrieved successfully.
-     * @returns ErrorType::Failure if the terminating character was not retrieved successfully.
-    */
-    ErrorType terminatingCharacter(char &terminatingCharacter);
-
-    /**
-     * @brief responseFormattingCharacter
-     * @details Pg. 24 EC21A AT Command Manual
-     * @param[out] responseFormattingCharacter The character that the modem will use to format the response.
-     * @returns ErrorType::Success if the response formatting character was retrieved successfully.
-     * @returns ErrorType::Failure if the response formatting character was not retrieved successfully.
-    */
-    ErrorType responseFormattingCharacter(char &responseFormattingCharacter);
-
-    /**
-     * @brief Find the next available connection id (aka socket)
+     * @brief Find the next available connection id (aka socket) and take it
      * @param id [out] The next available connection id
      * @return ErrorType::Success if an id was found
      * @return ErrorType::LimitReached if no ids are available
@@ -197,6 +495,7 @@ class Cellular : public CellularAbstraction {
 
         for (unsigned int i = 0; i < _connectionIds.size(); i++) {
             if (-1 == _connectionIds[i]) {
+                _connectionIds[i] = i;
                 id = i;
                 return ErrorType::Success;
             }
@@ -210,7 +509,12 @@ class Cellular : public CellularAbstraction {
      * @param id The connection id to release
      */
     void releaseConnectionId(const Socket id) {
+        _multiplexer.close(id);
         _connectionIds[id] = -1;
+
+        if (_transparentSocket == id) {
+            _transparentSocket = -1;
+        }
     }
 };
 
@@ -0,0 +1,522 @@
+//Modules
+#include "SocketMultiplexerModule.hpp"
+#include "CellularModule.hpp"
+#include "OperatingSystemModule.hpp"
+//C++
+#include <algorithm>
+#include <cassert>
+#include <charconv>
+
+std::atomic<int> SocketMultiplexer::instanceCount(0);
+
+SocketMultiplexer::SocketMultiplexer(Cellular &cellular) : _cellular(cellular) {
+    const int instance = ++instanceCount;
+
+    for (Count i = 0; i < _connections.size(); i++) {
+        _connections[i].semaphore = std::string("cellularConnection").append(std::to_string(instance)).append("_").append(std::to_string(i));
+        ErrorType error = OperatingSystem::Instance().createSemaphore(1, 1, _connections[i].semaphore);
+        assert(ErrorType::Success == error);
+
+        _connections[i].receivedSemaphore = std::string(_connections[i].semaphore).append("_received");
+        error = OperatingSystem::Instance().createSemaphore(MaxReceivedSignals, 0, _connections[i].receivedSemaphore);
+        assert(ErrorType::Success == error);
+    }
+}
+
+SocketMultiplexer::~SocketMultiplexer() {
+    for (Connection &connection : _connections) {
+        OperatingSystem::Instance().deleteSemaphore(connection.semaphore);
+        OperatingSystem::Instance().deleteSemaphore(connection.receivedSemaphore);
+    }
+}
+
+ErrorType SocketMultiplexer::open(const Socket socket) {
+    if (!isConnectionId(socket)) {
+        return ErrorType::InvalidParameter;
+    }
+
+    Connection &connection = _connections[socket];
+    std::vector<Completion> completions;
+
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(connection.semaphore, SemaphoreTimeout)) {
+        return ErrorType::Timeout;
+    }
+
+    //Anything left from a previous connection with the same id is stale.
+    failAll(connection, ErrorType::Failure, completions);
+    connection.received.clear();
+    connection.dataReady = false;
+    connection.peerClosed = false;
+    connection.unacknowledged = 0;
+    connection.nextWindowCheck = Clock::time_point();
+    connection.open = true;
+
+    OperatingSystem::Instance().incrementSemaphore(connection.semaphore);
+
+    complete(completions);
+    return ErrorType::Success;
+}
+
+void SocketMultiplexer::close(const Socket socket) {
+    if (!isConnectionId(socket)) {
+        return;
+    }
+
+    Connection &connection = _connections[socket];
+    std::vector<Completion> completions;
+
+    ErrorType error = OperatingSystem::Instance().waitSemaphore(connection.semaphore, SemaphoreTimeout);
+    assert(ErrorType::Success == error);
+
+    connection.open = false;
+    failAll(connection, ErrorType::Failure, completions);
+    connection.received.clear();
+
+    OperatingSystem::Instance().incrementSemaphore(connection.semaphore);
+    OperatingSystem::Instance().incrementSemaphore(connection.receivedSemaphore);
+
+    complete(completions);
+}
+
+ErrorType SocketMultiplexer::send(const Socket socket, std::shared_ptr<std::string> data, const Milliseconds timeout, std::function<void(const ErrorType error, const Bytes bytesWritten)> callback) {
+    if (!isConnectionId(socket) || nullptr == data) {
+        return ErrorType::InvalidParameter;
+    }
+
+    Connection &connection = _connections[socket];
+
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(connection.semaphore, SemaphoreTimeout)) {
+        return ErrorType::Timeout;
+    }
+
+    ErrorType error = ErrorType::Success;
+    if (!connection.open) {
+        error = ErrorType::PrerequisitesNotMet;
+    }
+    else if (connection.queued > 0 && connection.queued + data->size() > MaxSendQueue) {
+        error = ErrorType::LimitReached;
+    }
+    else {
+        connection.transfers.push_back({data, 0, Clock::now() + std::chrono::milliseconds(timeout), callback});
+        connection.queued += data->size();
+    }
+
+    OperatingSystem::Instance().incrementSemaphore(connection.semaphore);
+    return error;
+}
+
+ErrorType SocketMultiplexer::sendBlocking(const Socket socket, const std::string &data, const Milliseconds timeout) {
+    //Shared with the callback in case it is called after this has given up waiting.
+    auto done = std::make_shared<std::atomic<bool>>(false);
+    auto result = std::make_shared<std::atomic<ErrorType>>(ErrorType::Timeout);
+
+    ErrorType error = send(socket, std::make_shared<std::string>(data), timeout, [done, result](const ErrorType error, const Bytes) {
+        *result = error;
+        *done = true;
+    });
+
+    if (ErrorType::Success != error) {
+        return error;
+    }
+
+    //Data that started being sent before the timeout is finished, so the network thread is given a little longer.
+    const auto deadline = Clock::now() + std::chrono::milliseconds(timeout + CommandTimeout);
+    while (!*done && Clock::now() < deadline) {
+        OperatingSystem::Instance().delay(WaitPeriod);
+    }
+
+    return *done ? result->load() : ErrorType::Timeout;
+}
+
+ErrorType SocketMultiplexer::receive(const Socket socket, std::shared_ptr<std::string> buffer, const Milliseconds timeout, std::function<void(const ErrorType error, std::shared_ptr<std::string> buffer)> callback) {
+    if (!isConnectionId(socket) || nullptr == buffer || nullptr == callback) {
+        return ErrorType::InvalidParameter;
+    }
+
+    Connection &connection = _connections[socket];
+    std::vector<Completion> completions;
+
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(connection.semaphore, SemaphoreTimeout)) {
+        return ErrorType::Timeout;
+    }
+
+    ErrorType error = ErrorType::Success;
+    if (!connection.open) {
+        error = ErrorType::PrerequisitesNotMet;
+    }
+    else {
+        connection.receives.push_back({buffer, static_cast<Bytes>(buffer->size()), Clock::now() + std::chrono::milliseconds(timeout), callback});
+        //There may already be something for it.
+        completeReceives(connection, completions);
+    }
+
+    OperatingSystem::Instance().incrementSemaphore(connection.semaphore);
+
+    complete(completions);
+    return error;
+}
+
+ErrorType SocketMultiplexer::receiveBlocking(const Socket socket, std::string &buffer, const Milliseconds timeout) {
+    if (!isConnectionId(socket)) {
+        return ErrorType::InvalidParameter;
+    }
+
+    Connection &connection = _connections[socket];
+    const Bytes size = buffer.size();
+    const auto deadline = Clock::now() + std::chrono::milliseconds(timeout);
+
+    while (true) {
+        //Signals for anything that has already been looked at are spent. Any that come after this are for something new.
+        while (ErrorType::Success == OperatingSystem::Instance().decrementSemaphore(connection.receivedSemaphore));
+
+        if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(connection.semaphore, SemaphoreTimeout)) {
+            return ErrorType::Timeout;
+        }
+
+        ErrorType error = ErrorType::Timeout;
+        if (!connection.open) {
+            error = ErrorType::PrerequisitesNotMet;
+        }
+        else if (!connection.received.empty()) {
+            const Bytes bytes = std::min<Bytes>(size, connection.received.size());
+            buffer.assign(connection.received, 0, bytes);
+            connection.received.erase(0, bytes);
+            error = ErrorType::Success;
+        }
+        else if (connection.peerClosed && !connection.dataReady) {
+            error = ErrorType::EndOfFile;
+        }
+
+        OperatingSystem::Instance().incrementSemaphore(connection.semaphore);
+
+        const auto now = Clock::now();
+        if (ErrorType::Timeout != error || now >= deadline) {
+            if (ErrorType::Success != error) {
+                buffer.clear();
+            }
+
+            return error;
+        }
+
+        const Milliseconds remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - now).count();
+        OperatingSystem::Instance().waitSemaphore(connection.receivedSemaphore, remaining);
+    }
+}
+
+void SocketMultiplexer::urc(std::string_view urc) {
+    //+QIURC: "recv",<connectID>
+    //+QIURC: "closed",<connectID>
+    constexpr std::string_view recv("+QIURC: \"recv\",");
+    constexpr std::string_view closed("+QIURC: \"closed\",");
+
+    const bool isRecv = urc.starts_with(recv);
+    const bool isClosed = urc.starts_with(closed);
+    if (!isRecv && !isClosed) {
+        return;
+    }
+
+    Socket socket = 0;
+    urc.remove_prefix(isRecv ? recv.size() : closed.size());
+    const auto [end, error] = std::from_chars(urc.data(), urc.data() + urc.size(), socket);
+    if (std::errc() != error || !isConnectionId(socket)) {
+        return;
+    }
+
+    if (isRecv) {
+        _connections[socket].dataReady = true;
+    }
+    else {
+        _connections[socket].peerClosed = true;
+        OperatingSystem::Instance().incrementSemaphore(_connections[socket].receivedSemaphore);
+    }
+}
+
+void SocketMultiplexer::deliver(const Socket socket, std::string_view data, const bool peerClosed) {
+    if (!isConnectionId(socket)) {
+        return;
+    }
+
+    Connection &connection = _connections[socket];
+    std::vector<Completion> completions;
+
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(connection.semaphore, SemaphoreTimeout)) {
+        return;
+    }
+
+    if (connection.open) {
+        connection.received.append(data);
+        connection.peerClosed = connection.peerClosed || peerClosed;
+        completeReceives(connection, completions);
+    }
+
+    OperatingSystem::Instance().incrementSemaphore(connection.semaphore);
+    OperatingSystem::Instance().incrementSemaphore(connection.receivedSemaphore);
+
+    complete(completions);
+}
+
+void SocketMultiplexer::unsolicitedLost() {
+    //A read that finds nothing costs one command. Data that is never read is stuck in the modem for good.
+    for (Connection &connection : _connections) {
+        connection.dataReady = true;
+    }
+}
+
+ErrorType SocketMultiplexer::service() {
+    bool busy = false;
+
+    //Everything on the IC belongs to one connection while the modem is in data mode.
+    if (_cellular._dataMode) {
+        return serviceDataMode(_cellular._transparentSocket);
+    }
+
+    for (Count i = 0; i < _connections.size(); i++) {
+        const Socket socket = (_next + i) % _connections.size();
+        Connection &connection = _connections[socket];
+        std::vector<Completion> completions;
+
+        //The connection in transparent access mode moves its data when the modem returns to data mode.
+        if (!connection.open || socket == _cellular._transparentSocket) {
+            continue;
+        }
+
+        busy = serviceReceive(socket) || busy;
+        busy = serviceSend(socket, completions) || busy;
+
+        if (ErrorType::Success == OperatingSystem::Instance().waitSemaphore(connection.semaphore, SemaphoreTimeout)) {
+            completeReceives(connection, completions);
+            OperatingSystem::Instance().incrementSemaphore(connection.semaphore);
+        }
+
+        complete(completions);
+    }
+
+    _next = (_next + 1) % _connections.size();
+
+    if (!busy) {
+        _cellular.receiveUnsolicited(IdlePeriod);
+        return ErrorType::NoData;
+    }
+
+    return ErrorType::Success;
+}
+
+ErrorType SocketMultiplexer::serviceDataMode(const Socket socket) {
+    Connection &connection = _connections[socket];
+    std::vector<Completion> completions;
+
+    bool busy = serviceSend(socket, completions);
+    //Nothing was sent so waiting a little for data to arrive is all there is to do.
+    busy = serviceReceive(socket, busy ? 0 : IdlePeriod) || busy;
+
+    if (ErrorType::Success == OperatingSystem::Instance().waitSemaphore(connection.semaphore, SemaphoreTimeout)) {
+        completeReceives(connection, completions);
+        OperatingSystem::Instance().incrementSemaphore(connection.semaphore);
+    }
+
+    complete(completions);
+
+    return busy ? ErrorType::Success : ErrorType::NoData;
+}
+
+bool SocketMultiplexer::serviceReceive(const Socket socket, const Milliseconds wait) {
+    Connection &connection = _connections[socket];
+    const bool dataMode = _cellular._dataMode && socket == _cellular._transparentSocket;
+
+    if (!dataMode && !connection.dataReady) {
+        return false;
+    }
+
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(connection.semaphore, SemaphoreTimeout)) {
+        return false;
+    }
+
+    //Only the network thread adds to what has been received so there is at least this much room once the modem has been read.
+    const Bytes room = MaxReceiveBuffer - std::min<Bytes>(MaxReceiveBuffer, connection.received.size());
+    OperatingSystem::Instance().incrementSemaphore(connection.semaphore);
+
+    if (0 == room) {
+        return false;
+    }
+
+    //The modem is read without the semaphore so that the connection can be received from in the meantime.
+    //Whatever doesn't fit is held back by the flow control of the IC.
+    std::string bytesRead;
+    bool peerClosed = false;
+
+    if (dataMode) {
+        const Bytes toRead = std::min<Bytes>(room, Cellular::_DataModeChunkSize);
+        peerClosed = ErrorType::EndOfFile == _cellular.readDataMode(bytesRead, toRead, wait);
+    }
+    else {
+        //Cleared first so that a notification which arrives during the read isn't lost.
+        connection.dataReady = false;
+
+        const Bytes toRead = std::min<Bytes>(room, Cellular::_MaxBytesToRead);
+        const ErrorType error = _cellular.readData(socket, bytesRead, toRead, CommandTimeout);
+
+        //A read that takes everything there was can't tell that there's nothing left, and one that failed should be tried again.
+        if (ErrorType::Success != error || bytesRead.size() == toRead) {
+            connection.dataReady = true;
+        }
+    }
+
+    if (bytesRead.empty() && !peerClosed) {
+        return false;
+    }
+
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(connection.semaphore, SemaphoreTimeout)) {
+        return false;
+    }
+
+    //The connection may have been closed in the meantime.
+    if (connection.open) {
+        connection.received.append(bytesRead);
+        connection.peerClosed = connection.peerClosed || peerClosed;
+    }
+
+    OperatingSystem::Instance().incrementSemaphore(connection.semaphore);
+    OperatingSystem::Instance().incrementSemaphore(connection.receivedSemaphore);
+
+    return !bytesRead.empty();
+}
+
+bool SocketMultiplexer::serviceSend(const Socket socket, std::vector<Completion> &completions) {
+    Connection &connection = _connections[socket];
+    const Clock::time_point now = Clock::now();
+
+    if (now < connection.nextWindowCheck) {
+        return false;
+    }
+
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(connection.semaphore, SemaphoreTimeout)) {
+        return false;
+    }
+
+    //Data that hasn't been started by its deadline is dropped. Data that has can't be without corrupting the stream so it's finished.
+    while (!connection.transfers.empty() && 0 == connection.transfers.front().sent && now >= connection.transfers.front().deadline) {
+        Transfer &expired = connection.transfers.front();
+        if (nullptr != expired.callback) {
+            completions.push_back({std::bind(expired.callback, ErrorType::Timeout, 0)});
+        }
+        connection.queued -= expired.data->size();
+        connection.transfers.pop_front();
+    }
+
+    if (connection.transfers.empty()) {
+        OperatingSystem::Instance().incrementSemaphore(connection.semaphore);
+        return false;
+    }
+
+    //Keeps the data alive while the semaphore isn't held.
+    const std::shared_ptr<std::string> data = connection.transfers.front().data;
+    const Bytes sent = connection.transfers.front().sent;
+    OperatingSystem::Instance().incrementSemaphore(connection.semaphore);
+
+    const bool dataMode = _cellular._dataMode && socket == _cellular._transparentSocket;
+    const Bytes segmentSize = std::min<Bytes>(data->size() - sent, dataMode ? Cellular::_DataModeChunkSize : Cellular::_MaxBytesToSend);
+
+    //SEND OK only means that the modem has buffered a segment so segments are sent back to back. Only the modem's send buffer
+    //limits how much is in flight, and it's only asked how much is unacknowledged when the window looks full.
+    //In data mode there are no segments and the flow control of the IC is the window.
+    if (!dataMode && connection.unacknowledged + segmentSize > Cellular::_SendWindow) {
+        ErrorType error = _cellular.unacknowledgedBytes(socket, connection.unacknowledged, CommandTimeout);
+
+        if (ErrorType::Success != error || connection.unacknowledged + segmentSize > Cellular::_SendWindow) {
+            connection.nextWindowCheck = now + std::chrono::milliseconds(WindowFullDelay);
+            return false;
+        }
+    }
+
+    const std::string_view segment = std::string_view(*data).substr(sent, segmentSize);
+    ErrorType error = dataMode ? _cellular.writeDataMode(segment, CommandTimeout) : _cellular.sendData(socket, segment, CommandTimeout);
+    if (ErrorType::LimitReached == error) {
+        //Something else is using the send buffer. Find out how much next time.
+        connection.unacknowledged = Cellular::_SendWindow;
+        return false;
+    }
+
+    if (ErrorType::Success != OperatingSystem::Instance().waitSemaphore(connection.semaphore, SemaphoreTimeout)) {
+        return false;
+    }
+
+    //The connection may have been closed and its queue failed in the meantime.
+    if (!connection.transfers.empty() && data == connection.transfers.front().data) {
+        Transfer &transfer = connection.transfers.front();
+
+        if (ErrorType::Success == error) {
+            connection.unacknowledged += dataMode ? 0 : segmentSize;
+            connection.queued -= segmentSize;
+            transfer.sent += segmentSize;
+        }
+
+        if (ErrorType::Success != error || transfer.sent == transfer.data->size()) {
+            if (nullptr != transfer.callback) {
+                completions.push_back({std::bind(transfer.callback, error, transfer.sent)});
+            }
+
+            connection.queued -= transfer.data->size() - transfer.sent;
+            connection.transfers.pop_front();
+        }
+    }
+
+    OperatingSystem::Instance().incrementSemaphore(connection.semaphore);
+
+    return ErrorType::Success == error;
+}
+
+void SocketMultiplexer::completeReceives(Connection &connection, std::vector<Completion> &completions) {
+    const Clock::time_point now = Clock::now();
+
+    while (!connection.receives.empty()) {
+        Receive &receive = connection.receives.front();
+        ErrorType error = ErrorType::Success;
+
+        if (!connection.received.empty()) {
+            const Bytes bytes = std::min<Bytes>(receive.size, connection.received.size());
+            receive.buffer->assign(connection.received, 0, bytes);
+            connection.received.erase(0, bytes);
+        }
+        else if (connection.peerClosed && !connection.dataReady) {
+            error = ErrorType::EndOfFile;
+        }
+        else if (now >= receive.deadline) {
+            error = ErrorType::Timeout;
+        }
+        else {
+            return;
+        }
+
+        if (ErrorType::Success != error) {
+            receive.buffer->clear();
+        }
+
+        completions.push_back({std::bind(receive.callback, error, receive.buffer)});
+        connection.receives.pop_front();
+    }
+}
+
+void SocketMultiplexer::failAll(Connection &connection, const ErrorType error, std::vector<Completion> &completions) {
+    for (Transfer &transfer : connection.transfers) {
+        if (nullptr != transfer.callback) {
+            completions.push_back({std::bind(transfer.callback, error, transfer.sent)});
+        }
+    }
+
+    for (Receive &receive : connection.receives) {
+        receive.buffer->clear();
+        completions.push_back({std::bind(receive.callback, error, receive.buffer)});
+    }
+
+    connection.transfers.clear();
+    connection.receives.clear();
+    connection.queued = 0;
+}
+
+void SocketMultiplexer::complete(std::vector<Completion> &completions) {
+    for (Completion &completion : completions) {
+        completion.callback();
+    }
+
+    completions.clear();
+}
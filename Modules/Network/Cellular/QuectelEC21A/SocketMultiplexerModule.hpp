@@ -0,0 +1,263 @@
+/***************************************************************************//**
+* @author   Ben Haubrich
+* @file     SocketMultiplexerModule.hpp
+* @details  Shares the AT command channel of a Quectel EC21A between its connections.
+* @ingroup  NetworkModules
+*******************************************************************************/
+#ifndef __SOCKET_MULTIPLEXER_MODULE_HPP__
+#define __SOCKET_MULTIPLEXER_MODULE_HPP__
+
+//AbstractionLayer
+#include "Error.hpp"
+#include "Types.hpp"
+//C++
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class Cellular;
+
+/**
+ * @class SocketMultiplexer
+ * @brief Moves the data of every buffer access mode connection on the modem over its one AT command channel.
+ * @details Connections queue data to send and take data that has been received, but only the network thread talks to the modem.
+ *          Each time the multiplexer is serviced it visits every open connection once, starting one further along each time, and
+ *          gives each at most one AT+QIRD and one AT+QISEND. A busy connection can't starve the others and a connection that isn't
+ *          being read from only stops itself: once its receive buffer is full it is skipped and its data waits in the modem.
+ *
+ *          +QIURC: "recv" and "closed" are demultiplexed to their connection as they are parsed, whichever command they arrive in
+ *          the middle of.
+ *
+ *          A connection in transparent access mode uses the same queues. Its data is moved only while the modem is in data mode.
+ *
+ *          Callbacks are called from the network thread without any locks held.
+ * @code
+ * //Network thread
+ * while (true) {
+ *     multiplexer.service();
+ * }
+ *
+ * //Any thread
+ * multiplexer.open(socket);
+ * multiplexer.sendBlocking(socket, "hello", 1000);
+ * multiplexer.receiveBlocking(socket, buffer, 1000);
+ * @endcode
+*/
+class SocketMultiplexer {
+
+    public:
+    /// @brief The number of connection ids. Pg. 11 Quectel LTE Standard TCP/IP Application Note.
+    static constexpr Count MaxConnections = 12;
+    /// @brief The most bytes kept for a connection that haven't been received by it. More is left in the modem until there's room.
+    static constexpr Bytes MaxReceiveBuffer = 8*1500;
+    /// @brief The most bytes queued for a connection that haven't been sent.
+    static constexpr Bytes MaxSendQueue = 64*1024;
+
+    /**
+     * @brief Constructor.
+     * @param[in] cellular The modem that the connections are on.
+    */
+    SocketMultiplexer(Cellular &cellular);
+    ~SocketMultiplexer();
+
+    /**
+     * @brief Start moving the data of a connection that has been opened on the modem.
+     * @param[in] socket The connection id.
+     * @returns ErrorType::Success if the connection was started.
+     * @returns ErrorType::InvalidParameter if the socket is not a connection id.
+    */
+    ErrorType open(const Socket socket);
+    /**
+     * @brief Stop moving the data of a connection.
+     * @param[in] socket The connection id.
+     * @post Queued sends and receives are failed with ErrorType::Failure and anything received is thrown away.
+    */
+    void close(const Socket socket);
+
+    /**
+     * @brief Queue data to be sent on a connection.
+     * @param[in] socket The connection id.
+     * @param[in] data The data.
+     * @param[in] timeout The time allowed for the data to start being sent.
+     * @param[in] callback Called with the result and the number of bytes sent once the data is done with. May be nullptr.
+     * @returns ErrorType::Success if the data was queued.
+     * @returns ErrorType::LimitReached if MaxSendQueue bytes are already queued for the connection.
+     * @returns ErrorType::PrerequisitesNotMet if the connection is not open.
+     * @returns ErrorType::InvalidParameter if the socket is not a connection id or data is nullptr.
+    */
+    ErrorType send(const Socket socket, std::shared_ptr<std::string> data, const Milliseconds timeout, std::function<void(const ErrorType error, const Bytes bytesWritten)> callback);
+    /**
+     * @brief Send data on a connection and wait for the modem to take all of it.
+     * @returns ErrorType::Success if the data was sent.
+     * @returns ErrorType::Timeout if the data was not sent in time.
+     * @returns The errors of send otherwise.
+    */
+    ErrorType sendBlocking(const Socket socket, const std::string &data, const Milliseconds timeout);
+    /**
+     * @brief Receive data from a connection when it arrives.
+     * @param[in] socket The connection id.
+     * @param[in] buffer The buffer. Its size is the most that will be received and it is resized to what was received.
+     * @param[in] timeout The time to wait for data.
+     * @param[in] callback Called with the result and the buffer.
+     * @returns ErrorType::Success if the receive was queued.
+     * @returns ErrorType::PrerequisitesNotMet if the connection is not open.
+     * @returns ErrorType::InvalidParameter if the socket is not a connection id, or buffer or callback is nullptr.
+    */
+    ErrorType receive(const Socket socket, std::shared_ptr<std::string> buffer, const Milliseconds timeout, std::function<void(const ErrorType error, std::shared_ptr<std::string> buffer)> callback);
+    /**
+     * @brief Wait for data from a connection.
+     * @param[in] socket The connection id.
+     * @param[in] buffer The buffer. Its size is the most that will be received and it is resized to what was received.
+     * @param[in] timeout The time to wait for data.
+     * @returns ErrorType::Success if data was received.
+     * @returns ErrorType::Timeout if no data arrived in time.
+     * @returns ErrorType::EndOfFile if the remote closed the connection and everything it sent has been received.
+     * @returns ErrorType::PrerequisitesNotMet if the connection is not open.
+     * @returns ErrorType::InvalidParameter if the socket is not a connection id.
+    */
+    ErrorType receiveBlocking(const Socket socket, std::string &buffer, const Milliseconds timeout);
+
+    /**
+     * @brief Handle the +QIURC: unsolicited result codes.
+     * @details Pg. 36, Sect. 2.3.2, Quectel LTE Standard TCP/IP Application Note.
+     * @param[in] urc The whole line.
+    */
+    void urc(std::string_view urc);
+    /**
+     * @brief Give data to a connection that was received outside of service, such as around a switch between data and command mode.
+     * @param[in] socket The connection id.
+     * @param[in] data The data. Taken even if the receive buffer is full since the modem can't be asked for it again.
+     * @param[in] peerClosed True if the remote has closed the connection after the data.
+    */
+    void deliver(const Socket socket, std::string_view data, const bool peerClosed = false);
+    /**
+     * @brief Make up for unsolicited result codes that may have been thrown away, such as along with a response that was lost.
+     * @details Every connection is read from on its next turn in case +QIURC: "recv" was one of them.
+    */
+    void unsolicitedLost();
+    /**
+     * @brief Give every open connection a turn on the AT command channel.
+     * @details Network thread only. If no connection had anything to do, waits a short time for unsolicited result codes.
+     *          While the modem is in data mode the connection in transparent access mode has the IC to itself and its data is moved
+     *          without any AT commands.
+     * @returns ErrorType::Success if a connection had something to do.
+     * @returns ErrorType::NoData if no connection had anything to do.
+    */
+    ErrorType service();
+
+    private:
+    using Clock = std::chrono::steady_clock;
+
+    /// @brief The timeout for semaphore operations.
+    static constexpr Milliseconds SemaphoreTimeout = 1000;
+    /// @brief The timeout for each AT command.
+    static constexpr Milliseconds CommandTimeout = 1000;
+    /// @brief The longest that service waits for unsolicited result codes when there is nothing else to do.
+    static constexpr Milliseconds IdlePeriod = 5;
+    /// @brief How long to let the remote catch up when a connection's send window is full before asking the modem again.
+    static constexpr Milliseconds WindowFullDelay = 5;
+    /// @brief How often a thread that is blocked sending on a connection checks it again.
+    static constexpr Milliseconds WaitPeriod = 1;
+    /// @brief The most times a connection can be signalled that there is something new to receive before it is waited on.
+    static constexpr Count MaxReceivedSignals = 1;
+
+    /**
+     * @struct Transfer
+     * @brief Data waiting to be sent.
+    */
+    struct Transfer {
+        std::shared_ptr<std::string> data;                                             ///< The data.
+        Bytes sent = 0;                                                                ///< The bytes of the data that the modem has taken.
+        Clock::time_point deadline;                                                    ///< When the data must have started being sent by.
+        std::function<void(const ErrorType error, const Bytes bytesWritten)> callback; ///< Called when the data is done with.
+    };
+
+    /**
+     * @struct Receive
+     * @brief A receive waiting for data.
+    */
+    struct Receive {
+        std::shared_ptr<std::string> buffer;                                                  ///< Where the data goes.
+        Bytes size;                                                                           ///< The most that can be received.
+        Clock::time_point deadline;                                                           ///< When to give up waiting.
+        std::function<void(const ErrorType error, std::shared_ptr<std::string> buffer)> callback; ///< Called when the receive is done with.
+    };
+
+    /**
+     * @struct Connection
+     * @brief The state of one connection id.
+    */
+    struct Connection {
+        std::string semaphore;                   ///< Guards everything but the atomics and the network thread only members.
+        std::string receivedSemaphore;           ///< Incremented when there is something new for receiveBlocking: data, a close or the end of the stream.
+        bool open = false;                       ///< True while the connection's data is being moved.
+        std::atomic<bool> dataReady = false;     ///< The modem reported data that may not have been read yet.
+        std::atomic<bool> peerClosed = false;    ///< The modem reported that the remote closed the connection.
+        std::string received;                    ///< Read from the modem and not yet received by the connection.
+        std::deque<Transfer> transfers;          ///< Data to send in the order it was queued.
+        Bytes queued = 0;                        ///< The bytes in transfers that haven't been sent.
+        std::deque<Receive> receives;            ///< Receives waiting for data in the order they were queued.
+        Bytes unacknowledged = 0;                ///< Network thread only. Bytes sent that may not have been acknowledged yet.
+        Clock::time_point nextWindowCheck;       ///< Network thread only. When a full send window is next worth asking about.
+    };
+
+    /**
+     * @struct Completion
+     * @brief A callback that is called once the semaphore has been released.
+    */
+    struct Completion {
+        std::function<void(void)> callback; ///< The callback bound to its results.
+    };
+
+    /// @brief The number of multiplexers that have been created.
+    static std::atomic<int> instanceCount;
+    /// @brief The modem.
+    Cellular &_cellular;
+    /// @brief The connections, indexed by connection id.
+    std::array<Connection, MaxConnections> _connections;
+    /// @brief The connection that is visited first on the next service.
+    Count _next = 0;
+
+    /// @brief True if the socket is a connection id.
+    static bool isConnectionId(const Socket socket) { return socket >= 0 && static_cast<Count>(socket) < MaxConnections; }
+    /**
+     * @brief Move the data of the connection in transparent access mode while the modem is in data mode.
+     * @returns The same as service.
+    */
+    ErrorType serviceDataMode(const Socket socket);
+    /**
+     * @brief Read from the modem for a connection that has data waiting if there is room for it.
+     * @param[in] socket The connection id.
+     * @param[in] wait Data mode only. The longest to wait for data to arrive.
+     * @returns True if anything was read.
+    */
+    bool serviceReceive(const Socket socket, const Milliseconds wait = 0);
+    /**
+     * @brief Send a segment of the data at the front of a connection's queue if the send window allows it.
+     * @returns True if anything was sent.
+    */
+    bool serviceSend(const Socket socket, std::vector<Completion> &completions);
+    /**
+     * @brief Give the received data to the receives that are waiting and time out those that have waited too long.
+     * @pre The connection's semaphore is held.
+    */
+    void completeReceives(Connection &connection, std::vector<Completion> &completions);
+    /**
+     * @brief Fail every queued send and receive.
+     * @pre The connection's semaphore is held.
+    */
+    void failAll(Connection &connection, const ErrorType error, std::vector<Completion> &completions);
+    /**
+     * @brief Call the callbacks collected while a semaphore was held.
+     * @pre No semaphore is held.
+    */
+    static void complete(std::vector<Completion> &completions);
+};
+
+#endif // __SOCKET_MULTIPLEXER_MODULE_HPP__
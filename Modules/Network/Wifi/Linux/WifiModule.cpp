@@ -1,8 +1,10 @@
 //Modules
 #include "WifiModule.hpp"
+#include "HostResolverModule.hpp"
 //C++
 #include <cassert>
 #include <cstdio>
+#include <vector>
 
 ErrorType Wifi::init() {
     return ErrorType::NotAvailable;
@@ -79,32 +81,15 @@ ErrorType Wifi::getSignalStrength(DecibelMilliWatts &signalStrength) {
 }
 
 ErrorType Wifi::hostToIp(const std::string &host, std::string &ipAddress) {
-    const std::string command1("sh -c \"getent ahosts ");
-    const std::string command2(" | awk '{print $1; exit}' | cut -d' ' -f1\"");
-    std::string commandFinal(command1.size() + command2.size() + ipAddress.size(), 0);
-    commandFinal.assign(command1);
-    commandFinal.append(host);
-    commandFinal.append(command2);
+    std::vector<ResolvedAddress> addresses;
 
-    ErrorType error = ErrorType::Failure;
-    
-    FILE* pipe = popen(commandFinal.c_str(), "r");
-    if (nullptr != pipe) {
-        const size_t bytesRead = fread(ipAddress.data(), sizeof(uint8_t), ipAddress.capacity(), pipe);
-        if (feof(pipe) || bytesRead == ipAddress.capacity()) {
-            error = ErrorType::Success;
-            ipAddress.resize(bytesRead);
-            while (ipAddress.back() == '\n') {
-                ipAddress.pop_back();
-            }
-        }
-        else if (ferror(pipe)) {
-            pclose(pipe);
-            error = ErrorType::Failure;
-        }
+    HostResolver::Init();
+    ErrorType error = HostResolver::Instance().resolveBlocking(host, addresses, ResolveTimeout);
+    if (ErrorType::Success != error) {
+        return error;
     }
 
-    return error;
+    return addresses.front().toString(ipAddress);
 }
 
 ErrorType Wifi::interfaceRoutedTo(const std::string &ipAddress, std::string &interface) {
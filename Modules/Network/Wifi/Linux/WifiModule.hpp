@@ -8,7 +8,7 @@
 #define __WIFI_MODULE_HPP__
 
 //AbstractionLayer
-#include "NetworkAbstraction.hpp"
+#include "WifiAbstraction.hpp"
 #include "Error.hpp"
 //C++
 #include <memory>
@@ -44,12 +44,16 @@ class Wifi : public WifiAbstraction {
     ErrorType setAuthMode(WifiConfig::AuthMode authMode) override { return ErrorType::NotAvailable; }
 
     private:
+    /// @brief The time to wait for another lookup of the same hostname to finish.
+    static constexpr Milliseconds ResolveTimeout = 5000;
+
     /**
      * @brief Given a hostname, get it's IP address
      * @param[in] host The hostname to get the IP address of
      * @param[out] The IP address of the host
      * @returns ErrorType::Success if the IP address was returned.
-     * @returns ErrorType::Failure otherwise.
+     * @returns The errors of HostResolver::resolveBlocking otherwise.
+     * @sa HostResolver
      */
     ErrorType hostToIp(const std::string &host, std::string &ipAddress);
     /**
@@ -139,6 +139,7 @@ ErrorType OperatingSystem::waitSemaphore(std::string &name, Milliseconds timeout
 
     std::string internalName = std::string("/").append(name);
 
+    //errno is only meaningful when the wait failed. A stale EAGAIN left over from an earlier call would otherwise wait again.
     do {
         if (0 != (result = sem_wait(semaphores[name]))) {
             if (timeRemaining > 0) {
@@ -149,7 +150,7 @@ ErrorType OperatingSystem::waitSemaphore(std::string &name, Milliseconds timeout
                 return ErrorType::Timeout;
             }
         }
-    } while (EAGAIN == errno);
+    } while (0 != result && EAGAIN == errno);
 
 
     if (0 != result) {
@@ -138,31 +138,28 @@ ErrorType OperatingSystem::deleteSemaphore(std::string name) {
 }
 
 ErrorType OperatingSystem::waitSemaphore(std::string &name, Milliseconds timeout) {
-    Milliseconds timeRemaining = timeout;
-    constexpr Milliseconds delayTime = 1;
+    constexpr long NanosecondsPerSecond = 1000000000;
+    struct timespec deadline;
     int result;
 
     if (!semaphores.contains(name)) {
         return ErrorType::NoData;
     }
 
-    std::string internalName = std::string("/").append(name);
-
-    do {
-        if (0 != (result = sem_wait(semaphores[name]))) {
-            if (timeRemaining > 0) {
-                delay(delayTime);
-            }
-            timeRemaining >= delayTime ? timeRemaining -= delayTime : timeRemaining = 0;
-            if (0 == timeRemaining) {
-                return ErrorType::Timeout;
-            }
-        }
-    } while (EAGAIN == errno);
+    //sem_timedwait only takes an absolute time on the realtime clock.
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout / 1000;
+    deadline.tv_nsec += static_cast<long>(timeout % 1000) * 1000000;
+    if (deadline.tv_nsec >= NanosecondsPerSecond) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= NanosecondsPerSecond;
+    }
 
+    //A wait interrupted by a signal is resumed with the same deadline.
+    while (0 != (result = sem_timedwait(semaphores[name], &deadline)) && EINTR == errno);
 
     if (0 != result) {
-        return toPlatformError(errno);
+        return ETIMEDOUT == errno ? ErrorType::Timeout : toPlatformError(errno);
     }
 
     return ErrorType::Success;
@@ -11,6 +11,9 @@
 #include <cstdint>
 
 //-------------------------------Time
+///@typedef Microseconds
+///Microseconds (us)
+using Microseconds = uint32_t;
 ///@typedef Milliseconds
 ///Milliseconds (ms)
 using Milliseconds = uint32_t;
@@ -30,3 +30,5 @@ add_subdirectory(${CMAKE_CURRENT_LIST_DIR}/Utilities)
 add_subdirectory(${CMAKE_CURRENT_LIST_DIR}/Applications/Logging)
 add_subdirectory(${CMAKE_CURRENT_LIST_DIR}/Applications/ChainOfResponsibility)
 add_subdirectory(${CMAKE_CURRENT_LIST_DIR}/Applications/Event)
+add_subdirectory(${CMAKE_CURRENT_LIST_DIR}/Applications/RingBuffer)
+add_subdirectory(${CMAKE_CURRENT_LIST_DIR}/Applications/Framing)